@@ -11,12 +11,16 @@
 #include "Region.hpp"
 #include <experimental/filesystem>
 #include <unordered_map>
+#include <istream>
+#include <ostream>
 #include <map>
 #include <string>
 #include <vector>
 #include <array>
 
 using std::unordered_map;
+using std::ostream;
+using std::istream;
 using std::map;
 using std::array;
 using std::string;
@@ -63,6 +67,10 @@ public:
 
 void operator+=(CigarStats& cigar_stats_a, CigarStats& cigar_stats_b);
 
+void write_to_binary(ostream& file, const CigarStats& cigar_stats);
+
+void read_from_binary(istream& file, CigarStats& cigar_stats);
+
 
 
 class BamReader{
@@ -75,6 +83,7 @@ public:
     bam_hdr_t* bam_header;
     hts_idx_t* bam_index;
     hts_itr_t* bam_iterator;
+    hts_itr_multi_t* bam_multi_iterator;
     bam1_t* alignment;
 
     // Bit operations
@@ -87,6 +96,7 @@ public:
     int ref_id;
     uint64_t region_start;
     uint64_t region_stop;
+    int64_t min_alignment_start;    // Alignments that start before this (0-based) are skipped
     AlignedSegment aligned_segment;
 
     /// Methods ///
@@ -96,6 +106,14 @@ public:
     void free_hts_structs();
     void initialize_hts_structs();
     void initialize_region(string& ref_name, uint64_t start, uint64_t stop);
+
+    // Iterate the alignments overlapping any of the regions (0-based, [start, stop)), with one iterator that merges
+    // overlapping and adjacent regions and yields each alignment once, in file order
+    void initialize_regions(const vector<Region>& regions);
+
+    // Skip the alignments that start before a (0-based) reference position, without decoding them, until the region
+    // is reinitialized. Used to give alignments that span several regions to only one of them.
+    void skip_alignments_before(uint64_t position);
     void load_alignment(AlignedSegment& aligned_segment, bam1_t* alignment, bam_hdr_t* bam_header);
     bool next_alignment(AlignedSegment& aligned_segment,
                         uint16_t map_quality_cutoff=0,
@@ -105,8 +123,11 @@ public:
 private:
     /// Attributes ///
 
-    /// Methods ///
+    // The multi-region iterator refers to these names, so they must outlive it
+    vector<string> multi_region_names;
 
+    /// Methods ///
+    void free_iterators();
 };
 
 
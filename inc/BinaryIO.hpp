@@ -7,6 +7,7 @@
 #include <istream>
 #include <string>
 #include <vector>
+#include <map>
 #include <stdexcept>
 #include <fcntl.h>
 #include <unistd.h>
@@ -18,6 +19,7 @@ using std::string;
 using std::cout;
 using std::cerr;
 using std::vector;
+using std::map;
 using std::runtime_error;
 
 
@@ -65,6 +67,72 @@ template<class T> void read_vector_from_binary(istream& s, vector<T>& v, uint64_
 }
 
 
+template<class K, class V> void write_map_to_binary(ostream& s, const map<K,V>& m){
+    ///
+    /// Write the number of items in a map of values, then each key and value
+    ///
+
+    write_value_to_binary(s, uint64_t(m.size()));
+
+    for (auto& [key, value]: m){
+        write_value_to_binary(s, key);
+        write_value_to_binary(s, value);
+    }
+}
+
+
+template<class K, class K2, class V> void write_map_to_binary(ostream& s, const map <K, map<K2,V> >& m){
+    ///
+    /// Write the number of items in a map of maps, then each key and map
+    ///
+
+    write_value_to_binary(s, uint64_t(m.size()));
+
+    for (auto& [key, value]: m){
+        write_value_to_binary(s, key);
+        write_map_to_binary(s, value);
+    }
+}
+
+
+template<class K, class V> void read_map_from_binary(istream& s, map<K,V>& m){
+    ///
+    /// Replace the contents of a map with a map written by write_map_to_binary
+    ///
+
+    uint64_t length;
+    s.read(reinterpret_cast<char*>(&length), sizeof(uint64_t));
+
+    m.clear();
+
+    for (uint64_t i=0; i<length and s; i++){
+        K key;
+        V value;
+        s.read(reinterpret_cast<char*>(&key), sizeof(K));
+        s.read(reinterpret_cast<char*>(&value), sizeof(V));
+        m.emplace_hint(m.end(), key, value);
+    }
+}
+
+
+template<class K, class K2, class V> void read_map_from_binary(istream& s, map <K, map<K2,V> >& m){
+    ///
+    /// Replace the contents of a map of maps with one written by write_map_to_binary
+    ///
+
+    uint64_t length;
+    s.read(reinterpret_cast<char*>(&length), sizeof(uint64_t));
+
+    m.clear();
+
+    for (uint64_t i=0; i<length and s; i++){
+        K key;
+        s.read(reinterpret_cast<char*>(&key), sizeof(K));
+        read_map_from_binary(s, m[key]);
+    }
+}
+
+
 void pread_bytes(int file_descriptor, char* buffer_pointer, size_t bytes_to_read, off_t& byte_index);
 
 
@@ -0,0 +1,158 @@
+#ifndef RUNLENGTH_ANALYSIS_CHECKPOINT_HPP
+#define RUNLENGTH_ANALYSIS_CHECKPOINT_HPP
+
+#include "Region.hpp"
+#include "Matrix.hpp"
+#include <experimental/filesystem>
+#include <stdexcept>
+#include <fstream>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using std::experimental::filesystem::path;
+using std::experimental::filesystem::rename;
+using std::chrono::steady_clock;
+using std::chrono::duration;
+using std::runtime_error;
+using std::ofstream;
+using std::ifstream;
+using std::ostream;
+using std::istream;
+using std::string;
+using std::vector;
+
+
+///
+/// Periodically saves the partial results of each thread of a region-parallel measurement, with the indexes of the
+/// regions they contain, so that a preempted run can be resumed. Each thread's partial result is rewritten (atomically,
+/// by renaming) in '<output_directory>/checkpoint/checkpoint_<run>_<thread>.bin' after it completes a region, at most
+/// once per interval. A resumed run skips the regions completed by previous runs and adds their partial results to its
+/// own, and saves its own partials under a new run number, so that the files of every run stay valid. Checkpoints are
+/// only resumed by a run with the same regions and the same input files (by path and size).
+///
+/// Partial results are written and read with write_to_binary(ostream&, const T&) and read_from_binary(istream&, T&),
+/// and added with operator+=(T&, T&).
+///
+class Checkpoint {
+public:
+    /// Attributes ///
+    path directory;
+    double interval;            // Minimum seconds between saves of a thread's partial result, or 0 to never save
+
+    /// Methods ///
+
+    // Does nothing
+    Checkpoint();
+
+    // Find the checkpoints of previous runs for these regions and inputs (files or directories, e.g. the BAM and the
+    // reads). They must be resumed, or else removed.
+    Checkpoint(path output_directory,
+               const vector<Region>& regions,
+               const vector<path>& input_paths,
+               uint16_t max_threads,
+               bool resume,
+               double interval);
+
+    // Whether a region was completed by a previous run, and should be skipped
+    bool is_completed(size_t region_index) const;
+    size_t get_n_completed() const;
+
+    // Add the partial results of all previous runs to 'result', which must have the same shape (e.g. max runlength)
+    template <class T> void load(T& result) const;
+
+    // Record that a thread has completed a region (included in 'partial'), and save 'partial' if the interval has passed
+    template <class T> void update(uint16_t thread_index, size_t region_index, const T& partial);
+
+    // Save a thread's partial result, if it has completed any regions since it was last saved
+    template <class T> void save(uint16_t thread_index, const T& partial);
+
+    // Delete the checkpoints of this and previous runs, once the final result has been written
+    void remove_files() const;
+
+private:
+    /// Attributes ///
+    uint64_t run_index;
+    uint64_t inputs_hash;
+    uint64_t n_regions;
+    vector<bool> completed;
+    vector<path> previous_paths;
+    vector <vector <uint64_t> > completed_per_thread;
+    vector<size_t> n_saved_per_thread;
+    vector<steady_clock::time_point> save_times;
+
+    /// Methods ///
+    path get_path(uint64_t run, uint16_t thread_index) const;
+
+    // Parse 'checkpoint_<run>_<thread>.bin', returning false for any other name
+    static bool parse_name(const string& name, uint64_t& run, uint16_t& thread_index);
+
+    void write_header(ostream& file, uint16_t thread_index) const;
+    void read_header(istream& file, path file_path, vector<uint64_t>& region_indexes) const;
+};
+
+
+template <class T> void Checkpoint::load(T& result) const{
+    vector<uint64_t> region_indexes;
+
+    for (auto& file_path: this->previous_paths){
+        ifstream file(file_path, std::ios::binary);
+        this->read_header(file, file_path, region_indexes);
+
+        // Copy the result so that the partial has the same shape
+        T partial = result;
+        read_from_binary(file, partial);
+
+        if (not file){
+            throw runtime_error("ERROR: checkpoint is truncated: " + file_path.string());
+        }
+
+        result += partial;
+    }
+}
+
+
+template <class T> void Checkpoint::update(uint16_t thread_index, size_t region_index, const T& partial){
+    if (this->interval <= 0){
+        return;
+    }
+
+    this->completed_per_thread.at(thread_index).emplace_back(region_index);
+
+    if (duration<double>(steady_clock::now() - this->save_times[thread_index]).count() >= this->interval){
+        this->save(thread_index, partial);
+    }
+}
+
+
+template <class T> void Checkpoint::save(uint16_t thread_index, const T& partial){
+    if (this->interval <= 0 or this->completed_per_thread.at(thread_index).size() == this->n_saved_per_thread[thread_index]){
+        return;
+    }
+
+    path output_path = this->get_path(this->run_index, thread_index);
+    path temporary_path = output_path.string() + ".tmp";
+
+    ofstream file(temporary_path, std::ios::binary);
+
+    if (not file.is_open()){
+        throw runtime_error("ERROR: could not write checkpoint: " + temporary_path.string());
+    }
+
+    this->write_header(file, thread_index);
+    write_to_binary(file, partial);
+    file.close();
+
+    if (not file){
+        throw runtime_error("ERROR: could not write checkpoint: " + temporary_path.string());
+    }
+
+    // Replace the previous checkpoint of this thread only once the new one is complete
+    rename(temporary_path, output_path);
+
+    this->n_saved_per_thread[thread_index] = this->completed_per_thread[thread_index].size();
+    this->save_times[thread_index] = steady_clock::now();
+}
+
+
+#endif //RUNLENGTH_ANALYSIS_CHECKPOINT_HPP
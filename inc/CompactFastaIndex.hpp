@@ -0,0 +1,110 @@
+#ifndef RUNLENGTH_ANALYSIS_COMPACTFASTAINDEX_HPP
+#define RUNLENGTH_ANALYSIS_COMPACTFASTAINDEX_HPP
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <experimental/filesystem>
+
+using std::string;
+using std::vector;
+using std::pair;
+using std::runtime_error;
+using std::experimental::filesystem::path;
+
+
+class FastaIndex {
+public:
+    uint64_t byte_index;    // Where in the fasta is the start of the sequence
+    uint64_t length;        // How long is the sequence
+
+    FastaIndex(uint64_t byte_index, uint64_t length);
+    FastaIndex();
+
+    uint64_t size();
+};
+
+
+///
+/// Immutable name -> FastaIndex lookup, stored as one binary file beside the .fai and memory mapped when loaded, so
+/// that it costs no allocation at startup and can be shared by every reader of the same FASTA. The file holds:
+///
+///     header      magic, version, size of the FASTA and .fai it was built from, n_sequences, arena size, bits,
+///                 modification time of the FASTA and .fai (ns), reserved
+///     byte_index  uint64 per sequence, in FASTA order
+///     length      uint64 per sequence, in FASTA order
+///     hashes      uint64 per sequence, sorted
+///     order       uint32 per sequence, the FASTA order index of each sorted hash
+///     directory   uint32 per bucket (2^bits + 1), the first sorted hash whose top bits are >= the bucket
+///     offsets     uint32 per sequence + 1, the start of each name in the arena
+///     arena       all names concatenated, without separators
+///
+/// Every section starts at a multiple of 8 bytes. A lookup hashes the name, jumps to its bucket in the directory, and
+/// compares names only for matching hashes, so it touches a handful of cache lines regardless of the number of reads.
+///
+class CompactFastaIndex {
+public:
+    /// Attributes ///
+    path file_path;
+
+    static const uint64_t magic = 0x5844494146454c52;   // "RLEFAIDX" in little endian
+    static const uint64_t version = 2;
+    static const uint64_t header_size = 10*sizeof(uint64_t);
+
+    /// Methods ///
+    CompactFastaIndex(path file_path);
+    CompactFastaIndex(const CompactFastaIndex&) = delete;
+    CompactFastaIndex& operator=(const CompactFastaIndex&) = delete;
+    ~CompactFastaIndex();
+
+    // Convert a samtools .fai to the binary format, via a temporary file which is renamed once complete
+    static void build(path fai_path, path fasta_path, path output_path);
+
+    // Whether the file at file_path exists and was built from the current versions of the FASTA and .fai
+    static bool is_up_to_date(path file_path, path fai_path, path fasta_path);
+
+    // Whether the .fai describes the current version of the FASTA: it must not be older than the FASTA, and if the
+    // compact index at file_path was built from this .fai, the FASTA must not have changed since
+    static bool is_fai_up_to_date(path file_path, path fai_path, path fasta_path);
+
+    // Nanoseconds since the epoch
+    static uint64_t get_modification_time(path file_path);
+
+    static uint64_t hash(const char* s, size_t length);
+
+    // Return the FASTA order index of a name, or -1 if it isn't in the index
+    int64_t find(const string& name);
+    bool find(const string& name, FastaIndex& index);
+
+    FastaIndex get_index(uint64_t i);
+    string get_name(uint64_t i);
+    size_t size();
+
+private:
+    /// Attributes ///
+    int file_descriptor;
+    const char* data;
+    uint64_t file_length;
+
+    uint64_t n_sequences;
+    uint64_t arena_size;
+    uint64_t directory_bits;
+
+    const uint64_t* byte_indexes;
+    const uint64_t* lengths;
+    const uint64_t* hashes;
+    const uint32_t* order;
+    const uint32_t* directory;
+    const uint32_t* name_offsets;
+    const char* names;
+
+    /// Methods ///
+    void read_header();
+
+    // Read only the header of the file at file_path, returning false if it is missing or too short
+    static bool read_file_header(path file_path, uint64_t header[10]);
+};
+
+
+#endif //RUNLENGTH_ANALYSIS_COMPACTFASTAINDEX_HPP
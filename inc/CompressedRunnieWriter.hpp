@@ -2,8 +2,6 @@
 #ifndef RUNLENGTH_ANALYSIS_COMPRESSEDRUNNIEWRITER_HPP
 #define RUNLENGTH_ANALYSIS_COMPRESSEDRUNNIEWRITER_HPP
 
-#include "boost/icl/interval_map.hpp"
-#include "boost/icl/interval.hpp"
 #include "Miscellaneous.hpp"
 #include "RunnieReader.hpp"
 #include <utility>
@@ -14,9 +12,6 @@
 #include <stdexcept>
 #include <experimental/filesystem>
 
-using boost::icl::interval_map;
-using boost::icl::interval;
-using boost::icl::total_enricher;
 using std::pair;
 using std::string;
 using std::to_string;
@@ -27,8 +22,6 @@ using std::runtime_error;
 using std::experimental::filesystem::path;
 using std::experimental::filesystem::create_directories;
 
-using lower_interval_map = interval_map<double,uint8_t,total_enricher>;
-
 class CompressedRunnieIndex {
 public:
     /// Attributes ///
@@ -56,13 +49,24 @@ public:
     // What is the unit size of that channel
     static const vector<uint64_t> channel_sizes;
 
-    // Interval data structures used to initialize the interval map
+    // Interval data structures used to initialize the lookup table
     vector <pair <double,double> > scale_intervals;
     vector < vector <pair <double,double> > > shape_intervals;
 
-    // The interval map encodes any given pair of scale/shape.
-    // The first tree is for scale, which then refers to a second tree for shape, which finds the encoding
-    interval_map < double,lower_interval_map,total_enricher > recursive_interval_map = interval_map < double,lower_interval_map,total_enricher>();
+    // The lookup table encodes any given pair of scale/shape. scale_bounds is the lower bound of every scale interval
+    // followed by the upper bound of the last one. The shape bounds of every scale interval are stored the same way,
+    // concatenated into one vector, starting at shape_bound_offsets[i]. Encodings are assigned sequentially, so the
+    // encoding of shape interval j in scale interval i is encoding_offsets[i] + j.
+    vector<double> scale_bounds;
+    vector<double> shape_bounds;
+    vector<uint32_t> shape_bound_offsets;
+    vector<uint8_t> encoding_offsets;
+
+    // The most shape intervals in any scale interval, which sets the number of search steps in fetch_encodings
+    uint32_t max_shape_intervals;
+
+    // Reused for every sequence so that encoding a read doesn't allocate
+    vector<uint8_t> encodings;
 
     // When writing the binary file, this vector is appended, so the position of each sequence is stored
     vector<CompressedRunnieIndex> indexes;
@@ -70,8 +74,9 @@ public:
     /// Methods ///
     CompressedRunnieWriter(path file_path, path params_path);
     void load_parameters();
-    void build_recursive_interval_tree();
+    void build_lookup_table();
     uint8_t fetch_encoding(double scale, double shape);
+    void fetch_encodings(vector<uint8_t>& encodings, vector<float>& scales, vector<float>& shapes);
 
     void write_sequence(RunnieSequenceElement& sequence);
     void write_sequence_block(RunnieSequenceElement& sequence);
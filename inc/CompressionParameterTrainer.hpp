@@ -0,0 +1,97 @@
+#ifndef RUNLENGTH_ANALYSIS_COMPRESSIONPARAMETERTRAINER_HPP
+#define RUNLENGTH_ANALYSIS_COMPRESSIONPARAMETERTRAINER_HPP
+
+#include "RunnieReader.hpp"
+#include "QuadLoss.hpp"
+#include "Quadrant.hpp"
+#include <experimental/filesystem>
+#include <utility>
+#include <vector>
+#include <string>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using std::experimental::filesystem::path;
+using std::priority_queue;
+using std::vector;
+using std::string;
+using std::pair;
+using std::thread;
+using std::mutex;
+using std::condition_variable;
+
+
+///
+/// One rectangle of the codebook. Its points are the contiguous range [start, stop) of the trainer's sorted points
+///
+class CodebookCell{
+public:
+    double loss;
+    float lower;
+    float upper;
+    size_t start;
+    size_t stop;
+    uint32_t strip_index;
+
+    CodebookCell(double loss, float lower, float upper, size_t start, size_t stop, uint32_t strip_index=0);
+};
+
+
+bool operator<(const CodebookCell& a, const CodebookCell& b);
+
+
+///
+/// Learns the (scale, shape) intervals that CompressedRunnieWriter::load_parameters reads. A random sample of points is
+/// drawn from any number of Runnie directories, then the scale axis is greedily split into strips, and each strip is
+/// greedily split along the shape axis, always splitting whichever interval has the largest DiscreteWeibullLoss at its
+/// midpoint. Losses are summed over thread-local partial DiscreteWeibullLoss objects, which are accumulated by a pool of
+/// workers that lives for the duration of train(), so that no threads are launched per loss.
+///
+class CompressionParameterTrainer{
+public:
+    /// Attributes ///
+    BoundingBox boundary;
+    size_t distribution_size;
+    uint16_t max_threads;
+
+    // Sampled (scale, shape) points, sorted by scale, and then by shape within each strip once the strips are known
+    vector<QuadCoordinate> points;
+
+    // The trained codebook: one scale interval per strip, and a vector of shape bounds for each strip
+    vector <pair <float,float> > scale_intervals;
+    vector <vector <float> > shape_bounds;
+
+    /// Methods ///
+    CompressionParameterTrainer(BoundingBox boundary, size_t distribution_size=50, uint16_t max_threads=1);
+    ~CompressionParameterTrainer();
+    void sample_points(vector<path>& input_dirs, uint64_t sample_size, uint64_t seed=0);
+    void train(uint64_t n_scale_intervals, uint64_t n_encodings);
+    double calculate_loss(size_t start, size_t stop);
+    void write_parameters(path output_path);
+
+private:
+    /// Attributes ///
+    // Worker pool for calculate_loss. Each job is the range [job_start, job_stop), split into one slice per worker.
+    vector<thread> workers;
+    vector<DiscreteWeibullLoss> partial_losses;
+    mutex pool_mutex;
+    condition_variable job_ready;
+    condition_variable job_done;
+    uint64_t job_generation = 0;
+    size_t n_pending_workers = 0;
+    size_t job_start = 0;
+    size_t job_stop = 0;
+    bool stopping = false;
+
+    /// Methods ///
+    void start_workers();
+    void stop_workers();
+    void run_worker(size_t worker_index);
+    void split_scale_intervals(uint64_t n_scale_intervals, vector<CodebookCell>& strips);
+    void split_shape_intervals(uint64_t n_encodings, vector<CodebookCell>& strips);
+};
+
+
+#endif //RUNLENGTH_ANALYSIS_COMPRESSIONPARAMETERTRAINER_HPP
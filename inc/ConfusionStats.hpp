@@ -3,11 +3,15 @@
 #define RUNLENGTH_ANALYSIS_CONFUSIONSTATS_HPP
 
 #include <map>
+#include <istream>
+#include <ostream>
 #include <string>
 #include <vector>
 #include <experimental/filesystem>
 
 using std::map;
+using std::ostream;
+using std::istream;
 using std::string;
 using std::vector;
 using std::experimental::filesystem::path;
@@ -40,11 +44,17 @@ public:
 
 void operator+=(ConfusionStats& matrix_a, ConfusionStats& matrix_b);
 
+void write_to_binary(ostream& file, const ConfusionStats& confusion_stats);
+
+void read_from_binary(istream& file, ConfusionStats& confusion_stats);
+
 void measure_confusion_stats_from_shasta(path input_directory,
         path reference_fasta_path,
         path output_directory,
         uint16_t max_threads,
-        path bed_path=path());
+        path bed_path=path(),
+        bool resume=false,
+        double checkpoint_interval=600);
 
 
 #endif //RUNLENGTH_ANALYSIS_CONFUSIONSTATS_HPP
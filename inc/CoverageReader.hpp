@@ -1,8 +1,10 @@
-
 #ifndef RUNLENGTH_ANALYSIS_COVERAGEREADER_H
 #define RUNLENGTH_ANALYSIS_COVERAGEREADER_H
 
 #include "CoverageSegment.hpp"
+#include "CoverageWriter.hpp"
+#include "ShastaReader.hpp"
+#include "MarginPolishReader.hpp"
 #include <unordered_map>
 #include <string>
 #include <vector>
@@ -17,20 +19,79 @@ using std::ifstream;
 using std::experimental::filesystem::path;
 
 
+///
+/// Reads the single binary file written by CoverageWriter. The file is memory mapped, so fetching a segment by name or
+/// by its position in the file only touches that segment's block. This class has the same interface as ShastaReader
+/// and MarginPolishReader so it can be used in their place by the coverage templates, where the `index` maps every
+/// segment name to the one file path.
+///
 class CoverageReader {
 public:
     /// Attributes ///
-    path directory_path;
+    path file_path;
     unordered_map<string,path> file_paths;
+    bool store_length_consensus;
+    bool store_coverage_data;
+    bool store_vertex_labels;
+
+    vector<CoverageIndex> indexes;
 
     /// Methods ///
+    CoverageReader(path file_path, bool store_length_consensus=false, bool store_coverage_data=true);
+    CoverageReader(const CoverageReader&) = delete;
+    CoverageReader& operator=(const CoverageReader&) = delete;
+    ~CoverageReader();
+
+    // Map every segment name in the file to the file path
     void index();
+
+    // Return a copy of the read indexes
     unordered_map<string,path> get_index();
     void set_index(unordered_map<string, path>& file_paths);
 
-    void fetch_read(CoverageSegment& mp_segment, string& read_name);
-    void fetch_consensus_sequence(CoverageSegment& mp_segment, string& read_name);
+    // Fetch a segment based on its number (ordering in file, 0-based) or its name
+    void fetch_read(CoverageSegment& segment, uint64_t read_number);
+    void fetch_read(CoverageSegment& segment, string& read_name);
+    void fetch_consensus_sequence(CoverageSegment& segment, string& read_name);
+
+    size_t get_read_count();
+    const string& get_read_name(uint64_t read_number);
+
+    // Which of the optional per-position columns were stored by the writer
+    bool has_length_consensus();
+    bool has_vertex_labels();
+
+private:
+    /// Attributes ///
+    int file_descriptor;
+    const char* data;
+    size_t file_length;
+
+    uint64_t indexes_start_position;
+    uint64_t channel_metadata_start_position;
+    uint64_t n_channels;
+    vector<uint64_t> channel_sizes;
+    bool contains_length_consensus;
+    bool contains_vertex_labels;
+
+    unordered_map<string,size_t> index_map;
+
+    // Reused for every segment, when only the n-fold coverage is needed
+    vector<float> weights;
+
+    /// Methods ///
+    void read_footer();
+    void read_channel_metadata();
+    void read_indexes();
+    size_t find_read_number(string& read_name);
+    const char* get_pointer(uint64_t byte_index, uint64_t n_bytes);
+    template<class T> void copy_column(vector<T>& v, const char*& p, uint64_t length);
 };
 
 
+// Make a directory reader load every optional column that its format has, before it is packed by a CoverageWriter
+void configure_reader(ShastaReader& reader);
+void configure_reader(MarginPolishReader& reader);
+
+
 #endif //RUNLENGTH_ANALYSIS_COVERAGEREADER_H
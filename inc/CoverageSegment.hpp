@@ -1,4 +1,3 @@
-
 #ifndef RUNLENGTH_ANALYSIS_COVERAGESEGMENT_HPP
 #define RUNLENGTH_ANALYSIS_COVERAGESEGMENT_HPP
 
@@ -15,18 +14,78 @@ using std::string;
 using std::cout;
 
 
+class CoverageSegment;
+
+
+///
+/// Non-owning view of the observations at one position of a CoverageSegment. Elements are unpacked into
+/// CoverageElements by value as they are accessed, so iterating a pileup never allocates.
+///
+class CoveragePileup{
+public:
+    class iterator{
+    public:
+        const CoverageSegment* segment;
+        uint32_t index;
+
+        CoverageElement operator*() const;
+        iterator& operator++();
+        bool operator!=(const iterator& other) const;
+    };
+
+    /// Attributes ///
+    const CoverageSegment* segment;
+    uint32_t start;
+    uint32_t stop;
+
+    /// Methods ///
+    CoveragePileup();
+    CoveragePileup(const CoverageSegment* segment, uint32_t start, uint32_t stop);
+    CoverageElement operator[](size_t i) const;
+    size_t size() const;
+    bool empty() const;
+    iterator begin() const;
+    iterator end() const;
+};
+
+
+///
+/// The consensus of one segment, with all of its coverage observations stored in compressed sparse row form: the
+/// observations at position i are the range [coverage_offsets[i], coverage_offsets[i+1]) of the coverage_bases,
+/// coverage_lengths and coverage_weights arrays. Each base is packed with its reversal flag (high bit) into one byte,
+/// so an observation takes 7 bytes and a position only 4 more, with no per-position allocation. Clearing keeps the
+/// capacity of every array, so one segment can be reused for every fetch without allocating.
+///
 class CoverageSegment{
 public:
     /// Attributes ///
     string name;
-    vector <vector <CoverageElement> > coverage_data;
     string sequence;
     vector<uint16_t> lengths;
     vector<uint16_t> n_coverage;
     vector<bool> is_vertex;
 
+    vector<uint32_t> coverage_offsets;
+    vector<uint8_t> coverage_bases;
+    vector<uint16_t> coverage_lengths;
+    vector<float> coverage_weights;
+
+    static const uint8_t reversal_mask = 0x80;
+
     /// Methods ///
+    CoverageSegment();
+    void clear();
+    void add_observation(char base, uint16_t length, bool reversal, float weight);
+    void end_position();
+    size_t n_positions() const;
+    size_t n_observations() const;
+    CoveragePileup get_pileup(size_t position) const;
+    CoverageElement get_observation(size_t observation_index) const;
     void print();
+
+    static uint8_t pack_base(char base, bool reversal);
+    static char unpack_base(uint8_t packed_base);
+    static bool unpack_reversal(uint8_t packed_base);
 };
 
-#endif //RUNLENGTH_ANALYSIS_COVERAGEELEMENT_HPP
+#endif //RUNLENGTH_ANALYSIS_COVERAGESEGMENT_HPP
@@ -0,0 +1,67 @@
+#ifndef RUNLENGTH_ANALYSIS_COVERAGEWRITER_HPP
+#define RUNLENGTH_ANALYSIS_COVERAGEWRITER_HPP
+
+#include "CoverageSegment.hpp"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdexcept>
+#include <experimental/filesystem>
+
+using std::string;
+using std::vector;
+using std::ofstream;
+using std::runtime_error;
+using std::experimental::filesystem::path;
+
+
+class CoverageIndex{
+public:
+    /// Attributes ///
+    uint64_t byte_index;
+    uint64_t n_positions;
+    uint64_t n_observations;
+    uint64_t name_length;
+    string name;
+};
+
+
+///
+/// Packs many CoverageSegments (e.g. a whole Shasta or MarginPolish directory) into one binary file that can be read
+/// by CoverageReader. Each segment is one block of columns: the consensus sequence, optionally the consensus lengths
+/// and vertex labels, then the per-position observation offsets (relative to the segment), followed by one column for
+/// each field of the observations (packed base and reversal, length, weight), exactly as they are stored in the
+/// CoverageSegment. The table of indexes, channel metadata and footer follow the same layout as RunlengthWriter.
+///
+class CoverageWriter {
+public:
+    /// Attributes ///
+    path file_path;
+    ofstream file;
+
+    bool store_length_consensus;
+    bool store_vertex_labels;
+
+    // How many observation channels accompany each position, and what is the unit size of each
+    static const uint64_t n_channels = 3;
+    static const vector<uint64_t> channel_sizes;
+
+    // When writing the binary file, this vector is appended, so the position of each segment is stored
+    vector<CoverageIndex> indexes;
+
+    /// Methods ///
+    CoverageWriter(path file_path, bool store_length_consensus, bool store_vertex_labels);
+
+    void write_segment(CoverageSegment& segment);
+    void write_index(CoverageIndex& index);
+    void write_indexes();
+
+private:
+    /// Attributes ///
+
+    // Reused for every segment, so that packing vertex labels doesn't allocate
+    vector<uint8_t> is_vertex;
+};
+
+
+#endif //RUNLENGTH_ANALYSIS_COVERAGEWRITER_HPP
@@ -1,8 +1,11 @@
 #ifndef RUNLENGTH_ANALYSIS_CPP_FASTAREADER_H
 #define RUNLENGTH_ANALYSIS_CPP_FASTAREADER_H
 #include "SequenceElement.hpp"
+#include "CompactFastaIndex.hpp"
 #include "Pileup.hpp"
 #include <unordered_map>
+#include <atomic>
+#include <memory>
 #include <utility>
 #include <vector>
 #include <string>
@@ -11,6 +14,8 @@
 #include <experimental/filesystem>
 
 using std::unordered_map;
+using std::atomic;
+using std::shared_ptr;
 using std::pair;
 using std::vector;
 using std::string;
@@ -18,32 +23,46 @@ using std::ifstream;
 using std::experimental::filesystem::path;
 
 
-class FastaIndex {
+///
+/// One line of a samtools .fai: where a sequence starts in the FASTA, how long it is, and how its lines are wrapped
+///
+class FastaIndexRecord {
 public:
-    uint64_t byte_index;    // Where in the fasta is the start of the sequence
-    uint64_t length;        // How long is the sequence
-
-    FastaIndex(uint64_t byte_index, uint64_t length);
-    FastaIndex();
-
-    uint64_t size();
+    string name;
+    uint64_t length;        // Number of bases in the sequence
+    uint64_t byte_index;    // Byte offset of the first base
+    uint64_t line_bases;    // Number of bases per line
+    uint64_t line_width;    // Number of bytes per line, including the newline
 };
 
 
 void get_vector_from_index_map(vector< pair <string,FastaIndex> >& items, unordered_map<string,FastaIndex>& map_object);
 
 
+// Thread worker which indexes every sequence whose header falls within each of a series of byte ranges of a FASTA
+void index_fasta_chunks(const char* data,
+                        uint64_t file_length,
+                        vector <pair <uint64_t, uint64_t> >& chunk_bounds,
+                        vector <vector <FastaIndexRecord> >& chunk_records,
+                        atomic<uint64_t>& job_index);
+
+
 class FastaReader{
 public:
     /// Attributes ///
     path file_path;
     path index_path;
+    path compact_index_path;
     char header_symbol;
     string eof_placeholder_name;
     uint64_t line_index;
     bool end_of_file;
-    vector <FastaIndex> sequential_read_offsets;
-    unordered_map <string, size_t > read_indexes_by_name;
+
+    // Immutable and memory mapped, so it is shared (not copied) by readers that adopt it
+    shared_ptr <CompactFastaIndex> compact_index;
+
+    // Smallest byte range that is given to one thread when building an index
+    static const uint64_t minimum_index_chunk_size = 16*1024*1024;
 
     /// Methods ///
     FastaReader(path file_path);
@@ -53,11 +72,18 @@ public:
     void next_element(SequenceElement& element);
 
     // Generate index if needed, otherwise load index
-    void index();
+    void index(uint16_t max_threads=1);
 
     // Return a copy of the read indexes
     void get_indexes_mapped_by_name(unordered_map <string, FastaIndex>& indexes);
 
+    // Return a copy of the read indexes, in the order that the sequences appear in the FASTA
+    void get_indexes(vector <pair <string, FastaIndex> >& indexes);
+
+    // Look up the indexes of a subset of reads, sorted by their position in the FASTA, so that fetching them in this
+    // order reads the file sequentially
+    void get_indexes_in_file_order(const vector<string>& names, vector <pair <string, FastaIndex> >& indexes);
+
     // Set this reader's index-related attributes to match the donor FastaReader
     void adopt_index(FastaReader& donor);
 
@@ -68,8 +94,9 @@ public:
     // Create a copy of the appropriate sequence container for this reader
     SequenceElement generate_sequence_container();
 
-    // Use htslib to make an .fai
-    void build_fasta_index();
+    // If no .fai exists, or it is older than the FASTA, make a samtools compatible one (<file_path>.fai) by parsing byte
+    // ranges of the file in parallel
+    void build_fasta_index(uint16_t max_threads=1, uint64_t minimum_chunk_size=minimum_index_chunk_size);
 
 private:
     /// Attributes ///
@@ -83,8 +110,11 @@ private:
     // which precede the next header
     void read_next_sequence(SequenceElement& element);
 
-    // Read fai
+    // Load the compact index, converting the .fai to it first if it is missing or out of date
     void read_fasta_index();
+
+    // Write samtools fai, via a temporary file which is renamed once complete
+    void write_fasta_index(vector <vector <FastaIndexRecord> >& records);
 };
 
 
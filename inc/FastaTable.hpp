@@ -0,0 +1,55 @@
+#ifndef RUNLENGTH_ANALYSIS_FASTATABLE_HPP
+#define RUNLENGTH_ANALYSIS_FASTATABLE_HPP
+
+#include "CompactFastaIndex.hpp"
+#include <string_view>
+#include <string>
+#include <vector>
+#include <memory>
+#include <experimental/filesystem>
+
+using std::string_view;
+using std::unique_ptr;
+using std::string;
+using std::vector;
+using std::experimental::filesystem::path;
+
+
+///
+/// Every sequence of a FASTA, loaded into memory at once and then immutable. The file is memory mapped and split into
+/// pieces of at most piece_size bytes (so even a single chromosome is loaded by many threads), and the bases of each
+/// piece are copied directly to their final position in one contiguous arena, with line breaks removed. Names are
+/// looked up with the FASTA's CompactFastaIndex, so the table itself stores nothing per sequence but an offset.
+///
+class FastaTable {
+public:
+    /// Attributes ///
+    path fasta_path;
+    static const uint64_t piece_size = 16*1024*1024;
+
+    /// Methods ///
+    FastaTable(path fasta_path, uint16_t max_threads=1);
+    FastaTable(const FastaTable&) = delete;
+    FastaTable& operator=(const FastaTable&) = delete;
+
+    // Sequences are numbered in FASTA order
+    size_t size() const;
+    string get_name(size_t i) const;
+    uint64_t get_length(size_t i) const;
+    string_view get_sequence(size_t i) const;
+
+    // Throws if the name is not in the FASTA
+    string_view get_sequence(const string& name) const;
+
+    // Return the index of a name, or -1 if it isn't in the FASTA
+    int64_t find(const string& name) const;
+
+private:
+    /// Attributes ///
+    unique_ptr<CompactFastaIndex> compact_index;
+    unique_ptr<char[]> arena;
+    vector<uint64_t> offsets;       // The start of each sequence in the arena, and the total size at the end
+};
+
+
+#endif //RUNLENGTH_ANALYSIS_FASTATABLE_HPP
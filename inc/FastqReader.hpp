@@ -1,38 +1,69 @@
-
 #ifndef RUNLENGTH_ANALYSIS_FASTQREADER_HPP
 #define RUNLENGTH_ANALYSIS_FASTQREADER_HPP
 
-#include "IterativeSummaryStats.hpp"
-
+#include "htslib/bgzf.h"
 #include <vector>
 #include <string>
+#include <atomic>
 #include <iostream>
 #include <fstream>
 #include <experimental/filesystem>
 
 using std::vector;
 using std::string;
+using std::atomic;
 using std::ifstream;
 using std::ofstream;
 using std::experimental::filesystem::path;
 
 
+///
+/// A block of whole FASTQ records. Chunks are filtered independently so they can be distributed to threads, and the
+/// records that pass are appended to `output`, which is written in the same order the chunks were read.
+///
+class FastqChunk{
+public:
+    /// Attributes ///
+    string input;
+    string output;
+    uint64_t n_reads = 0;
+    uint64_t n_passed = 0;
+
+    /// Methods ///
+    void clear();
+};
+
+
+// Sum of the raw (ASCII) quality chars, vectorized when SSE2 is available
+uint64_t sum_quality_chars(const char* qualities, size_t length);
+
+void filter_fastq_chunk(FastqChunk& chunk, uint64_t minimum_average_quality);
+
+void filter_fastq_chunks(vector<FastqChunk>& chunks, uint64_t minimum_average_quality, atomic<uint64_t>& job_index);
+
+
 class FastqReader {
 public:
     /// Attributes ///
     path file_path;
 
+    // Approximate number of bytes read per chunk (chunks are extended to the end of the last record that they contain)
+    static const size_t chunk_size = 8*1024*1024;
+
     /// Methods ///
     FastqReader(path file_path);
 
-    void filter_by_quality(uint64_t minimum_average_quality);
-    void parse_filter_candidate(
-        string& name,
-        string& sequence,
-        string& qualities,
-        IterativeSummaryStats<uint64_t>& stats,
-        uint64_t minimum_average_quality,
-        ofstream& output_file);
+    // Default output path: beside the input, named <stem>_filtered_<quality>.fastq, with .gz if the input was gzipped
+    path get_filtered_path(uint64_t minimum_average_quality);
+
+    // Write all the reads with mean quality >= the minimum to a new file. Plain, gzip and BGZF input is supported, and
+    // the output is BGZF compressed if its name ends in .gz
+    void filter_by_quality(uint64_t minimum_average_quality, uint16_t max_threads=1);
+    void filter_by_quality(uint64_t minimum_average_quality, path output_path, uint16_t max_threads=1);
+
+private:
+    /// Methods ///
+    bool read_chunk(BGZF* input_file, FastqChunk& chunk, string& remainder);
 };
 
 #endif //RUNLENGTH_ANALYSIS_FASTQREADER_HPP
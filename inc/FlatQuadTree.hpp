@@ -0,0 +1,86 @@
+#ifndef RUNLENGTH_ANALYSIS_FLATQUADTREE_HPP
+#define RUNLENGTH_ANALYSIS_FLATQUADTREE_HPP
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <experimental/filesystem>
+#include "QuadLoss.hpp"
+#include "Quadrant.hpp"
+
+using std::vector;
+using std::string;
+using std::pair;
+using std::experimental::filesystem::path;
+
+
+class QuadNode{
+public:
+    BoundingBox boundary;
+    uint32_t first_child;   // The 4 children of a node are stored contiguously, starting at this index
+    uint32_t point_start;   // Points belonging to this node (and all its descendants) are one contiguous range
+    uint32_t n_points;
+
+    QuadNode();
+    QuadNode(BoundingBox boundary, uint32_t point_start, uint32_t n_points);
+    bool is_leaf();
+};
+
+
+///
+/// Quadtree where all nodes live in one vector and refer to their children by 32 bit index. Points are appended to a
+/// single flat vector by insert() and then bulk loaded by build(), which sorts them in Morton (Z) order so that every
+/// node's points, at every level, form one contiguous range. Child indexes follow the same TOP_LEFT, TOP_RIGHT,
+/// BOTTOM_LEFT, BOTTOM_RIGHT convention as QuadTree.
+///
+class FlatQuadTree{
+public:
+    /// Attributes ///
+
+    // Index macros
+    static const uint8_t TOP_LEFT = 0;
+    static const uint8_t TOP_RIGHT = 1;
+    static const uint8_t BOTTOM_LEFT = 2;
+    static const uint8_t BOTTOM_RIGHT = 3;
+    static const uint8_t NOT_FOUND = -1;
+    static const uint32_t NO_CHILD = -1;
+
+    // Morton codes use this many bits per axis, which also limits the depth of the tree
+    static const uint8_t max_depth = 30;
+
+    BoundingBox boundary;
+    size_t capacity;
+
+    vector<QuadNode> nodes;
+    vector<QuadCoordinate> points;
+
+    /// Methods ///
+    FlatQuadTree();
+    FlatQuadTree(BoundingBox boundary, size_t capacity=4);
+    bool insert(QuadCoordinate coordinate);
+    void reserve(size_t n_points);
+    void build();
+    void subdivide(uint32_t node_index);
+    uint8_t find_quadrant(uint32_t node_index, QuadCoordinate c);
+    void query_range(vector<QuadCoordinate>& results, BoundingBox& bounds);
+    void update_loss_from_range(BoundingBox& bounds, QuadLoss& loss_calculator);
+    void write_as_dot(path output_dir="output/", string suffix="0", bool plot=false);
+    void write_bounds(path output_dir="output/", string suffix="0");
+    void append_bounds_string(string& bounds, uint32_t node_index=0);
+    void append_dot_string(string& edges, string& labels, uint64_t& n, uint32_t node_index=0);
+    size_t size();
+
+private:
+    /// Attributes ///
+    bool is_built;
+
+    /// Methods ///
+    uint64_t get_morton_code(QuadCoordinate c);
+    void add_children(uint32_t node_index);
+    void build_node(uint32_t node_index, uint8_t level, vector <pair <uint64_t, QuadCoordinate> >& sorted_points);
+    void query_node(uint32_t node_index, vector<QuadCoordinate>& results, BoundingBox& bounds);
+    void update_loss_from_node(uint32_t node_index, BoundingBox& bounds, QuadLoss& loss_calculator);
+};
+
+
+#endif //RUNLENGTH_ANALYSIS_FLATQUADTREE_HPP
@@ -18,14 +18,18 @@ CigarStats measure_identity_from_fasta(path reads_fasta_path,
         uint16_t max_threads,
         bool per_alignment=false,
         uint64_t chunk_size=1*1000*1000,
-        vector<Region> regions={});
+        vector<Region> regions={},
+        bool resume=false,
+        double checkpoint_interval=600);
 
 CigarStats measure_identity_from_bam(path bam_path,
                                      path reference_fasta_path,
                                      uint16_t max_threads,
                                      path output_directory="",
                                      bool per_alignment=false,
-                                     uint64_t chunk_size=1*1000*1000);
+                                     uint64_t chunk_size=1*1000*1000,
+                                     bool resume=false,
+                                     double checkpoint_interval=600);
 
 
 #endif //RUNLENGTH_ANALYSIS_IDENTITY_HPP
@@ -0,0 +1,88 @@
+#ifndef RUNLENGTH_ANALYSIS_INTERVALINDEX_HPP
+#define RUNLENGTH_ANALYSIS_INTERVALINDEX_HPP
+
+#include "Region.hpp"
+#include <experimental/filesystem>
+#include <unordered_map>
+#include <utility>
+#include <string>
+#include <vector>
+#include <set>
+
+using std::experimental::filesystem::path;
+using std::unordered_map;
+using std::string;
+using std::vector;
+using std::pair;
+using std::set;
+
+
+class IntervalIndexNode {
+public:
+    /// Attributes ///
+    uint64_t start;
+    uint64_t stop;
+    uint64_t max_stop;      // Largest stop in the subtree rooted at this node
+};
+
+
+///
+/// An immutable index of half-open intervals [start, stop) (e.g. the regions of a BED file) for overlap queries. The
+/// intervals of each contig are sorted by start in one flat array, which is also an implicit binary search tree: the
+/// node at index i of level k (i has k trailing 1 bits) has children at i -/+ 2^(k-1), and stores the largest stop of
+/// its subtree. A query only descends into subtrees that can overlap it, and scans small subtrees linearly, so it reads
+/// contiguous memory and needs no pointers. All contigs share the same array.
+///
+class IntervalIndex {
+public:
+    /// Methods ///
+    IntervalIndex() = default;
+    IntervalIndex(const vector<Region>& intervals);
+    IntervalIndex(path bed_path);
+
+    size_t size() const;
+    bool empty() const;
+
+    // Intervals are numbered in sorted order: by contig in order of first appearance, then by start and stop
+    Region get_interval(size_t i) const;
+
+    // Whether any interval on contig 'name' contains the position
+    bool contains(const string& name, uint64_t position) const;
+
+    // The largest stop of the intervals on contig 'name' that start before the position, or 0 if there are none
+    uint64_t get_max_stop(const string& name, uint64_t position) const;
+
+    // Append the numbers of all intervals overlapping [start, stop) on contig 'name'
+    void find_overlaps(const string& name, uint64_t start, uint64_t stop, vector<size_t>& overlaps) const;
+
+    // Append a (query number, interval number) pair for every interval that overlaps each of the queries
+    void find_overlaps(const vector<Region>& queries, vector <pair <size_t, size_t> >& overlaps) const;
+
+    // The union of the intervals, as sorted non-overlapping regions, optionally only for some contigs
+    void get_merged_regions(vector<Region>& regions) const;
+    void get_merged_regions(vector<Region>& regions, const set<string>& names) const;
+
+    // The union of the intervals that overlap [start, stop) on contig 'name', clipped to [start, stop)
+    void get_merged_regions(vector<Region>& regions, const string& name, uint64_t start, uint64_t stop) const;
+
+private:
+    /// Attributes ///
+    vector<IntervalIndexNode> nodes;
+    vector<string> names;
+    vector<size_t> offsets;             // The first node of each contig, and the total number of nodes at the end
+    vector<int32_t> max_levels;         // The level of the root of each contig's tree
+    vector<uint64_t> prefix_max_stops;  // The largest stop of each node and the nodes before it in its contig
+    unordered_map<string, size_t> name_to_contig;
+
+    /// Methods ///
+    void initialize(const vector<Region>& intervals);
+    int32_t build(size_t contig_index);
+    template <class T> void for_each_overlap(size_t contig_index, uint64_t start, uint64_t stop, T&& fn) const;
+};
+
+
+// Whether a position is in any of a sorted list of non-overlapping regions on one contig (e.g. from get_merged_regions)
+bool contains_position(const vector<Region>& regions, uint64_t position);
+
+
+#endif //RUNLENGTH_ANALYSIS_INTERVALINDEX_HPP
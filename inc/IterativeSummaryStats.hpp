@@ -34,10 +34,24 @@ public:
 
 
 template <class T> void operator+=(IterativeSummaryStats<T>& a, IterativeSummaryStats<T>& b){
-    /// Might break the add and remove functions?? cant be bothered to test this...
+    ///
+    /// Both objects store sums shifted by their own k, so b's sums are re-shifted to a's k before adding:
+    ///     E(x-ka) = E(x-kb) + n*(kb-ka)
+    ///     E(x-ka)^2 = E(x-kb)^2 + 2*(kb-ka)*E(x-kb) + n*(kb-ka)^2
+    ///
+    if (b.n == 0){
+        return;
+    }
+    if (a.n == 0){
+        a = b;
+        return;
+    }
+
+    T d = b.k - a.k;
+
+    a.sum_of_squares += b.sum_of_squares + 2*d*b.sum + b.n*d*d;
+    a.sum += b.sum + b.n*d;
     a.n += b.n;
-    a.sum += b.sum;
-    a.sum_of_squares += b.sum_of_squares;
 }
 
 
@@ -0,0 +1,105 @@
+#ifndef RUNLENGTH_ANALYSIS_LABELEDCOVERAGEWRITER_HPP
+#define RUNLENGTH_ANALYSIS_LABELEDCOVERAGEWRITER_HPP
+
+#include "CoverageSegment.hpp"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <utility>
+#include <mutex>
+#include <stdexcept>
+#include <experimental/filesystem>
+
+using std::string;
+using std::vector;
+using std::ofstream;
+using std::mutex;
+using std::pair;
+using std::runtime_error;
+using std::experimental::filesystem::path;
+
+
+///
+/// Destination of labeled coverage CSVs, shared by all threads. Either every record (one alignment of one read to one
+/// region) goes to its own file "<output_directory>/<name>.csv", as before, or all of them go to a single file
+/// "<output_directory>/labeled_coverage.csv" with a tab separated index "labeled_coverage.csv.idx" of
+/// (name, byte offset, length) lines. Records that were larger than a thread's buffer are written as several
+/// pieces, which are listed in the index in order, so a record is the concatenation of all of the pieces with its name.
+///
+class LabeledCoverageWriter {
+public:
+    /// Attributes ///
+    path output_directory;
+    bool single_file;
+    uint64_t buffer_size;
+
+    static const string file_name;
+
+    /// Methods ///
+    LabeledCoverageWriter(path output_directory, bool single_file, uint64_t buffer_size=8*1024*1024);
+
+    path get_record_path(const string& name);
+
+    // Append a block of records to the single file, and their pieces to the index. Returns the offset of the block.
+    uint64_t append(const string& block, const vector <pair <string, pair <uint64_t, uint64_t> > >& pieces);
+
+private:
+    /// Attributes ///
+    mutex file_mutex;
+    ofstream file;
+    ofstream index_file;
+    uint64_t file_size;
+};
+
+
+///
+/// One thread's view of a LabeledCoverageWriter. Lines are formatted directly into a reusable buffer (without any
+/// temporary strings), which is only written once it holds buffer_size bytes or its record ends, so each thread makes a
+/// few large writes instead of one small one per field.
+///
+class LabeledCoverageBuffer {
+public:
+    /// Methods ///
+    LabeledCoverageBuffer(LabeledCoverageWriter& writer);
+    ~LabeledCoverageBuffer();
+
+    void start_record(const string& name);
+
+    // Write the labels and coverage of one position of the alignment (bases are given in reference orientation)
+    void write_line(
+            bool reversal,
+            char true_base,
+            uint16_t true_length,
+            char consensus_base,
+            uint16_t consensus_length,
+            const CoveragePileup& coverage_data,
+            bool is_vertex);
+
+    void end_record();
+    void flush();
+
+    // End any open record and write everything that is buffered. Errors are thrown from here, so this should be called
+    // once the last record is complete rather than relying on the destructor, which can only print them.
+    void close();
+
+private:
+    /// Attributes ///
+    LabeledCoverageWriter& writer;
+    string buffer;
+
+    // Pieces of records in the buffer that haven't been written yet, as (name, (start, length))
+    vector <pair <string, pair <uint64_t, uint64_t> > > pieces;
+
+    string record_name;
+    uint64_t record_start;
+    bool in_record;
+
+    // Only used when each record has its own file
+    ofstream record_file;
+
+    /// Methods ///
+    void append_integer(uint64_t value);
+};
+
+
+#endif //RUNLENGTH_ANALYSIS_LABELEDCOVERAGEWRITER_HPP
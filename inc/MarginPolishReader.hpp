@@ -35,6 +35,7 @@ public:
     void read_file(CoverageSegment& mp_segment, path& file_path);
     void fetch_read(CoverageSegment& mp_segment, string& read_name);
     void parse_coverage_string(CoverageSegment& mp_segment, string& line);
+    void parse_coverage_string(CoverageSegment& mp_segment, const char* start, const char* stop);
     bool parse_reversal_string(string reversal_string);
     void read_consensus_sequence_from_file(CoverageSegment& mp_segment, path& file_path);
     void fetch_consensus_sequence(CoverageSegment& mp_segment, string& read_name);
@@ -42,6 +43,9 @@ public:
 private:
     /// Attributes ///
 
+    // Reused for every file, so that reading doesn't allocate once it has grown to the size of the largest file
+    string file_buffer;
+
     /// Methods ///
 };
 
@@ -3,14 +3,17 @@
 #define RUNLENGTH_ANALYSIS_MATRIX_HPP
 
 #include "boost/multi_array.hpp"
+#include <experimental/filesystem>
 #include <algorithm>
 #include <iostream>
+#include <fstream>
 #include <stdexcept>
 #include <utility>
 #include <vector>
 #include <string>
 
 #include "DiscreteWeibull.hpp"
+#include "BinaryIO.hpp"
 #include "Base.hpp"
 
 
@@ -21,10 +24,16 @@ using std::tie;
 using std::runtime_error;
 using std::string;
 using std::to_string;
+using std::ostream;
+using std::istream;
+using std::ofstream;
+using std::ifstream;
+using std::experimental::filesystem::path;
 
 
 typedef multi_array<double,4> rle_length_matrix;
 typedef multi_array<double,2> reference_rle_length_matrix;
+typedef multi_array<uint64_t,2> reference_rle_length_histogram;
 typedef multi_array<double,3> rle_base_matrix;
 
 class RLEConfusion {
@@ -41,6 +50,10 @@ void operator+=(rle_length_matrix& matrix_a, float increment);
 
 void operator+=(rle_base_matrix& matrix_a, rle_base_matrix& matrix_b);
 
+void operator+=(reference_rle_length_histogram& matrix_a, reference_rle_length_histogram& matrix_b);
+
+void operator+=(RLEConfusion& matrix_a, RLEConfusion& matrix_b);
+
 void increment_matrix(rle_length_matrix& matrix_a, rle_length_matrix& matrix_b);
 
 void increment_matrix(rle_length_matrix& matrix_a, float increment);
@@ -71,4 +84,151 @@ string matrix_to_string(rle_length_matrix& matrix, size_t cutoff=0);
 string matrix_to_string(rle_base_matrix& matrix);
 
 
+template <class T, size_t N> void write_to_binary(ostream& file, const multi_array<T,N>& matrix){
+    ///
+    /// Write the shape of a matrix, then its elements in (C) storage order
+    ///
+    for (size_t i=0; i<N; i++){
+        write_value_to_binary(file, uint64_t(matrix.shape()[i]));
+    }
+
+    file.write(reinterpret_cast<const char*>(matrix.data()), matrix.num_elements()*sizeof(T));
+}
+
+
+template <class T, size_t N> void read_from_binary(istream& file, multi_array<T,N>& matrix){
+    ///
+    /// Read a matrix written by write_to_binary into a matrix that already has the same shape
+    ///
+    for (size_t i=0; i<N; i++){
+        uint64_t length;
+        file.read(reinterpret_cast<char*>(&length), sizeof(uint64_t));
+
+        if (not file or length != matrix.shape()[i]){
+            throw runtime_error("ERROR: shape of binary matrix does not match (axis " + to_string(i) + ")");
+        }
+    }
+
+    file.read(reinterpret_cast<char*>(matrix.data()), matrix.num_elements()*sizeof(T));
+}
+
+
+void write_to_binary(ostream& file, const RLEConfusion& confusion);
+
+void read_from_binary(istream& file, RLEConfusion& confusion);
+
+
+///
+/// Binary matrix files: a versioned header with the size of an element and the shape of the matrix, followed by the
+/// raw elements in (C) storage order, so that the counts of many runs can be summed without parsing text
+///
+/// magic (8 bytes) | version (uint64) | element size (uint64) | n dimensions (uint64) | shape (uint64 each) | elements
+///
+static const uint64_t binary_matrix_version = 1;
+
+void write_binary_matrix_header(ostream& file, uint64_t element_size, const vector<uint64_t>& shape);
+
+// Check the magic, version and element size, and read the shape
+void read_binary_matrix_header(istream& file, path file_path, uint64_t element_size, vector<uint64_t>& shape);
+
+vector<uint64_t> read_binary_matrix_shape(path file_path, uint64_t element_size=sizeof(double));
+
+
+template <class T, size_t N> void write_matrix_to_binary_file(path file_path, const multi_array<T,N>& matrix){
+    ofstream file(file_path, std::ios::binary);
+
+    if (not file.is_open()){
+        throw runtime_error("ERROR: file could not be written: " + file_path.string());
+    }
+
+    vector<uint64_t> shape(matrix.shape(), matrix.shape() + N);
+
+    write_binary_matrix_header(file, sizeof(T), shape);
+    file.write(reinterpret_cast<const char*>(matrix.data()), matrix.num_elements()*sizeof(T));
+
+    if (not file){
+        throw runtime_error("ERROR: file could not be written: " + file_path.string());
+    }
+}
+
+
+template <class T, size_t N> void add_binary_matrix_file(path file_path, multi_array<T,N>& matrix){
+    ///
+    /// Add the elements of a binary matrix file to a matrix of the same shape, reading a block at a time, so that any
+    /// number of files can be summed in the memory of one matrix
+    ///
+    ifstream file(file_path, std::ios::binary);
+
+    if (not file.is_open()){
+        throw runtime_error("ERROR: file could not be read: " + file_path.string());
+    }
+
+    vector<uint64_t> shape;
+    read_binary_matrix_header(file, file_path, sizeof(T), shape);
+
+    if (shape.size() != N or not std::equal(shape.begin(), shape.end(), matrix.shape())){
+        throw runtime_error("ERROR: shape of binary matrix does not match: " + file_path.string());
+    }
+
+    const size_t block_size = 64*1024;
+    vector<T> block(block_size);
+
+    T* element = matrix.data();
+    size_t n_remaining = matrix.num_elements();
+
+    while (n_remaining > 0){
+        size_t n = std::min(block_size, n_remaining);
+        file.read(reinterpret_cast<char*>(block.data()), n*sizeof(T));
+
+        if (not file){
+            throw runtime_error("ERROR: binary matrix is truncated: " + file_path.string());
+        }
+
+        for (size_t i=0; i<n; i++){
+            element[i] += block[i];
+        }
+
+        element += n;
+        n_remaining -= n;
+    }
+}
+
+
+template <class T, size_t N> void read_matrix_from_binary_file(path file_path, multi_array<T,N>& matrix){
+    ///
+    /// Resize the matrix to the shape in the file and fill it with the elements of the file
+    ///
+    vector<uint64_t> shape = read_binary_matrix_shape(file_path, sizeof(T));
+
+    if (shape.size() != N){
+        throw runtime_error("ERROR: binary matrix has " + to_string(shape.size()) + " dimensions, expected " +
+                            to_string(N) + ": " + file_path.string());
+    }
+
+    matrix.resize(shape);
+    std::fill_n(matrix.data(), matrix.num_elements(), T(0));
+
+    add_binary_matrix_file(file_path, matrix);
+}
+
+
+template <class T, size_t N> void sum_binary_matrix_files(const vector<path>& file_paths, multi_array<T,N>& sum){
+    ///
+    /// Sum any number of binary matrix files of the same shape, one file at a time
+    ///
+    if (file_paths.empty()){
+        throw runtime_error("ERROR: no binary matrix files to sum");
+    }
+
+    read_matrix_from_binary_file(file_paths[0], sum);
+
+    for (size_t i=1; i<file_paths.size(); i++){
+        add_binary_matrix_file(file_paths[i], sum);
+        cerr << "\33[2K\rSummed: " << i + 1 << " of " << file_paths.size() << std::flush;
+    }
+
+    cerr << '\n';
+}
+
+
 #endif //RUNLENGTH_ANALYSIS_MATRIX_HPP
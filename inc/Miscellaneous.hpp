@@ -7,6 +7,7 @@
 #include <utility>
 #include <fstream>
 #include <stdexcept>
+#include <experimental/filesystem>
 #include "boost/program_options.hpp"
 
 using std::string;
@@ -17,6 +18,7 @@ using std::ostream;
 using std::istream;
 using std::ofstream;
 using std::runtime_error;
+using std::experimental::filesystem::path;
 using boost::program_options::options_description;
 using boost::program_options::value;
 using boost::program_options::variables_map;
@@ -29,6 +31,16 @@ void split_as_double(vector<double>& tokens, string& s, string& separators);
 
 void parse_comma_separated_pair_as_doubles(pair<double,double>& p, string& s);
 
+void read_file_to_string(path file_path, string& buffer);
+
+path get_temporary_path(path file_path);
+
+void rename_temporary_file(path temporary_path, path file_path);
+
+const char* parse_uint16(const char* start, const char* stop, uint16_t& value);
+
+const char* parse_float(const char* start, const char* stop, float& value);
+
 double log10_sum_exp(double x1, double x2);
 
 string join(vector <string> s, char delimiter);
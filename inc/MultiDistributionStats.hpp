@@ -28,4 +28,7 @@ public:
 };
 
 
+void operator+=(MultiDistributionStats& a, MultiDistributionStats& b);
+
+
 #endif //RUNLENGTH_ANALYSIS_MULTIDISTRIBUTIONSTATS_HPP
@@ -5,6 +5,7 @@
 #include "BamReader.hpp"
 #include "Runlength.hpp"
 #include "Pileup.hpp"
+#include "PileupRowAllocator.hpp"
 #include <utility>
 #include <iostream>
 #include <cassert>
@@ -20,6 +21,17 @@ using std::unordered_map;
 using std::experimental::filesystem::path;
 
 
+// Fetch every distinct read that appears in a set of alignments, once each
+template <class T, class T2> void fetch_read_sequences(T& sequence_reader,
+        vector<AlignedSegment>& alignments,
+        unordered_map<string,T2>& read_sequences);
+
+// For FASTAs, fetch the reads in the order they appear in the file so that it is read sequentially
+void fetch_read_sequences(FastaReader& sequence_reader,
+        vector<AlignedSegment>& alignments,
+        unordered_map<string,SequenceElement>& read_sequences);
+
+
 class PileupGenerator{
 public:
     /// Attributes ///
@@ -45,7 +57,7 @@ public:
 
     template <class T> void fetch_region(Region& region, T& sequence_reader, Pileup& pileup);
     void fetch_sequence_indexes_from_region(Region& region, vector <tuple <string,int64_t,int64_t> >& read_indexes);
-    int64_t find_depth_index(int64_t start_index);
+    int64_t find_depth_index(int64_t start_index, int64_t stop_index);
     void parse_insert(Pileup& pileup, int64_t pileup_width_index, int64_t pileup_depth_index, uint64_t cigar_length, AlignedSegment& aligned_segment, vector<float>& read_data);
     void update_insert_column(
         Pileup& pileup,
@@ -58,7 +70,7 @@ public:
 
 private:
     /// Attributes ///
-    deque <pair <int64_t, int64_t> > lowest_free_index_per_depth;
+    PileupRowAllocator row_allocator;
     vector <float> default_data_vector;
     vector <vector <float> > default_insert_column;
     vector <vector <vector <float> > > default_insert_pileup;
@@ -68,6 +80,18 @@ private:
 };
 
 
+template <class T, class T2> void fetch_read_sequences(T& sequence_reader,
+        vector<AlignedSegment>& alignments,
+        unordered_map<string,T2>& read_sequences){
+
+    for (auto& aligned_segment: alignments){
+        if (read_sequences.count(aligned_segment.read_name) == 0){
+            sequence_reader.get_sequence(read_sequences[aligned_segment.read_name], aligned_segment.read_name);
+        }
+    }
+}
+
+
 template <class T> void PileupGenerator::fetch_region(Region& region,
         T& sequence_reader,
         Pileup& pileup) {
@@ -97,18 +121,25 @@ template <class T> void PileupGenerator::fetch_region(Region& region,
     int64_t pileup_depth_index;
     vector<float> read_data;
 
-    this->lowest_free_index_per_depth = {{0,0}};
+    this->row_allocator.clear();
     pileup = Pileup(read_sequence.n_channels+2, region_size, this->maximum_depth, this->default_data_vector);
 
+    // Collect the alignments first, so that the reads they need can be fetched together
+    vector<AlignedSegment> alignments;
     while (bam_reader.next_alignment(aligned_segment)) {
+        alignments.emplace_back(aligned_segment);
+    }
+
+    unordered_map <string, decltype(read_sequence)> read_sequences;
+    fetch_read_sequences(sequence_reader, alignments, read_sequences);
+
+    for (auto& aligned_segment: alignments) {
         pileup.n_alignments++;
 //        cerr << "\33[2K\rParsed: "<< aligned_segment.to_string() << "\n";
 
-        sequence_reader.get_sequence(read_sequence, aligned_segment.read_name);
-        pileup_depth_index = find_depth_index(aligned_segment.ref_start_index - region.start);
-
-        // Update the occupancy status of this row
-        this->lowest_free_index_per_depth[0].second = aligned_segment.infer_reference_stop_position_from_alignment() - region.start;
+        auto& sequence = read_sequences.at(aligned_segment.read_name);
+        pileup_depth_index = find_depth_index(aligned_segment.ref_start_index - region.start,
+                aligned_segment.infer_reference_stop_position_from_alignment() - region.start);
 
         while (aligned_segment.next_coordinate(coordinate, cigar) and (pileup_depth_index < maximum_depth)) {
             in_left_bound = (coordinate.ref_index >= int64_t(region.start));
@@ -119,7 +150,7 @@ template <class T> void PileupGenerator::fetch_region(Region& region,
                 // Update the current width index
                 pileup_width_index = coordinate.ref_index - region.start;
 
-                read_sequence.get_read_data(read_data, cigar, coordinate, aligned_segment);
+                sequence.get_read_data(read_data, cigar, coordinate, aligned_segment);
 
                 if (cigar.is_ref_move()) {
                     // Update the pileup base
@@ -1,20 +1,57 @@
-
 #ifndef RUNLENGTH_ANALYSIS_PILEUPKMER_HPP
 #define RUNLENGTH_ANALYSIS_PILEUPKMER_HPP
 
+#include "RingBuffer.hpp"
 #include "Kmer.hpp"
 #include "Pileup.hpp"
 #include "Base.hpp"
 
 
+///
+/// Flat hash table of the distinct kmers found in the middle of a pileup window. Each kmer is paired with a bitset
+/// (one bit per pileup row) marking which reads contain it. Clearing only touches the slots used in the previous
+/// window, so the table can be reused for every column without reallocating.
+///
+class KmerReadTable {
+public:
+    /// Attributes ///
+    vector <uint64_t> kmers;        // Distinct kmers, in order of insertion
+    vector <uint64_t> read_bits;    // n_words bitset per kmer, contiguous
+    size_t n_kmers;
+    size_t n_words;
+
+    /// Methods ///
+    KmerReadTable();
+    KmerReadTable(size_t n_reads);
+    void clear();
+    size_t insert(uint64_t kmer);
+    int64_t find(uint64_t kmer);
+    void add_read(size_t kmer_entry, size_t read_index);
+    uint64_t get_coverage(size_t kmer_entry);
+    size_t size();
+
+private:
+    /// Attributes ///
+    vector <uint32_t> slots;        // Open addressed, stores kmer entry + 1 so that 0 is empty
+    vector <uint32_t> used_slots;
+    size_t slot_mask;
+
+    /// Methods ///
+    size_t hash(uint64_t kmer);
+    void grow();
+};
+
+
 class PileupReadKmerIterator {
 public:
-    vector <unordered_set <size_t> > kmer_indexes;
+    RingBuffer <uint64_t> window_kmer_indexes;  // This is all the kmers in the current window, possibly including inserts
+    RingBuffer <uint64_t> n_operations;         // This is how we know how many kmers to cycle in the buffer, it will
+                                                // always be exactly the window size, where each element is n kmers per
+                                                // ref index
+
+    uint64_t current_kmer_index;    // Rolling 2 bit encoding of the most recent bases, oldest base in the lowest bits
+    uint8_t current_kmer_length;    // Number of bases currently encoded in current_kmer_index (saturates at k)
 
-    deque <uint8_t> current_kmer;   // for efficiency of updating the kmer
-    deque <uint64_t> window_kmer_indexes;  // This is all the kmers in the current window, possibly including inserts
-    deque <uint64_t> n_operations;  // This is how we know how many kmers to cycle in the deque, it will always be
-                                    // exactly the window size, where each element is n kmers per ref index
     size_t depth_index;
     size_t width_index;
     size_t window_size;
@@ -22,10 +59,10 @@ public:
     uint8_t k;
 
     PileupReadKmerIterator(size_t window_size, size_t depth_index, uint8_t k);
-    void step(Pileup& pileup, unordered_map<uint64_t, unordered_set <uint64_t> >& middle_kmers);
+    void step(Pileup& pileup, KmerReadTable& middle_kmers);
     void pop_left_kmers(Pileup& pileup);
     void push_right_kmer(uint8_t base);
-    void update_middle_kmers(unordered_map<uint64_t, unordered_set <uint64_t> >& middle_kmers);
+    void update_middle_kmers(KmerReadTable& middle_kmers);
 };
 
 
@@ -34,14 +71,8 @@ public:
     vector <PileupReadKmerIterator> read_iterators;     // Iterating the pileup is simplified by abstracting each row
                                                         // as their own iterators
 
-    unordered_map <uint64_t, unordered_set <uint64_t> > middle_kmers;   // The kmers and their coverages in the middle
-                                                                        // of the window
-
-    vector <unordered_set <size_t> > kmer_indexes;      // This is all the kmers in the current window, possibly
-                                                        // including inserts, and the indexes of their supporting reads
-
-    vector <vector <uint64_t> > kmer_confusion_matrix;  // This represents the frequency of overlap between kmers, for
-                                                        // all possible pairs of kmers
+    KmerReadTable middle_kmers;     // The kmers in the middle of the window and the rows that contain them anywhere in
+                                    // the window
 
     size_t width_index = 0;
     size_t window_size;
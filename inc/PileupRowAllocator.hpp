@@ -0,0 +1,45 @@
+#ifndef RUNLENGTH_ANALYSIS_PILEUPROWALLOCATOR_HPP
+#define RUNLENGTH_ANALYSIS_PILEUPROWALLOCATOR_HPP
+
+#include <functional>
+#include <vector>
+#include <queue>
+#include <tuple>
+
+using std::priority_queue;
+using std::greater;
+using std::vector;
+using std::tuple;
+
+
+///
+/// Packs alignments (in order of start position) into the rows of a pileup. Each alignment goes in the row whose last
+/// alignment ended first, if that leaves at least 1 free position before it starts, or else in a new row. Rows that
+/// are tied for the earliest end are ranked by when they were last used, most recent first, so the assignment is
+/// deterministic. The rows are kept in a min-heap, so each alignment costs O(log(depth)).
+///
+class PileupRowAllocator{
+public:
+    /// Methods ///
+    PileupRowAllocator();
+
+    // Forget all rows, and start again with a single empty row
+    void clear();
+
+    // Choose the row for an alignment spanning [start_index, stop_index] (pileup coordinates), and mark it as occupied
+    int64_t allocate(int64_t start_index, int64_t stop_index);
+
+    size_t get_n_rows() const;
+    void print() const;
+
+private:
+    /// Attributes ///
+
+    // (stop index of the last alignment in the row, -(time of last use), row index)
+    priority_queue <tuple <int64_t, int64_t, int64_t>, vector <tuple <int64_t, int64_t, int64_t> >, greater <tuple <int64_t, int64_t, int64_t> > > rows;
+    int64_t n_rows;
+    int64_t n_allocations;
+};
+
+
+#endif //RUNLENGTH_ANALYSIS_PILEUPROWALLOCATOR_HPP
@@ -3,7 +3,7 @@
 #define RUNLENGTH_ANALYSIS_QUADCOMPRESSION_H
 
 #include "MultiDistributionStats.hpp"
-#include "QuadTree.hpp"
+#include "FlatQuadTree.hpp"
 #include "QuadLoss.hpp"
 #include <utility>
 #include <memory>
@@ -11,7 +11,7 @@
 #include <array>
 #include <string>
 #include <experimental/filesystem>
-#include <map>
+#include <queue>
 
 using std::pair;
 using std::make_pair;
@@ -20,29 +20,39 @@ using std::array;
 using std::shared_ptr;
 using std::string;
 using std::experimental::filesystem::path;
-using std::map;
+using std::priority_queue;
 
 
-class QuadCompressor: public QuadTree{
+class LeafLoss{
 public:
-    /// Attributes ///
-//    array<shared_ptr<QuadCompressor>,4> subtrees;
+    double loss;
+    float x;
+    float y;
+    uint32_t node_index;
 
+    LeafLoss(double loss, QuadNode& node, uint32_t node_index);
+};
+
+
+// Max-heap ordering by loss. Ties go to the leaf with the smallest center (x, then y) to keep splits deterministic.
+bool operator<(const LeafLoss& a, const LeafLoss& b);
+
+
+class QuadCompressor: public FlatQuadTree{
+public:
     /// Methods ///
-//    using QuadTree::QuadTree;
     QuadCompressor();
     QuadCompressor(BoundingBox bounds);
     void compress(uint64_t max_quadrants, QuadLoss& loss_calculator, path output_dir);
-    void update_loss_from_range(BoundingBox& bounds, QuadLoss& loss_calculator);
-    shared_ptr<QuadTree> generate_child(BoundingBox bounds) override;
 
     void subdivide_lossiest_leaf(QuadLoss& loss_calculator,
-                                 QuadCompressor& reference_tree,
-                                 map<double, map <double, pair <double,QuadTree*> > >& scores);
+                                 FlatQuadTree& reference_tree,
+                                 priority_queue<LeafLoss>& leaf_losses);
 
-    void find_lossiest_leaf(QuadTree& reference_tree,
-                            map<double, map <double, pair <double,QuadTree*> > >& scores,
-                            QuadLoss& loss_calculator);
+    void push_leaf_loss(FlatQuadTree& reference_tree,
+                        uint32_t node_index,
+                        priority_queue<LeafLoss>& leaf_losses,
+                        QuadLoss& loss_calculator);
 };
 
 
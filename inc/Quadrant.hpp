@@ -34,6 +34,7 @@ public:
     BoundingBox(QuadCoordinate center, float half_size);
     bool contains(QuadCoordinate coordinate);
     bool intersects(BoundingBox boundary);
+    bool encloses(BoundingBox boundary);
 };
 
 
@@ -0,0 +1,126 @@
+#ifndef RUNLENGTH_ANALYSIS_READLENGTHSTATS_HPP
+#define RUNLENGTH_ANALYSIS_READLENGTHSTATS_HPP
+
+#include <experimental/filesystem>
+#include <utility>
+#include <random>
+#include <vector>
+#include <string>
+
+using std::experimental::filesystem::path;
+using std::mt19937_64;
+using std::vector;
+using std::string;
+using std::pair;
+
+
+///
+/// A uniform random sample of lengths, of the smallest size whose total length reaches max_cumulative_length: the same
+/// sample as shuffling every length and taking a prefix, without storing every length. Each length gets a random key,
+/// and the sample is the prefix of the lengths sorted by key, so it is kept as a max-heap of keys and trimmed whenever
+/// the largest key is no longer needed to reach the total. Reservoirs from disjoint inputs merge into a sample of the
+/// union.
+///
+class ReadLengthReservoir {
+public:
+    /// Attributes ///
+    uint64_t max_cumulative_length;
+    uint64_t cumulative_length;
+
+    // (random key, length), as a max-heap of keys
+    vector <pair <uint64_t, uint32_t> > sample;
+
+    /// Methods ///
+    ReadLengthReservoir(uint64_t max_cumulative_length, uint64_t seed);
+    void add(uint32_t length);
+    void insert(uint64_t key, uint32_t length);
+
+    // The sampled lengths, sorted ascending
+    void get_lengths(vector<uint32_t>& lengths) const;
+
+private:
+    /// Attributes ///
+    mt19937_64 generator;
+
+    /// Methods ///
+    void trim();
+};
+
+
+///
+/// A mergeable sketch of a length distribution, with logarithmic buckets of relative width 'relative_accuracy' (as in
+/// DDSketch). Each bucket also stores the total length of its reads, so quantiles (by read count) and N-statistics (by
+/// bases) are both within 'relative_accuracy' of the exact value, using a few thousand buckets for any number of reads.
+///
+class ReadLengthSketch {
+public:
+    /// Attributes ///
+    double relative_accuracy;
+    double gamma;
+    double log_gamma;
+
+    vector<uint64_t> counts;
+    vector<uint64_t> cumulative_lengths;
+    uint64_t n_reads;
+    uint64_t total_length;
+    uint32_t min_length;
+    uint32_t max_length;
+
+    /// Methods ///
+    ReadLengthSketch(double relative_accuracy=0.005);
+    void add(uint32_t length);
+    size_t get_bucket_index(uint32_t length) const;
+    double get_bucket_value(size_t index) const;
+
+    // Length at quantile q of the reads, e.g. 0.5 for the median
+    uint32_t get_quantile(double q) const;
+
+    // Length such that reads at least this long contain a fraction x of all bases, e.g. 0.5 for the N50
+    uint32_t get_nx(double x) const;
+
+    double get_mean() const;
+};
+
+
+///
+/// Read counts in bins of fixed width, [i*bin_size, (i+1)*bin_size)
+///
+class ReadLengthHistogram {
+public:
+    /// Attributes ///
+    uint32_t bin_size;
+    vector<uint64_t> counts;
+
+    /// Methods ///
+    ReadLengthHistogram(uint32_t bin_size=1000);
+    void add(uint32_t length);
+    string to_string() const;
+};
+
+
+class ReadLengthStats {
+public:
+    /// Attributes ///
+    ReadLengthReservoir reservoir;
+    ReadLengthSketch sketch;
+    ReadLengthHistogram histogram;
+
+    /// Methods ///
+    ReadLengthStats(uint64_t max_cumulative_length, uint64_t seed, uint32_t bin_size=1000, double relative_accuracy=0.005);
+    void add(uint32_t length);
+};
+
+
+void operator+=(ReadLengthReservoir& a, ReadLengthReservoir& b);
+
+void operator+=(ReadLengthSketch& a, ReadLengthSketch& b);
+
+void operator+=(ReadLengthHistogram& a, ReadLengthHistogram& b);
+
+void operator+=(ReadLengthStats& a, ReadLengthStats& b);
+
+// Stream the lengths of a .fai into 'stats', without storing them
+void update_read_length_stats_from_fasta_index(path index_path, ReadLengthStats& stats, uint32_t min_length=0);
+
+
+#endif //RUNLENGTH_ANALYSIS_READLENGTHSTATS_HPP
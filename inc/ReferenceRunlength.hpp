@@ -1,50 +1,40 @@
-
 #ifndef RUNLENGTH_ANALYSIS_REFERENCERUNLENGTH_HPP
 #define RUNLENGTH_ANALYSIS_REFERENCERUNLENGTH_HPP
 
-#include "Runlength.hpp"
+#include "FastaTable.hpp"
 #include "Matrix.hpp"
 #include "Base.hpp"
 #include <experimental/filesystem>
-#include <cmath>
+#include <string_view>
+#include <string>
 
-using std::min;
+using std::string;
+using std::string_view;
 using std::experimental::filesystem::path;
 
 
-void measure_runlength_priors_from_reference(path fasta_path, uint16_t max_runlength);
-
-
-template<class T> void count_runlengths(reference_rle_length_matrix& runlength_frequencies, T& sequence){
-    if (runlength_frequencies.empty()){
-        throw runtime_error("ERROR: uninitialized vector passed to 'evaluate_discrete_weibull', vector must be initialized");
-    }
-
-    auto shape_a = runlength_frequencies.shape();
-
-    size_t max_runlength = shape_a[1];
-
-    char current_character = 0;
-    double current_length = 1;
-
-    // Iterate each run and append/update base/length for their corresponding vectors
-    for (char& character: sequence.sequence){
-        if (tolower(character) != tolower(current_character)){
-            if (not is_valid_base(character)){
-                continue;
-            }
-
-            uint8_t base_index = base_to_index(character);
-            runlength_frequencies[base_index][min(current_length, double(max_runlength-1))]++;
-            current_length = 1;
-        }
-        else{
-            current_length++;
-        }
-
-        current_character = character;
-    }
-}
+///
+/// Count the runs that start in [start, stop) of a sequence, in a histogram of [base][length]. A run is a maximal stretch
+/// of one base (in either case), and any other character (e.g. N) ends it. A run that began before 'start' is left to
+/// the range it began in, and a run that continues past 'stop' is followed to its end, so adjacent ranges count every
+/// run exactly once. Lengths beyond the last column of the histogram are counted in the last column.
+///
+void count_runlengths(reference_rle_length_histogram& runlength_frequencies, string_view sequence, uint64_t start, uint64_t stop);
+
+// Count the runs of every sequence in the table, split into ranges of at most 'chunk_size' bases on 'max_threads' threads
+void count_runlengths(reference_rle_length_histogram& runlength_frequencies,
+                      FastaTable& sequences,
+                      uint16_t max_threads,
+                      uint64_t chunk_size=FastaTable::piece_size);
+
+// Format the histogram as the '>AT prior' and '>GC prior' sections of a SimpleBayesianConsensusCaller config, in log10
+string reference_histogram_to_prior_string(reference_rle_length_histogram& runlength_frequencies, double pseudocount);
+
+path measure_runlength_priors_from_reference(path fasta_path,
+                                             path output_directory,
+                                             uint16_t max_runlength,
+                                             uint16_t max_threads,
+                                             double pseudocount=1);
 
 
 #endif //RUNLENGTH_ANALYSIS_REFERENCERUNLENGTH_HPP
@@ -0,0 +1,146 @@
+#ifndef RUNLENGTH_ANALYSIS_RINGBUFFER_HPP
+#define RUNLENGTH_ANALYSIS_RINGBUFFER_HPP
+
+#include <stdexcept>
+#include <vector>
+
+using std::runtime_error;
+using std::vector;
+
+
+///
+/// Fixed capacity FIFO queue stored in one contiguous vector. Capacity is always a power of 2 so that wrapping is a
+/// bitmask. If a push would exceed the capacity, the buffer doubles, so after a short warmup period no allocation
+/// occurs no matter how many elements are cycled through it.
+///
+template <class T> class RingBuffer {
+public:
+    /// Attributes ///
+    vector<T> data;
+    size_t start;
+    size_t n;
+    size_t mask;
+
+    /// Methods ///
+    RingBuffer();
+    RingBuffer(size_t capacity);
+    void push_back(T x);
+    void pop_front();
+    void pop_front(size_t n_items);
+    T& front();
+    T& back();
+    T& operator[](size_t i);
+    size_t size();
+    size_t capacity();
+    bool empty();
+    void clear();
+
+private:
+    void grow();
+};
+
+
+template <class T> RingBuffer<T>::RingBuffer(){
+    this->data.resize(1);
+    this->start = 0;
+    this->n = 0;
+    this->mask = 0;
+}
+
+
+template <class T> RingBuffer<T>::RingBuffer(size_t capacity){
+    size_t c = 1;
+
+    // Round up to the nearest power of 2
+    while (c < capacity){
+        c <<= 1;
+    }
+
+    this->data.resize(c);
+    this->start = 0;
+    this->n = 0;
+    this->mask = c - 1;
+}
+
+
+template <class T> void RingBuffer<T>::grow(){
+    vector<T> new_data(this->data.size()*2);
+
+    // Unwrap the existing items so they start at index 0
+    for (size_t i=0; i<this->n; i++){
+        new_data[i] = this->data[(this->start + i) & this->mask];
+    }
+
+    this->data.swap(new_data);
+    this->start = 0;
+    this->mask = this->data.size() - 1;
+}
+
+
+template <class T> void RingBuffer<T>::push_back(T x){
+    if (this->n == this->data.size()){
+        this->grow();
+    }
+
+    this->data[(this->start + this->n) & this->mask] = x;
+    this->n++;
+}
+
+
+template <class T> void RingBuffer<T>::pop_front(){
+    if (this->n == 0){
+        throw runtime_error("ERROR: cannot pop from empty RingBuffer");
+    }
+
+    this->start = (this->start + 1) & this->mask;
+    this->n--;
+}
+
+
+template <class T> void RingBuffer<T>::pop_front(size_t n_items){
+    if (n_items > this->n){
+        throw runtime_error("ERROR: cannot pop more items than exist in RingBuffer");
+    }
+
+    this->start = (this->start + n_items) & this->mask;
+    this->n -= n_items;
+}
+
+
+template <class T> T& RingBuffer<T>::front(){
+    return this->data[this->start];
+}
+
+
+template <class T> T& RingBuffer<T>::back(){
+    return this->data[(this->start + this->n - 1) & this->mask];
+}
+
+
+template <class T> T& RingBuffer<T>::operator[](size_t i){
+    return this->data[(this->start + i) & this->mask];
+}
+
+
+template <class T> size_t RingBuffer<T>::size(){
+    return this->n;
+}
+
+
+template <class T> size_t RingBuffer<T>::capacity(){
+    return this->data.size();
+}
+
+
+template <class T> bool RingBuffer<T>::empty(){
+    return (this->n == 0);
+}
+
+
+template <class T> void RingBuffer<T>::clear(){
+    this->start = 0;
+    this->n = 0;
+}
+
+
+#endif //RUNLENGTH_ANALYSIS_RINGBUFFER_HPP
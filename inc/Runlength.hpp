@@ -3,11 +3,13 @@
 
 #include "MarginPolishReader.hpp"
 #include "ShastaReader.hpp"
+#include "CoverageReader.hpp"
 #include "AlignedSegment.hpp"
 #include "RunnieReader.hpp"
 #include "FastaReader.hpp"
 #include "FastaWriter.hpp"
 #include "BedReader.hpp"
+#include "IntervalIndex.hpp"
 #include "BamReader.hpp"
 #include "Runlength.hpp"
 #include "Matrix.hpp"
@@ -47,6 +49,26 @@ using std::vector;
 template<class T> void runlength_encode(RunlengthSequenceElement& runlength_sequence, T& sequence);
 
 
+// Chunk the sequences into regions to iterate. If a BED is given, it is loaded into 'bed_index', and only the chunks
+// that overlap its intervals are kept.
+void chunk_regions(path bed_path,
+                   IntervalIndex& bed_index,
+                   vector<Region>& regions,
+                   unordered_map<string,RunlengthSequenceElement>& sequences,
+                   uint64_t chunk_size);
+
+// Fetch the alignments that belong to a chunk from chunk_regions. Each alignment belongs to the one chunk containing the
+// first position of it that is counted (its start, or with a BED, the first BED position it covers), and should be
+// walked in full there. Alignments that belong to earlier chunks are skipped before they are decoded.
+void initialize_chunk(BamReader& bam_reader, const Region& chunk);
+void initialize_chunk(BamReader& bam_reader, const IntervalIndex& bed_index, const Region& chunk, vector<Region>& bed_regions);
+
+// Write the directional and nondirectional (reverse complements summed) matrices as CSV, and the directional matrix as
+// a binary matrix file that can be summed with merge_matrices
+void write_length_matrix_to_file(path output_directory, rle_length_matrix& matrix);
+void write_base_matrix_to_file(path output_directory, rle_base_matrix& matrix);
+
+
 path runlength_encode_fasta_file(path input_file_path,
                                  unordered_map <string,RunlengthSequenceElement>& runlength_sequences,
                                  path output_dir,
@@ -59,7 +81,9 @@ void measure_runlength_distribution_from_marginpolish(
         path output_directory,
         uint16_t max_runlength,
         uint16_t max_threads,
-        path bed_path=path());
+        path bed_path=path(),
+        bool resume=false,
+        double checkpoint_interval=600);
 
 
 void measure_runlength_distribution_from_shasta(
@@ -68,7 +92,9 @@ void measure_runlength_distribution_from_shasta(
         path output_directory,
         uint16_t max_runlength,
         uint16_t max_threads,
-        path bed_path=path());
+        path bed_path=path(),
+        bool resume=false,
+        double checkpoint_interval=600);
 
 
 void measure_runlength_distribution_from_fasta(
@@ -79,7 +105,37 @@ void measure_runlength_distribution_from_fasta(
         uint16_t max_threads,
         size_t minimum_match_length,
         string minimap_preset,
-        uint16_t minimap_k);
+        uint16_t minimap_k,
+        bool resume=false,
+        double checkpoint_interval=600);
+
+
+// Sharded measurement from BAMs that were already aligned to the RLE reference, listed in a manifest of BAM and reads
+// FASTA paths. Each shard is run separately (e.g. on its own node) and writes partial binary matrices, which are then
+// summed by reduce_runlength_distribution_shards.
+void measure_runlength_distribution_from_manifest(
+        path manifest_path,
+        path reference_fasta_path,
+        path output_directory,
+        uint16_t max_runlength,
+        uint16_t max_threads,
+        size_t minimum_match_length,
+        uint64_t shard_index,
+        uint64_t n_shards);
+
+
+void reduce_runlength_distribution_shards(path output_directory, uint64_t n_shards);
+
+
+path get_shard_directory(path output_directory, uint64_t shard_index, uint64_t n_shards);
+
+
+void get_shard_regions(
+        const vector<Region>& regions,
+        size_t entry_index,
+        uint64_t shard_index,
+        uint64_t n_shards,
+        vector<Region>& shard_regions);
 
 
 void measure_runlength_distribution_from_runnie(
@@ -87,7 +143,9 @@ void measure_runlength_distribution_from_runnie(
         path reference_fasta_path,
         path output_directory,
         uint16_t max_runlength,
-        uint16_t max_threads);
+        uint16_t max_threads,
+        bool resume=false,
+        double checkpoint_interval=600);
 
 
 void get_vector_from_index_map(vector< pair <string,FastaIndex> >& items, unordered_map<string,FastaIndex>& map_object);
@@ -151,15 +209,17 @@ template <typename T> void write_segment_consensus_sequence_to_fasta(path& paren
                                                FastaWriter& fasta_writer,
                                                atomic<uint64_t>& job_index){
 
+    // Initialize one reader per thread, some readers load a table of indexes when constructed
+    T reader = T(parent_directory);
+    reader.set_index(read_paths);
+
+    // Initialize containers
+    CoverageSegment segment;
+
     while (job_index < read_names.size()) {
         uint64_t thread_job_index = job_index.fetch_add(1);
 
-        // Initialize containers
-        CoverageSegment segment;
-
         // Fetch Fasta sequence
-        T reader = T(parent_directory);
-        reader.set_index(read_paths);
         reader.fetch_consensus_sequence(segment, read_names[thread_job_index]);
 
         // Write RLE sequence to file (no lengths written)
@@ -236,7 +296,8 @@ void label_coverage_data_from_shasta(
         path output_directory,
         uint16_t max_threads,
         path bed_path,
-        uint16_t insert_cutoff=32768);
+        uint16_t insert_cutoff=32768,
+        bool single_file=false);
 
 
 #endif //RUNLENGTH_ANALYSIS_CPP_RUNLENGTH_HPP
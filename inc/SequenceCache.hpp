@@ -0,0 +1,134 @@
+#ifndef RUNLENGTH_ANALYSIS_SEQUENCECACHE_HPP
+#define RUNLENGTH_ANALYSIS_SEQUENCECACHE_HPP
+
+#include <unordered_map>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <list>
+#include <utility>
+
+using std::unordered_map;
+using std::shared_ptr;
+using std::lock_guard;
+using std::atomic;
+using std::string;
+using std::vector;
+using std::mutex;
+using std::list;
+using std::pair;
+using std::move;
+
+
+///
+/// Bounded, thread safe, least-recently-used cache of sequences keyed by read name. The budget is a total number of
+/// bases (as measured by T::sequence.size()), and the cache is split into shards by name hash, each with its own mutex
+/// and LRU list, so threads working on different reads rarely contend. Entries are immutable and handed out as
+/// shared pointers, so an evicted sequence stays valid for as long as a caller still holds it.
+///
+template <class T> class SequenceCache {
+public:
+    /// Attributes ///
+    atomic<uint64_t> n_hits;
+    atomic<uint64_t> n_misses;
+
+    /// Methods ///
+    SequenceCache(uint64_t max_bases, size_t n_shards=64);
+
+    // Return the cached sequence, or a null pointer if it isn't cached
+    shared_ptr<const T> find(const string& name);
+
+    // Add a sequence and evict the least recently used ones from its shard until the shard is within its budget
+    void insert(const string& name, shared_ptr<const T> sequence);
+
+    uint64_t get_n_bases();
+
+private:
+    class Shard {
+    public:
+        mutex shard_mutex;
+        list <pair <string, shared_ptr<const T> > > recency;     // Most recently used first
+        unordered_map <string, typename list <pair <string, shared_ptr<const T> > >::iterator> items;
+        uint64_t n_bases = 0;
+    };
+
+    /// Attributes ///
+    vector<Shard> shards;
+    uint64_t max_bases_per_shard;
+
+    /// Methods ///
+    Shard& get_shard(const string& name);
+};
+
+
+template <class T> SequenceCache<T>::SequenceCache(uint64_t max_bases, size_t n_shards):
+        n_hits(0),
+        n_misses(0),
+        shards(n_shards),
+        max_bases_per_shard(max_bases/n_shards)
+{}
+
+
+template <class T> typename SequenceCache<T>::Shard& SequenceCache<T>::get_shard(const string& name){
+    return this->shards[std::hash<string>()(name) % this->shards.size()];
+}
+
+
+template <class T> shared_ptr<const T> SequenceCache<T>::find(const string& name){
+    Shard& shard = this->get_shard(name);
+    lock_guard<mutex> lock(shard.shard_mutex);
+
+    auto result = shard.items.find(name);
+
+    if (result == shard.items.end()){
+        this->n_misses++;
+        return nullptr;
+    }
+
+    // Move to the front of the recency list
+    shard.recency.splice(shard.recency.begin(), shard.recency, result->second);
+    this->n_hits++;
+
+    return result->second->second;
+}
+
+
+template <class T> void SequenceCache<T>::insert(const string& name, shared_ptr<const T> sequence){
+    Shard& shard = this->get_shard(name);
+    lock_guard<mutex> lock(shard.shard_mutex);
+
+    // Another thread may have fetched the same read in the meantime
+    if (shard.items.count(name) > 0){
+        return;
+    }
+
+    shard.n_bases += sequence->sequence.size();
+    shard.recency.emplace_front(name, move(sequence));
+    shard.items.emplace(name, shard.recency.begin());
+
+    // Evict, but never the item that was just inserted
+    while (shard.n_bases > this->max_bases_per_shard and shard.recency.size() > 1){
+        auto& item = shard.recency.back();
+        shard.n_bases -= item.second->sequence.size();
+        shard.items.erase(item.first);
+        shard.recency.pop_back();
+    }
+}
+
+
+template <class T> uint64_t SequenceCache<T>::get_n_bases(){
+    uint64_t n_bases = 0;
+
+    for (auto& shard: this->shards){
+        lock_guard<mutex> lock(shard.shard_mutex);
+        n_bases += shard.n_bases;
+    }
+
+    return n_bases;
+}
+
+
+#endif //RUNLENGTH_ANALYSIS_SEQUENCECACHE_HPP
@@ -47,7 +47,8 @@ public:
     void read_file(CoverageSegment& segment, path& file_path);
     void fetch_read(CoverageSegment& segment, string& read_name);
     void parse_coverage_string(CoverageSegment& segment, string& line);
-    size_t parse_consensus(CoverageSegment& segment, string& line);
+    void parse_coverage_string(CoverageSegment& segment, const char* start, const char* stop);
+    const char* parse_consensus(CoverageSegment& segment, const char* start, const char* stop);
     bool parse_reversal_string(string reversal_string);
     void read_consensus_sequence_from_file(CoverageSegment& segment, path& file_path);
     void fetch_consensus_sequence(CoverageSegment& segment, string& read_name);
@@ -55,6 +56,9 @@ public:
 private:
     /// Attributes ///
 
+    // Reused for every file, so that reading doesn't allocate once it has grown to the size of the largest file
+    string file_buffer;
+
     /// Methods ///
 };
 
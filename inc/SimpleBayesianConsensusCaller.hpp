@@ -73,6 +73,18 @@ public:
     // run length of the aligned bases at a position
     void operator()(const vector <vector <float> >& coverage, vector <float>& consensus) const;
 
+    // Incremental version of operator() for coverage titration: consensus[i] is the call that operator() would make on
+    // the first min(coverage.size(), (i+1)*step) observations. The observation counts are accumulated in one pass over
+    // the column, so each additional checkpoint only costs the (cheap) likelihood evaluation and not a recount.
+    void predictConsensusByCoverage(
+        const vector <vector <float> >& coverage,
+        size_t step,
+        size_t n_checkpoints,
+        vector <vector <float> >& consensus) const;
+
+    // The log10 prior of each true run length, for AT (0) or GC (1), as parsed from the config
+    const vector<double>& getPrior(size_t atOrGc) const;
+
 private:
 
     /// ---- Attributes ---- ///
@@ -121,6 +133,18 @@ private:
     void factorRepeats(array<std::map<uint16_t, uint16_t>, 2>& factoredRepeats, const vector <vector <float> >&coverage) const;
     void factorRepeats(array<std::map<uint16_t, uint16_t>, 2>& factoredRepeats, const vector <vector <float> >&coverage, uint8_t consensus_base) const;
 
+    // Add a single observation to the counts, as factorRepeats does for each one
+    void factorRepeat(array<std::map<uint16_t, uint16_t>, 2>& factoredRepeats, const vector <float>& observation) const;
+
+    // The likelihood evaluation of predictRunlength, given repeats that have already been factored
+    uint16_t predictRunlength(
+        const array<std::map<uint16_t, uint16_t>, 2>& factoredRepeats,
+        uint8_t consensus_base_index,
+        vector<double>& logLikelihoodY) const;
+
+    // The majority vote of predictConsensusBase, given counts of each base (with gaps at index 4)
+    uint8_t predictConsensusBase(const array<uint32_t, 5>& baseCounts) const;
+
     // For debugging or exporting
     void printPriors(char separator) const;
     void printProbabilityMatrices(char separator=',') const;
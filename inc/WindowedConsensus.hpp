@@ -0,0 +1,106 @@
+#ifndef RUNLENGTH_ANALYSIS_WINDOWEDCONSENSUS_HPP
+#define RUNLENGTH_ANALYSIS_WINDOWEDCONSENSUS_HPP
+
+#include "Region.hpp"
+#include <unordered_map>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <limits>
+
+using std::unordered_map;
+using std::ofstream;
+using std::string;
+using std::vector;
+using std::mutex;
+using std::condition_variable;
+using std::numeric_limits;
+
+
+// Split a sequence into windows of `window_size` bp that each extend `overlap` bp into their neighbors (inclusive
+// coordinates, like chunk_sequence). Neighboring windows share 2*overlap positions.
+void chunk_sequence_into_windows(vector<Region>& windows,
+        string name,
+        uint64_t window_size,
+        uint64_t overlap,
+        uint64_t length);
+
+
+///
+/// The consensus sequence of one window, and where the contribution of each reference position (its column and any
+/// insert columns that follow it) ends within that sequence
+///
+class WindowConsensus {
+public:
+    /// Attributes ///
+    Region region;
+    string sequence;
+    vector<uint64_t> column_stops;
+
+    /// Methods ///
+    WindowConsensus();
+    WindowConsensus(Region& region);
+
+    // Mark the end of the current reference position's contribution
+    void end_column();
+
+    // Where the contribution of a reference position (in contig coordinates) begins and ends in the sequence
+    uint64_t get_column_start(uint64_t ref_index);
+    uint64_t get_column_stop(uint64_t ref_index);
+
+    bool column_equals(WindowConsensus& other, uint64_t ref_index);
+};
+
+
+// Choose the reference position at which the consensus switches from the left window to the right one: the first
+// position from the middle of their overlap onwards at which both windows agree, or the middle if there is none
+uint64_t find_stitch_position(WindowConsensus& left, WindowConsensus& right);
+
+
+///
+/// Thread safe, in-order assembly of window consensus sequences into one FASTA record per contig. Windows may be added
+/// in any order, and each one is written (and freed) as soon as it and its right neighbor are both available, so the
+/// output only depends on the window contents and not on thread scheduling. Producers that call wait_for_capacity
+/// before computing a window are held back while it is max_pending or more windows ahead of the next one to be
+/// written, which bounds the number of pending windows when one slow window holds up the rest.
+///
+class ConsensusStitcher {
+public:
+    /// Attributes ///
+    vector<Region>& windows;
+    ofstream& file;
+    string name_suffix;
+
+    /// Methods ///
+    ConsensusStitcher(vector<Region>& windows,
+                      ofstream& file,
+                      string name_suffix="",
+                      size_t max_pending=numeric_limits<size_t>::max());
+
+    void add(size_t window_index, WindowConsensus& consensus);
+
+    // Block until window_index is fewer than max_pending windows ahead of the next window to be written
+    void wait_for_capacity(size_t window_index);
+
+    // How many windows are waiting for a neighbor
+    size_t get_n_pending();
+
+private:
+    /// Attributes ///
+    mutex stitch_mutex;
+    condition_variable window_written;
+    size_t max_pending;
+    unordered_map<size_t, WindowConsensus> pending;
+    size_t next_window_index;
+    uint64_t next_ref_index;        // The first reference position that hasn't been written yet, for the current contig
+    bool record_started;
+
+    /// Methods ///
+    bool is_last_in_contig(size_t window_index);
+    void write(WindowConsensus& consensus, uint64_t start, uint64_t stop);
+};
+
+
+#endif //RUNLENGTH_ANALYSIS_WINDOWEDCONSENSUS_HPP
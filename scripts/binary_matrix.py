@@ -0,0 +1,38 @@
+import numpy
+
+
+def load_binary_matrix(path):
+    """
+    Load a binary matrix file written by runlength_analysis (e.g. length_frequency_matrix_directional.bin): a header
+    with the version, element size and shape, followed by the float64 elements in C order
+    """
+    with open(path, "rb") as file:
+        magic = file.read(8)
+
+        if magic != b"RLEMATRX":
+            exit("ERROR: not a binary matrix file: " + path)
+
+        header = numpy.fromfile(file, dtype="<u8", count=3)
+
+        if header.size != 3:
+            exit("ERROR: binary matrix is truncated: " + path)
+
+        version, element_size, n_dimensions = header
+
+        if version != 1:
+            exit("ERROR: unsupported binary matrix version (" + str(version) + "): " + path)
+
+        if element_size != 8:
+            exit("ERROR: binary matrix does not contain float64 elements: " + path)
+
+        shape = tuple(map(int, numpy.fromfile(file, dtype="<u8", count=int(n_dimensions))))
+
+        if len(shape) != n_dimensions:
+            exit("ERROR: binary matrix is truncated: " + path)
+
+        matrix = numpy.fromfile(file, dtype="<f8", count=int(numpy.prod(shape)))
+
+    if matrix.size != numpy.prod(shape):
+        exit("ERROR: binary matrix is truncated: " + path)
+
+    return matrix.reshape(shape)
@@ -1,5 +1,6 @@
 from matplotlib import pyplot, colors
 from datetime import datetime
+from binary_matrix import load_binary_matrix
 import matplotlib
 import argparse
 import platform
@@ -98,6 +99,21 @@ def load_directional_base_length_matrix_from_csv(path, max_runlength_row, max_ru
     return matrices
 
 
+def load_directional_base_length_matrix_from_binary(path, max_runlength_row, max_runlength_col):
+    """
+    Load a directional binary length matrix into the same shape as the csv loader
+    """
+    directional_matrices = load_binary_matrix(path)
+
+    if directional_matrices.ndim != 4 or directional_matrices.shape[0] != 2:
+        exit("ERROR: not a directional length matrix: " + path)
+
+    matrices = numpy.zeros([2, 4, max_runlength_row + 1, max_runlength_col + 1])
+    matrices[:, :, :max_runlength_row, :] = directional_matrices[:, :, :max_runlength_row, :max_runlength_col + 1]
+
+    return matrices
+
+
 def save_directional_frequency_matrices_as_marginpolish_config(output_dir, frequency_matrices, chromosome_name=None, delimiter=",", log_normalize=False, plot=False, pseudocount=1e-12, diagonal_bias=0, default_type=int):
     if chromosome_name is not None:
         name_suffix = chromosome_name + "_"
@@ -154,7 +170,10 @@ def main(matrix_path, output_dir, pseudocount):
 
     print("Using pseudocount: " + str(pseudocount))
 
-    matrix = load_directional_base_length_matrix_from_csv(path=matrix_path, max_runlength_row=50, max_runlength_col=50)
+    if matrix_path.endswith(".bin"):
+        matrix = load_directional_base_length_matrix_from_binary(path=matrix_path, max_runlength_row=50, max_runlength_col=50)
+    else:
+        matrix = load_directional_base_length_matrix_from_csv(path=matrix_path, max_runlength_row=50, max_runlength_col=50)
 
     save_directional_frequency_matrices_as_marginpolish_config(output_dir=output_dir,
                                                                frequency_matrices=matrix,
@@ -174,7 +193,7 @@ if __name__ == "__main__":
         "--input", "-i",
         type=str,
         required=True,
-        help="Path to directional frequency matrix csv"
+        help="Path to directional frequency matrix csv, or binary matrix (.bin)"
     )
 
     parser.add_argument(
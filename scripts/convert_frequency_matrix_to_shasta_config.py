@@ -1,5 +1,6 @@
 from matplotlib import pyplot, colors
 from datetime import datetime
+from binary_matrix import load_binary_matrix
 import matplotlib
 import argparse
 import platform
@@ -103,6 +104,24 @@ def load_base_length_matrix_from_csv(path, max_runlength_row, max_runlength_col)
     return matrices
 
 
+def load_base_length_matrix_from_binary(path, max_runlength_row, max_runlength_col):
+    """
+    Load a directional binary length matrix, and sum the reverse complements, as in the nondirectional csv
+    """
+    directional_matrices = load_binary_matrix(path)
+
+    if directional_matrices.ndim != 4 or directional_matrices.shape[0] != 2:
+        exit("ERROR: not a directional length matrix: " + path)
+
+    # The reverse matrix of each base is stored at the index of its complement
+    nondirectional_matrices = directional_matrices[0] + directional_matrices[1][::-1]
+
+    matrices = numpy.zeros([4, max_runlength_row + 1, max_runlength_col + 1])
+    matrices[:, :, :] = nondirectional_matrices[:, :max_runlength_row + 1, :max_runlength_col + 1]
+
+    return matrices
+
+
 def save_nondirectional_frequency_matrices_as_delimited_text(output_dir, prior, name, frequency_matrices, chromosome_name=None, delimiter=",", log_normalize=False, pseudocount=1e-12, diagonal_bias=0, plot=False, default_type=int, filename=None):
     if filename is None:
         if chromosome_name is not None:
@@ -169,7 +188,10 @@ def main(matrix_path, output_dir, pseudocount, prior, name):
 
     print("Using pseudocount: " + str(pseudocount))
 
-    matrix = load_base_length_matrix_from_csv(path=matrix_path, max_runlength_row=50, max_runlength_col=50)
+    if matrix_path.endswith(".bin"):
+        matrix = load_base_length_matrix_from_binary(path=matrix_path, max_runlength_row=50, max_runlength_col=50)
+    else:
+        matrix = load_base_length_matrix_from_csv(path=matrix_path, max_runlength_row=50, max_runlength_col=50)
 
     output_filename_prefix = matrix_path.split("/")[-1]
     output_filename_prefix = ".".join(output_filename_prefix.split(".")[:-1])
@@ -210,7 +232,7 @@ if __name__ == "__main__":
         "--input", "-i",
         type=str,
         required=True,
-        help="Path to directional frequency matrix csv"
+        help="Path to nondirectional frequency matrix csv, or directional binary matrix (.bin)"
     )
     parser.add_argument(
         "--output", "-o",
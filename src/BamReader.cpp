@@ -1,10 +1,13 @@
 #include "Region.hpp"
 #include "BamReader.hpp"
+#include "BinaryIO.hpp"
 #include "htslib/hts.h"
 #include "htslib/sam.h"
+#include <algorithm>
 #include <string>
 #include <stdexcept>
 #include <cstdlib>
+#include <climits>
 #include <experimental/filesystem>
 
 using std::string;
@@ -15,6 +18,11 @@ using std::array;
 using std::runtime_error;
 using std::abs;
 using std::free;
+using std::sort;
+using std::min;
+using std::max;
+using std::tuple;
+using std::get;
 using std::experimental::filesystem::path;
 
 
@@ -47,6 +55,24 @@ void operator+=(CigarStats& cigar_stats_a, CigarStats& cigar_stats_b){
 }
 
 
+void write_to_binary(ostream& file, const CigarStats& cigar_stats){
+    write_value_to_binary(file, cigar_stats.n_matches);
+    write_value_to_binary(file, cigar_stats.n_mismatches);
+    write_value_to_binary(file, cigar_stats.n_inserts);
+    write_value_to_binary(file, cigar_stats.n_deletes);
+    write_map_to_binary(file, cigar_stats.cigar_lengths);
+}
+
+
+void read_from_binary(istream& file, CigarStats& cigar_stats){
+    file.read(reinterpret_cast<char*>(&cigar_stats.n_matches), sizeof(uint64_t));
+    file.read(reinterpret_cast<char*>(&cigar_stats.n_mismatches), sizeof(uint64_t));
+    file.read(reinterpret_cast<char*>(&cigar_stats.n_inserts), sizeof(uint64_t));
+    file.read(reinterpret_cast<char*>(&cigar_stats.n_deletes), sizeof(uint64_t));
+    read_map_from_binary(file, cigar_stats.cigar_lengths);
+}
+
+
 double CigarStats::calculate_identity() {
     return double(this->n_matches)/double(this->n_matches + this->n_mismatches + this->n_inserts + this->n_deletes);
 }
@@ -118,7 +144,15 @@ void BamReader::free_hts_structs(){
     bam_hdr_destroy(this->bam_header);
     bam_destroy1(this->alignment);
     hts_idx_destroy(this->bam_index);
+    this->free_iterators();
+}
+
+
+void BamReader::free_iterators(){
     hts_itr_destroy(this->bam_iterator);
+    hts_itr_multi_destroy(this->bam_multi_iterator);
+    this->bam_iterator = nullptr;
+    this->bam_multi_iterator = nullptr;
 }
 
 
@@ -131,6 +165,7 @@ void BamReader::initialize_hts_structs(){
     this->bam_file = nullptr;
     this->bam_index = nullptr;
     this->bam_iterator = nullptr;
+    this->bam_multi_iterator = nullptr;
     this->alignment = bam_init1();
 
 //    this->secondary_mask = 256;
@@ -140,6 +175,7 @@ void BamReader::initialize_hts_structs(){
     this->ref_name = "";
     this->region_start = -1;
     this->region_stop = -1;
+    this->min_alignment_start = 0;
 
     // bam file
     if ((this->bam_file = hts_open(this->bam_path.string().c_str(), "r")) == 0) {
@@ -166,10 +202,8 @@ BamReader::BamReader(path bam_path){
 
 
 void BamReader::initialize_region(string& reference_name, uint64_t start, uint64_t stop){
-    if (this->bam_iterator != nullptr){
-        free_hts_structs();
-        initialize_hts_structs();
-    }
+    // The file, header and index are reused, only the iterator is replaced
+    this->free_iterators();
 
     this->ref_name = reference_name;
 
@@ -179,6 +213,7 @@ void BamReader::initialize_region(string& reference_name, uint64_t start, uint64
     // sam_itr_queryi(const hts_idx_t *idx, int tid, int beg, int end);
     this->region_start = start;
     this->region_stop = stop;
+    this->min_alignment_start = 0;
     this->bam_iterator = sam_itr_queryi(this->bam_index, this->ref_id, start, stop);
 
     if (this->bam_iterator == nullptr) {
@@ -191,6 +226,108 @@ void BamReader::initialize_region(string& reference_name, uint64_t start, uint64
 }
 
 
+void BamReader::initialize_regions(const vector<Region>& regions){
+    ///
+    /// Build an htslib multi-region iterator, which needs one entry per contig with sorted, non-overlapping intervals.
+    /// htslib merges the file offsets of all the intervals, so BGZF blocks shared by nearby regions are read once.
+    ///
+    this->free_iterators();
+
+    // Sort the regions by contig ID and start, skipping contigs that aren't in the BAM
+    vector <tuple <int, uint64_t, uint64_t> > sorted_regions;
+
+    for (auto& region: regions){
+        int id = bam_name2id(this->bam_header, region.name.c_str());
+
+        if (id < 0 or region.start >= region.stop){
+            continue;
+        }
+
+        sorted_regions.emplace_back(id, region.start, min(region.stop, uint64_t(INT_MAX)));
+    }
+
+    sort(sorted_regions.begin(), sorted_regions.end());
+
+    // Merge overlapping and adjacent regions, and count the contigs
+    vector <tuple <int, uint64_t, uint64_t> > merged_regions;
+    size_t n_contigs = 0;
+
+    for (auto& [id, start, stop]: sorted_regions){
+        if (not merged_regions.empty() and get<0>(merged_regions.back()) == id and start <= get<2>(merged_regions.back())){
+            get<2>(merged_regions.back()) = max(get<2>(merged_regions.back()), stop);
+        }
+        else{
+            if (merged_regions.empty() or get<0>(merged_regions.back()) != id){
+                n_contigs++;
+            }
+            merged_regions.emplace_back(id, start, stop);
+        }
+    }
+
+    this->ref_name = "";
+    this->ref_id = -1;
+    this->region_start = -1;
+    this->region_stop = -1;
+    this->min_alignment_start = 0;
+    this->valid_region = true;
+
+    // Nothing to iterate (next_alignment will return false)
+    if (n_contigs == 0){
+        return;
+    }
+
+    // htslib takes ownership of these, and frees them with the iterator
+    auto reglist = static_cast<hts_reglist_t*>(calloc(n_contigs, sizeof(hts_reglist_t)));
+
+    if (reglist == nullptr){
+        throw runtime_error("ERROR: could not allocate region list for bam file: " + string(this->bam_path));
+    }
+
+    this->multi_region_names.clear();
+    this->multi_region_names.reserve(n_contigs);
+
+    size_t r = 0;
+    for (size_t c=0; c<n_contigs; c++){
+        int id = get<0>(merged_regions[r]);
+
+        size_t n_intervals = 0;
+        while (r + n_intervals < merged_regions.size() and get<0>(merged_regions[r + n_intervals]) == id){
+            n_intervals++;
+        }
+
+        this->multi_region_names.emplace_back(this->bam_header->target_name[id]);
+
+        reglist[c].reg = this->multi_region_names.back().c_str();
+        reglist[c].tid = id;
+        reglist[c].count = uint32_t(n_intervals);
+        reglist[c].intervals = static_cast<hts_pair32_t*>(malloc(n_intervals*sizeof(hts_pair32_t)));
+
+        if (reglist[c].intervals == nullptr){
+            hts_reglist_free(reglist, int(n_contigs));
+            throw runtime_error("ERROR: could not allocate region list for bam file: " + string(this->bam_path));
+        }
+
+        for (size_t i=0; i<n_intervals; i++){
+            reglist[c].intervals[i].beg = int(get<1>(merged_regions[r + i]));
+            reglist[c].intervals[i].end = int(get<2>(merged_regions[r + i]));
+        }
+
+        reglist[c].min_beg = reglist[c].intervals[0].beg;
+        reglist[c].max_end = reglist[c].intervals[n_intervals - 1].end;
+
+        r += n_intervals;
+    }
+
+    this->bam_multi_iterator = sam_itr_regions(this->bam_index, this->bam_header, reglist, n_contigs);
+
+    if (this->bam_multi_iterator == nullptr) {
+        hts_reglist_free(reglist, int(n_contigs));
+        throw runtime_error("ERROR: Cannot open iterator for " + to_string(merged_regions.size()) + " regions"
+                            + " for bam file " + string(this->bam_path) + "\n");
+    }
+}
+
+
 void BamReader::load_alignment(AlignedSegment& aligned_segment, bam1_t* alignment, bam_hdr_t* bam_header){
     ///
     /// Load data from shitty samtools structs into a cpp object
@@ -218,6 +355,11 @@ void BamReader::load_alignment(AlignedSegment& aligned_segment, bam1_t* alignmen
 }
 
 
+void BamReader::skip_alignments_before(uint64_t position){
+    this->min_alignment_start = int64_t(position);
+}
+
+
 bool BamReader::next_alignment(AlignedSegment& aligned_segment,
         uint16_t map_quality_cutoff,
         bool filter_secondary,
@@ -236,9 +378,21 @@ bool BamReader::next_alignment(AlignedSegment& aligned_segment,
         bam_destroy1(this->alignment);
         this->alignment = bam_init1();
 
-        // Call next() on samtools
-        int64_t result;
-        if ((result = sam_itr_next(this->bam_file, this->bam_iterator, this->alignment)) >= 0) {
+        // Call next() on samtools, with whichever kind of iterator was initialized
+        int64_t result = -1;
+        if (this->bam_multi_iterator != nullptr) {
+            result = sam_itr_multi_next(this->bam_file, this->bam_multi_iterator, this->alignment);
+        }
+        else if (this->bam_iterator != nullptr) {
+            result = sam_itr_next(this->bam_file, this->bam_iterator, this->alignment);
+        }
+
+        if (result >= 0) {
+
+            // Alignments that belong to an earlier region don't need to be decoded at all
+            if (this->alignment->core.pos < this->min_alignment_start){
+                continue;
+            }
 
             // Load alignment into container
             load_alignment(aligned_segment, this->alignment, this->bam_header);
@@ -0,0 +1,284 @@
+#include "Checkpoint.hpp"
+#include "BinaryIO.hpp"
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <charconv>
+
+using std::experimental::filesystem::directory_iterator;
+using std::experimental::filesystem::create_directories;
+using std::experimental::filesystem::exists;
+using std::experimental::filesystem::remove;
+using std::experimental::filesystem::is_empty;
+using std::experimental::filesystem::is_regular_file;
+using std::experimental::filesystem::is_directory;
+using std::experimental::filesystem::file_size;
+using std::experimental::filesystem::absolute;
+using std::from_chars;
+using std::errc;
+using std::to_string;
+using std::cerr;
+using std::sort;
+using std::count;
+using std::max;
+
+
+static const char checkpoint_magic[8] = {'R','L','E','C','K','P','T','1'};
+
+
+uint64_t hash_inputs(const vector<Region>& regions, const vector<path>& input_paths){
+    ///
+    /// FNV-1a hash of the names and coordinates of the regions, so that a checkpoint is only resumed with the same
+    /// regions (same reference, chunk size, and BED), in which its region indexes are valid. The paths and sizes of the
+    /// inputs are included too, so that a checkpoint isn't resumed with different reads or alignments over the same
+    /// reference. For a directory, the names and sizes of the files it contains are used.
+    ///
+    uint64_t hash = 14695981039346656037ull;
+
+    auto update = [&](const char* bytes, size_t length){
+        for (size_t i=0; i<length; i++){
+            hash ^= uint8_t(bytes[i]);
+            hash *= 1099511628211ull;
+        }
+    };
+
+    auto update_file = [&](const path& file_path){
+        string name = absolute(file_path).string();
+        uint64_t size = file_size(file_path);
+        update(name.c_str(), name.size() + 1);
+        update(reinterpret_cast<const char*>(&size), sizeof(size));
+    };
+
+    for (auto& region: regions){
+        update(region.name.c_str(), region.name.size() + 1);
+        update(reinterpret_cast<const char*>(&region.start), sizeof(region.start));
+        update(reinterpret_cast<const char*>(&region.stop), sizeof(region.stop));
+    }
+
+    for (auto& input_path: input_paths){
+        if (is_directory(input_path)){
+            vector<path> file_paths;
+
+            for (auto& entry: directory_iterator(input_path)){
+                if (is_regular_file(entry.path())){
+                    file_paths.emplace_back(entry.path());
+                }
+            }
+
+            sort(file_paths.begin(), file_paths.end());
+
+            for (auto& file_path: file_paths){
+                update_file(file_path);
+            }
+        }
+        else if (is_regular_file(input_path)){
+            update_file(input_path);
+        }
+        else{
+            throw runtime_error("ERROR: checkpoint input does not exist: " + input_path.string());
+        }
+    }
+
+    return hash;
+}
+
+
+bool Checkpoint::parse_name(const string& name, uint64_t& run, uint16_t& thread_index){
+    const string prefix = "checkpoint_";
+    const string suffix = ".bin";
+
+    if (name.size() <= prefix.size() + suffix.size() or
+        name.compare(0, prefix.size(), prefix) != 0 or
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0){
+        return false;
+    }
+
+    const char* start = name.data() + prefix.size();
+    const char* stop = name.data() + name.size() - suffix.size();
+
+    auto run_result = from_chars(start, stop, run);
+
+    if (run_result.ec != errc() or run_result.ptr == stop or *run_result.ptr != '_'){
+        return false;
+    }
+
+    auto thread_result = from_chars(run_result.ptr + 1, stop, thread_index);
+
+    return thread_result.ec == errc() and thread_result.ptr == stop;
+}
+
+
+Checkpoint::Checkpoint(){
+    this->interval = 0;
+    this->run_index = 0;
+    this->inputs_hash = 0;
+    this->n_regions = 0;
+}
+
+
+Checkpoint::Checkpoint(path output_directory,
+                       const vector<Region>& regions,
+                       const vector<path>& input_paths,
+                       uint16_t max_threads,
+                       bool resume,
+                       double interval){
+    this->directory = output_directory / "checkpoint";
+    this->interval = interval;
+    this->run_index = 0;
+    this->inputs_hash = hash_inputs(regions, input_paths);
+    this->n_regions = regions.size();
+    this->completed.assign(regions.size(), false);
+    this->completed_per_thread.resize(max_threads);
+    this->n_saved_per_thread.assign(max_threads, 0);
+    this->save_times.assign(max_threads, steady_clock::now());
+
+    // Find the checkpoints of previous runs: checkpoint_<run>_<thread>.bin
+    if (exists(this->directory)){
+        for (auto& entry: directory_iterator(this->directory)){
+            path file_path = entry.path();
+            string name = file_path.filename().string();
+
+            // A checkpoint that was being written when the run stopped is incomplete
+            if (file_path.extension() == ".tmp"){
+                remove(file_path);
+                continue;
+            }
+
+            // Anything else in the directory isn't ours
+            uint64_t run;
+            uint16_t thread_index;
+
+            if (not parse_name(name, run, thread_index)){
+                cerr << "WARNING: skipping file in checkpoint directory that is not a checkpoint: " << file_path << '\n';
+                continue;
+            }
+
+            this->previous_paths.emplace_back(file_path);
+            this->run_index = max(this->run_index, run + 1);
+        }
+    }
+
+    sort(this->previous_paths.begin(), this->previous_paths.end());
+
+    if (not this->previous_paths.empty() and not resume){
+        throw runtime_error("ERROR: output directory contains checkpoints of a previous run: " +
+                            this->directory.string() + "\nUse --resume to continue it, or delete them to start over");
+    }
+
+    if (resume and this->previous_paths.empty()){
+        cerr << "No checkpoints found in " << this->directory << ", starting from the beginning\n";
+    }
+
+    // Mark the regions completed by previous runs
+    vector<uint64_t> region_indexes;
+
+    for (auto& file_path: this->previous_paths){
+        ifstream file(file_path, std::ios::binary);
+        this->read_header(file, file_path, region_indexes);
+
+        for (auto& i: region_indexes){
+            if (this->completed[i]){
+                throw runtime_error("ERROR: region " + to_string(i) + " is in more than one checkpoint: " + file_path.string());
+            }
+
+            this->completed[i] = true;
+        }
+    }
+
+    if (resume){
+        cerr << "Resuming from " << this->previous_paths.size() << " checkpoints, with " << this->get_n_completed()
+             << " of " << this->n_regions << " regions completed\n";
+    }
+
+    if (this->interval > 0){
+        create_directories(this->directory);
+    }
+}
+
+
+void Checkpoint::remove_files() const{
+    if (not exists(this->directory)){
+        return;
+    }
+
+    for (auto& entry: directory_iterator(this->directory)){
+        string name = entry.path().filename().string();
+        uint64_t run;
+        uint16_t thread_index;
+
+        // Including any that was being written when the run stopped
+        if (entry.path().extension() == ".tmp"){
+            name = entry.path().stem().string();
+        }
+
+        if (parse_name(name, run, thread_index)){
+            remove(entry.path());
+        }
+    }
+
+    if (is_empty(this->directory)){
+        remove(this->directory);
+    }
+}
+
+
+bool Checkpoint::is_completed(size_t region_index) const{
+    return region_index < this->completed.size() and this->completed[region_index];
+}
+
+
+size_t Checkpoint::get_n_completed() const{
+    return size_t(count(this->completed.begin(), this->completed.end(), true));
+}
+
+
+path Checkpoint::get_path(uint64_t run, uint16_t thread_index) const{
+    return this->directory / ("checkpoint_" + to_string(run) + "_" + to_string(thread_index) + ".bin");
+}
+
+
+void Checkpoint::write_header(ostream& file, uint16_t thread_index) const{
+    auto& region_indexes = this->completed_per_thread[thread_index];
+
+    file.write(checkpoint_magic, sizeof(checkpoint_magic));
+    write_value_to_binary(file, this->inputs_hash);
+    write_value_to_binary(file, this->n_regions);
+    write_value_to_binary(file, uint64_t(region_indexes.size()));
+    write_vector_to_binary(file, region_indexes);
+}
+
+
+void Checkpoint::read_header(istream& file, path file_path, vector<uint64_t>& region_indexes) const{
+    char magic[sizeof(checkpoint_magic)];
+    uint64_t hash;
+    uint64_t n;
+    uint64_t n_completed;
+
+    file.read(magic, sizeof(magic));
+
+    if (not file or memcmp(magic, checkpoint_magic, sizeof(magic)) != 0){
+        throw runtime_error("ERROR: not a checkpoint file: " + file_path.string());
+    }
+
+    file.read(reinterpret_cast<char*>(&hash), sizeof(uint64_t));
+    file.read(reinterpret_cast<char*>(&n), sizeof(uint64_t));
+    file.read(reinterpret_cast<char*>(&n_completed), sizeof(uint64_t));
+
+    if (not file or hash != this->inputs_hash or n != this->n_regions or n_completed > n){
+        throw runtime_error("ERROR: checkpoint was made with different inputs or regions (reads, alignments, reference, "
+                            "chunk size or BED): " + file_path.string());
+    }
+
+    region_indexes.resize(n_completed);
+    file.read(reinterpret_cast<char*>(region_indexes.data()), n_completed*sizeof(uint64_t));
+
+    if (not file){
+        throw runtime_error("ERROR: checkpoint is truncated: " + file_path.string());
+    }
+
+    for (auto& i: region_indexes){
+        if (i >= this->n_regions){
+            throw runtime_error("ERROR: region index out of range in checkpoint: " + file_path.string());
+        }
+    }
+}
@@ -0,0 +1,439 @@
+#include "CompactFastaIndex.hpp"
+#include "Miscellaneous.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <cerrno>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using std::experimental::filesystem::exists;
+using std::experimental::filesystem::file_size;
+using std::from_chars;
+using std::memchr;
+using std::memcmp;
+using std::memcpy;
+using std::ifstream;
+using std::ofstream;
+using std::to_string;
+using std::sort;
+using std::lower_bound;
+
+
+FastaIndex::FastaIndex(uint64_t byte_index, uint64_t length){
+    this->byte_index = byte_index;
+    this->length = length;
+}
+
+
+uint64_t FastaIndex::size(){
+    return this->length;
+}
+
+
+FastaIndex::FastaIndex() = default;
+
+
+uint64_t get_padding(uint64_t n_bytes){
+    return (8 - n_bytes%8)%8;
+}
+
+
+void write_padding(ofstream& file, uint64_t n_bytes){
+    const char zeros[8] = {0};
+    file.write(zeros, get_padding(n_bytes));
+}
+
+
+uint64_t CompactFastaIndex::get_modification_time(path file_path){
+    ///
+    /// Nanoseconds since the epoch, so that a file rewritten within the same second (with the same size) still differs
+    ///
+    struct stat file_stats;
+
+    if (stat(file_path.c_str(), &file_stats) == -1){
+        throw runtime_error("ERROR: could not stat " + file_path.string());
+    }
+
+    return uint64_t(file_stats.st_mtim.tv_sec)*1000*1000*1000 + uint64_t(file_stats.st_mtim.tv_nsec);
+}
+
+
+uint64_t CompactFastaIndex::hash(const char* s, size_t length){
+    ///
+    /// Mix the name 8 bytes at a time, then apply the splitmix64 finalizer so that the top bits (which select the
+    /// directory bucket) are well distributed. This must never change without incrementing the version, because the
+    /// hashes are stored in the file.
+    ///
+    uint64_t h = 0x9e3779b97f4a7c15 ^ length;
+    uint64_t word;
+
+    for (; length >= 8; s += 8, length -= 8){
+        memcpy(&word, s, 8);
+        h = (h ^ word)*0xff51afd7ed558ccd;
+        h ^= h >> 32;
+    }
+
+    word = 0;
+    memcpy(&word, s, length);
+    h = (h ^ word)*0xff51afd7ed558ccd;
+
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111eb;
+    h ^= h >> 31;
+
+    return h;
+}
+
+
+void CompactFastaIndex::build(path fai_path, path fasta_path, path output_path){
+    // Stat the inputs before reading them, so that a change made during the build makes the result out of date
+    uint64_t fasta_size = file_size(fasta_path);
+    uint64_t fai_size = file_size(fai_path);
+    uint64_t fasta_modification_time = get_modification_time(fasta_path);
+    uint64_t fai_modification_time = get_modification_time(fai_path);
+
+    string buffer;
+    read_file_to_string(fai_path, buffer);
+
+    vector<uint64_t> byte_indexes;
+    vector<uint64_t> lengths;
+    vector<uint32_t> name_offsets = {0};
+    string arena;
+
+    const char* p = buffer.data();
+    const char* end = p + buffer.size();
+
+    uint64_t byte_index;
+    uint64_t length;
+
+    // Parse the name, length and offset columns of the samtools .fai
+    while (p < end){
+        auto newline = static_cast<const char*>(memchr(p, '\n', end - p));
+        const char* line_stop = (newline == nullptr) ? end : newline;
+
+        if (line_stop > p) {
+            auto tab_0 = static_cast<const char*>(memchr(p, '\t', line_stop - p));
+            auto tab_1 = (tab_0 == nullptr) ? nullptr : static_cast<const char*>(memchr(tab_0 + 1, '\t', line_stop - tab_0 - 1));
+
+            if (tab_1 == nullptr){
+                throw runtime_error("ERROR: incomplete line in fasta index " + fai_path.string() + ": " + string(p, line_stop));
+            }
+
+            auto length_result = from_chars(tab_0 + 1, tab_1, length);
+            auto byte_index_result = from_chars(tab_1 + 1, line_stop, byte_index);
+
+            if (length_result.ec != std::errc() or byte_index_result.ec != std::errc()){
+                throw runtime_error("ERROR: could not parse line in fasta index " + fai_path.string() + ": " + string(p, line_stop));
+            }
+
+            arena.append(p, tab_0);
+
+            if (arena.size() > UINT32_MAX){
+                throw runtime_error("ERROR: read names in " + fai_path.string() + " exceed 4GB, too large for compact index");
+            }
+
+            byte_indexes.emplace_back(byte_index);
+            lengths.emplace_back(length);
+            name_offsets.emplace_back(arena.size());
+        }
+
+        p = line_stop + 1;
+    }
+
+    uint64_t n_sequences = byte_indexes.size();
+
+    // Sort by hash, and keep the FASTA order index of each hash
+    vector <pair <uint64_t, uint32_t> > sorted_hashes(n_sequences);
+
+    for (uint64_t i=0; i<n_sequences; i++){
+        sorted_hashes[i] = {hash(arena.data() + name_offsets[i], name_offsets[i+1] - name_offsets[i]), uint32_t(i)};
+    }
+
+    sort(sorted_hashes.begin(), sorted_hashes.end());
+
+    // Any duplicate name must be among the sequences that share its hash, which are adjacent after sorting
+    for (uint64_t i=1; i<n_sequences; i++){
+        for (uint64_t j=i; j>0 and sorted_hashes[j-1].first == sorted_hashes[i].first; j--){
+            uint32_t a = sorted_hashes[j-1].second;
+            uint32_t b = sorted_hashes[i].second;
+            uint32_t a_length = name_offsets[a+1] - name_offsets[a];
+            uint32_t b_length = name_offsets[b+1] - name_offsets[b];
+
+            if (a_length == b_length and memcmp(arena.data() + name_offsets[a], arena.data() + name_offsets[b], a_length) == 0){
+                throw runtime_error("ERROR: duplicate reads detected in FASTA: " + arena.substr(name_offsets[a], a_length));
+            }
+        }
+    }
+
+    // Roughly 2 sequences per bucket
+    uint64_t directory_bits = 0;
+    while ((uint64_t(4) << directory_bits) <= n_sequences and directory_bits < 32){
+        directory_bits++;
+    }
+
+    uint64_t n_buckets = uint64_t(1) << directory_bits;
+    vector<uint32_t> directory(n_buckets + 1);
+
+    uint64_t s = 0;
+    for (uint64_t bucket=0; bucket<n_buckets; bucket++){
+        while (s < n_sequences and (directory_bits == 0 ? 0 : sorted_hashes[s].first >> (64 - directory_bits)) < bucket){
+            s++;
+        }
+        directory[bucket] = uint32_t(s);
+    }
+    directory[n_buckets] = uint32_t(n_sequences);
+
+    path temporary_path = get_temporary_path(output_path);
+    ofstream file(temporary_path, std::ios::binary);
+
+    if (not file.is_open()){
+        throw runtime_error("ERROR: could not open file " + temporary_path.string());
+    }
+
+    uint64_t header[10] = {CompactFastaIndex::magic,
+                           CompactFastaIndex::version,
+                           fasta_size,
+                           fai_size,
+                           n_sequences,
+                           arena.size(),
+                           directory_bits,
+                           fasta_modification_time,
+                           fai_modification_time,
+                           0};
+
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(byte_indexes.data()), n_sequences*sizeof(uint64_t));
+    file.write(reinterpret_cast<const char*>(lengths.data()), n_sequences*sizeof(uint64_t));
+
+    for (auto& item: sorted_hashes){
+        file.write(reinterpret_cast<const char*>(&item.first), sizeof(uint64_t));
+    }
+    for (auto& item: sorted_hashes){
+        file.write(reinterpret_cast<const char*>(&item.second), sizeof(uint32_t));
+    }
+    write_padding(file, n_sequences*sizeof(uint32_t));
+
+    file.write(reinterpret_cast<const char*>(directory.data()), directory.size()*sizeof(uint32_t));
+    write_padding(file, directory.size()*sizeof(uint32_t));
+
+    file.write(reinterpret_cast<const char*>(name_offsets.data()), name_offsets.size()*sizeof(uint32_t));
+    write_padding(file, name_offsets.size()*sizeof(uint32_t));
+
+    file.write(arena.data(), arena.size());
+
+    file.close();
+
+    if (file.fail()){
+        throw runtime_error("ERROR: could not write file " + temporary_path.string());
+    }
+
+    rename_temporary_file(temporary_path, output_path);
+}
+
+
+bool CompactFastaIndex::read_file_header(path file_path, uint64_t header[10]){
+    if (not exists(file_path)){
+        return false;
+    }
+
+    ifstream file(file_path, std::ios::binary);
+    file.read(reinterpret_cast<char*>(header), 10*sizeof(uint64_t));
+
+    return file.good();
+}
+
+
+bool CompactFastaIndex::is_up_to_date(path file_path, path fai_path, path fasta_path){
+    uint64_t header[10];
+
+    if (not exists(fai_path) or not read_file_header(file_path, header)){
+        return false;
+    }
+
+    // An edit that keeps the size of the FASTA or .fai (e.g. renaming a read to one of the same length) still changes
+    // its modification time
+    return header[0] == CompactFastaIndex::magic and
+           header[1] == CompactFastaIndex::version and
+           header[2] == file_size(fasta_path) and
+           header[3] == file_size(fai_path) and
+           header[7] == get_modification_time(fasta_path) and
+           header[8] == get_modification_time(fai_path);
+}
+
+
+bool CompactFastaIndex::is_fai_up_to_date(path file_path, path fai_path, path fasta_path){
+    ///
+    /// A FASTA edited in place after its .fai was made has a newer modification time. An edit within the resolution of
+    /// the modification times can't be seen that way, but if the compact index was built from this .fai after the edit,
+    /// its record of the FASTA shows the change.
+    ///
+    if (not exists(fai_path)){
+        return false;
+    }
+
+    if (get_modification_time(fai_path) < get_modification_time(fasta_path)){
+        return false;
+    }
+
+    uint64_t header[10];
+
+    if (read_file_header(file_path, header) and
+        header[0] == CompactFastaIndex::magic and
+        header[1] == CompactFastaIndex::version and
+        header[3] == file_size(fai_path) and
+        header[8] == get_modification_time(fai_path)){
+        return header[2] == file_size(fasta_path) and header[7] == get_modification_time(fasta_path);
+    }
+
+    return true;
+}
+
+
+CompactFastaIndex::CompactFastaIndex(path file_path){
+    this->file_path = file_path;
+
+    this->file_descriptor = ::open(file_path.c_str(), O_RDONLY);
+
+    if (this->file_descriptor == -1) {
+        throw runtime_error("ERROR: could not read " + file_path.string());
+    }
+
+    struct stat file_stats;
+    if (fstat(this->file_descriptor, &file_stats) == -1){
+        ::close(this->file_descriptor);
+        throw runtime_error("ERROR: could not stat " + file_path.string());
+    }
+    this->file_length = file_stats.st_size;
+
+    if (this->file_length < CompactFastaIndex::header_size){
+        ::close(this->file_descriptor);
+        throw runtime_error("ERROR: file too small to be a compact fasta index: " + file_path.string());
+    }
+
+    void* mapped = mmap(nullptr, this->file_length, PROT_READ, MAP_PRIVATE, this->file_descriptor, 0);
+
+    if (mapped == MAP_FAILED){
+        ::close(this->file_descriptor);
+        throw runtime_error("ERROR: could not mmap " + file_path.string() + ": " + string(::strerror(errno)));
+    }
+
+    this->data = static_cast<const char*>(mapped);
+
+    try {
+        this->read_header();
+    }
+    catch (...){
+        munmap(const_cast<char*>(this->data), this->file_length);
+        ::close(this->file_descriptor);
+        throw;
+    }
+}
+
+
+CompactFastaIndex::~CompactFastaIndex(){
+    munmap(const_cast<char*>(this->data), this->file_length);
+    ::close(this->file_descriptor);
+}
+
+
+void CompactFastaIndex::read_header(){
+    ///
+    /// Verify the header and point each section at its place in the mapped file. Sections are 8 byte aligned relative
+    /// to the (page aligned) start of the mapping, so they can be read in place.
+    ///
+    uint64_t header[10];
+    memcpy(header, this->data, sizeof(header));
+
+    if (header[0] != CompactFastaIndex::magic or header[1] != CompactFastaIndex::version){
+        throw runtime_error("ERROR: unrecognized compact fasta index format: " + this->file_path.string());
+    }
+
+    this->n_sequences = header[4];
+    this->arena_size = header[5];
+    this->directory_bits = header[6];
+
+    uint64_t n_buckets = uint64_t(1) << this->directory_bits;
+
+    uint64_t byte_index = CompactFastaIndex::header_size;
+
+    this->byte_indexes = reinterpret_cast<const uint64_t*>(this->data + byte_index);
+    byte_index += this->n_sequences*sizeof(uint64_t);
+
+    this->lengths = reinterpret_cast<const uint64_t*>(this->data + byte_index);
+    byte_index += this->n_sequences*sizeof(uint64_t);
+
+    this->hashes = reinterpret_cast<const uint64_t*>(this->data + byte_index);
+    byte_index += this->n_sequences*sizeof(uint64_t);
+
+    this->order = reinterpret_cast<const uint32_t*>(this->data + byte_index);
+    byte_index += this->n_sequences*sizeof(uint32_t);
+    byte_index += get_padding(byte_index);
+
+    this->directory = reinterpret_cast<const uint32_t*>(this->data + byte_index);
+    byte_index += (n_buckets + 1)*sizeof(uint32_t);
+    byte_index += get_padding(byte_index);
+
+    this->name_offsets = reinterpret_cast<const uint32_t*>(this->data + byte_index);
+    byte_index += (this->n_sequences + 1)*sizeof(uint32_t);
+    byte_index += get_padding(byte_index);
+
+    this->names = this->data + byte_index;
+    byte_index += this->arena_size;
+
+    if (byte_index != this->file_length){
+        throw runtime_error("ERROR: compact fasta index is truncated or corrupt: " + this->file_path.string());
+    }
+}
+
+
+int64_t CompactFastaIndex::find(const string& name){
+    uint64_t h = CompactFastaIndex::hash(name.data(), name.size());
+    uint64_t bucket = (this->directory_bits == 0) ? 0 : h >> (64 - this->directory_bits);
+
+    const uint64_t* start = this->hashes + this->directory[bucket];
+    const uint64_t* stop = this->hashes + this->directory[bucket + 1];
+
+    for (auto p = lower_bound(start, stop, h); p < stop and *p == h; p++){
+        uint32_t i = this->order[p - this->hashes];
+        uint32_t length = this->name_offsets[i+1] - this->name_offsets[i];
+
+        if (length == name.size() and memcmp(this->names + this->name_offsets[i], name.data(), length) == 0){
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+
+bool CompactFastaIndex::find(const string& name, FastaIndex& index){
+    int64_t i = this->find(name);
+
+    if (i < 0){
+        return false;
+    }
+
+    index = this->get_index(i);
+    return true;
+}
+
+
+FastaIndex CompactFastaIndex::get_index(uint64_t i){
+    return {this->byte_indexes[i], this->lengths[i]};
+}
+
+
+string CompactFastaIndex::get_name(uint64_t i){
+    return string(this->names + this->name_offsets[i], this->name_offsets[i+1] - this->name_offsets[i]);
+}
+
+
+size_t CompactFastaIndex::size(){
+    return this->n_sequences;
+}
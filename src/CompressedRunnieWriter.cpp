@@ -1,22 +1,19 @@
 
-#include "boost/icl/interval_map.hpp"
-#include "boost/icl/interval.hpp"
 #include "CompressedRunnieWriter.hpp"
 #include "RunnieReader.hpp"
 #include "BinaryIO.hpp"
 #include <experimental/filesystem>
 #include <utility>
 #include <bitset>
+#include <algorithm>
 
-using boost::icl::interval_map;
-using boost::icl::interval;
-using boost::icl::total_enricher;
 using std::experimental::filesystem::create_directories;
 using std::unordered_map;
 using std::make_pair;
 using std::getline;
 using std::bitset;
 using std::cerr;
+using std::max;
 
 
 ostream& operator<<(ostream& s, CompressedRunnieIndex& index) {
@@ -50,38 +47,153 @@ CompressedRunnieWriter::CompressedRunnieWriter(path file_path, path params_path)
 }
 
 
-void CompressedRunnieWriter::build_recursive_interval_tree(){
+void CompressedRunnieWriter::build_lookup_table(){
     ///
-    /// Build a recursive interval tree such that each scale interval refers to its substituent shape tree, which refers
-    /// to the encoding for (shape|scale)
+    /// Flatten the scale intervals and each of their shape intervals into sorted arrays of bounds, such that each scale
+    /// interval refers to its substituent shape bounds, which give the encoding for (shape|scale)
     ///
 
+    this->scale_bounds = {};
+    this->shape_bounds = {};
+    this->shape_bound_offsets = {};
+    this->encoding_offsets = {};
+    this->max_shape_intervals = 0;
+
     // This is incremented for each cluster/2D interval
-    uint8_t byte_encoding = 0;
+    uint64_t n_encodings = 0;
 
-    // Convert each vector of shape intervals into an interval tree
     for (size_t i=0; i<this->shape_intervals.size(); i++){
         pair<double,double> scale_interval = this->scale_intervals[i];
-        auto shape_interval_tree = interval_map<double,uint8_t,total_enricher>();
 
-        // Build the child tree
-        for (auto& shape_interval: this->shape_intervals[i]){
-            auto a = interval<double>::right_open(shape_interval.first, shape_interval.second);
-            shape_interval_tree.insert(make_pair(a, byte_encoding));
-            byte_encoding++;
+        if (i > 0 and scale_interval.first != this->scale_intervals[i-1].second){
+            throw runtime_error("ERROR: scale intervals in compression parameters are not contiguous at: " + to_string(scale_interval.first));
+        }
+        if (this->shape_intervals[i].empty()){
+            throw runtime_error("ERROR: no shape intervals in compression parameters for scale: " + to_string(scale_interval.first));
         }
 
-        // Add the child tree (shapes) to the parent tree (scales)
-        auto b = interval<double>::right_open(scale_interval.first, scale_interval.second);
-        this->recursive_interval_map.insert(make_pair(b, shape_interval_tree));
+        this->scale_bounds.emplace_back(scale_interval.first);
+        this->shape_bound_offsets.emplace_back(this->shape_bounds.size());
+        this->encoding_offsets.emplace_back(n_encodings);
+
+        for (size_t j=0; j<this->shape_intervals[i].size(); j++){
+            auto& shape_interval = this->shape_intervals[i][j];
+
+            if (j > 0 and shape_interval.first != this->shape_intervals[i][j-1].second){
+                throw runtime_error("ERROR: shape intervals in compression parameters are not contiguous at: " + to_string(shape_interval.first));
+            }
+
+            this->shape_bounds.emplace_back(shape_interval.first);
+            n_encodings++;
+        }
+
+        this->shape_bounds.emplace_back(this->shape_intervals[i].back().second);
+        this->max_shape_intervals = max(this->max_shape_intervals, uint32_t(this->shape_intervals[i].size()));
+    }
+
+    if (this->scale_intervals.empty()){
+        throw runtime_error("ERROR: no intervals found in compression parameters: " + this->params_path.string());
     }
+    if (n_encodings > 256){
+        throw runtime_error("ERROR: compression parameters define more encodings than fit in one byte: " + to_string(n_encodings));
+    }
+
+    this->scale_bounds.emplace_back(this->scale_intervals.back().second);
+    this->shape_bound_offsets.emplace_back(this->shape_bounds.size());
+}
+
+
+inline size_t find_interval(const double* bounds, size_t n_intervals, double x){
+    ///
+    /// Branchless binary search for the interval [bounds[i], bounds[i+1]) containing x. The loop always runs
+    /// log2(n_intervals) times and the comparison compiles to a conditional move. Values below the first bound (or NaN)
+    /// fall into the first interval, and values above the last bound fall into the last interval.
+    ///
+    const double* base = bounds;
+    size_t n = n_intervals;
+
+    while (n > 1){
+        size_t half = n/2;
+        base = (base[half] <= x) ? base + half : base;
+        n -= half;
+    }
+
+    return base - bounds;
 }
 
 
 uint8_t CompressedRunnieWriter::fetch_encoding(double scale, double shape){
-    uint8_t byte = this->recursive_interval_map.find(scale)->second.find(shape)->second;
+    size_t i = find_interval(this->scale_bounds.data(), this->scale_bounds.size() - 1, scale);
+
+    uint32_t start = this->shape_bound_offsets[i];
+    uint32_t n_intervals = this->shape_bound_offsets[i+1] - start - 1;
+
+    size_t j = find_interval(this->shape_bounds.data() + start, n_intervals, shape);
+
+    return uint8_t(this->encoding_offsets[i] + j);
+}
+
 
-    return byte;
+void CompressedRunnieWriter::fetch_encodings(vector<uint8_t>& encodings, vector<float>& scales, vector<float>& shapes){
+    ///
+    /// Encode a whole read at once. Elements are encoded in blocks, and each step of the binary search is applied to
+    /// every element of the block before the next step, so the loads of independent elements overlap instead of each
+    /// search waiting on its own chain of dependent loads. The scale searches all take the same number of steps. The
+    /// shape searches take as many steps as the largest scale interval needs, and a search that has already converged
+    /// (n == 1) adds a step of 0, so every element gets the same result as fetch_encoding.
+    ///
+    static const size_t block_size = 16;
+
+    encodings.resize(scales.size());
+
+    const double* scale_bounds = this->scale_bounds.data();
+    const double* shape_bounds = this->shape_bounds.data();
+    const size_t n_scale_intervals = this->scale_bounds.size() - 1;
+
+    size_t scale_index[block_size];
+    size_t shape_index[block_size];
+    size_t n_shape_intervals[block_size];
+
+    size_t i = 0;
+
+    for (; i + block_size <= scales.size(); i += block_size){
+        const float* block_scales = scales.data() + i;
+        const float* block_shapes = shapes.data() + i;
+
+        for (size_t b=0; b<block_size; b++){
+            scale_index[b] = 0;
+        }
+
+        for (size_t n=n_scale_intervals; n > 1; n -= n/2){
+            size_t half = n/2;
+
+            for (size_t b=0; b<block_size; b++){
+                scale_index[b] += (scale_bounds[scale_index[b] + half] <= block_scales[b]) ? half : 0;
+            }
+        }
+
+        for (size_t b=0; b<block_size; b++){
+            shape_index[b] = this->shape_bound_offsets[scale_index[b]];
+            n_shape_intervals[b] = this->shape_bound_offsets[scale_index[b]+1] - shape_index[b] - 1;
+        }
+
+        for (size_t n=this->max_shape_intervals; n > 1; n -= n/2){
+            for (size_t b=0; b<block_size; b++){
+                size_t half = n_shape_intervals[b]/2;
+                shape_index[b] += (shape_bounds[shape_index[b] + half] <= block_shapes[b]) ? half : 0;
+                n_shape_intervals[b] -= half;
+            }
+        }
+
+        for (size_t b=0; b<block_size; b++){
+            size_t j = shape_index[b] - this->shape_bound_offsets[scale_index[b]];
+            encodings[i+b] = uint8_t(this->encoding_offsets[scale_index[b]] + j);
+        }
+    }
+
+    for (; i<scales.size(); i++){
+        encodings[i] = this->fetch_encoding(scales[i], shapes[i]);
+    }
 }
 
 
@@ -116,7 +228,7 @@ void CompressedRunnieWriter::load_parameters(){
             tab_index = line.find_first_of(tab_separator);
 
             // Read the comma separated scale interval
-            line_scales_string = line.substr(0,tab_index-1);
+            line_scales_string = line.substr(0,tab_index);
             parse_comma_separated_pair_as_doubles(interval, line_scales_string);
             this->scale_intervals.emplace_back(interval);
 
@@ -134,7 +246,7 @@ void CompressedRunnieWriter::load_parameters(){
         }
     }
 
-    this-> build_recursive_interval_tree();
+    this->build_lookup_table();
 }
 
 
@@ -145,13 +257,9 @@ void CompressedRunnieWriter::write_sequence_block(RunnieSequenceElement& sequenc
 
 
 void CompressedRunnieWriter::write_encoding_block(RunnieSequenceElement& sequence){
-    uint8_t encoding = -1;
-
-    // Write the encodings to the file
-    for (size_t i=0; i<sequence.scales.size(); i++){
-        encoding = this->fetch_encoding(sequence.scales[i], sequence.shapes[i]);
-        write_value_to_binary(this->sequence_file, encoding);
-    }
+    // Encode the whole sequence, then write the encodings to the file in one block
+    this->fetch_encodings(this->encodings, sequence.scales, sequence.shapes);
+    write_vector_to_binary(this->sequence_file, this->encodings);
 }
 
 
@@ -0,0 +1,472 @@
+#include "CompressionParameterTrainer.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <exception>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <thread>
+#include <atomic>
+
+using std::experimental::filesystem::create_directories;
+using std::bernoulli_distribution;
+using std::partition_point;
+using std::runtime_error;
+using std::setprecision;
+using std::exception;
+using std::ofstream;
+using std::mt19937_64;
+using std::to_string;
+using std::atomic;
+using std::thread;
+using std::fixed;
+using std::cerr;
+using std::sort;
+using std::min;
+using std::max;
+using std::ref;
+using std::unique_lock;
+using std::lock_guard;
+
+
+CodebookCell::CodebookCell(double loss, float lower, float upper, size_t start, size_t stop, uint32_t strip_index){
+    this->loss = loss;
+    this->lower = lower;
+    this->upper = upper;
+    this->start = start;
+    this->stop = stop;
+    this->strip_index = strip_index;
+}
+
+
+bool operator<(const CodebookCell& a, const CodebookCell& b){
+    ///
+    /// Ties in loss are broken by position, so that training is deterministic
+    ///
+    if (a.loss != b.loss){
+        return a.loss < b.loss;
+    }
+    if (a.strip_index != b.strip_index){
+        return a.strip_index > b.strip_index;
+    }
+    return a.lower > b.lower;
+}
+
+
+CompressionParameterTrainer::CompressionParameterTrainer(BoundingBox boundary, size_t distribution_size, uint16_t max_threads){
+    this->boundary = boundary;
+    this->distribution_size = distribution_size;
+    this->max_threads = max(uint16_t(1), max_threads);
+}
+
+
+CompressionParameterTrainer::~CompressionParameterTrainer(){
+    this->stop_workers();
+}
+
+
+void CompressionParameterTrainer::start_workers(){
+    // New workers start from generation 0, so a generation left over from a previous train() must not look like a job
+    {
+        lock_guard<mutex> lock(this->pool_mutex);
+        this->stopping = false;
+        this->job_generation = 0;
+        this->n_pending_workers = 0;
+    }
+
+    this->partial_losses.assign(this->max_threads, DiscreteWeibullLoss(this->distribution_size));
+
+    for (size_t i=0; i<this->max_threads; i++){
+        try {
+            this->workers.emplace_back(thread(&CompressionParameterTrainer::run_worker, this, i));
+        } catch (const exception &e) {
+            cerr << e.what() << "\n";
+            exit(1);
+        }
+    }
+}
+
+
+void CompressionParameterTrainer::stop_workers(){
+    {
+        lock_guard<mutex> lock(this->pool_mutex);
+        this->stopping = true;
+    }
+    this->job_ready.notify_all();
+
+    for (auto& t: this->workers){
+        t.join();
+    }
+
+    this->workers.clear();
+}
+
+
+void CompressionParameterTrainer::run_worker(size_t worker_index){
+    ///
+    /// Wait for each job posted by calculate_loss, and accumulate this worker's slice of its range
+    ///
+    uint64_t last_generation = 0;
+
+    while (true){
+        size_t start;
+        size_t stop;
+
+        {
+            unique_lock<mutex> lock(this->pool_mutex);
+            this->job_ready.wait(lock, [&]{return this->stopping or this->job_generation != last_generation;});
+
+            if (this->stopping){
+                return;
+            }
+
+            last_generation = this->job_generation;
+            start = this->job_start;
+            stop = this->job_stop;
+        }
+
+        size_t length = stop - start;
+        size_t a = start + (length*worker_index)/this->max_threads;
+        size_t b = start + (length*(worker_index+1))/this->max_threads;
+
+        auto& partial_loss = this->partial_losses[worker_index];
+        partial_loss.reset();
+
+        for (size_t i=a; i<b; i++){
+            partial_loss.update(this->points[i]);
+        }
+
+        {
+            lock_guard<mutex> lock(this->pool_mutex);
+            this->n_pending_workers--;
+        }
+        this->job_done.notify_one();
+    }
+}
+
+
+void index_runnie_directories(vector<RunnieReader>& readers, atomic<uint64_t>& job_index){
+    while (job_index < readers.size()){
+        uint64_t thread_job_index = job_index.fetch_add(1);
+
+        if (thread_job_index >= readers.size()){
+            break;
+        }
+
+        readers[thread_job_index].index();
+
+        cerr << "Indexed: " << readers[thread_job_index].directory_path.string() + "\n";
+    }
+}
+
+
+void sample_runnie_points(vector<RunnieReader>& readers,
+                          vector <pair <uint32_t, string> >& reads,
+                          BoundingBox& boundary,
+                          double sample_rate,
+                          uint64_t seed,
+                          vector<QuadCoordinate>& thread_points,
+                          atomic<uint64_t>& job_index){
+    ///
+    /// Each read has its own RNG seeded by its position in the (sorted) read list, so the sample does not depend on
+    /// how reads happen to be distributed across threads
+    ///
+    RunnieSequenceElement sequence;
+    bernoulli_distribution coin(sample_rate);
+
+    while (job_index < reads.size()){
+        uint64_t thread_job_index = job_index.fetch_add(1);
+
+        if (thread_job_index >= reads.size()){
+            break;
+        }
+
+        auto& read = reads[thread_job_index];
+        readers[read.first].fetch_sequence(sequence, read.second);
+
+        mt19937_64 generator(seed + thread_job_index);
+
+        for (size_t i=0; i<sequence.scales.size(); i++){
+            if (not coin(generator)){
+                continue;
+            }
+
+            QuadCoordinate point(sequence.scales[i], sequence.shapes[i]);
+
+            if (boundary.contains(point)){
+                thread_points.emplace_back(point);
+            }
+        }
+    }
+}
+
+
+void CompressionParameterTrainer::sample_points(vector<path>& input_dirs, uint64_t sample_size, uint64_t seed){
+    vector<RunnieReader> readers;
+    for (auto& input_dir: input_dirs){
+        readers.emplace_back(input_dir);
+    }
+
+    vector<thread> threads;
+    atomic<uint64_t> job_index = 0;
+
+    // Index all the directories at once
+    for (uint64_t i=0; i<min(uint64_t(this->max_threads), uint64_t(readers.size())); i++){
+        try {
+            threads.emplace_back(thread(index_runnie_directories, ref(readers), ref(job_index)));
+        } catch (const exception &e) {
+            cerr << e.what() << "\n";
+            exit(1);
+        }
+    }
+
+    for (auto& t: threads){
+        t.join();
+    }
+
+    // Pool the reads from every directory into one job list
+    vector <pair <uint32_t, string> > reads;
+    uint64_t n_bases = 0;
+
+    for (uint32_t r=0; r<readers.size(); r++){
+        for (auto& item: readers[r].read_indexes){
+            reads.emplace_back(r, item.first);
+            n_bases += item.second.length;
+        }
+    }
+
+    sort(reads.begin(), reads.end());
+
+    if (n_bases == 0){
+        throw runtime_error("ERROR: no Runnie sequences found in input directories");
+    }
+
+    double sample_rate = min(1.0, double(sample_size)/double(n_bases));
+
+    cerr << "Sampling " << sample_rate*100 << "% of " << n_bases << " bases from " << reads.size() << " reads\n";
+
+    vector <vector <QuadCoordinate> > points_per_thread(this->max_threads);
+
+    threads.clear();
+    job_index = 0;
+
+    for (uint64_t i=0; i<this->max_threads; i++){
+        try {
+            threads.emplace_back(thread(sample_runnie_points,
+                                        ref(readers),
+                                        ref(reads),
+                                        ref(this->boundary),
+                                        sample_rate,
+                                        seed,
+                                        ref(points_per_thread[i]),
+                                        ref(job_index)));
+        } catch (const exception &e) {
+            cerr << e.what() << "\n";
+            exit(1);
+        }
+    }
+
+    for (auto& t: threads){
+        t.join();
+    }
+
+    for (auto& thread_points: points_per_thread){
+        this->points.insert(this->points.end(), thread_points.begin(), thread_points.end());
+    }
+
+    cerr << "Sampled " << this->points.size() << " points\n";
+}
+
+
+double CompressionParameterTrainer::calculate_loss(size_t start, size_t stop){
+    ///
+    /// Split the range into one slice per worker, accumulate a DiscreteWeibullLoss for each slice, then sum the partial
+    /// stats. Small ranges, or calls outside of train() (when there are no workers), are accumulated on this thread.
+    ///
+    size_t length = stop - start;
+
+    if (this->workers.empty() or length < 1024*this->workers.size()){
+        DiscreteWeibullLoss loss(this->distribution_size);
+
+        for (size_t i=start; i<stop; i++){
+            loss.update(this->points[i]);
+        }
+
+        return loss.calculate_loss();
+    }
+
+    {
+        lock_guard<mutex> lock(this->pool_mutex);
+        this->job_start = start;
+        this->job_stop = stop;
+        this->n_pending_workers = this->workers.size();
+        this->job_generation++;
+    }
+    this->job_ready.notify_all();
+
+    {
+        unique_lock<mutex> lock(this->pool_mutex);
+        this->job_done.wait(lock, [&]{return this->n_pending_workers == 0;});
+    }
+
+    for (size_t i=1; i<this->partial_losses.size(); i++){
+        this->partial_losses[0].stats += this->partial_losses[i].stats;
+    }
+
+    return this->partial_losses[0].calculate_loss();
+}
+
+
+void CompressionParameterTrainer::split_scale_intervals(uint64_t n_scale_intervals, vector<CodebookCell>& strips){
+    float x_min = this->boundary.center.x - this->boundary.half_size;
+    float x_max = this->boundary.center.x + this->boundary.half_size;
+
+    priority_queue<CodebookCell> cells;
+    cells.emplace(this->calculate_loss(0, this->points.size()), x_min, x_max, 0, this->points.size());
+
+    while (cells.size() < n_scale_intervals){
+        CodebookCell cell = cells.top();
+
+        float midpoint = (cell.lower + cell.upper)/2;
+
+        // Nothing left to gain, or the interval can't be halved any further at float precision
+        if (cell.loss <= 0 or midpoint <= cell.lower or midpoint >= cell.upper){
+            break;
+        }
+
+        cells.pop();
+
+        auto split = partition_point(this->points.begin() + cell.start, this->points.begin() + cell.stop,
+                [&](const QuadCoordinate& p){return p.x < midpoint;});
+
+        size_t split_index = split - this->points.begin();
+
+        cells.emplace(this->calculate_loss(cell.start, split_index), cell.lower, midpoint, cell.start, split_index);
+        cells.emplace(this->calculate_loss(split_index, cell.stop), midpoint, cell.upper, split_index, cell.stop);
+
+        cerr << cells.size() << " scale intervals calculated\n";
+    }
+
+    strips = {};
+    while (not cells.empty()){
+        strips.emplace_back(cells.top());
+        cells.pop();
+    }
+
+    sort(strips.begin(), strips.end(), [](const CodebookCell& a, const CodebookCell& b){
+        return a.lower < b.lower;
+    });
+}
+
+
+void CompressionParameterTrainer::split_shape_intervals(uint64_t n_encodings, vector<CodebookCell>& strips){
+    float y_min = this->boundary.center.y - this->boundary.half_size;
+    float y_max = this->boundary.center.y + this->boundary.half_size;
+
+    priority_queue<CodebookCell> cells;
+
+    for (uint32_t s=0; s<strips.size(); s++){
+        auto& strip = strips[s];
+
+        sort(this->points.begin() + strip.start, this->points.begin() + strip.stop,
+                [](const QuadCoordinate& a, const QuadCoordinate& b){return a.y < b.y;});
+
+        cells.emplace(this->calculate_loss(strip.start, strip.stop), y_min, y_max, strip.start, strip.stop, s);
+    }
+
+    while (cells.size() < n_encodings){
+        CodebookCell cell = cells.top();
+
+        float midpoint = (cell.lower + cell.upper)/2;
+
+        if (cell.loss <= 0 or midpoint <= cell.lower or midpoint >= cell.upper){
+            break;
+        }
+
+        cells.pop();
+
+        auto split = partition_point(this->points.begin() + cell.start, this->points.begin() + cell.stop,
+                [&](const QuadCoordinate& p){return p.y < midpoint;});
+
+        size_t split_index = split - this->points.begin();
+
+        cells.emplace(this->calculate_loss(cell.start, split_index), cell.lower, midpoint, cell.start, split_index, cell.strip_index);
+        cells.emplace(this->calculate_loss(split_index, cell.stop), midpoint, cell.upper, split_index, cell.stop, cell.strip_index);
+
+        cerr << cells.size() << " encodings calculated\n";
+    }
+
+    // Collect the lower bound of every cell in each strip, then cap each strip with the upper bound of the domain
+    this->shape_bounds = vector <vector <float> >(strips.size());
+    while (not cells.empty()){
+        this->shape_bounds[cells.top().strip_index].emplace_back(cells.top().lower);
+        cells.pop();
+    }
+
+    for (auto& bounds: this->shape_bounds){
+        sort(bounds.begin(), bounds.end());
+        bounds.emplace_back(y_max);
+    }
+}
+
+
+void CompressionParameterTrainer::train(uint64_t n_scale_intervals, uint64_t n_encodings){
+    if (n_encodings > 256){
+        throw runtime_error("ERROR: cannot train more than 256 encodings, each must fit in one byte: " + to_string(n_encodings));
+    }
+    if (n_scale_intervals > n_encodings or n_scale_intervals == 0){
+        throw runtime_error("ERROR: number of scale intervals must be between 1 and the number of encodings");
+    }
+    if (this->points.empty()){
+        throw runtime_error("ERROR: no points sampled, cannot train compression parameters");
+    }
+
+    // Sorting by scale (and then shape) makes every strip a contiguous range, and makes the order deterministic. This
+    // is redone for every call, because splitting the shape intervals reorders the points within each strip.
+    sort(this->points.begin(), this->points.end(), [](const QuadCoordinate& a, const QuadCoordinate& b){
+        return (a.x < b.x) or (a.x == b.x and a.y < b.y);
+    });
+
+    vector<CodebookCell> strips;
+
+    if (this->max_threads > 1){
+        this->start_workers();
+    }
+
+    this->split_scale_intervals(n_scale_intervals, strips);
+    this->split_shape_intervals(n_encodings, strips);
+
+    this->stop_workers();
+
+    this->scale_intervals = {};
+    for (auto& strip: strips){
+        this->scale_intervals.emplace_back(strip.lower, strip.upper);
+    }
+}
+
+
+void CompressionParameterTrainer::write_parameters(path output_path){
+    ///
+    /// Write the bounds in the format read by CompressedRunnieWriter::load_parameters
+    ///
+    create_directories(output_path.parent_path());
+
+    ofstream file(output_path);
+
+    if (not file.is_open()){
+        throw runtime_error("ERROR: could not write file " + output_path.string());
+    }
+
+    file << fixed << setprecision(6);
+
+    file << ">bounds\n";
+    for (size_t s=0; s<this->scale_intervals.size(); s++){
+        file << this->scale_intervals[s].first << ',' << this->scale_intervals[s].second;
+
+        for (auto& bound: this->shape_bounds[s]){
+            file << '\t' << bound;
+        }
+        file << '\n';
+    }
+}
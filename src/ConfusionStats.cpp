@@ -1,15 +1,17 @@
 #include "ConfusionStats.hpp"
 #include "MarginPolishReader.hpp"
 #include "ShastaReader.hpp"
+#include "CoverageReader.hpp"
 #include "AlignedSegment.hpp"
 #include "RunnieReader.hpp"
 #include "FastaReader.hpp"
 #include "FastaWriter.hpp"
 #include "Runlength.hpp"
-#include "BedReader.hpp"
 #include "BamReader.hpp"
 #include "Align.hpp"
 #include "Base.hpp"
+#include "BinaryIO.hpp"
+#include "Checkpoint.hpp"
 #include <vector>
 #include <thread>
 #include <string>
@@ -219,6 +221,22 @@ void operator+=(ConfusionStats& a, ConfusionStats& b){
 }
 
 
+void write_to_binary(ostream& file, const ConfusionStats& confusion_stats){
+    write_map_to_binary(file, confusion_stats.length_match_coverage);
+    write_map_to_binary(file, confusion_stats.length_mismatch_coverage);
+    write_map_to_binary(file, confusion_stats.base_match_coverage);
+    write_map_to_binary(file, confusion_stats.base_mismatch_coverage);
+}
+
+
+void read_from_binary(istream& file, ConfusionStats& confusion_stats){
+    read_map_from_binary(file, confusion_stats.length_match_coverage);
+    read_map_from_binary(file, confusion_stats.length_mismatch_coverage);
+    read_map_from_binary(file, confusion_stats.base_match_coverage);
+    read_map_from_binary(file, confusion_stats.base_mismatch_coverage);
+}
+
+
 void ConfusionStats::update(
         char true_base,
         char consensus_base,
@@ -248,7 +266,10 @@ template<typename T> void parse_aligned_coverage(path bam_path,
         unordered_map <string,path>& read_paths,
         unordered_map <string,RunlengthSequenceElement>& ref_runlength_sequences,
         vector <Region>& regions,
+        IntervalIndex& bed_index,
         ConfusionStats& confusion_stats,
+        Checkpoint& checkpoint,
+        uint16_t thread_index,
         atomic <uint64_t>& job_index){
     ///
     ///
@@ -273,8 +294,8 @@ template<typename T> void parse_aligned_coverage(path bam_path,
     bool filter_secondary = true;
     uint16_t map_quality_cutoff = 5;
 
-    bool in_left_bound;
-    bool in_right_bound;
+    bool in_bed;
+    vector<Region> bed_regions;
     char true_base;
     char consensus_base;
     uint16_t true_length = -1;
@@ -286,23 +307,41 @@ template<typename T> void parse_aligned_coverage(path bam_path,
 
     while (job_index < regions.size()) {
         uint64_t thread_job_index = job_index.fetch_add(1);
+
+        if (thread_job_index >= regions.size()){
+            break;
+        }
+
+        // Skip the regions that were completed before the run was resumed
+        if (checkpoint.is_completed(thread_job_index)){
+            continue;
+        }
+
         region = regions.at(thread_job_index);
 
-        // BAM coords are 1 based
-        bam_reader.initialize_region(region.name, region.start+1, region.stop+1);
+        // Fetch only the alignments that belong to this region, each of which is walked in full
+        initialize_chunk(bam_reader, bed_index, region, bed_regions);
 
         int i = 0;
 
         while (bam_reader.next_alignment(aligned_segment, map_quality_cutoff, filter_secondary)) {
             reader.fetch_read(segment, aligned_segment.read_name);
 
+            // The BED intervals that the whole alignment overlaps (the fetch has already used the ones in this region)
+            if (not bed_index.empty()){
+                bed_regions.clear();
+                bed_index.get_merged_regions(bed_regions,
+                                             aligned_segment.ref_name,
+                                             aligned_segment.ref_start_index - 1,
+                                             aligned_segment.infer_reference_stop_position_from_alignment());
+            }
+
             // Iterate cigars that match the criteria (must be '=' or 'X')
             while (aligned_segment.next_coordinate(coordinate, cigar, valid_cigar_codes)) {
-                in_left_bound = (int64_t(region.start) <= coordinate.ref_index - 1);
-                in_right_bound = (coordinate.ref_index - 1 < int64_t(region.stop));
+                in_bed = bed_index.empty() or contains_position(bed_regions, coordinate.ref_index);
 
-                // Subset alignment to portions of the read that are within the window/region
-                if (in_left_bound and in_right_bound) {
+                // With a BED, only count the positions in its intervals
+                if (in_bed) {
                     true_base = ref_runlength_sequences.at(aligned_segment.ref_name).sequence[coordinate.ref_index];
                     consensus_base = segment.sequence[coordinate.read_true_index];
 
@@ -327,7 +366,11 @@ template<typename T> void parse_aligned_coverage(path bam_path,
         }
 
         cerr << "\33[2K\rParsed: " << region.to_string() << flush;
+
+        checkpoint.update(thread_index, thread_job_index, confusion_stats);
     }
+
+    checkpoint.save(thread_index, confusion_stats);
 }
 
 
@@ -336,6 +379,8 @@ template <typename T> ConfusionStats get_confusion_stats(path bam_path,
                                        unordered_map <string,path>& read_paths,
                                        unordered_map <string,RunlengthSequenceElement>& ref_runlength_sequences,
                                        vector <Region>& regions,
+                                       IntervalIndex& bed_index,
+                                       Checkpoint& checkpoint,
                                        uint16_t max_threads){
     ///
     ///
@@ -356,7 +401,10 @@ template <typename T> ConfusionStats get_confusion_stats(path bam_path,
                                         ref(read_paths),
                                         ref(ref_runlength_sequences),
                                         ref(regions),
+                                        ref(bed_index),
                                         ref(confusion_stats_per_thread[i]),
+                                        ref(checkpoint),
+                                        i,
                                         ref(job_index)));
         } catch (const exception &e) {
             cerr << e.what() << "\n";
@@ -380,29 +428,10 @@ template <typename T> ConfusionStats get_confusion_stats(path bam_path,
 
     confusion_stats_per_thread[0].write_summary_to_file("coverage_confusion_test/test_summary.csv");
 
-    return confusion_sum;
-}
-
-
-void chunk_regions(path bed_path, vector<Region>& regions, unordered_map<string,RunlengthSequenceElement>& sequences, uint64_t chunk_size){
-    if (bed_path.empty()){
-        // Chunk alignment regions
-        for (auto& [name, item]: sequences){
-            chunk_sequence(regions, name, chunk_size, item.sequence.size());
-        }
-    }
-    else{
-        // Load the BED regions, and then find the union of the regions in BED and reference FASTA
-        set<string> names;
-        for (auto& item: sequences){
-            names.insert(item.first);
-        }
-
-        BedReader bed_reader(bed_path);
-        bed_reader.read_regions(regions);
-        bed_reader.subset_by_regions_name(regions, names);
-    }
+    // Add the results of the regions that were completed before the run was resumed
+    checkpoint.load(confusion_sum);
 
+    return confusion_sum;
 }
 
 
@@ -410,7 +439,9 @@ template <typename T> void measure_confusion_stats_from_coverage_data(path input
                                                        path reference_fasta_path,
                                                        path output_directory,
                                                        uint16_t max_threads,
-                                                       path bed_path){
+                                                       path bed_path,
+                                                       bool resume,
+                                                       double checkpoint_interval){
 
     cerr << "Using " + to_string(max_threads) + " threads\n";
 
@@ -480,7 +511,12 @@ template <typename T> void measure_confusion_stats_from_coverage_data(path input
     // If a BED file was provided, only iterate the regions of the BAM that may be found in the reference provided.
     // Otherwise, iterate the entire BAM.
     vector<Region> regions;
-    chunk_regions(bed_path, regions, ref_runlength_sequences, chunk_size);
+    IntervalIndex bed_index;
+    chunk_regions(bed_path, bed_index, regions, ref_runlength_sequences, chunk_size);
+
+    // Save partial results periodically, and skip the regions that were completed by a previous run if resuming
+    Checkpoint checkpoint(output_directory, regions, {input_directory, reference_fasta_path},
+                          max_threads, resume, checkpoint_interval);
 
     cerr << "Iterating alignments...\n" << std::flush;
 
@@ -490,6 +526,8 @@ template <typename T> void measure_confusion_stats_from_coverage_data(path input
             read_paths,
             ref_runlength_sequences,
             regions,
+            bed_index,
+            checkpoint,
             max_threads);
 
     cerr << '\n';
@@ -504,6 +542,8 @@ template <typename T> void measure_confusion_stats_from_coverage_data(path input
     summary_output_file_path = absolute(summary_output_file_path);
     stats.write_summary_to_file(summary_output_file_path);
 
+    // The output is complete, so the partial results are no longer needed
+    checkpoint.remove_files();
 }
 
 
@@ -511,11 +551,27 @@ void measure_confusion_stats_from_shasta(path input_directory,
         path reference_fasta_path,
         path output_directory,
         uint16_t max_threads,
-        path bed_path) {
-
-    measure_confusion_stats_from_coverage_data<ShastaReader>(input_directory,
-            reference_fasta_path,
-            output_directory,
-            max_threads,
-            bed_path);
+        path bed_path,
+        bool resume,
+        double checkpoint_interval) {
+
+    // A single file is a directory that was packed by convert_coverage_directory
+    if (is_regular_file(input_directory)){
+        measure_confusion_stats_from_coverage_data<CoverageReader>(input_directory,
+                reference_fasta_path,
+                output_directory,
+                max_threads,
+                bed_path,
+                resume,
+                checkpoint_interval);
+    }
+    else{
+        measure_confusion_stats_from_coverage_data<ShastaReader>(input_directory,
+                reference_fasta_path,
+                output_directory,
+                max_threads,
+                bed_path,
+                resume,
+                checkpoint_interval);
+    }
 }
@@ -1,2 +1,312 @@
-
 #include "CoverageReader.hpp"
+#include "BinaryIO.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <cmath>
+
+using std::memcpy;
+using std::cerr;
+using std::to_string;
+using std::runtime_error;
+
+
+CoverageReader::CoverageReader(path file_path, bool store_length_consensus, bool store_coverage_data) {
+    this->file_path = file_path;
+    this->store_length_consensus = store_length_consensus;
+    this->store_coverage_data = store_coverage_data;
+    this->store_vertex_labels = false;
+
+    // Open the input file
+    this->file_descriptor = ::open(file_path.c_str(), O_RDONLY);
+
+    if (this->file_descriptor == -1) {
+        throw runtime_error("ERROR: could not read " + file_path.string());
+    }
+
+    // Find file size in bytes
+    struct stat file_stats;
+    if (fstat(this->file_descriptor, &file_stats) == -1){
+        ::close(this->file_descriptor);
+        throw runtime_error("ERROR: could not stat " + file_path.string());
+    }
+    this->file_length = file_stats.st_size;
+
+    if (this->file_length < 2*sizeof(uint64_t)){
+        ::close(this->file_descriptor);
+        throw runtime_error("ERROR: file too small to be a coverage file: " + file_path.string());
+    }
+
+    // Map the whole file, pages are only loaded as segments are fetched
+    void* mapped = mmap(nullptr, this->file_length, PROT_READ, MAP_PRIVATE, this->file_descriptor, 0);
+
+    if (mapped == MAP_FAILED){
+        ::close(this->file_descriptor);
+        throw runtime_error("ERROR: could not mmap " + file_path.string() + ": " + string(::strerror(errno)));
+    }
+
+    this->data = static_cast<const char*>(mapped);
+
+    // Initialize remaining parameters using the file footer data
+    this->read_footer();
+
+    // Read table of contents, needed for indexed reading
+    this->read_indexes();
+}
+
+
+CoverageReader::~CoverageReader(){
+    munmap(const_cast<char*>(this->data), this->file_length);
+    ::close(this->file_descriptor);
+}
+
+
+const char* CoverageReader::get_pointer(uint64_t byte_index, uint64_t n_bytes){
+    if (byte_index > this->file_length or n_bytes > this->file_length - byte_index){
+        throw runtime_error("ERROR: attempted to read beyond end of file " + this->file_path.string() +
+                            " at byte " + to_string(byte_index));
+    }
+
+    return this->data + byte_index;
+}
+
+
+template<class T> void CoverageReader::copy_column(vector<T>& v, const char*& p, uint64_t length){
+    ///
+    /// Copy one column of a segment block into a vector and advance the pointer past it. The mapped columns are not
+    /// aligned, so they are never dereferenced as T directly.
+    ///
+    v.resize(length);
+    memcpy(v.data(), p, length*sizeof(T));
+    p += length*sizeof(T);
+}
+
+
+void CoverageReader::read_footer(){
+    const char* p = this->get_pointer(this->file_length - 2*sizeof(uint64_t), 2*sizeof(uint64_t));
+    memcpy(&this->indexes_start_position, p, sizeof(uint64_t));
+    memcpy(&this->channel_metadata_start_position, p + sizeof(uint64_t), sizeof(uint64_t));
+
+    this->read_channel_metadata();
+}
+
+
+void CoverageReader::read_channel_metadata(){
+    ///
+    /// Read the sizes of the observation channels and verify that they are the ones this reader was compiled with
+    ///
+    const char* p = this->get_pointer(this->channel_metadata_start_position, sizeof(uint64_t));
+    memcpy(&this->n_channels, p, sizeof(uint64_t));
+    p += sizeof(uint64_t);
+
+    if (this->n_channels != CoverageWriter::n_channels){
+        throw runtime_error("ERROR: unexpected number of channels (" + to_string(this->n_channels) + ") in file: " +
+                            this->file_path.string());
+    }
+
+    p = this->get_pointer(this->channel_metadata_start_position + sizeof(uint64_t), this->n_channels*sizeof(uint64_t) + 2);
+    this->copy_column(this->channel_sizes, p, this->n_channels);
+
+    if (this->channel_sizes != CoverageWriter::channel_sizes){
+        throw runtime_error("ERROR: unexpected channel sizes in file: " + this->file_path.string());
+    }
+
+    this->contains_length_consensus = bool(p[0]);
+    this->contains_vertex_labels = bool(p[1]);
+}
+
+
+void CoverageReader::read_indexes(){
+    uint64_t byte_index = this->indexes_start_position;
+
+    while (byte_index < this->channel_metadata_start_position){
+        CoverageIndex index;
+
+        const char* p = this->get_pointer(byte_index, 4*sizeof(uint64_t));
+        memcpy(&index.byte_index, p, sizeof(uint64_t));
+        memcpy(&index.n_positions, p + sizeof(uint64_t), sizeof(uint64_t));
+        memcpy(&index.n_observations, p + 2*sizeof(uint64_t), sizeof(uint64_t));
+        memcpy(&index.name_length, p + 3*sizeof(uint64_t), sizeof(uint64_t));
+        byte_index += 4*sizeof(uint64_t);
+
+        p = this->get_pointer(byte_index, index.name_length);
+        index.name.assign(p, index.name_length);
+        byte_index += index.name_length;
+
+        this->indexes.emplace_back(index);
+
+        // Update the mapping of read names to their places in the vector of indexes
+        auto success = this->index_map.emplace(index.name, this->indexes.size() - 1).second;
+        if (not success){
+            throw runtime_error("ERROR: possible duplicate read name (" + index.name + ") found in coverage file: " +
+                                this->file_path.string());
+        }
+    }
+}
+
+
+void CoverageReader::index(){
+    ///
+    /// The table of indexes is always loaded on construction, this only exposes it in the same form as the directory
+    /// readers, where every name maps to the one file
+    ///
+    this->file_paths.clear();
+    for (auto& index: this->indexes){
+        this->file_paths.emplace(index.name, this->file_path);
+    }
+}
+
+
+unordered_map<string,path> CoverageReader::get_index(){
+    return this->file_paths;
+}
+
+
+void CoverageReader::set_index(unordered_map<string, path>& file_paths){
+    this->file_paths = file_paths;
+}
+
+
+size_t CoverageReader::get_read_count(){
+    return this->indexes.size();
+}
+
+
+const string& CoverageReader::get_read_name(uint64_t read_number){
+    return this->indexes.at(read_number).name;
+}
+
+
+bool CoverageReader::has_length_consensus(){
+    return this->contains_length_consensus;
+}
+
+
+bool CoverageReader::has_vertex_labels(){
+    return this->contains_vertex_labels;
+}
+
+
+size_t CoverageReader::find_read_number(string& read_name){
+    auto result = this->index_map.find(read_name);
+
+    if (result == this->index_map.end()){
+        throw runtime_error("ERROR: " + read_name + " not found in index for file " + this->file_path.string());
+    }
+
+    return result->second;
+}
+
+
+void CoverageReader::fetch_read(CoverageSegment& segment, uint64_t read_number){
+    ///
+    /// Copy the columns of one segment block out of the mapped file
+    ///
+    if (this->store_length_consensus and not this->contains_length_consensus){
+        throw runtime_error("ERROR: consensus lengths requested but not stored in file: " + this->file_path.string());
+    }
+    if (this->store_vertex_labels and not this->contains_vertex_labels){
+        throw runtime_error("ERROR: vertex labels requested but not stored in file: " + this->file_path.string());
+    }
+
+    CoverageIndex& index = this->indexes.at(read_number);
+
+    uint64_t n = index.n_positions;
+    uint64_t m = index.n_observations;
+
+    uint64_t block_size = n*sizeof(char)
+            + (this->contains_length_consensus ? n*sizeof(uint16_t) : 0)
+            + (this->contains_vertex_labels ? n*sizeof(uint8_t) : 0)
+            + (n + 1)*sizeof(uint32_t)
+            + m*(sizeof(uint8_t) + sizeof(uint16_t) + sizeof(float));
+
+    const char* p = this->get_pointer(index.byte_index, block_size);
+
+    segment.clear();
+    segment.name = index.name;
+    segment.sequence.assign(p, n);
+    p += n;
+
+    if (this->contains_length_consensus){
+        if (this->store_length_consensus){
+            this->copy_column(segment.lengths, p, n);
+        }
+        else{
+            p += n*sizeof(uint16_t);
+        }
+    }
+
+    if (this->contains_vertex_labels){
+        if (this->store_vertex_labels){
+            segment.is_vertex.resize(n);
+            for (uint64_t i=0; i<n; i++){
+                segment.is_vertex[i] = bool(p[i]);
+            }
+        }
+        p += n*sizeof(uint8_t);
+    }
+
+    // The columns are stored exactly as they are in the CoverageSegment: observations at position i are the range
+    // [offsets[i], offsets[i+1]) of each of the observation columns
+    if (this->store_coverage_data) {
+        this->copy_column(segment.coverage_offsets, p, n + 1);
+        this->copy_column(segment.coverage_bases, p, m);
+        this->copy_column(segment.coverage_lengths, p, m);
+        this->copy_column(segment.coverage_weights, p, m);
+    }
+    else{
+        // Only count the n-fold coverage at each position
+        const char* offsets = p;
+        p += (n + 1)*sizeof(uint32_t) + m*(sizeof(uint8_t) + sizeof(uint16_t));
+        this->copy_column(this->weights, p, m);
+
+        segment.n_coverage.reserve(n);
+
+        uint32_t start;
+        uint32_t stop;
+        memcpy(&start, offsets, sizeof(uint32_t));
+
+        for (uint64_t i=0; i<n; i++){
+            memcpy(&stop, offsets + (i + 1)*sizeof(uint32_t), sizeof(uint32_t));
+
+            float n_coverage = 0;
+            for (uint32_t j=start; j<stop; j++){
+                n_coverage += this->weights[j];
+            }
+            segment.n_coverage.emplace_back(uint16_t(round(n_coverage)));
+
+            start = stop;
+        }
+    }
+}
+
+
+void CoverageReader::fetch_read(CoverageSegment& segment, string& read_name){
+    ///
+    /// Fetch a segment by its name, using the table of indexes stored in the file
+    ///
+    this->fetch_read(segment, this->find_read_number(read_name));
+}
+
+
+void CoverageReader::fetch_consensus_sequence(CoverageSegment& segment, string& read_name){
+    ///
+    /// Fetch only the consensus sequence of a segment, which is the first column of its block
+    ///
+    CoverageIndex& index = this->indexes.at(this->find_read_number(read_name));
+
+    segment.clear();
+    segment.name = read_name;
+    segment.sequence.assign(this->get_pointer(index.byte_index, index.n_positions), index.n_positions);
+}
+
+
+void configure_reader(ShastaReader& reader){
+    reader.store_length_consensus = true;
+    reader.store_vertex_labels = true;
+}
+
+
+void configure_reader(MarginPolishReader& reader){
+    // MarginPolish TSVs have no consensus lengths or vertex labels
+}
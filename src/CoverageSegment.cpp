@@ -1,15 +1,147 @@
-
 #include "CoverageSegment.hpp"
+#include <stdexcept>
+#include <limits>
+
+using std::runtime_error;
+using std::numeric_limits;
+
+
+CoveragePileup::CoveragePileup(){
+    this->segment = nullptr;
+    this->start = 0;
+    this->stop = 0;
+}
+
+
+CoveragePileup::CoveragePileup(const CoverageSegment* segment, uint32_t start, uint32_t stop){
+    this->segment = segment;
+    this->start = start;
+    this->stop = stop;
+}
+
+
+CoverageElement CoveragePileup::operator[](size_t i) const{
+    return this->segment->get_observation(this->start + i);
+}
+
+
+size_t CoveragePileup::size() const{
+    return this->stop - this->start;
+}
+
+
+bool CoveragePileup::empty() const{
+    return this->stop == this->start;
+}
+
+
+CoveragePileup::iterator CoveragePileup::begin() const{
+    return {this->segment, this->start};
+}
+
+
+CoveragePileup::iterator CoveragePileup::end() const{
+    return {this->segment, this->stop};
+}
+
+
+CoverageElement CoveragePileup::iterator::operator*() const{
+    return this->segment->get_observation(this->index);
+}
+
+
+CoveragePileup::iterator& CoveragePileup::iterator::operator++(){
+    this->index++;
+    return *this;
+}
+
+
+bool CoveragePileup::iterator::operator!=(const iterator& other) const{
+    return this->index != other.index;
+}
+
+
+CoverageSegment::CoverageSegment(){
+    this->coverage_offsets = {0};
+}
+
+
+void CoverageSegment::clear(){
+    this->name.clear();
+    this->sequence.clear();
+    this->lengths.clear();
+    this->n_coverage.clear();
+    this->is_vertex.clear();
+    this->coverage_offsets.resize(1);
+    this->coverage_offsets[0] = 0;
+    this->coverage_bases.clear();
+    this->coverage_lengths.clear();
+    this->coverage_weights.clear();
+}
+
+
+uint8_t CoverageSegment::pack_base(char base, bool reversal){
+    return uint8_t(base & ~CoverageSegment::reversal_mask) | (reversal ? CoverageSegment::reversal_mask : 0);
+}
+
+
+char CoverageSegment::unpack_base(uint8_t packed_base){
+    return char(packed_base & ~CoverageSegment::reversal_mask);
+}
+
+
+bool CoverageSegment::unpack_reversal(uint8_t packed_base){
+    return packed_base & CoverageSegment::reversal_mask;
+}
+
+
+void CoverageSegment::add_observation(char base, uint16_t length, bool reversal, float weight){
+    this->coverage_bases.emplace_back(CoverageSegment::pack_base(base, reversal));
+    this->coverage_lengths.emplace_back(length);
+    this->coverage_weights.emplace_back(weight);
+}
+
+
+void CoverageSegment::end_position(){
+    if (this->coverage_bases.size() > numeric_limits<uint32_t>::max()){
+        throw runtime_error("ERROR: too many coverage observations in segment: " + this->name);
+    }
+
+    this->coverage_offsets.emplace_back(uint32_t(this->coverage_bases.size()));
+}
+
+
+size_t CoverageSegment::n_positions() const{
+    return this->coverage_offsets.size() - 1;
+}
+
+
+size_t CoverageSegment::n_observations() const{
+    return this->coverage_bases.size();
+}
+
+
+CoveragePileup CoverageSegment::get_pileup(size_t position) const{
+    return {this, this->coverage_offsets[position], this->coverage_offsets[position+1]};
+}
+
+
+CoverageElement CoverageSegment::get_observation(size_t observation_index) const{
+    uint8_t packed_base = this->coverage_bases[observation_index];
+
+    return {CoverageSegment::unpack_base(packed_base),
+            this->coverage_lengths[observation_index],
+            CoverageSegment::unpack_reversal(packed_base),
+            this->coverage_weights[observation_index]};
+}
 
 
 void CoverageSegment::print(){
-    uint64_t i = 0;
-    for (auto& coverage_pileup: this->coverage_data){
+    for (size_t i=0; i<this->n_positions(); i++){
         cout << to_string(i) << " " << this->sequence[i] << " ";
-        for (auto& coverage_element: coverage_pileup){
+        for (auto coverage_element: this->get_pileup(i)){
             cout << coverage_element.to_string() << " ";
         }
         cout << "\n";
-        i++;
     }
 }
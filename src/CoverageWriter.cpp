@@ -0,0 +1,112 @@
+#include "CoverageWriter.hpp"
+#include "BinaryIO.hpp"
+
+using std::experimental::filesystem::create_directories;
+using std::to_string;
+
+
+const vector<uint64_t> CoverageWriter::channel_sizes = {sizeof(uint8_t), sizeof(uint16_t), sizeof(float)};
+
+
+CoverageWriter::CoverageWriter(path file_path, bool store_length_consensus, bool store_vertex_labels) {
+    this->file_path = file_path;
+    this->store_length_consensus = store_length_consensus;
+    this->store_vertex_labels = store_vertex_labels;
+
+    // Ensure that the output directory exists
+    if (this->file_path.has_parent_path()) {
+        create_directories(this->file_path.parent_path());
+    }
+
+    this->file = ofstream(this->file_path, ofstream::binary);
+
+    if (not this->file.is_open()){
+        throw runtime_error("ERROR: could not open file " + file_path.string());
+    }
+}
+
+
+void CoverageWriter::write_segment(CoverageSegment& segment){
+    ///
+    /// Append the segment's columns to the file as one block
+    ///
+    if (segment.sequence.empty()){
+        throw runtime_error("ERROR: empty sequence provided to CoverageWriter: " + segment.name);
+    }
+    if (segment.n_positions() != segment.sequence.size()){
+        throw runtime_error("ERROR: coverage data does not match sequence length for segment: " + segment.name);
+    }
+    if (this->store_length_consensus and segment.lengths.size() != segment.sequence.size()){
+        throw runtime_error("ERROR: consensus lengths do not match sequence length for segment: " + segment.name);
+    }
+    if (this->store_vertex_labels and segment.is_vertex.size() != segment.sequence.size()){
+        throw runtime_error("ERROR: vertex labels do not match sequence length for segment: " + segment.name);
+    }
+
+    CoverageIndex index;
+    index.byte_index = this->file.tellp();
+    index.n_positions = segment.sequence.size();
+    index.n_observations = segment.n_observations();
+    index.name_length = segment.name.size();
+    index.name = segment.name;
+
+    write_string_to_binary(this->file, segment.sequence);
+
+    if (this->store_length_consensus){
+        write_vector_to_binary(this->file, segment.lengths);
+    }
+    if (this->store_vertex_labels){
+        this->is_vertex.assign(segment.is_vertex.begin(), segment.is_vertex.end());
+        write_vector_to_binary(this->file, this->is_vertex);
+    }
+
+    write_vector_to_binary(this->file, segment.coverage_offsets);
+    write_vector_to_binary(this->file, segment.coverage_bases);
+    write_vector_to_binary(this->file, segment.coverage_lengths);
+    write_vector_to_binary(this->file, segment.coverage_weights);
+
+    this->indexes.emplace_back(index);
+}
+
+
+void CoverageWriter::write_index(CoverageIndex& index){
+    write_value_to_binary(this->file, index.byte_index);
+    write_value_to_binary(this->file, index.n_positions);
+    write_value_to_binary(this->file, index.n_observations);
+    write_value_to_binary(this->file, index.name_length);
+    write_string_to_binary(this->file, index.name);
+}
+
+
+void CoverageWriter::write_indexes(){
+    // Store the current file byte index so the beginning of the INDEX table can be located later
+    uint64_t indexes_start_position = this->file.tellp();
+
+    // Iterate all the indexes, write them to the file
+    for (auto& index: this->indexes){
+        this->write_index(index);
+    }
+
+    // Store the current file byte index so the beginning of the CHANNEL table can be located later
+    uint64_t channel_metadata_start_position = this->file.tellp();
+
+    // Write channel metadata, followed by which of the optional per-position columns are present
+    write_value_to_binary(this->file, CoverageWriter::n_channels);
+    for (auto& size: CoverageWriter::channel_sizes){
+        write_value_to_binary(this->file, size);
+    }
+    write_value_to_binary(this->file, uint8_t(this->store_length_consensus));
+    write_value_to_binary(this->file, uint8_t(this->store_vertex_labels));
+
+    // Write the pointer to the beginning of the index table
+    write_value_to_binary(this->file, indexes_start_position);
+
+    // Write the pointer to the beginning of the channels table
+    write_value_to_binary(this->file, channel_metadata_start_position);
+
+    this->file.flush();
+
+    if (not this->file.good()){
+        throw runtime_error("ERROR: failed while writing file " + this->file_path.string());
+    }
+}
@@ -1,4 +1,5 @@
 #include "FastaReader.hpp"
+#include "Miscellaneous.hpp"
 #include "htslib/faidx.h"
 #include "htslib/hts.h"
 #include <unordered_map>
@@ -9,6 +10,12 @@
 #include <stdexcept>
 #include <exception>
 #include <experimental/filesystem>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "boost/algorithm/string.hpp"
 
 using std::unordered_map;
@@ -24,9 +31,18 @@ using std::ofstream;
 using std::runtime_error;
 using std::experimental::filesystem::path;
 using std::experimental::filesystem::exists;
+using std::experimental::filesystem::file_size;
+using std::exception;
+using std::memchr;
+using std::thread;
+using std::move;
+using std::ref;
+using std::max;
+using std::min;
+using std::make_shared;
+using std::sort;
 using boost::trim_left_if;
 using boost::trim_right;
-using boost::split;
 
 
 void get_vector_from_index_map(vector< pair <string,FastaIndex> >& items, unordered_map<string,FastaIndex>& map_object){
@@ -46,31 +62,13 @@ bool is_tab(char c){
 }
 
 
-bool is_comma(char c){
-    return (c == ',');
-}
-
-
-FastaIndex::FastaIndex(uint64_t byte_index, uint64_t length){
-    this->byte_index = byte_index;
-    this->length = length;
-}
-
-
-uint64_t FastaIndex::size(){
-    return this->length;
-}
-
-
-FastaIndex::FastaIndex() = default;
-
 FastaReader::FastaReader() = default;
 
 FastaReader::FastaReader(path file_path){
     file_path = absolute(file_path);
     this->file_path = file_path;
-    this->index_path = file_path;
-    this->index_path.replace_extension(".fai");
+    this->index_path = file_path.string() + ".fai";
+    this->compact_index_path = file_path.string() + ".fai.bin";
     this->fasta_file = ifstream(file_path);
     this->header_symbol = '>';
     this->eof_placeholder_name = ">EOF<";
@@ -89,27 +87,60 @@ SequenceElement FastaReader::generate_sequence_container(){
 }
 
 void FastaReader::get_indexes_mapped_by_name(unordered_map <string, FastaIndex>& indexes){
-    if (this->sequential_read_offsets.empty()){
+    if (not this->compact_index){
         this->index();
     }
 
     // Construct a direct mapping of the read names to their fasta indexes
-    for (auto& element: this->read_indexes_by_name){
-        indexes.try_emplace(element.first, this->sequential_read_offsets[element.second]);
+    indexes.reserve(indexes.size() + this->compact_index->size());
+    for (size_t i=0; i<this->compact_index->size(); i++){
+        indexes.try_emplace(this->compact_index->get_name(i), this->compact_index->get_index(i));
+    }
+}
+
+
+void FastaReader::get_indexes(vector <pair <string, FastaIndex> >& indexes){
+    if (not this->compact_index){
+        this->index();
+    }
+
+    indexes.reserve(indexes.size() + this->compact_index->size());
+    for (size_t i=0; i<this->compact_index->size(); i++){
+        indexes.emplace_back(this->compact_index->get_name(i), this->compact_index->get_index(i));
+    }
+}
+
+
+void FastaReader::get_indexes_in_file_order(const vector<string>& names, vector <pair <string, FastaIndex> >& indexes){
+    if (not this->compact_index){
+        this->index();
+    }
+
+    indexes.resize(names.size());
+
+    for (size_t i=0; i<names.size(); i++){
+        indexes[i].first = names[i];
+
+        if (not this->compact_index->find(names[i], indexes[i].second)){
+            throw out_of_range("ERROR: sequence '" + names[i] + "' not found in fasta index for file: " + this->file_path.string());
+        }
     }
+
+    sort(indexes.begin(), indexes.end(), [](const pair<string,FastaIndex>& a, const pair<string,FastaIndex>& b){
+        return a.second.byte_index < b.second.byte_index;
+    });
 }
 
 
 void FastaReader::adopt_index(FastaReader& donor){
-    this->sequential_read_offsets = donor.sequential_read_offsets;
-    this->read_indexes_by_name = donor.read_indexes_by_name;
+    this->compact_index = donor.compact_index;
 }
 
 
 void FastaReader::get_sequence(SequenceElement& element, string& sequence_name){
     element = {};
 
-    if (this->sequential_read_offsets.empty()){
+    if (not this->compact_index){
         this->index();
     }
 
@@ -122,14 +153,15 @@ void FastaReader::get_sequence(SequenceElement& element, string& sequence_name){
         this->fasta_file.clear();
     }
 
-    try {
-        // Set ifstream cursor to the start of this read's sequence
-        this->fasta_file.seekg(this->sequential_read_offsets.at(this->read_indexes_by_name.at(sequence_name)).byte_index);
-    }
-    catch(std::out_of_range& e){
+    FastaIndex fasta_index;
+
+    if (not this->compact_index->find(sequence_name, fasta_index)){
         throw out_of_range("ERROR: sequence '" + sequence_name + "' not found in fasta index for file: " + this->file_path.string());
     }
 
+    // Set ifstream cursor to the start of this read's sequence
+    this->fasta_file.seekg(fasta_index.byte_index);
+
     // Fill in the "sequence" field of the sequence element
     this->read_next_sequence(element);
 }
@@ -152,98 +184,244 @@ void FastaReader::get_sequence(SequenceElement& element, string& sequence_name,
 }
 
 
-void FastaReader::index(){
+void FastaReader::index(uint16_t max_threads){
     // If not fai exists build one
-    this->build_fasta_index();
+    this->build_fasta_index(max_threads);
 
     // Read fai and store in this->read_indexes
     this->read_fasta_index();
 }
 
 
-void FastaReader::build_fasta_index(){
-    if (!exists(this->index_path)){
-        cout << "No index found, generating .fai for " << this->file_path << "... ";
+const char* index_fasta_sequence(const char* header, const char* end, FastaIndexRecord& record, const char* data){
+    ///
+    /// Parse the header at `header` and then every sequence line that follows it, up to the next line that starts with
+    /// '>' (or the end of the file). Return a pointer to that next header.
+    ///
+    auto newline = static_cast<const char*>(memchr(header, '\n', end - header));
+    const char* header_stop = (newline == nullptr) ? end : newline;
 
-        ofstream index_file(this->index_path);
-        ifstream file(this->file_path);
+    // The name ends at the first whitespace, as in samtools
+    const char* name_stop = header + 1;
+    while (name_stop < header_stop and not isspace(*name_stop)){
+        name_stop++;
+    }
+
+    record.name.assign(header + 1, name_stop);
+    record.length = 0;
+    record.line_bases = 0;
+    record.line_width = 0;
+
+    const char* p = (newline == nullptr) ? end : newline + 1;
+    record.byte_index = p - data;
 
-        if (not index_file.is_open()){
-            throw runtime_error("ERROR: could not open file " + this->index_path.string());
+    bool first_line = true;
+
+    while (p < end and *p != '>'){
+        newline = static_cast<const char*>(memchr(p, '\n', end - p));
+        const char* line_stop = (newline == nullptr) ? end : newline;
+
+        uint64_t line_width = line_stop - p + 1;
+        if (line_stop > p and line_stop[-1] == '\r'){
+            line_stop--;
         }
-        if (not file.good()){
-            throw runtime_error("ERROR: could not open file " + this->file_path.string());
+        uint64_t line_bases = line_stop - p;
+
+        // Lines are assumed to be wrapped at the width of the first line, as samtools does
+        if (first_line){
+            record.line_bases = line_bases;
+            record.line_width = line_width;
+            first_line = false;
+        }
+
+        record.length += line_bases;
+        p = (newline == nullptr) ? end : newline + 1;
+    }
+
+    return p;
+}
+
+
+void index_fasta_chunks(const char* data,
+                        uint64_t file_length,
+                        vector <pair <uint64_t, uint64_t> >& chunk_bounds,
+                        vector <vector <FastaIndexRecord> >& chunk_records,
+                        atomic<uint64_t>& job_index){
+    ///
+    /// A sequence belongs to the chunk that contains the '>' of its header, and the worker for that chunk follows the
+    /// sequence past the end of the chunk if necessary. Each worker resyncs by skipping to the first line that starts
+    /// at or after its chunk's start.
+    ///
+    const char* end = data + file_length;
+
+    while (job_index < chunk_bounds.size()) {
+        uint64_t thread_job_index = job_index.fetch_add(1);
+
+        if (thread_job_index >= chunk_bounds.size()){
+            break;
+        }
+
+        uint64_t start = chunk_bounds[thread_job_index].first;
+        uint64_t stop = chunk_bounds[thread_job_index].second;
+
+        const char* p = data + start;
+
+        // Unless this chunk begins at a line start, the line it begins in belongs to the previous chunk
+        if (start > 0 and data[start - 1] != '\n'){
+            auto newline = static_cast<const char*>(memchr(p, '\n', end - p));
+            p = (newline == nullptr) ? end : newline + 1;
         }
 
-        string line;
-        string name;
-        uint64_t n_bytes = 0;
-        uint64_t sequence_start_offset = 0;
-        uint64_t n_lines_in_sequence = 0;
-
-        while(getline(file,line)){
-            if (line[0] == this->header_symbol){
-                // Iterate the header until a space character is reached, save the name to the index
-                for(size_t i=1; i<line.size(); i++){
-                    if (line[i] == '\n' or line[i] == ' '){
-                        break;
-                    }
-                    name += line[i];
-                }
-
-                // If at least on sequence has been totally read, calculate the length by subtracting offsets, and
-                // removing newline bytes from the total
-                if (sequence_start_offset > 0){
-                    index_file << n_bytes - sequence_start_offset - n_lines_in_sequence + 1<< '\n';
-                }
-
-                index_file << name << ',' << n_bytes + line.size() + 1 << ',';
-                sequence_start_offset = n_bytes + line.size() + 1;
-
-                n_lines_in_sequence = 0;
-                name.resize(0);
+        while (p < data + stop){
+            if (*p == '>'){
+                FastaIndexRecord record;
+                p = index_fasta_sequence(p, end, record, data);
+                chunk_records[thread_job_index].emplace_back(move(record));
             }
             else{
+                // A sequence line of a header in a previous chunk
+                auto newline = static_cast<const char*>(memchr(p, '\n', end - p));
+                p = (newline == nullptr) ? end : newline + 1;
             }
-
-            n_bytes += line.size() + 1;
-            n_lines_in_sequence++;
         }
-        // Write the last length value and newline
-        index_file << n_bytes - sequence_start_offset - n_lines_in_sequence + 1<< '\n';
-        cout << "done\n";
     }
 }
 
 
-void FastaReader::read_fasta_index(){
-    ifstream index_file = ifstream(this->index_path);
-    vector <string> elements;
-    uint64_t byte_index;
-    uint64_t length;
-    string read_name;
+void FastaReader::write_fasta_index(vector <vector <FastaIndexRecord> >& records){
+    path temporary_path = get_temporary_path(this->index_path);
+    ofstream index_file(temporary_path);
+
+    if (not index_file.is_open()){
+        throw runtime_error("ERROR: could not open file " + temporary_path.string());
+    }
+
     string line;
 
-    // Check if file is readable or exists
-    if (!index_file.good()){
-        throw runtime_error("ERROR: file read error: " + string(this->index_path));
+    for (auto& chunk: records){
+        for (auto& record: chunk){
+            line = record.name;
+            line += '\t';
+            line += to_string(record.length);
+            line += '\t';
+            line += to_string(record.byte_index);
+            line += '\t';
+            line += to_string(record.line_bases);
+            line += '\t';
+            line += to_string(record.line_width);
+            line += '\n';
+
+            index_file << line;
+        }
+    }
+
+    index_file.close();
+
+    if (index_file.fail()){
+        throw runtime_error("ERROR: could not write file " + temporary_path.string());
+    }
+
+    rename_temporary_file(temporary_path, this->index_path);
+}
+
+
+void FastaReader::build_fasta_index(uint16_t max_threads, uint64_t minimum_chunk_size){
+    if (exists(this->index_path)){
+        if (CompactFastaIndex::is_fai_up_to_date(this->compact_index_path, this->index_path, this->file_path)){
+            return;
+        }
+
+        cerr << "Index is out of date, regenerating .fai for " << this->file_path << "... ";
+    }
+    else{
+        cerr << "No index found, generating .fai for " << this->file_path << "... ";
+    }
+
+    if (max_threads < 1){
+        max_threads = 1;
+    }
+
+    int file_descriptor = ::open(this->file_path.c_str(), O_RDONLY);
+
+    if (file_descriptor == -1){
+        throw runtime_error("ERROR: could not open file " + this->file_path.string());
     }
 
-    // Iterate .fai to collect byte start positions of sequences for each fasta element
-    while(getline(index_file, line)){
-        split(elements, line, is_comma);
+    uint64_t file_length = file_size(this->file_path);
+
+    vector <vector <FastaIndexRecord> > chunk_records;
+
+    if (file_length > 0) {
+        void* mapped = mmap(nullptr, file_length, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+
+        if (mapped == MAP_FAILED){
+            ::close(file_descriptor);
+            throw runtime_error("ERROR: could not mmap file " + this->file_path.string());
+        }
+
+        madvise(mapped, file_length, MADV_SEQUENTIAL);
+
+        const char* data = static_cast<const char*>(mapped);
 
-        // Each index element is a pair of sequence name (column 0), byte position (column 2), and sequence length (column 1)
-        length = stoull(elements[2]);
-        byte_index = stoull(elements[1]);
-        read_name = elements[0];
+        // Split the file into byte ranges, several per thread so that large sequences don't leave threads idle
+        uint64_t chunk_size = max(max(uint64_t(1), minimum_chunk_size), file_length/(4*uint64_t(max_threads)) + 1);
 
-        bool no_conflict = this->read_indexes_by_name.insert({read_name, this->sequential_read_offsets.size()}).second;
-        if (not no_conflict){
-            throw runtime_error("ERROR: duplicate reads detected in FASTA: " + read_name);
+        vector <pair <uint64_t, uint64_t> > chunk_bounds;
+        for (uint64_t start=0; start<file_length; start+=chunk_size){
+            chunk_bounds.emplace_back(start, min(start + chunk_size, file_length));
         }
-        this->sequential_read_offsets.emplace_back(byte_index, length);
+
+        chunk_records.resize(chunk_bounds.size());
+
+        vector<thread> threads;
+        atomic<uint64_t> job_index = 0;
+
+        // Launch threads
+        for (uint64_t i=0; i<max_threads; i++){
+            try {
+                threads.emplace_back(thread(index_fasta_chunks,
+                                            data,
+                                            file_length,
+                                            ref(chunk_bounds),
+                                            ref(chunk_records),
+                                            ref(job_index)));
+            } catch (const exception &e) {
+                cerr << e.what() << "\n";
+                exit(1);
+            }
+        }
+
+        // Wait for threads to finish
+        for (auto& t: threads){
+            t.join();
+        }
+
+        munmap(mapped, file_length);
     }
+
+    ::close(file_descriptor);
+
+    // Chunks were indexed in file order, so concatenating them gives the same order as the FASTA
+    this->write_fasta_index(chunk_records);
+
+    cerr << "done\n";
+}
+
+
+void FastaReader::read_fasta_index(){
+    ///
+    /// The .fai is only parsed when the compact index needs to be (re)built from it, otherwise the compact index is
+    /// just mapped into memory
+    ///
+    if (not exists(this->index_path)){
+        throw runtime_error("ERROR: file read error: " + string(this->index_path));
+    }
+
+    if (not CompactFastaIndex::is_up_to_date(this->compact_index_path, this->index_path, this->file_path)){
+        CompactFastaIndex::build(this->index_path, this->file_path, this->compact_index_path);
+    }
+
+    this->compact_index = make_shared<CompactFastaIndex>(this->compact_index_path);
 }
 
 
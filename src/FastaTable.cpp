@@ -0,0 +1,278 @@
+#include "FastaTable.hpp"
+#include "FastaReader.hpp"
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using std::make_unique;
+using std::atomic;
+using std::thread;
+using std::exception;
+using std::out_of_range;
+using std::to_string;
+using std::ref;
+using std::cerr;
+using std::min;
+
+
+class FastaTablePiece {
+public:
+    /// Attributes ///
+    uint64_t sequence_index;
+    uint64_t start;             // Byte range of the FASTA
+    uint64_t stop;
+    uint64_t n_bases;
+    uint64_t arena_offset;
+};
+
+
+bool is_line_break(const char* data, uint64_t file_length, uint64_t i){
+    ///
+    /// Newlines, and carriage returns that end a line, are not part of the sequence (as in index_fasta_sequence)
+    ///
+    return data[i] == '\n' or (data[i] == '\r' and (i + 1 == file_length or data[i + 1] == '\n'));
+}
+
+
+void count_fasta_table_bases(const char* data,
+        uint64_t file_length,
+        vector<FastaTablePiece>& pieces,
+        atomic<uint64_t>& job_index){
+
+    while (job_index < pieces.size()) {
+        uint64_t thread_job_index = job_index.fetch_add(1);
+
+        if (thread_job_index >= pieces.size()){
+            break;
+        }
+
+        auto& piece = pieces[thread_job_index];
+        uint64_t n_breaks = 0;
+
+        const char* p = data + piece.start;
+        const char* stop = data + piece.stop;
+
+        while (p < stop){
+            auto newline = static_cast<const char*>(memchr(p, '\n', stop - p));
+
+            if (newline == nullptr){
+                break;
+            }
+
+            n_breaks++;
+
+            if (newline > data + piece.start and newline[-1] == '\r'){
+                n_breaks++;
+            }
+
+            p = newline + 1;
+        }
+
+        // A carriage return at the end of the piece whose newline begins the next one
+        if (piece.stop > piece.start and data[piece.stop - 1] == '\r' and is_line_break(data, file_length, piece.stop - 1)){
+            n_breaks++;
+        }
+
+        piece.n_bases = (piece.stop - piece.start) - n_breaks;
+    }
+}
+
+
+void copy_fasta_table_bases(const char* data,
+        uint64_t file_length,
+        vector<FastaTablePiece>& pieces,
+        char* arena,
+        atomic<uint64_t>& job_index){
+
+    while (job_index < pieces.size()) {
+        uint64_t thread_job_index = job_index.fetch_add(1);
+
+        if (thread_job_index >= pieces.size()){
+            break;
+        }
+
+        auto& piece = pieces[thread_job_index];
+        char* destination = arena + piece.arena_offset;
+
+        const char* p = data + piece.start;
+        const char* stop = data + piece.stop;
+
+        while (p < stop){
+            auto newline = static_cast<const char*>(memchr(p, '\n', stop - p));
+            const char* line_stop = (newline == nullptr) ? stop : newline;
+
+            if (line_stop > p and line_stop[-1] == '\r' and is_line_break(data, file_length, line_stop - 1 - data)){
+                line_stop--;
+            }
+
+            memcpy(destination, p, line_stop - p);
+            destination += line_stop - p;
+
+            p = (newline == nullptr) ? stop : newline + 1;
+        }
+    }
+}
+
+
+FastaTable::FastaTable(path fasta_path, uint16_t max_threads){
+    this->fasta_path = fasta_path;
+
+    // Build (or validate) the .fai and compact index, then use the compact index for names and byte offsets
+    FastaReader reader(fasta_path);
+    reader.index(max_threads);
+    this->compact_index = make_unique<CompactFastaIndex>(reader.compact_index_path);
+
+    size_t n = this->compact_index->size();
+
+    this->offsets.resize(n + 1);
+    this->offsets[0] = 0;
+    for (size_t i=0; i<n; i++){
+        this->offsets[i + 1] = this->offsets[i] + this->compact_index->get_index(i).length;
+    }
+
+    this->arena = unique_ptr<char[]>(new char[this->offsets[n]]);
+
+    if (n == 0){
+        return;
+    }
+
+    int file_descriptor = ::open(fasta_path.string().c_str(), O_RDONLY);
+    if (file_descriptor < 0){
+        throw runtime_error("ERROR: could not open " + fasta_path.string() + ": " + string(::strerror(errno)));
+    }
+
+    struct stat file_stats;
+    if (::fstat(file_descriptor, &file_stats) != 0){
+        ::close(file_descriptor);
+        throw runtime_error("ERROR: could not stat " + fasta_path.string() + ": " + string(::strerror(errno)));
+    }
+
+    uint64_t file_length = file_stats.st_size;
+
+    void* mapped = mmap(nullptr, file_length, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+    ::close(file_descriptor);
+
+    if (mapped == MAP_FAILED){
+        throw runtime_error("ERROR: could not mmap " + fasta_path.string() + ": " + string(::strerror(errno)));
+    }
+
+    madvise(mapped, file_length, MADV_SEQUENTIAL);
+    const char* data = static_cast<const char*>(mapped);
+
+    // Split the sequence lines of each record into pieces. A record ends where the header of the next one begins.
+    vector<FastaTablePiece> pieces;
+
+    for (size_t i=0; i<n; i++){
+        uint64_t start = this->compact_index->get_index(i).byte_index;
+        uint64_t stop = file_length;
+
+        if (i + 1 < n){
+            uint64_t next_start = this->compact_index->get_index(i + 1).byte_index;
+            auto header_newline = static_cast<const char*>(memrchr(data + start, '\n', next_start - 1 - start));
+            stop = (header_newline == nullptr) ? start : header_newline + 1 - data;
+        }
+
+        if (stop > file_length or start > stop){
+            munmap(mapped, file_length);
+            throw runtime_error("ERROR: FASTA index does not match file: " + fasta_path.string());
+        }
+
+        for (uint64_t piece_start=start; piece_start<stop; piece_start+=this->piece_size){
+            pieces.push_back({i, piece_start, min(piece_start + this->piece_size, stop), 0, 0});
+        }
+    }
+
+    vector<thread> threads;
+    atomic<uint64_t> job_index = 0;
+
+    try {
+        for (uint64_t i=0; i<max_threads; i++){
+            threads.emplace_back(thread(count_fasta_table_bases, data, file_length, ref(pieces), ref(job_index)));
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        exit(1);
+    }
+
+    for (auto& t: threads){
+        t.join();
+    }
+
+    // Place each piece after the previous pieces of its sequence, and check that the sequences add up to the index
+    vector<uint64_t> n_bases_per_sequence(n, 0);
+
+    for (auto& piece: pieces){
+        piece.arena_offset = this->offsets[piece.sequence_index] + n_bases_per_sequence[piece.sequence_index];
+        n_bases_per_sequence[piece.sequence_index] += piece.n_bases;
+    }
+
+    for (size_t i=0; i<n; i++){
+        if (n_bases_per_sequence[i] != this->get_length(i)){
+            munmap(mapped, file_length);
+            throw runtime_error("ERROR: length of sequence '" + this->get_name(i) + "' (" +
+                                to_string(n_bases_per_sequence[i]) + ") does not match FASTA index (" +
+                                to_string(this->get_length(i)) + "): " + fasta_path.string());
+        }
+    }
+
+    threads.clear();
+    job_index = 0;
+
+    try {
+        for (uint64_t i=0; i<max_threads; i++){
+            threads.emplace_back(thread(copy_fasta_table_bases, data, file_length, ref(pieces), this->arena.get(), ref(job_index)));
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        exit(1);
+    }
+
+    for (auto& t: threads){
+        t.join();
+    }
+
+    munmap(mapped, file_length);
+}
+
+
+size_t FastaTable::size() const{
+    return this->offsets.size() - 1;
+}
+
+
+string FastaTable::get_name(size_t i) const{
+    return this->compact_index->get_name(i);
+}
+
+
+uint64_t FastaTable::get_length(size_t i) const{
+    return this->offsets.at(i + 1) - this->offsets.at(i);
+}
+
+
+string_view FastaTable::get_sequence(size_t i) const{
+    return string_view(this->arena.get() + this->offsets.at(i), this->get_length(i));
+}
+
+
+int64_t FastaTable::find(const string& name) const{
+    return this->compact_index->find(name);
+}
+
+
+string_view FastaTable::get_sequence(const string& name) const{
+    int64_t i = this->find(name);
+
+    if (i < 0){
+        throw out_of_range("ERROR: sequence '" + name + "' not found in fasta file: " + this->fasta_path.string());
+    }
+
+    return this->get_sequence(i);
+}
@@ -1,7 +1,142 @@
-
 #include "FastqReader.hpp"
+#include <stdexcept>
+#include <cstring>
+#include <thread>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 using std::to_string;
+using std::runtime_error;
+using std::exception;
+using std::exception_ptr;
+using std::current_exception;
+using std::rethrow_exception;
+using std::memchr;
+using std::thread;
+using std::cerr;
+using std::swap;
+using std::ref;
+
+
+void FastqChunk::clear(){
+    this->input.clear();
+    this->output.clear();
+    this->n_reads = 0;
+    this->n_passed = 0;
+}
+
+
+uint64_t sum_quality_chars(const char* qualities, size_t length){
+    ///
+    /// Sum every byte of the quality string. With SSE2, 16 bytes at a time are summed horizontally by _mm_sad_epu8
+    /// (sum of absolute differences from zero) into two 64 bit lanes.
+    ///
+    uint64_t sum = 0;
+    size_t i = 0;
+
+#ifdef __SSE2__
+    __m128i zero = _mm_setzero_si128();
+    __m128i total = _mm_setzero_si128();
+
+    for (; i + 16 <= length; i += 16){
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(qualities + i));
+        total = _mm_add_epi64(total, _mm_sad_epu8(block, zero));
+    }
+
+    sum += uint64_t(_mm_cvtsi128_si64(total)) + uint64_t(_mm_cvtsi128_si64(_mm_unpackhi_epi64(total, total)));
+#endif
+
+    for (; i < length; i++){
+        sum += uint8_t(qualities[i]);
+    }
+
+    return sum;
+}
+
+
+const char* next_fastq_line(const char* start, const char* end, const char*& line_stop){
+    ///
+    /// Find the end of the line beginning at `start`, and return the start of the following line
+    ///
+    auto newline = static_cast<const char*>(memchr(start, '\n', end - start));
+
+    if (newline == nullptr){
+        line_stop = end;
+        return end;
+    }
+
+    line_stop = newline;
+    return newline + 1;
+}
+
+
+void filter_fastq_chunk(FastqChunk& chunk, uint64_t minimum_average_quality){
+    ///
+    /// Iterate the 4 line records of a chunk and append those with mean quality >= minimum to the chunk's output.
+    /// Quality is compared as an integer sum, i.e. sum(q - 33) >= minimum*n
+    ///
+    const char* p = chunk.input.data();
+    const char* end = p + chunk.input.size();
+
+    const char* name_start;
+    const char* name_stop;
+    const char* sequence_start;
+    const char* sequence_stop;
+    const char* quality_start;
+    const char* quality_stop;
+    const char* plus_stop;
+
+    while (p < end){
+        name_start = p;
+        p = next_fastq_line(p, end, name_stop);
+        sequence_start = p;
+        p = next_fastq_line(p, end, sequence_stop);
+        p = next_fastq_line(p, end, plus_stop);
+        quality_start = p;
+        p = next_fastq_line(p, end, quality_stop);
+
+        chunk.n_reads++;
+
+        uint64_t n_qualities = quality_stop - quality_start;
+
+        // Records with no sequence or qualities are never written
+        if (sequence_stop == sequence_start or n_qualities == 0){
+            continue;
+        }
+
+        uint64_t sum = sum_quality_chars(quality_start, n_qualities);
+
+        if (sum >= (33 + minimum_average_quality)*n_qualities){
+            // The header character is always written as '@', and the separator line is written as only '+'
+            chunk.output += '@';
+            if (name_stop > name_start) {
+                chunk.output.append(name_start + 1, name_stop);
+            }
+            chunk.output += '\n';
+            chunk.output.append(sequence_start, sequence_stop);
+            chunk.output += "\n+\n";
+            chunk.output.append(quality_start, quality_stop);
+            chunk.output += '\n';
+
+            chunk.n_passed++;
+        }
+    }
+}
+
+
+void filter_fastq_chunks(vector<FastqChunk>& chunks, uint64_t minimum_average_quality, atomic<uint64_t>& job_index){
+    while (job_index < chunks.size()) {
+        uint64_t thread_job_index = job_index.fetch_add(1);
+
+        if (thread_job_index >= chunks.size()){
+            break;
+        }
+
+        filter_fastq_chunk(chunks[thread_job_index], minimum_average_quality);
+    }
+}
 
 
 FastqReader::FastqReader(path file_path){
@@ -15,103 +150,210 @@ FastqReader::FastqReader(path file_path){
 }
 
 
-void FastqReader::parse_filter_candidate(
-        string& name,
-        string& sequence,
-        string& qualities,
-        IterativeSummaryStats<uint64_t>& stats,
-        uint64_t minimum_average_quality,
-        ofstream& output_file){
+path FastqReader::get_filtered_path(uint64_t minimum_average_quality){
+    path input_path = this->file_path;
+    string extension = ".fastq";
+
+    if (input_path.extension() == ".gz"){
+        input_path = input_path.stem();
+        extension += ".gz";
+    }
+
+    string output_filename = input_path.stem().string();
+    output_filename = output_filename + "_filtered_" + to_string(int(minimum_average_quality)) + extension;
+
+    return this->file_path.parent_path() / output_filename;
+}
+
+
+bool FastqReader::read_chunk(BGZF* input_file, FastqChunk& chunk, string& remainder){
+    ///
+    /// Fill a chunk with at least `chunk_size` bytes (or whatever is left in the file) and cut it after the last
+    /// complete 4 line record. The bytes after the cut are stored in `remainder`, to begin the next chunk.
+    ///
+    chunk.clear();
+    swap(chunk.input, remainder);
 
-    if (stats.get_mean() >= double(minimum_average_quality)){
-        output_file << '@' << name << '\n';
-        output_file << sequence << '\n';
-        output_file << '+' << '\n';
-        output_file << qualities << '\n';
+    string& input = chunk.input;
+    size_t boundary = 0;
+    size_t scanned = 0;
+    uint64_t n_lines = 0;
+    bool eof = false;
+
+    while (true){
+        // Count lines in whatever has been read since the last scan, remembering where the last record ended
+        const char* start = input.data();
+        const char* end = start + input.size();
+        const char* p = start + scanned;
+
+        while (p < end){
+            auto newline = static_cast<const char*>(memchr(p, '\n', end - p));
+            if (newline == nullptr){
+                break;
+            }
+
+            n_lines++;
+            p = newline + 1;
+
+            if (n_lines % 4 == 0){
+                boundary = p - start;
+            }
+        }
+        scanned = input.size();
+
+        if (boundary > 0 and input.size() >= FastqReader::chunk_size){
+            break;
+        }
+
+        size_t previous_size = input.size();
+        input.resize(previous_size + FastqReader::chunk_size);
+
+        ssize_t n_bytes = bgzf_read(input_file, &input[previous_size], FastqReader::chunk_size);
+
+        if (n_bytes < 0){
+            throw runtime_error("ERROR: failed to read file: " + this->file_path.string());
+        }
+
+        input.resize(previous_size + n_bytes);
+
+        if (n_bytes == 0){
+            eof = true;
+            break;
+        }
     }
 
-    // Reset the temporary containers
-    name.clear();
-    sequence.clear();
-    qualities.clear();
-    stats.clear();
+    // At the end of the file, whatever remains is the final chunk
+    if (eof){
+        boundary = input.size();
+    }
+
+    remainder.assign(input, boundary, string::npos);
+    input.resize(boundary);
+
+    return not input.empty();
 }
 
 
-void FastqReader::filter_by_quality(uint64_t minimum_average_quality) {
-    string output_filename = this->file_path.stem().string();
-    output_filename = output_filename + "_filtered_" + to_string(int(minimum_average_quality)) + ".fastq";
+void FastqReader::filter_by_quality(uint64_t minimum_average_quality, uint16_t max_threads){
+    this->filter_by_quality(minimum_average_quality, this->get_filtered_path(minimum_average_quality), max_threads);
+}
 
-    path parent_directory = this->file_path.parent_path();
-    path output_path = parent_directory / output_filename;
 
-    ifstream input_file(this->file_path);
-    ofstream output_file(output_path);
+void FastqReader::filter_by_quality(uint64_t minimum_average_quality, path output_path, uint16_t max_threads){
+    ///
+    /// Read batches of `max_threads` chunks, and filter each batch on all threads while the next batch is being read.
+    /// Batches are written in order, so the output has the same order as the input. Decompression of BGZF input and
+    /// compression of BGZF output are done by htslib's thread pool.
+    ///
+    if (max_threads < 1){
+        max_threads = 1;
+    }
+
+    BGZF* input_file = bgzf_open(this->file_path.string().c_str(), "r");
+
+    if (input_file == nullptr){
+        throw runtime_error("ERROR: file read error: " + this->file_path.string());
+    }
+
+    bool compress_output = (output_path.extension() == ".gz");
+    BGZF* output_file = bgzf_open(output_path.string().c_str(), compress_output ? "w" : "wu");
 
-    if (not output_file.is_open()){
+    if (output_file == nullptr){
+        bgzf_close(input_file);
         throw runtime_error("ERROR: file can't be written: " + output_path.string());
     }
 
-    string name;
-    string sequence;
-    string qualities;
-    IterativeSummaryStats<uint64_t> stats;
-
-    uint64_t line_index = 0;
-    bool first_char = true;
-    char c;
-
-    // Read each char
-    while (input_file.get(c)) {
-        // When newline found, increment line number
-        if (c == '\n'){
-            line_index++;
-            first_char = true;
+    // Both files are closed if anything fails
+    try {
+        // Has no effect on uncompressed or plain gzip files
+        if (max_threads > 1){
+            bgzf_mt(input_file, max_threads, 256);
+            bgzf_mt(output_file, max_threads, 256);
         }
 
-        // Header, name
-        else if ((line_index % 4) == 0){
-            // Skip the header character
-            if (first_char){
-                if (not sequence.empty()) {
-                    this->parse_filter_candidate(
-                            name,
-                            sequence,
-                            qualities,
-                            stats,
-                            minimum_average_quality,
-                            output_file);
+        vector<FastqChunk> chunks(max_threads);
+        vector<FastqChunk> next_chunks(max_threads);
+        string remainder;
+
+        uint64_t n_reads = 0;
+        uint64_t n_passed = 0;
+
+        // Read the first batch
+        size_t n_chunks = 0;
+        while (n_chunks < chunks.size() and this->read_chunk(input_file, chunks[n_chunks], remainder)){
+            n_chunks++;
+        }
+
+        while (n_chunks > 0){
+            chunks.resize(n_chunks);
+
+            vector<thread> threads;
+            atomic<uint64_t> job_index = 0;
+
+            // Launch threads
+            for (uint64_t i=0; i<max_threads; i++){
+                try {
+                    threads.emplace_back(thread(filter_fastq_chunks,
+                                                ref(chunks),
+                                                minimum_average_quality,
+                                                ref(job_index)));
+                } catch (const exception &e) {
+                    cerr << e.what() << "\n";
+                    exit(1);
                 }
+            }
 
-                first_char = false;
-                continue;
+            // Read the next batch while this one is being filtered. A read error is only rethrown once the threads are
+            // joined, because destroying a joinable thread terminates the program.
+            size_t n_next_chunks = 0;
+            exception_ptr read_error;
+
+            try {
+                next_chunks.resize(max_threads);
+                while (n_next_chunks < next_chunks.size() and
+                       this->read_chunk(input_file, next_chunks[n_next_chunks], remainder)){
+                    n_next_chunks++;
+                }
+            }
+            catch (...){
+                read_error = current_exception();
             }
 
-            // Update the name
-            name += c;
-        }
-        else if ((line_index % 4) == 1){
-            // Update the sequence
-            sequence += c;
-        }
-        else if ((line_index % 4) == 2){
-            // Skip useless garbage (why does this line exist?)
-            continue;
-        }
-        else if ((line_index % 4) == 3){
-            // Update the qualities
-            qualities += c;
-            stats.add((uint64_t(c)-33));
+            // Wait for threads to finish
+            for (auto& t: threads){
+                t.join();
+            }
+
+            if (read_error){
+                rethrow_exception(read_error);
+            }
+
+            // Write the batch in order
+            for (auto& chunk: chunks){
+                if (bgzf_write(output_file, chunk.output.data(), chunk.output.size()) < 0){
+                    throw runtime_error("ERROR: failed to write file: " + output_path.string());
+                }
+
+                n_reads += chunk.n_reads;
+                n_passed += chunk.n_passed;
+            }
+
+            swap(chunks, next_chunks);
+            n_chunks = n_next_chunks;
+
+            cerr << "\33[2K\rReads parsed: " << n_reads << " passed: " << n_passed << std::flush;
         }
+        cerr << '\n';
+    }
+    catch (...){
+        bgzf_close(input_file);
+        bgzf_close(output_file);
+        throw;
     }
 
-    if (not sequence.empty()){
-        this->parse_filter_candidate(
-                name,
-                sequence,
-                qualities,
-                stats,
-                minimum_average_quality,
-                output_file);
+    bgzf_close(input_file);
+
+    if (bgzf_close(output_file) < 0){
+        throw runtime_error("ERROR: failed to write file: " + output_path.string());
     }
 }
@@ -0,0 +1,405 @@
+
+#include "FlatQuadTree.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+#include <fstream>
+#include <limits>
+
+using std::ofstream;
+using std::runtime_error;
+using std::cerr;
+using std::to_string;
+using std::sort;
+using std::stable_partition;
+using std::partition_point;
+using std::numeric_limits;
+using std::experimental::filesystem::create_directories;
+
+
+QuadNode::QuadNode()=default;
+
+
+QuadNode::QuadNode(BoundingBox boundary, uint32_t point_start, uint32_t n_points){
+    this->boundary = boundary;
+    this->first_child = FlatQuadTree::NO_CHILD;
+    this->point_start = point_start;
+    this->n_points = n_points;
+}
+
+
+bool QuadNode::is_leaf(){
+    return this->first_child == FlatQuadTree::NO_CHILD;
+}
+
+
+FlatQuadTree::FlatQuadTree():
+    FlatQuadTree(BoundingBox(QuadCoordinate(0,0), 0))
+{}
+
+
+FlatQuadTree::FlatQuadTree(BoundingBox boundary, size_t capacity){
+    this->boundary = boundary;
+    this->capacity = capacity;
+    this->nodes.emplace_back(boundary, 0, 0);
+    this->is_built = true;
+}
+
+
+size_t FlatQuadTree::size(){
+    return this->points.size();
+}
+
+
+void FlatQuadTree::reserve(size_t n_points){
+    this->points.reserve(n_points);
+}
+
+
+bool FlatQuadTree::insert(QuadCoordinate c){
+    ///
+    /// Points are only staged here, the tree structure is (re)built lazily the next time it is queried
+    ///
+    if (not this->boundary.contains(c)){
+        return false;
+    }
+
+    if (this->points.size() == numeric_limits<uint32_t>::max()){
+        throw runtime_error("ERROR: FlatQuadTree cannot contain more than 2^32-1 points");
+    }
+
+    this->points.push_back(c);
+    this->is_built = false;
+
+    return true;
+}
+
+
+uint64_t FlatQuadTree::get_morton_code(QuadCoordinate c){
+    const uint64_t n_cells = uint64_t(1) << FlatQuadTree::max_depth;
+
+    double x_min = double(this->boundary.center.x) - this->boundary.half_size;
+    double y_min = double(this->boundary.center.y) - this->boundary.half_size;
+    double size = 2*double(this->boundary.half_size);
+
+    uint64_t x = std::min(uint64_t((double(c.x) - x_min)/size*n_cells), n_cells - 1);
+    uint64_t y = std::min(uint64_t((double(c.y) - y_min)/size*n_cells), n_cells - 1);
+
+    // Interleave the bits so that y occupies the odd positions and x the even positions
+    uint64_t code = 0;
+    for (uint8_t i=0; i<FlatQuadTree::max_depth; i++){
+        code |= ((x >> i) & 1) << (2*i);
+        code |= ((y >> i) & 1) << (2*i + 1);
+    }
+
+    return code;
+}
+
+
+void FlatQuadTree::add_children(uint32_t node_index){
+    if (this->nodes.size() + 4 > numeric_limits<uint32_t>::max()){
+        throw runtime_error("ERROR: FlatQuadTree cannot contain more than 2^32-1 nodes");
+    }
+
+    BoundingBox parent_boundary = this->nodes[node_index].boundary;
+    uint32_t point_start = this->nodes[node_index].point_start;
+
+    // Find new half size
+    float new_half_size = parent_boundary.half_size/2;
+
+    // Find boundaries
+    float x_left = parent_boundary.center.x - new_half_size;
+    float x_right = parent_boundary.center.x + new_half_size;
+    float y_bottom = parent_boundary.center.y - new_half_size;
+    float y_top = parent_boundary.center.y + new_half_size;
+
+    this->nodes[node_index].first_child = this->nodes.size();
+
+    // Children are added in index macro order (TOP_LEFT, TOP_RIGHT, BOTTOM_LEFT, BOTTOM_RIGHT), with empty ranges
+    this->nodes.emplace_back(BoundingBox(QuadCoordinate(x_left, y_top), new_half_size), point_start, 0);
+    this->nodes.emplace_back(BoundingBox(QuadCoordinate(x_right, y_top), new_half_size), point_start, 0);
+    this->nodes.emplace_back(BoundingBox(QuadCoordinate(x_left, y_bottom), new_half_size), point_start, 0);
+    this->nodes.emplace_back(BoundingBox(QuadCoordinate(x_right, y_bottom), new_half_size), point_start, 0);
+}
+
+
+uint8_t FlatQuadTree::find_quadrant(uint32_t node_index, QuadCoordinate c){
+    BoundingBox& b = this->nodes[node_index].boundary;
+
+    if (not b.contains(c)){
+        return FlatQuadTree::NOT_FOUND;
+    }
+
+    if (c.y >= b.center.y){
+        return (c.x >= b.center.x) ? FlatQuadTree::TOP_RIGHT : FlatQuadTree::TOP_LEFT;
+    }
+    else{
+        return (c.x >= b.center.x) ? FlatQuadTree::BOTTOM_RIGHT : FlatQuadTree::BOTTOM_LEFT;
+    }
+}
+
+
+void FlatQuadTree::subdivide(uint32_t node_index){
+    ///
+    /// Split a leaf into 4 children, partitioning its range of points among them (stable, so Morton order is kept)
+    ///
+    if (not this->is_built){
+        this->build();
+    }
+
+    if (not this->nodes[node_index].is_leaf()){
+        throw runtime_error("ERROR: cannot subdivide FlatQuadTree node that already has children");
+    }
+
+    this->add_children(node_index);
+
+    QuadNode node = this->nodes[node_index];
+    auto begin = this->points.begin() + node.point_start;
+    auto end = begin + node.n_points;
+
+    for (uint8_t q=0; q<4; q++){
+        auto child_end = stable_partition(begin, end, [&](QuadCoordinate& c){
+            return this->find_quadrant(node_index, c) == q;
+        });
+
+        QuadNode& child = this->nodes[node.first_child + q];
+        child.point_start = begin - this->points.begin();
+        child.n_points = child_end - begin;
+
+        begin = child_end;
+    }
+}
+
+
+void FlatQuadTree::build_node(uint32_t node_index, uint8_t level, vector <pair <uint64_t, QuadCoordinate> >& sorted_points){
+    if (this->nodes[node_index].n_points <= this->capacity or level == FlatQuadTree::max_depth){
+        return;
+    }
+
+    this->add_children(node_index);
+
+    uint32_t first_child = this->nodes[node_index].first_child;
+    uint32_t start = this->nodes[node_index].point_start;
+    uint32_t stop = start + this->nodes[node_index].n_points;
+    uint8_t shift = 2*(FlatQuadTree::max_depth - level - 1);
+
+    // Within this node's range the codes are sorted, so the 2 bits for this level split it into 4 consecutive runs.
+    // Morton order is (BOTTOM_LEFT, BOTTOM_RIGHT, TOP_LEFT, TOP_RIGHT), which maps to the index macros by XOR with 2.
+    auto begin = sorted_points.begin() + start;
+    auto end = sorted_points.begin() + stop;
+
+    for (uint64_t m=0; m<4; m++){
+        auto child_end = partition_point(begin, end, [&](const pair<uint64_t, QuadCoordinate>& p){
+            return ((p.first >> shift) & 3) <= m;
+        });
+
+        QuadNode& child = this->nodes[first_child + (m ^ 2)];
+        child.point_start = begin - sorted_points.begin();
+        child.n_points = child_end - begin;
+
+        begin = child_end;
+    }
+
+    for (uint8_t q=0; q<4; q++){
+        this->build_node(first_child + q, level + 1, sorted_points);
+    }
+}
+
+
+void FlatQuadTree::build(){
+    ///
+    /// Morton sort all the points and then split nodes top-down until each leaf is at or below capacity
+    ///
+    vector <pair <uint64_t, QuadCoordinate> > sorted_points;
+    sorted_points.reserve(this->points.size());
+
+    for (auto& c: this->points){
+        sorted_points.emplace_back(this->get_morton_code(c), c);
+    }
+
+    sort(sorted_points.begin(), sorted_points.end(), [](const pair<uint64_t, QuadCoordinate>& a, const pair<uint64_t, QuadCoordinate>& b){
+        return a.first < b.first;
+    });
+
+    for (size_t i=0; i<sorted_points.size(); i++){
+        this->points[i] = sorted_points[i].second;
+    }
+
+    this->nodes.clear();
+    this->nodes.emplace_back(this->boundary, 0, this->points.size());
+    this->build_node(0, 0, sorted_points);
+
+    this->nodes.shrink_to_fit();
+    this->is_built = true;
+}
+
+
+void FlatQuadTree::query_node(uint32_t node_index, vector<QuadCoordinate>& results, BoundingBox& bounds){
+    QuadNode& node = this->nodes[node_index];
+
+    if (node.n_points == 0 or not bounds.intersects(node.boundary)){
+        return;
+    }
+
+    // If this node is entirely inside the query, all of its points are too
+    if (bounds.encloses(node.boundary)){
+        results.insert(results.end(), this->points.begin() + node.point_start, this->points.begin() + node.point_start + node.n_points);
+        return;
+    }
+
+    if (node.is_leaf()){
+        for (uint32_t i=node.point_start; i<node.point_start + node.n_points; i++){
+            if (bounds.contains(this->points[i])){
+                results.push_back(this->points[i]);
+            }
+        }
+    }
+    else{
+        for (uint32_t q=0; q<4; q++){
+            this->query_node(node.first_child + q, results, bounds);
+        }
+    }
+}
+
+
+void FlatQuadTree::query_range(vector<QuadCoordinate>& results, BoundingBox& bounds){
+    if (not this->is_built){
+        this->build();
+    }
+
+    this->query_node(0, results, bounds);
+}
+
+
+void FlatQuadTree::update_loss_from_node(uint32_t node_index, BoundingBox& bounds, QuadLoss& loss_calculator){
+    QuadNode& node = this->nodes[node_index];
+
+    if (node.n_points == 0 or not bounds.intersects(node.boundary)){
+        return;
+    }
+
+    bool enclosed = bounds.encloses(node.boundary);
+
+    if (enclosed or node.is_leaf()){
+        for (uint32_t i=node.point_start; i<node.point_start + node.n_points; i++){
+            if (enclosed or bounds.contains(this->points[i])){
+                loss_calculator.update(this->points[i]);
+            }
+        }
+    }
+    else{
+        for (uint32_t q=0; q<4; q++){
+            this->update_loss_from_node(node.first_child + q, bounds, loss_calculator);
+        }
+    }
+}
+
+
+void FlatQuadTree::update_loss_from_range(BoundingBox& bounds, QuadLoss& loss_calculator){
+    if (not this->is_built){
+        this->build();
+    }
+
+    this->update_loss_from_node(0, bounds, loss_calculator);
+}
+
+
+void FlatQuadTree::append_dot_string(string& edges, string& labels, uint64_t& n, uint32_t node_index){
+    string name;
+    string label;
+    uint64_t n_parent = n;
+
+    if (this->nodes[node_index].is_leaf()){
+        return;
+    }
+
+    for (uint32_t q=0; q<4; q++){
+        uint32_t child_index = this->nodes[node_index].first_child + q;
+        QuadNode& child = this->nodes[child_index];
+
+        n += 1;
+        name = to_string(n);
+
+        edges += "\n\t" + to_string(n_parent) + "->" + name + ";";
+
+        // Only leaves hold points
+        if (child.is_leaf() and child.n_points > 0){
+            label = to_string(child.n_points);
+            labels += "\t" + name + "[label=\"" + label + "\"];\n";
+        }
+        else{
+            labels += "\t" + name + "[label=\"\"];\n";
+        }
+
+        this->append_dot_string(edges, labels, n, child_index);
+    }
+}
+
+
+void FlatQuadTree::write_as_dot(path output_dir, string suffix, bool plot){
+    if (not this->is_built){
+        this->build();
+    }
+
+    output_dir = absolute(output_dir);
+    path output_path = output_dir / ("quad_tree_" + suffix + ".dot");
+    create_directories(output_dir);
+    ofstream file = ofstream(output_path);
+
+    string dot_string = "digraph G {\n";
+    string edges;
+    string labels;
+
+    uint64_t n = 0;
+
+    this->append_dot_string(edges, labels, n);
+
+    dot_string += labels;
+    dot_string += edges;
+    dot_string += "\n}\n";
+
+    file << dot_string;
+
+    if (plot){
+        path plot_path = output_dir / ("quad_tree_" + suffix + ".pdf");
+        string command = "dot -Tps " + output_path.string() + " -o " + plot_path.string();
+        cerr << "plotting with graphviz: " + command + "\n";
+
+        int exit_code = system(command.c_str());
+
+        if (exit_code != 0){
+            throw runtime_error("ERROR: command failed to run: " + command);
+        }
+    }
+}
+
+
+void FlatQuadTree::append_bounds_string(string& bounds, uint32_t node_index){
+    QuadNode& node = this->nodes[node_index];
+
+    if (node.is_leaf()) {
+        bounds += to_string(node.boundary.center.x) + "," + to_string(node.boundary.center.y) + "\t" +
+                  to_string(node.boundary.half_size) + "\n";
+        return;
+    }
+
+    for (uint32_t q=0; q<4; q++){
+        this->append_bounds_string(bounds, this->nodes[node_index].first_child + q);
+    }
+}
+
+
+void FlatQuadTree::write_bounds(path output_dir, string suffix){
+    if (not this->is_built){
+        this->build();
+    }
+
+    output_dir = absolute(output_dir);
+    create_directories(output_dir);
+    ofstream file = ofstream(output_dir / ("quad_tree_bounds_" + suffix + ".txt"));
+    string bounds;
+
+    this->append_bounds_string(bounds);
+
+    file << bounds;
+}
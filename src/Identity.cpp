@@ -2,6 +2,7 @@
 #include "AlignedSegment.hpp"
 #include "FastaReader.hpp"
 #include "Align.hpp"
+#include "Checkpoint.hpp"
 #include <vector>
 #include <thread>
 #include <string>
@@ -32,100 +33,19 @@ using std::experimental::filesystem::path;
 using std::experimental::filesystem::absolute;
 
 
-void chunk_sequences_into_regions(vector<Region>& regions, unordered_map<string,SequenceElement>& sequences, uint64_t chunk_size){
+void chunk_sequences_into_regions(vector<Region>& regions, CompactFastaIndex& index, uint64_t chunk_size){
     ///
-    /// Take all the sequences in some iterable object and chunk their lengths
+    /// Take the lengths of all the sequences in a FASTA's index and chunk them, without loading any sequence
     ///
 
     // For every sequence
-    for (auto& [name, item]: sequences){
-        chunk_sequence(regions, name, chunk_size, item.sequence.size());
+    for (size_t i=0; i<index.size(); i++){
+        chunk_sequence(regions, index.get_name(i), chunk_size, index.get_index(i).size());
     }
 }
 
 
-void load_fasta_sequences_from_file(path& fasta_path,
-        vector <pair <string, FastaIndex> >& read_index_vector,
-        unordered_map<string, SequenceElement>& sequences,
-        mutex& map_mutex,
-        atomic<uint64_t>& job_index){
-
-    while (job_index < read_index_vector.size()) {
-        // Fetch add
-        uint64_t thread_job_index = job_index.fetch_add(1);
-
-        // Initialize containers
-        SequenceElement sequence;
-
-        // Fetch Fasta sequence
-        FastaReader fasta_reader = FastaReader(fasta_path);
-
-        // Get read name and index
-        string read_name = read_index_vector[thread_job_index].first;
-        uint64_t read_index = read_index_vector[thread_job_index].second.byte_index;
-
-        // First of each element is read_name, second is its index
-        fasta_reader.get_sequence(sequence, read_name, read_index);
-
-        // Append the sequence to a map of names:sequence
-        map_mutex.lock();
-        sequences[sequence.name] = move(sequence);
-        map_mutex.unlock();
-
-        // Print status update to stdout
-        cerr << "\33[2K\rParsed: " << read_name << flush;
-    }
-}
-
-
-void load_fasta_file(path input_file_path,
-        unordered_map <string, SequenceElement>& sequences,
-        uint16_t max_threads) {
-
-    // This reader is used to fetch an index
-    FastaReader fasta_reader(input_file_path);
-
-    // Get index
-    unordered_map <string, FastaIndex> read_indexes;
-    fasta_reader.get_indexes_mapped_by_name(read_indexes);
-
-    // Convert the map object into an indexable object
-    vector <pair <string, FastaIndex> > read_index_vector;
-    get_vector_from_index_map(read_index_vector, read_indexes);
-
-    mutex map_mutex;
-
-    atomic<uint64_t> job_index = 0;
-    vector<thread> threads;
-
-    // Launch threads
-    for (uint64_t i=0; i<max_threads; i++){
-        // Get data to send to threads (must not be sent by reference, or will lead to concurrency issues)
-        try {
-            // Call thread safe function to RL encode and write to file
-            threads.emplace_back(thread(load_fasta_sequences_from_file,
-                                        ref(input_file_path),
-                                        ref(read_index_vector),
-                                        ref(sequences),
-                                        ref(map_mutex),
-                                        ref(job_index)));
-        } catch (const exception &e) {
-            cerr << e.what() << "\n";
-            exit(1);
-        }
-    }
-
-    // Wait for threads to finish
-    for (auto& t: threads){
-        t.join();
-    }
-
-    cerr << "\n" << flush;
-}
-
-
 void parse_cigars_per_alignment(path bam_path,
-                                unordered_map <string,SequenceElement>& ref_sequences,
                                 vector <Region>& regions,
                                 ofstream& output_file,
                                 atomic <uint64_t>& job_index,
@@ -238,9 +158,10 @@ void parse_cigars_per_alignment(path bam_path,
 
 
 void parse_cigars(path bam_path,
-                  unordered_map <string,SequenceElement>& ref_sequences,
                   CigarStats& cigar_stats,
                   vector <Region>& regions,
+                  Checkpoint& checkpoint,
+                  uint16_t thread_index,
                   atomic <uint64_t>& job_index){
     ///
     ///
@@ -281,6 +202,16 @@ void parse_cigars(path bam_path,
 
     while (job_index < regions.size()) {
         uint64_t thread_job_index = job_index.fetch_add(1);
+
+        if (thread_job_index >= regions.size()){
+            break;
+        }
+
+        // Skip the regions that were completed before the run was resumed
+        if (checkpoint.is_completed(thread_job_index)){
+            continue;
+        }
+
         region = regions.at(thread_job_index);
 
         // BAM coords are 1 based
@@ -335,13 +266,16 @@ void parse_cigars(path bam_path,
         }
 
         cerr << "\33[2K\rParsed: " << region.to_string() << flush;
+
+        checkpoint.update(thread_index, thread_job_index, cigar_stats);
     }
+
+    checkpoint.save(thread_index, cigar_stats);
 }
 
 
 void get_fasta_cigar_stats_per_alignment(
         path bam_path,
-        unordered_map <string,SequenceElement>& ref_sequences,
         vector <Region>& regions,
         ofstream& output_file,
         uint16_t max_threads){
@@ -359,7 +293,6 @@ void get_fasta_cigar_stats_per_alignment(
             // Call thread safe function to read and write to file
             threads.emplace_back(thread(parse_cigars_per_alignment,
                                         ref(bam_path),
-                                        ref(ref_sequences),
                                         ref(regions),
                                         ref(output_file),
                                         ref(job_index),
@@ -381,8 +314,8 @@ void get_fasta_cigar_stats_per_alignment(
 
 
 CigarStats get_fasta_cigar_stats(path bam_path,
-        unordered_map <string,SequenceElement>& ref_sequences,
         vector <Region>& regions,
+        Checkpoint& checkpoint,
         uint16_t max_threads){
     ///
     ///
@@ -398,9 +331,10 @@ CigarStats get_fasta_cigar_stats(path bam_path,
             // Call thread safe function to read and write to file
             threads.emplace_back(thread(parse_cigars,
                                         ref(bam_path),
-                                        ref(ref_sequences),
                                         ref(stats_per_thread[i]),
                                         ref(regions),
+                                        ref(checkpoint),
+                                        i,
                                         ref(job_index)));
         } catch (const exception &e) {
             cerr << e.what() << "\n";
@@ -422,6 +356,9 @@ CigarStats get_fasta_cigar_stats(path bam_path,
         cigar_stats_sum += element;
     }
 
+    // Add the results of the regions that were completed before the run was resumed
+    checkpoint.load(cigar_stats_sum);
+
     return cigar_stats_sum;
 }
 
@@ -433,7 +370,9 @@ CigarStats measure_identity_from_fasta(path reads_fasta_path,
         uint16_t max_threads,
         bool per_alignment,
         uint64_t chunk_size,
-        vector<Region> regions){
+        vector<Region> regions,
+        bool resume,
+        double checkpoint_interval){
 
     cerr << "Using " + to_string(max_threads) + " threads\n";
 
@@ -441,9 +380,8 @@ CigarStats measure_identity_from_fasta(path reads_fasta_path,
     FastaReader reads_fasta_reader = FastaReader(reads_fasta_path);
     FastaReader ref_fasta_reader = FastaReader(reference_fasta_path);
 
-    // Store ref sequences in memory
-    unordered_map<string,SequenceElement> ref_sequences;
-    load_fasta_file(reference_fasta_path, ref_sequences, max_threads);
+    // Only the names and lengths of the reference sequences are needed, for chunking, so none are loaded
+    ref_fasta_reader.index(max_threads);
 
     // Index all the files in the MP directory
     // Setup Alignment parameters
@@ -468,12 +406,12 @@ CigarStats measure_identity_from_fasta(path reads_fasta_path,
 
     // Chunk alignment regions if none were provided
     if (regions.empty()) {
-        chunk_sequences_into_regions(regions, ref_sequences, chunk_size);
+        chunk_sequences_into_regions(regions, *ref_fasta_reader.compact_index, chunk_size);
     }
 
     cerr << "Iterating alignments...\n" << std::flush;
 
-    reads_fasta_reader.index();
+    reads_fasta_reader.index(max_threads);
 
     CigarStats stats;
 
@@ -485,16 +423,19 @@ CigarStats measure_identity_from_fasta(path reads_fasta_path,
         cerr << "Writing results to file: " << output_path << '\n';
 
         get_fasta_cigar_stats_per_alignment(bam_path,
-                ref_sequences,
                 regions,
                 output_file,
                 max_threads);
     }
     else {
+        // Save partial results periodically, and skip the regions that were completed by a previous run if resuming
+        Checkpoint checkpoint(output_directory, regions, {reads_fasta_path, reference_fasta_path},
+                              max_threads, resume, checkpoint_interval);
+
         // Launch threads for parsing alignments and generating matrices
         stats = get_fasta_cigar_stats(bam_path,
-                ref_sequences,
                 regions,
+                checkpoint,
                 max_threads);
 
         cerr << '\n';
@@ -502,6 +443,9 @@ CigarStats measure_identity_from_fasta(path reads_fasta_path,
         cout << "identity (M/(M+X+I+D)):\t" << stats.calculate_identity() << '\n';
         cout << stats.to_string();
 
+        // The output is complete, so the partial results are no longer needed
+        checkpoint.remove_files();
+
     }
     return stats;
 }
@@ -512,20 +456,21 @@ CigarStats measure_identity_from_bam(path bam_path,
         uint16_t max_threads,
         path output_directory,
         bool per_alignment,
-        uint64_t chunk_size){
+        uint64_t chunk_size,
+        bool resume,
+        double checkpoint_interval){
 
     cerr << "Using " + to_string(max_threads) + " threads\n";
 
     // Initialize readers
     FastaReader ref_fasta_reader = FastaReader(reference_fasta_path);
 
-    // Store ref sequences in memory
-    unordered_map<string,SequenceElement> ref_sequences;
-    load_fasta_file(reference_fasta_path, ref_sequences, max_threads);
+    // Only the names and lengths of the reference sequences are needed, for chunking, so none are loaded
+    ref_fasta_reader.index(max_threads);
 
     // Chunk alignment regions
     vector<Region> regions;
-    chunk_sequences_into_regions(regions, ref_sequences, chunk_size);
+    chunk_sequences_into_regions(regions, *ref_fasta_reader.compact_index, chunk_size);
 
     cerr << "Iterating alignments...\n" << std::flush;
 
@@ -544,16 +489,20 @@ CigarStats measure_identity_from_bam(path bam_path,
         cerr << "Writing results to file: " << output_path << '\n';
 
         get_fasta_cigar_stats_per_alignment(bam_path,
-                ref_sequences,
                 regions,
                 output_file,
                 max_threads);
     }
     else {
+        // Save partial results periodically, and skip the regions that were completed by a previous run if resuming
+        path checkpoint_directory = output_directory.empty() ? bam_path.parent_path() : output_directory;
+        Checkpoint checkpoint(checkpoint_directory, regions, {bam_path, reference_fasta_path},
+                              max_threads, resume, checkpoint_interval);
+
         // Launch threads for parsing alignments and generating matrices
         stats = get_fasta_cigar_stats(bam_path,
-                ref_sequences,
                 regions,
+                checkpoint,
                 max_threads);
 
         cerr << '\n';
@@ -561,6 +510,9 @@ CigarStats measure_identity_from_bam(path bam_path,
         cout << "identity (M/(M+X+I+D)):\t" << stats.calculate_identity() << '\n';
         cout << stats.to_string();
 
+        // The output is complete, so the partial results are no longer needed
+        checkpoint.remove_files();
+
     }
 
     return stats;
@@ -0,0 +1,366 @@
+#include "IntervalIndex.hpp"
+#include "BedReader.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <tuple>
+#include <iterator>
+
+using std::runtime_error;
+using std::tuple;
+using std::get;
+using std::max;
+using std::min;
+using std::upper_bound;
+using std::lower_bound;
+using std::prev;
+
+
+IntervalIndex::IntervalIndex(const vector<Region>& intervals){
+    this->initialize(intervals);
+}
+
+
+IntervalIndex::IntervalIndex(path bed_path){
+    vector<Region> intervals;
+
+    BedReader bed_reader(bed_path);
+    bed_reader.read_regions(intervals);
+
+    this->initialize(intervals);
+}
+
+
+void IntervalIndex::initialize(const vector<Region>& intervals){
+    vector <tuple <size_t, uint64_t, uint64_t> > sorted_intervals;
+    sorted_intervals.reserve(intervals.size());
+
+    for (auto& interval: intervals){
+        // Empty intervals can't overlap anything
+        if (interval.start >= interval.stop){
+            continue;
+        }
+
+        auto result = this->name_to_contig.emplace(interval.name, this->names.size());
+
+        if (result.second){
+            this->names.emplace_back(interval.name);
+        }
+
+        sorted_intervals.emplace_back(result.first->second, interval.start, interval.stop);
+    }
+
+    sort(sorted_intervals.begin(), sorted_intervals.end());
+
+    this->nodes.resize(sorted_intervals.size());
+    this->offsets.assign(this->names.size() + 1, 0);
+
+    for (size_t i=0; i<sorted_intervals.size(); i++){
+        auto& [contig_index, start, stop] = sorted_intervals[i];
+        this->nodes[i] = {start, stop, stop};
+        this->offsets[contig_index + 1]++;
+    }
+
+    for (size_t c=0; c<this->names.size(); c++){
+        this->offsets[c + 1] += this->offsets[c];
+    }
+
+    this->prefix_max_stops.resize(this->nodes.size());
+
+    for (size_t c=0; c<this->names.size(); c++){
+        uint64_t max_stop = 0;
+
+        for (size_t i=this->offsets[c]; i<this->offsets[c + 1]; i++){
+            max_stop = max(max_stop, this->nodes[i].stop);
+            this->prefix_max_stops[i] = max_stop;
+        }
+    }
+
+    this->max_levels.resize(this->names.size());
+
+    for (size_t c=0; c<this->names.size(); c++){
+        this->max_levels[c] = this->build(c);
+    }
+}
+
+
+int32_t IntervalIndex::build(size_t contig_index){
+    ///
+    /// Fill in the max stop of every node, level by level. Nodes past the end of the array don't exist, but the tree is
+    /// built as if the array were complete, so the rightmost branch takes its max from the last node that does exist.
+    ///
+    IntervalIndexNode* a = this->nodes.data() + this->offsets[contig_index];
+    int64_t n = int64_t(this->offsets[contig_index + 1] - this->offsets[contig_index]);
+
+    if (n == 0){
+        return -1;
+    }
+
+    int64_t last_i = 0;
+    uint64_t last = 0;
+
+    // Leaves are the even indexes
+    for (int64_t i=0; i<n; i+=2){
+        last_i = i;
+        last = a[i].max_stop = a[i].stop;
+    }
+
+    int32_t k = 1;
+
+    for (; (int64_t(1) << k) <= n; k++){
+        int64_t x = int64_t(1) << (k - 1);
+        int64_t i0 = (x << 1) - 1;
+        int64_t step = x << 2;
+
+        for (int64_t i=i0; i<n; i+=step){
+            uint64_t left = a[i - x].max_stop;
+            uint64_t right = (i + x < n) ? a[i + x].max_stop : last;
+            a[i].max_stop = max(a[i].stop, max(left, right));
+        }
+
+        last_i = ((last_i >> k) & 1) ? last_i - x : last_i + x;
+
+        if (last_i < n and a[last_i].max_stop > last){
+            last = a[last_i].max_stop;
+        }
+    }
+
+    return k - 1;
+}
+
+
+template <class T> void IntervalIndex::for_each_overlap(size_t contig_index, uint64_t start, uint64_t stop, T&& fn) const{
+    ///
+    /// Call fn(i) for the index i (within the contig) of each interval that overlaps [start, stop), until it returns
+    /// false. The left subtree of a node is skipped if nothing in it stops after 'start', and the node and its right
+    /// subtree are skipped if the node starts at or after 'stop'.
+    ///
+    if (start >= stop or this->max_levels[contig_index] < 0){
+        return;
+    }
+
+    const IntervalIndexNode* a = this->nodes.data() + this->offsets[contig_index];
+    int64_t n = int64_t(this->offsets[contig_index + 1] - this->offsets[contig_index]);
+
+    class StackItem {
+    public:
+        int64_t x;          // Node index
+        int32_t k;          // Level
+        bool visited_left;
+    };
+
+    StackItem stack[128];
+    size_t t = 0;
+
+    stack[t++] = {(int64_t(1) << this->max_levels[contig_index]) - 1, this->max_levels[contig_index], false};
+
+    while (t > 0){
+        StackItem z = stack[--t];
+
+        // Small subtrees are scanned in order
+        if (z.k <= 3){
+            int64_t i0 = (z.x >> z.k) << z.k;
+            int64_t i1 = min(i0 + (int64_t(1) << (z.k + 1)) - 1, n);
+
+            for (int64_t i=i0; i<i1 and a[i].start < stop; i++){
+                if (start < a[i].stop and not fn(i)){
+                    return;
+                }
+            }
+        }
+        else if (not z.visited_left){
+            int64_t y = z.x - (int64_t(1) << (z.k - 1));
+            stack[t++] = {z.x, z.k, true};
+
+            if (y >= n or a[y].max_stop > start){
+                stack[t++] = {y, z.k - 1, false};
+            }
+        }
+        else if (z.x < n and a[z.x].start < stop){
+            if (start < a[z.x].stop and not fn(z.x)){
+                return;
+            }
+
+            stack[t++] = {z.x + (int64_t(1) << (z.k - 1)), z.k - 1, false};
+        }
+    }
+}
+
+
+size_t IntervalIndex::size() const{
+    return this->nodes.size();
+}
+
+
+bool IntervalIndex::empty() const{
+    return this->nodes.empty();
+}
+
+
+Region IntervalIndex::get_interval(size_t i) const{
+    if (i >= this->nodes.size()){
+        throw runtime_error("ERROR: interval index out of range: " + std::to_string(i));
+    }
+
+    // Find the contig whose range of nodes contains i
+    size_t contig_index = size_t(upper_bound(this->offsets.begin(), this->offsets.end(), i) - this->offsets.begin()) - 1;
+
+    return {this->names[contig_index], this->nodes[i].start, this->nodes[i].stop};
+}
+
+
+bool IntervalIndex::contains(const string& name, uint64_t position) const{
+    auto result = this->name_to_contig.find(name);
+
+    if (result == this->name_to_contig.end()){
+        return false;
+    }
+
+    bool found = false;
+
+    this->for_each_overlap(result->second, position, position + 1, [&](int64_t){
+        found = true;
+        return false;
+    });
+
+    return found;
+}
+
+
+uint64_t IntervalIndex::get_max_stop(const string& name, uint64_t position) const{
+    auto result = this->name_to_contig.find(name);
+
+    if (result == this->name_to_contig.end()){
+        return 0;
+    }
+
+    // Find the first node of the contig that starts at or after the position
+    auto begin = this->nodes.begin() + this->offsets[result->second];
+    auto end = this->nodes.begin() + this->offsets[result->second + 1];
+
+    auto node = lower_bound(begin, end, position, [](const IntervalIndexNode& node, uint64_t p){
+        return node.start < p;
+    });
+
+    if (node == begin){
+        return 0;
+    }
+
+    return this->prefix_max_stops[node - this->nodes.begin() - 1];
+}
+
+
+void IntervalIndex::find_overlaps(const string& name, uint64_t start, uint64_t stop, vector<size_t>& overlaps) const{
+    auto result = this->name_to_contig.find(name);
+
+    if (result == this->name_to_contig.end()){
+        return;
+    }
+
+    size_t offset = this->offsets[result->second];
+
+    this->for_each_overlap(result->second, start, stop, [&](int64_t i){
+        overlaps.emplace_back(offset + i);
+        return true;
+    });
+}
+
+
+void IntervalIndex::find_overlaps(const vector<Region>& queries, vector <pair <size_t, size_t> >& overlaps) const{
+    // Consecutive queries are usually on the same contig, so only look up its name when it changes
+    const string* previous_name = nullptr;
+    int64_t contig_index = -1;
+
+    for (size_t q=0; q<queries.size(); q++){
+        auto& query = queries[q];
+
+        if (previous_name == nullptr or query.name != *previous_name){
+            auto result = this->name_to_contig.find(query.name);
+            contig_index = (result == this->name_to_contig.end()) ? -1 : int64_t(result->second);
+            previous_name = &query.name;
+        }
+
+        if (contig_index < 0){
+            continue;
+        }
+
+        size_t offset = this->offsets[contig_index];
+
+        this->for_each_overlap(contig_index, query.start, query.stop, [&](int64_t i){
+            overlaps.emplace_back(q, offset + i);
+            return true;
+        });
+    }
+}
+
+
+void IntervalIndex::get_merged_regions(vector<Region>& regions) const{
+    set<string> names(this->names.begin(), this->names.end());
+    this->get_merged_regions(regions, names);
+}
+
+
+void IntervalIndex::get_merged_regions(vector<Region>& regions, const set<string>& names) const{
+    ///
+    /// Intervals that overlap or abut are merged, so every position is in exactly one region
+    ///
+    for (size_t c=0; c<this->names.size(); c++){
+        if (names.count(this->names[c]) == 0){
+            continue;
+        }
+
+        for (size_t i=this->offsets[c]; i<this->offsets[c + 1]; i++){
+            auto& node = this->nodes[i];
+
+            if (i > this->offsets[c] and node.start <= regions.back().stop){
+                regions.back().stop = max(regions.back().stop, node.stop);
+            }
+            else{
+                regions.emplace_back(this->names[c], node.start, node.stop);
+            }
+        }
+    }
+}
+
+
+void IntervalIndex::get_merged_regions(vector<Region>& regions, const string& name, uint64_t start, uint64_t stop) const{
+    auto result = this->name_to_contig.find(name);
+
+    if (result == this->name_to_contig.end()){
+        return;
+    }
+
+    vector<int64_t> overlaps;
+
+    this->for_each_overlap(result->second, start, stop, [&](int64_t i){
+        overlaps.emplace_back(i);
+        return true;
+    });
+
+    // Nodes are sorted by start, so their indexes are too
+    sort(overlaps.begin(), overlaps.end());
+
+    const IntervalIndexNode* a = this->nodes.data() + this->offsets[result->second];
+    size_t n_regions = regions.size();
+
+    for (auto& i: overlaps){
+        uint64_t clipped_start = max(a[i].start, start);
+        uint64_t clipped_stop = min(a[i].stop, stop);
+
+        if (regions.size() > n_regions and clipped_start <= regions.back().stop){
+            regions.back().stop = max(regions.back().stop, clipped_stop);
+        }
+        else{
+            regions.emplace_back(name, clipped_start, clipped_stop);
+        }
+    }
+}
+
+
+bool contains_position(const vector<Region>& regions, uint64_t position){
+    // Find the last region that starts at or before the position
+    auto result = upper_bound(regions.begin(), regions.end(), position, [](uint64_t p, const Region& region){
+        return p < region.start;
+    });
+
+    return result != regions.begin() and position < prev(result)->stop;
+}
@@ -0,0 +1,220 @@
+#include "LabeledCoverageWriter.hpp"
+#include <charconv>
+
+using std::experimental::filesystem::create_directories;
+using std::experimental::filesystem::absolute;
+using std::lock_guard;
+using std::exception;
+using std::cerr;
+using std::to_chars;
+
+
+const string LabeledCoverageWriter::file_name = "labeled_coverage.csv";
+
+
+LabeledCoverageWriter::LabeledCoverageWriter(path output_directory, bool single_file, uint64_t buffer_size) {
+    this->output_directory = output_directory;
+    this->single_file = single_file;
+    this->buffer_size = buffer_size;
+    this->file_size = 0;
+
+    create_directories(this->output_directory);
+
+    if (this->single_file){
+        path file_path = this->output_directory / this->file_name;
+        path index_path = file_path.string() + ".idx";
+
+        this->file = ofstream(file_path, ofstream::binary);
+        this->index_file = ofstream(index_path);
+
+        if (not this->file.is_open() or not this->index_file.is_open()){
+            throw runtime_error("ERROR: could not open file " + file_path.string());
+        }
+    }
+}
+
+
+path LabeledCoverageWriter::get_record_path(const string& name){
+    return absolute(this->output_directory / (name + ".csv"));
+}
+
+
+uint64_t LabeledCoverageWriter::append(const string& block,
+        const vector <pair <string, pair <uint64_t, uint64_t> > >& pieces){
+
+    lock_guard<mutex> lock(this->file_mutex);
+
+    uint64_t offset = this->file_size;
+
+    this->file.write(block.data(), block.size());
+    this->file_size += block.size();
+
+    for (auto& piece: pieces){
+        this->index_file << piece.first << '\t' << offset + piece.second.first << '\t' << piece.second.second << '\n';
+    }
+
+    if (not this->file.good() or not this->index_file.good()){
+        throw runtime_error("ERROR: could not write to file " + (this->output_directory / this->file_name).string());
+    }
+
+    return offset;
+}
+
+
+LabeledCoverageBuffer::LabeledCoverageBuffer(LabeledCoverageWriter& writer):
+    writer(writer)
+{
+    this->record_start = 0;
+    this->in_record = false;
+
+    // Lines can overshoot the flush threshold by one line before they are written
+    this->buffer.reserve(this->writer.buffer_size + 64*1024);
+}
+
+
+LabeledCoverageBuffer::~LabeledCoverageBuffer(){
+    ///
+    /// A destructor can't report a failed write to its caller, so callers should close() the buffer themselves. This is
+    /// only a fallback for a buffer that wasn't closed, e.g. when its thread is unwinding from another error.
+    ///
+    try {
+        this->close();
+    }
+    catch (const exception& e){
+        cerr << e.what() << '\n';
+    }
+}
+
+
+void LabeledCoverageBuffer::close(){
+    if (this->in_record){
+        this->end_record();
+    }
+
+    this->flush();
+}
+
+
+void LabeledCoverageBuffer::start_record(const string& name){
+    if (this->in_record){
+        throw runtime_error("ERROR: labeled coverage record started before the previous one was ended: " + name);
+    }
+
+    this->record_name = name;
+    this->record_start = this->buffer.size();
+    this->in_record = true;
+
+    if (not this->writer.single_file){
+        path record_path = this->writer.get_record_path(name);
+        this->record_file = ofstream(record_path, ofstream::binary);
+
+        if (not this->record_file.is_open()){
+            throw runtime_error("ERROR: could not open file " + record_path.string());
+        }
+    }
+}
+
+
+void LabeledCoverageBuffer::end_record(){
+    if (not this->in_record){
+        throw runtime_error("ERROR: labeled coverage record ended without being started");
+    }
+
+    if (this->writer.single_file){
+        this->pieces.push_back({this->record_name, {this->record_start, this->buffer.size() - this->record_start}});
+        this->in_record = false;
+
+        if (this->buffer.size() >= this->writer.buffer_size){
+            this->flush();
+        }
+    }
+    else{
+        this->flush();
+        this->in_record = false;
+        this->record_file.close();
+
+        if (this->record_file.fail()){
+            throw runtime_error("ERROR: could not write to file " + this->writer.get_record_path(this->record_name).string());
+        }
+    }
+}
+
+
+void LabeledCoverageBuffer::flush(){
+    if (this->writer.single_file){
+        // The part of an unfinished record that is already buffered is written as a piece of its own
+        if (this->in_record and this->buffer.size() > this->record_start){
+            this->pieces.push_back({this->record_name, {this->record_start, this->buffer.size() - this->record_start}});
+        }
+
+        if (not this->pieces.empty()){
+            this->writer.append(this->buffer, this->pieces);
+        }
+
+        this->pieces.clear();
+    }
+    else if (this->in_record){
+        this->record_file.write(this->buffer.data(), this->buffer.size());
+
+        if (not this->record_file.good()){
+            throw runtime_error("ERROR: could not write to file " + this->writer.get_record_path(this->record_name).string());
+        }
+    }
+
+    this->buffer.clear();
+    this->record_start = 0;
+}
+
+
+void LabeledCoverageBuffer::append_integer(uint64_t value){
+    char digits[20];
+    auto result = to_chars(digits, digits + sizeof(digits), value);
+    this->buffer.append(digits, result.ptr - digits);
+}
+
+
+void LabeledCoverageBuffer::write_line(
+        bool reversal,
+        char true_base,
+        uint16_t true_length,
+        char consensus_base,
+        uint16_t consensus_length,
+        const CoveragePileup& coverage_data,
+        bool is_vertex){
+
+    if (not this->in_record){
+        throw runtime_error("ERROR: labeled coverage written outside of a record");
+    }
+
+    if (reversal and consensus_base != '_'){
+        consensus_base = complement_base(consensus_base);
+    }
+
+    this->buffer += CoverageElement::reversal_string_plus_minus[reversal];
+    this->buffer += ',';
+    this->buffer += true_base;
+    this->buffer += ',';
+    this->append_integer(true_length);
+    this->buffer += ',';
+    this->buffer += consensus_base;
+    this->buffer += ',';
+    this->append_integer(consensus_length);
+    this->buffer += ',';
+
+    for (auto coverage_element: coverage_data) {
+        this->buffer += coverage_element.base;
+        this->append_integer(coverage_element.length);
+        this->buffer += CoverageElement::reversal_string_plus_minus[coverage_element.reversal];
+        this->buffer += ' ';
+        this->append_integer(uint32_t(coverage_element.weight));
+        this->buffer += ',';
+    }
+
+    this->buffer += ' ';
+    this->buffer += (is_vertex ? 'v' : 'e');
+    this->buffer += '\n';
+
+    if (this->buffer.size() >= this->writer.buffer_size){
+        this->flush();
+    }
+}
@@ -1,9 +1,11 @@
 #include "MarginPolishReader.hpp"
+#include "Miscellaneous.hpp"
 #include <utility>
 #include <iostream>
 #include <algorithm>
 #include <stdexcept>
 #include <exception>
+#include <cstring>
 #include <experimental/filesystem>
 
 using std::move;
@@ -15,6 +17,7 @@ using std::getline;
 using std::replace;
 using std::runtime_error;
 using std::exception;
+using std::memchr;
 using std::experimental::filesystem::directory_iterator;
 using std::experimental::filesystem::path;
 
@@ -74,16 +77,26 @@ bool MarginPolishReader::parse_reversal_string(string reversal_string){
 
 
 void MarginPolishReader::parse_coverage_string(CoverageSegment& mp_segment, string& line){
+    this->parse_coverage_string(mp_segment, line.data(), line.data() + line.size());
+}
+
+
+void MarginPolishReader::parse_coverage_string(CoverageSegment& mp_segment, const char* start, const char* stop){
     ///
-    /// Read a line of the MarginPolish runlength TSV and converts it to a vector of CoverageElements
+    /// Read a line of the MarginPolish runlength TSV and append its observations to the segment, without
+    /// allocating. Each observation looks like "G+3,1.000" i.e. base, strand, length, comma, weight.
     ///
 
-    // For iterating elements within the tab separated string
-    uint64_t start_index = line.find_first_of('\t') + 2;
-    uint64_t c = 0;
+    // Skip the index column, the consensus base follows the first tab
+    auto p = static_cast<const char*>(memchr(start, '\t', stop - start));
+
+    if (p == nullptr or p + 1 >= stop){
+        throw runtime_error("ERROR: incomplete line in MarginPolish coverage data: " + string(start, stop));
+    }
 
     // Append consensus base to MarginPolish segment
-    mp_segment.sequence += line[start_index-1];
+    mp_segment.sequence += p[1];
+    p += 2;
 
     // Placeholders for Coverage element
     char base;
@@ -91,51 +104,40 @@ void MarginPolishReader::parse_coverage_string(CoverageSegment& mp_segment, stri
     bool reversal;
     float weight;
 
-    // Buffers for elements with indeterminate number of chars
-    string reversal_string;
-    string weight_string;
-    string length_string;
-    bool comma_found = false;
-
-    vector<CoverageElement> pileup;
-
-    // Iterate observations
-    for (uint64_t i=start_index; i<=line.size(); i++){
-        // Perform element level operations at start of next element and end of line
-        if (line[i] == '\t' or i == line.size()){
-            if (i > start_index){
-                reversal = this->parse_reversal_string(reversal_string);
-                length = uint16_t(stoi(length_string));
-                weight = stof(weight_string);
-//                CoverageElement coverage_element = CoverageElement(base, length, reversal, weight);
-                pileup.emplace_back(base, length, reversal, weight);
-            }
-            c = 0;
-            length_string = "";
-            weight_string = "";
-            comma_found = false;
+    // Iterate observations, p always points at the tab that precedes the next observation
+    while (p < stop){
+        const char* element_start = p + 1;
+        auto element_stop = static_cast<const char*>(memchr(element_start, '\t', stop - element_start));
+
+        if (element_stop == nullptr){
+            element_stop = stop;
         }
-        // Parse element members
-        else {
-            if (c == 1) {
-                base = line[i];
-            }
-            else if (c == 2) {
-                reversal_string = line[i];
-            }
-            else if (c > 2 and line[i] != ',' and not comma_found) {
-                length_string += line[i];
-            }
-            else if (line[i] == ','){
-                comma_found = true;
-            }
-            else if (comma_found){
-                weight_string += line[i];
-            }
+
+        if (element_stop - element_start < 3){
+            throw runtime_error("ERROR: incomplete observation in MarginPolish coverage data: " + string(element_start, element_stop));
+        }
+
+        base = element_start[0];
+
+        if (element_start[1] == '+'){
+            reversal = false;
+        }
+        else if (element_start[1] == '-'){
+            reversal = true;
         }
-        c++;
+        else{
+            throw runtime_error("ERROR: Invalid reversal string " + string(1, element_start[1]));
+        }
+
+        const char* q = parse_uint16(element_start + 2, element_stop, length);
+        parse_float(q + 1, element_stop, weight);
+
+        mp_segment.add_observation(base, length, reversal, weight);
+
+        p = element_stop;
     }
-    mp_segment.coverage_data.push_back(move(pileup));
+
+    mp_segment.end_position();
 }
 
 
@@ -143,35 +145,37 @@ void MarginPolishReader::read_file(CoverageSegment& mp_segment, path& file_path)
     ///
     /// Iterate all the lines in a marginpolish runlength output file (TSV)
     ///
-    // Clear the container
-    mp_segment = {};
+    // Clear the containers (without releasing their memory)
+    mp_segment.clear();
 
-    // Open file
-    ifstream file = ifstream(file_path);
-    if (not file.good()){
-        throw runtime_error("ERROR: could not open file " + file_path.string());
-    }
+    read_file_to_string(file_path, this->file_buffer);
 
-    // File iteration variables
-    string line;
+    const char* start = this->file_buffer.data();
+    const char* end = start + this->file_buffer.size();
     uint64_t l = 0;
 
-    // TODO: stop using getline()
-    while (getline(file, line)){
-        if (l > 2){
+    while (start < end){
+        auto stop = static_cast<const char*>(memchr(start, '\n', end - start));
+        if (stop == nullptr){
+            stop = end;
+        }
+
+        if (l > 2 and stop > start){
             // Skip the first 2 header lines
             try {
-                this->parse_coverage_string(mp_segment, line);
+                this->parse_coverage_string(mp_segment, start, stop);
             }
             catch (exception& e){
                 cerr << "Exception: " << e.what() << '\n';
                 cerr << "ERROR parsing line in file:\n\t"
                      << file_path.string() << "\n\t"
                      << "at line index: " << to_string(l) << "\n\t"
-                     << line << '\n';
-                throw(e);
+                     << string(start, stop) << '\n';
+                throw;
             }
         }
+
+        start = stop + 1;
         l++;
     }
 }
@@ -195,22 +199,26 @@ void MarginPolishReader::read_consensus_sequence_from_file(CoverageSegment& mp_s
     ///
     /// Iterate all the lines in a marginpolish runlength output file (TSV)
     ///
-    // Open file
-    ifstream file = ifstream(file_path);
-    if (not file.good()){
-        throw runtime_error("ERROR: could not open file " + file_path.string());
-    }
+    read_file_to_string(file_path, this->file_buffer);
 
-    // File iteration variables
-    string line;
+    const char* start = this->file_buffer.data();
+    const char* end = start + this->file_buffer.size();
     uint64_t l = 0;
-    uint16_t tab_separator_index;
 
-    while (getline(file, line)){
+    while (start < end){
+        auto stop = static_cast<const char*>(memchr(start, '\n', end - start));
+        if (stop == nullptr){
+            stop = end;
+        }
+
         if (l > 2){
-            tab_separator_index = line.find_first_of('\t');
-            mp_segment.sequence += line[tab_separator_index+1];
+            auto tab = static_cast<const char*>(memchr(start, '\t', stop - start));
+            if (tab != nullptr and tab + 1 < stop) {
+                mp_segment.sequence += tab[1];
+            }
         }
+
+        start = stop + 1;
         l++;
     }
 }
@@ -221,7 +229,7 @@ void MarginPolishReader::fetch_consensus_sequence(CoverageSegment& mp_segment, s
     /// Fetch a read by its read name (which is derived from its filename) and skip fetching all the coverage data
     ///
     // Clear the container
-    mp_segment = {};
+    mp_segment.clear();
 
     if (this->file_paths.empty()){
         cerr << "Index not loaded for marginpolish directory, generating now...\n";
@@ -139,6 +139,120 @@ void operator+=(rle_base_matrix& matrix_a, rle_base_matrix& matrix_b){
 }
 
 
+void operator+=(reference_rle_length_histogram& matrix_a, reference_rle_length_histogram& matrix_b){
+    ///
+    /// Increment 'matrix_a' element-wise with values from 'matrix_b'
+    ///
+    auto shape_a = matrix_a.shape();
+    auto shape_b = matrix_b.shape();
+
+    if (shape_a[0] != shape_b[0] or shape_a[1] != shape_b[1]){
+        string shape_a_string = to_string(shape_a[0]) + "," + to_string(shape_a[1]);
+        string shape_b_string = to_string(shape_b[0]) + "," + to_string(shape_b[1]);
+
+        throw runtime_error("ERROR: matrices with unequal sizes cannot be added: " + shape_a_string + " " + shape_b_string);
+    }
+
+    for (size_t b=0; b<shape_a[0]; b++) {
+        for (size_t i=0; i<shape_a[1]; i++) {
+            matrix_a[b][i] += matrix_b[b][i];
+        }
+    }
+}
+
+
+void operator+=(RLEConfusion& matrix_a, RLEConfusion& matrix_b){
+    ///
+    /// Increment both matrices of 'matrix_a' element-wise with values from 'matrix_b'
+    ///
+    increment_matrix(matrix_a.length_matrix, matrix_b.length_matrix);
+    increment_matrix(matrix_a.base_matrix, matrix_b.base_matrix);
+}
+
+
+void write_to_binary(ostream& file, const RLEConfusion& confusion){
+    write_to_binary(file, confusion.length_matrix);
+    write_to_binary(file, confusion.base_matrix);
+}
+
+
+void read_from_binary(istream& file, RLEConfusion& confusion){
+    read_from_binary(file, confusion.length_matrix);
+    read_from_binary(file, confusion.base_matrix);
+}
+
+
+static const char binary_matrix_magic[8] = {'R','L','E','M','A','T','R','X'};
+
+
+void write_binary_matrix_header(ostream& file, uint64_t element_size, const vector<uint64_t>& shape){
+    file.write(binary_matrix_magic, sizeof(binary_matrix_magic));
+    write_value_to_binary(file, binary_matrix_version);
+    write_value_to_binary(file, element_size);
+    write_value_to_binary(file, uint64_t(shape.size()));
+    write_vector_to_binary(file, shape);
+}
+
+
+void read_binary_matrix_header(istream& file, path file_path, uint64_t element_size, vector<uint64_t>& shape){
+    char magic[sizeof(binary_matrix_magic)];
+    uint64_t version;
+    uint64_t file_element_size;
+    uint64_t n_dimensions;
+
+    file.read(magic, sizeof(magic));
+
+    if (not file or memcmp(magic, binary_matrix_magic, sizeof(magic)) != 0){
+        throw runtime_error("ERROR: not a binary matrix file: " + file_path.string());
+    }
+
+    file.read(reinterpret_cast<char*>(&version), sizeof(uint64_t));
+    file.read(reinterpret_cast<char*>(&file_element_size), sizeof(uint64_t));
+    file.read(reinterpret_cast<char*>(&n_dimensions), sizeof(uint64_t));
+
+    if (not file){
+        throw runtime_error("ERROR: binary matrix is truncated: " + file_path.string());
+    }
+
+    if (version != binary_matrix_version){
+        throw runtime_error("ERROR: unsupported binary matrix version (" + to_string(version) + "): " + file_path.string());
+    }
+
+    if (file_element_size != element_size){
+        throw runtime_error("ERROR: binary matrix has elements of " + to_string(file_element_size) + " bytes, expected " +
+                            to_string(element_size) + ": " + file_path.string());
+    }
+
+    if (n_dimensions == 0 or n_dimensions > 8){
+        throw runtime_error("ERROR: binary matrix has an invalid number of dimensions: " + file_path.string());
+    }
+
+    shape.resize(n_dimensions);
+    file.read(reinterpret_cast<char*>(shape.data()), n_dimensions*sizeof(uint64_t));
+
+    if (not file){
+        throw runtime_error("ERROR: binary matrix is truncated: " + file_path.string());
+    }
+}
+
+
+vector<uint64_t> read_binary_matrix_shape(path file_path, uint64_t element_size){
+    ///
+    /// Read only the header of a binary matrix file, e.g. to find which kind of matrix it is
+    ///
+    ifstream file(file_path, std::ios::binary);
+
+    if (not file.is_open()){
+        throw runtime_error("ERROR: file could not be read: " + file_path.string());
+    }
+
+    vector<uint64_t> shape;
+    read_binary_matrix_header(file, file_path, element_size, shape);
+
+    return shape;
+}
+
+
 void increment_matrix(rle_length_matrix& matrix_a, rle_length_matrix& matrix_b){
     ///
     /// Increment 'matrix_a' element-wise with values from 'matrix_b'
@@ -7,6 +7,11 @@
 #include <vector>
 #include <stdexcept>
 #include <cmath>
+#include <charconv>
+#include <fstream>
+#include <experimental/filesystem>
+#include <atomic>
+#include <unistd.h>
 #include "boost/program_options.hpp"
 #include <boost/tokenizer.hpp>
 
@@ -22,6 +27,15 @@ using std::runtime_error;
 using std::pow;
 using std::max;
 using std::log10;
+using std::from_chars;
+using std::errc;
+using std::ifstream;
+using std::atomic;
+using std::experimental::filesystem::path;
+using std::experimental::filesystem::exists;
+using std::experimental::filesystem::remove;
+using std::experimental::filesystem::rename;
+using std::experimental::filesystem::filesystem_error;
 using boost::program_options::options_description;
 using boost::program_options::value;
 using boost::program_options::variables_map;
@@ -62,7 +76,7 @@ void split_as_double(vector<double>& tokens, string& s, string& separators){
 
 void parse_comma_separated_pair_as_doubles(pair<double,double>& p, string& s) {
     size_t comma_index = s.find_first_of(',');
-    string first = s.substr(0,comma_index-1);
+    string first = s.substr(0,comma_index);
     string second = s.substr(comma_index+1,s.size());
 
     p.first = stod(first);
@@ -70,6 +84,84 @@ void parse_comma_separated_pair_as_doubles(pair<double,double>& p, string& s) {
 }
 
 
+void read_file_to_string(path file_path, string& buffer){
+    ///
+    /// Read a whole file into a (reusable) string, so that it can be parsed in place without any per-line allocation
+    ///
+    ifstream file(file_path, ifstream::binary);
+
+    if (not file.good()){
+        throw runtime_error("ERROR: could not open file " + file_path.string());
+    }
+
+    file.seekg(0, ifstream::end);
+    size_t size = file.tellg();
+    file.seekg(0, ifstream::beg);
+
+    buffer.resize(size);
+    file.read(&buffer[0], size);
+}
+
+
+path get_temporary_path(path file_path){
+    ///
+    /// A name to write file_path under before renaming it into place, which is unique to this process and call, so
+    /// that concurrent writers of the same file (e.g. two shards building one index) never share a temporary file
+    ///
+    static atomic<uint64_t> n_calls = 0;
+
+    return file_path.string() + "." + to_string(getpid()) + "." + to_string(n_calls.fetch_add(1)) + ".tmp";
+}
+
+
+void rename_temporary_file(path temporary_path, path file_path){
+    ///
+    /// Move a finished temporary file into place. If the rename fails but the file exists, another writer has already
+    /// produced it from the same input, so that copy is kept.
+    ///
+    try {
+        rename(temporary_path, file_path);
+    }
+    catch (const filesystem_error& e){
+        remove(temporary_path);
+
+        if (not exists(file_path)){
+            throw runtime_error("ERROR: could not move " + temporary_path.string() + " to " + file_path.string() + ": " + e.what());
+        }
+    }
+}
+
+
+const char* parse_uint16(const char* start, const char* stop, uint16_t& value){
+    ///
+    /// Parse an integer from the start of a char range without allocating, returning a pointer to the first char that
+    /// was not part of it
+    ///
+    auto result = from_chars(start, stop, value);
+
+    if (result.ec != errc()){
+        throw runtime_error("ERROR: could not parse integer from: " + string(start, stop));
+    }
+
+    return result.ptr;
+}
+
+
+const char* parse_float(const char* start, const char* stop, float& value){
+    ///
+    /// Parse a float from the start of a char range without allocating, returning a pointer to the first char that
+    /// was not part of it
+    ///
+    auto result = from_chars(start, stop, value);
+
+    if (result.ec != errc()){
+        throw runtime_error("ERROR: could not parse float from: " + string(start, stop));
+    }
+
+    return result.ptr;
+}
+
+
 size_t find_nth_character(string& s, char c, size_t n){
     size_t n_found = 0;
     size_t index = -1;
@@ -14,6 +14,19 @@ MultiDistributionStats::MultiDistributionStats(size_t distribution_size):
     pointwise_stats(distribution_size){}
 
 
+void operator+=(MultiDistributionStats& a, MultiDistributionStats& b){
+    if (a.pointwise_stats.size() != b.pointwise_stats.size()){
+        throw runtime_error("ERROR: cannot sum MultiDistributionStats objects of different sizes");
+    }
+
+    for (size_t i=0; i<a.pointwise_stats.size(); i++){
+        a.pointwise_stats[i] += b.pointwise_stats[i];
+    }
+
+    a.size += b.size;
+}
+
+
 void MultiDistributionStats::update(vector<double>& distribution){
     if (this->pointwise_stats.size() != distribution.size()){
         throw runtime_error("ERROR: user-provided distribution does not match MultiDistributionStats size");
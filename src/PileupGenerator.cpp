@@ -11,52 +11,48 @@ using std::min;
 using std::experimental::filesystem::path;
 
 
-PileupGenerator::PileupGenerator(path bam_path, uint16_t maximum_depth){
-    this->bam_path = bam_path;
-    this->bam_reader = BamReader(bam_path);
-    this->maximum_depth = maximum_depth;
-}
+void fetch_read_sequences(FastaReader& sequence_reader,
+        vector<AlignedSegment>& alignments,
+        unordered_map<string,SequenceElement>& read_sequences){
 
+    vector<string> read_names;
+    vector <pair <string, FastaIndex> > read_indexes;
 
-int64_t PileupGenerator::find_depth_index(int64_t start_index){
-    ///
-    /// Decide where to insert a read in the pileup, depending on what space is available.
-    ///
+    for (auto& aligned_segment: alignments){
+        if (read_sequences.count(aligned_segment.read_name) == 0){
+            read_sequences.emplace(aligned_segment.read_name, SequenceElement());
+            read_names.emplace_back(aligned_segment.read_name);
+        }
+    }
 
-    int64_t depth_index = -1;
-    int64_t lowest_width_index;
+    sequence_reader.get_indexes_in_file_order(read_names, read_indexes);
 
-    // Sort a vector of pairs
-    sort(this->lowest_free_index_per_depth.begin(), this->lowest_free_index_per_depth.end(), [](auto &left, auto &right) {
-        return left.second < right.second;
-    });
+    for (auto& [read_name, fasta_index]: read_indexes){
+        sequence_reader.get_sequence(read_sequences.at(read_name), read_name, fasta_index.byte_index);
+    }
+}
 
-    lowest_width_index = this->lowest_free_index_per_depth[0].second;
 
-    // If this row is not empty
-    if (lowest_width_index != 0){
-        // Check if there is at least 1 space between the lowest free index and the start index for this read
-        if (start_index > lowest_width_index + 1){
-            depth_index = this->lowest_free_index_per_depth[0].first;
-        }
-        // If there is not, then just add another row, and set the depth index to that row
-        else{
-            depth_index = this->lowest_free_index_per_depth.size();
-            this->lowest_free_index_per_depth.emplace_front(this->lowest_free_index_per_depth.size(), start_index);
-        }
-    }
-    else{
-        depth_index = 0;
-    }
+PileupGenerator::PileupGenerator(path bam_path, uint16_t maximum_depth):
+    bam_reader(bam_path)
+{
+    // The reader must be constructed in place, BamReader owns raw htslib pointers and has no copy semantics
+    this->bam_path = bam_path;
+    this->maximum_depth = maximum_depth;
+}
+
 
-    return depth_index;
+int64_t PileupGenerator::find_depth_index(int64_t start_index, int64_t stop_index){
+    ///
+    /// Decide where to insert a read in the pileup, depending on what space is available, and mark that row as
+    /// occupied until stop_index
+    ///
+    return this->row_allocator.allocate(start_index, stop_index);
 }
 
 
 void PileupGenerator::print_lowest_free_indexes(){
-    for (auto& item: this->lowest_free_index_per_depth){
-        cout << item.first << " " << item.second << "\n";
-    }
+    this->row_allocator.print();
 }
 
 
@@ -1,16 +1,155 @@
 #include "PileupKmer.hpp"
 #include <cmath>
+#include <algorithm>
 
 using std::pow;
 using std::min;
 
 
+KmerReadTable::KmerReadTable():
+    KmerReadTable(0)
+{}
+
+
+KmerReadTable::KmerReadTable(size_t n_reads){
+    // Start with room for about one distinct kmer per read, which is enough for most columns
+    size_t n_slots = 16;
+    while (n_slots < 2*n_reads){
+        n_slots <<= 1;
+    }
+
+    this->n_kmers = 0;
+    this->n_words = n_reads/64 + 1;
+    this->slots.resize(n_slots, 0);
+    this->slot_mask = n_slots - 1;
+    this->kmers.resize(n_slots/2);
+    this->read_bits.resize(this->kmers.size()*this->n_words, 0);
+    this->used_slots.reserve(n_slots);
+}
+
+
+size_t KmerReadTable::hash(uint64_t kmer){
+    // Fibonacci hashing, then use the high bits which are the best mixed
+    return ((kmer * 11400714819323198485llu) >> 32) & this->slot_mask;
+}
+
+
+void KmerReadTable::grow(){
+    size_t n_slots = this->slots.size()*2;
+
+    this->slots.assign(n_slots, 0);
+    this->slot_mask = n_slots - 1;
+    this->used_slots.clear();
+    this->used_slots.reserve(n_slots);
+
+    // Reinsert all the existing entries
+    for (size_t i=0; i<this->n_kmers; i++){
+        size_t s = this->hash(this->kmers[i]);
+        while (this->slots[s] != 0){
+            s = (s + 1) & this->slot_mask;
+        }
+        this->slots[s] = i + 1;
+        this->used_slots.emplace_back(s);
+    }
+
+    this->kmers.resize(n_slots/2);
+    this->read_bits.resize(this->kmers.size()*this->n_words, 0);
+}
+
+
+void KmerReadTable::clear(){
+    for (auto& s: this->used_slots){
+        this->slots[s] = 0;
+    }
+
+    std::fill(this->read_bits.begin(), this->read_bits.begin() + this->n_kmers*this->n_words, 0);
+
+    this->used_slots.clear();
+    this->n_kmers = 0;
+}
+
+
+int64_t KmerReadTable::find(uint64_t kmer){
+    size_t s = this->hash(kmer);
+
+    while (this->slots[s] != 0){
+        if (this->kmers[this->slots[s] - 1] == kmer){
+            return int64_t(this->slots[s]) - 1;
+        }
+        s = (s + 1) & this->slot_mask;
+    }
+
+    return -1;
+}
+
+
+size_t KmerReadTable::insert(uint64_t kmer){
+    int64_t entry = this->find(kmer);
+
+    if (entry >= 0){
+        return entry;
+    }
+
+    // Keep the load factor at or below 1/2
+    if (2*(this->n_kmers + 1) > this->slots.size()){
+        this->grow();
+    }
+
+    size_t s = this->hash(kmer);
+    while (this->slots[s] != 0){
+        s = (s + 1) & this->slot_mask;
+    }
+
+    this->kmers[this->n_kmers] = kmer;
+    this->slots[s] = this->n_kmers + 1;
+    this->used_slots.emplace_back(s);
+
+    return this->n_kmers++;
+}
+
+
+void KmerReadTable::add_read(size_t kmer_entry, size_t read_index){
+    if (read_index >= this->n_words*64){
+        throw runtime_error("ERROR: read index " + std::to_string(read_index) + " exceeds capacity of KmerReadTable");
+    }
+
+    this->read_bits[kmer_entry*this->n_words + read_index/64] |= (uint64_t(1) << (read_index % 64));
+}
+
+
+uint64_t KmerReadTable::get_coverage(size_t kmer_entry){
+    uint64_t coverage = 0;
+
+    for (size_t i=kmer_entry*this->n_words; i<(kmer_entry+1)*this->n_words; i++){
+        coverage += __builtin_popcountll(this->read_bits[i]);
+    }
+
+    return coverage;
+}
+
+
+size_t KmerReadTable::size(){
+    return this->n_kmers;
+}
+
+
 PileupReadKmerIterator::PileupReadKmerIterator(size_t window_size, size_t depth_index, uint8_t k){
     if (window_size % 2 != 1){
         throw runtime_error("ERROR: window size must be odd or it has no middle index");
     }
+    if (k > 20){
+        throw runtime_error("ERROR: cannot use kmer size greater than 20: " + std::to_string(k));
+    }
+
+    // One extra slot for the placeholder that is added before the leftmost column is cycled out
+    this->n_operations = RingBuffer<uint64_t>(window_size + 1);
+    this->n_operations.push_back(0);
 
-    this->n_operations = {0};
+    // Usually there is about one kmer per column, inserts will grow the buffer if needed
+    this->window_kmer_indexes = RingBuffer<uint64_t>(2*window_size);
+
+    this->current_kmer_index = 0;
+    this->current_kmer_length = 0;
     this->window_size = window_size;
     this->depth_index = depth_index;
     this->width_index = 0;
@@ -25,11 +164,9 @@ void PileupReadKmerIterator::pop_left_kmers(Pileup& pileup){
     }
 
     // Cycle out the left kmer indexes
-    for (uint64_t i=0; i<this->n_operations[0]; i++){
-        this->window_kmer_indexes.pop_front();
-    }
+    this->window_kmer_indexes.pop_front(this->n_operations.front());
 
-    // Update the n_operations deque
+    // Update the n_operations buffer
     this->n_operations.pop_front();
 }
 
@@ -39,29 +176,26 @@ void PileupReadKmerIterator::push_right_kmer(uint8_t base){
         return;
     }
 
-    uint64_t kmer_index;
-
-    // Update kmer, ignoring anything not canonical
-    if (is_valid_base_index(base)){
-        this->current_kmer.emplace_back(base);
+    // Until k bases have been seen, just fill in the kmer
+    if (this->current_kmer_length < this->k){
+        this->current_kmer_index |= uint64_t(base) << (2*this->current_kmer_length);
+        this->current_kmer_length++;
+        return;
     }
 
-    if (current_kmer.size() > this->k) {
-        this->current_kmer.pop_front();
+    // Shift the oldest base out and the newest base in
+    this->current_kmer_index >>= 2;
+    this->current_kmer_index |= uint64_t(base) << (2*(this->k - 1));
 
-        // Get current kmer_index
-        kmer_index = kmer_to_index(this->current_kmer);
+    // And add the right side kmers
+    this->window_kmer_indexes.push_back(this->current_kmer_index);
 
-        // And add the right side kmers
-        this->window_kmer_indexes.emplace_back(kmer_index);
-
-        // Update kmer count for this ref index
-        this->n_operations.back()++;
-    }
+    // Update kmer count for this ref index
+    this->n_operations.back()++;
 }
 
 
-void PileupReadKmerIterator::update_middle_kmers(unordered_map<uint64_t, unordered_set <uint64_t> >& middle_kmers){
+void PileupReadKmerIterator::update_middle_kmers(KmerReadTable& middle_kmers){
     if (this->n_operations.size() == this->window_size and this->n_operations[middle_index] != 0){
         size_t start_index=0;
 
@@ -73,18 +207,18 @@ void PileupReadKmerIterator::update_middle_kmers(unordered_map<uint64_t, unorder
 
         // Add whichever kmer(s) is/are in the middle, possibly accounting for insert kmers
         for (size_t i=start_index; i<start_index+n_operations[middle_index]; i++){
-            middle_kmers.emplace(this->window_kmer_indexes[i], unordered_set<uint64_t>());
+            middle_kmers.insert(this->window_kmer_indexes[i]);
         }
     }
 
 }
 
 
-void PileupReadKmerIterator::step(Pileup& pileup, unordered_map<uint64_t, unordered_set <uint64_t> >& middle_kmers){
+void PileupReadKmerIterator::step(Pileup& pileup, KmerReadTable& middle_kmers){
     uint8_t base;
 
     // Make a placeholder counter for this step
-    this->n_operations.emplace_back(0);
+    this->n_operations.push_back(0);
 
     // Load next ref-aligned base
     base = pileup.pileup[this->width_index][this->depth_index][Pileup::BASE];
@@ -96,8 +230,9 @@ void PileupReadKmerIterator::step(Pileup& pileup, unordered_map<uint64_t, unorde
     push_right_kmer(base);
 
     // Load any insert bases that exist
-    if (pileup.inserts.count(this->width_index) > 0) {
-        for (auto &column: pileup.inserts.at(this->width_index)) {
+    auto result = pileup.inserts.find(this->width_index);
+    if (result != pileup.inserts.end()) {
+        for (auto &column: result->second) {
             base = column[this->depth_index][Pileup::BASE];
 
             // Update current kmer
@@ -118,12 +253,16 @@ PileupKmerIterator::PileupKmerIterator(Pileup& pileup, size_t window_size, uint8
 
     // Initialize read iterators
     this->read_iterators = vector <PileupReadKmerIterator>();
+    this->read_iterators.reserve(pileup.max_observed_depth);
 
     // Initialize all the read iterators for this pileup
     for (size_t i=0; i<pileup.max_observed_depth; i++){
         this->read_iterators.emplace_back(window_size, i, k);
     }
 
+    // One bit per row, for each distinct middle kmer
+    this->middle_kmers = KmerReadTable(pileup.max_observed_depth);
+
     this->window_size = window_size;
     this->k = k;
 }
@@ -136,19 +275,23 @@ PileupKmerIterator::PileupKmerIterator(Pileup& pileup, size_t window_size, uint8
 
     // Initialize read iterators
     this->read_iterators = vector <PileupReadKmerIterator>();
+    this->read_iterators.reserve(pileup.max_observed_depth);
 
     // Initialize all the read iterators for this pileup
     for (size_t i=0; i<pileup.max_observed_depth; i++){
         this->read_iterators.emplace_back(window_size, i, k);
     }
 
+    // One bit per row, for each distinct middle kmer
+    this->middle_kmers = KmerReadTable(pileup.max_observed_depth);
+
     this->window_size = window_size;
     this->k = k;
 }
 
 
 void PileupKmerIterator::step(Pileup& pileup){
-    this->middle_kmers = {};
+    this->middle_kmers.clear();
 
     // Step each of the read iterators
     for (size_t i=0; i<pileup.max_observed_depth; i++){
@@ -156,10 +299,17 @@ void PileupKmerIterator::step(Pileup& pileup){
     }
 
     // Find the number of rows that contain this kmer (not allowing multiple counts per row)
-    for(size_t i=0; i<pileup.max_observed_depth; i++){
-        for (auto& kmer_index: this->read_iterators[i].window_kmer_indexes){
-            if (this->middle_kmers.count(kmer_index) > 0){
-                this->middle_kmers.at(kmer_index).insert(i);  // A set tracks which rows in the pileup contain this kmer
+    if (this->middle_kmers.size() > 0) {
+        for (size_t i = 0; i < pileup.max_observed_depth; i++) {
+            auto& window_kmer_indexes = this->read_iterators[i].window_kmer_indexes;
+
+            for (size_t j = 0; j < window_kmer_indexes.size(); j++) {
+                int64_t kmer_entry = this->middle_kmers.find(window_kmer_indexes[j]);
+
+                if (kmer_entry >= 0) {
+                    // A bitset tracks which rows in the pileup contain this kmer
+                    this->middle_kmers.add_read(kmer_entry, i);
+                }
             }
         }
     }
@@ -173,7 +323,7 @@ void PileupKmerIterator::update_coverage_stats(Pileup& pileup, KmerStats& kmer_s
     uint16_t coverage;
 
     // Calculate the percentage of reads that contain each kmer and add it to the stats
-    for (auto& [middle_kmer_index, kmer_coverage_set]: this->middle_kmers){
+    for (size_t i=0; i<this->middle_kmers.size(); i++){
         coverage = pileup.coverage_per_position[this->width_index - this->read_iterators[0].middle_index];
 
         // Don't calculate kmer quality if the coverage is too low
@@ -182,30 +332,36 @@ void PileupKmerIterator::update_coverage_stats(Pileup& pileup, KmerStats& kmer_s
         }
 
         // Calculate proportion of reads that contain the kmer
-        quality = double(kmer_coverage_set.size())/double(coverage);
+        quality = double(this->middle_kmers.get_coverage(i))/double(coverage);
 
         // Occasional gaps in coverage smaller than the kmer size create impossible quality >1.0
         quality = min(1.0,quality);
 
         // Record this instance of quality
-        kmer_stats.update_quality(middle_kmer_index, quality);
+        kmer_stats.update_quality(this->middle_kmers.kmers[i], quality);
     }
 }
 
 
 void PileupKmerIterator::update_ref_kmer_confusion_stats(PileupKmerIterator& ref_pileup_iterator, KmerConfusionStats& kmer_confusion_stats){
-    for (auto& [ref_kmer_index,_]: ref_pileup_iterator.middle_kmers){
-        for (auto& [read_kmer_index, supporting_reads]: this->middle_kmers){
-            kmer_confusion_stats.confusion[ref_kmer_index][read_kmer_index] += supporting_reads.size();
+    for (size_t i=0; i<ref_pileup_iterator.middle_kmers.size(); i++){
+        uint64_t ref_kmer_index = ref_pileup_iterator.middle_kmers.kmers[i];
+
+        for (size_t j=0; j<this->middle_kmers.size(); j++){
+            uint64_t read_kmer_index = this->middle_kmers.kmers[j];
+            kmer_confusion_stats.confusion[ref_kmer_index][read_kmer_index] += this->middle_kmers.get_coverage(j);
         }
     }
 }
 
 
 void PileupKmerIterator::update_read_kmer_confusion_stats(PileupKmerIterator& ref_pileup_iterator, KmerConfusionStats& kmer_confusion_stats){
-    for (auto& [ref_kmer_index,_]: ref_pileup_iterator.middle_kmers){
-        for (auto& [read_kmer_index, supporting_reads]: this->middle_kmers){
-            kmer_confusion_stats.confusion[read_kmer_index][ref_kmer_index] += supporting_reads.size();
+    for (size_t i=0; i<ref_pileup_iterator.middle_kmers.size(); i++){
+        uint64_t ref_kmer_index = ref_pileup_iterator.middle_kmers.kmers[i];
+
+        for (size_t j=0; j<this->middle_kmers.size(); j++){
+            uint64_t read_kmer_index = this->middle_kmers.kmers[j];
+            kmer_confusion_stats.confusion[read_kmer_index][ref_kmer_index] += this->middle_kmers.get_coverage(j);
         }
     }
 }
@@ -0,0 +1,61 @@
+#include "PileupRowAllocator.hpp"
+#include <iostream>
+
+using std::cout;
+using std::get;
+
+
+PileupRowAllocator::PileupRowAllocator(){
+    this->clear();
+}
+
+
+void PileupRowAllocator::clear(){
+    this->rows = {};
+    this->rows.emplace(0, 0, 0);
+    this->n_rows = 1;
+    this->n_allocations = 1;
+}
+
+
+int64_t PileupRowAllocator::allocate(int64_t start_index, int64_t stop_index){
+    ///
+    /// Decide where to insert a read in the pileup, depending on what space is available.
+    ///
+    int64_t lowest_width_index = get<0>(this->rows.top());
+    int64_t depth_index;
+
+    // If the row is empty, or there is at least 1 space between its lowest free index and the start index for this
+    // read, then reuse it
+    if (lowest_width_index == 0 or start_index > lowest_width_index + 1){
+        depth_index = get<2>(this->rows.top());
+        this->rows.pop();
+    }
+    // If there is not, then just add another row, and set the depth index to that row
+    else{
+        depth_index = this->n_rows;
+        this->n_rows++;
+    }
+
+    // Update the occupancy status of this row
+    this->rows.emplace(stop_index, -this->n_allocations, depth_index);
+    this->n_allocations++;
+
+    return depth_index;
+}
+
+
+size_t PileupRowAllocator::get_n_rows() const{
+    return size_t(this->n_rows);
+}
+
+
+void PileupRowAllocator::print() const{
+    // Print in order of priority, from a copy, since a heap can only be iterated by popping
+    auto rows = this->rows;
+
+    while (not rows.empty()){
+        cout << get<2>(rows.top()) << " " << get<0>(rows.top()) << "\n";
+        rows.pop();
+    }
+}
@@ -27,3 +27,34 @@ BoundingBox::BoundingBox(QuadCoordinate center, float half_size){
     this->center = center;
     this->half_size = half_size;
 }
+
+
+bool BoundingBox::contains(QuadCoordinate coordinate){
+    ///
+    /// Bounds are half-open: [center - half_size, center + half_size)
+    ///
+    bool in_x = (coordinate.x >= this->center.x - this->half_size) and (coordinate.x < this->center.x + this->half_size);
+    bool in_y = (coordinate.y >= this->center.y - this->half_size) and (coordinate.y < this->center.y + this->half_size);
+
+    return in_x and in_y;
+}
+
+
+bool BoundingBox::intersects(BoundingBox boundary){
+    bool in_x = (this->center.x - this->half_size < boundary.center.x + boundary.half_size) and
+                (boundary.center.x - boundary.half_size < this->center.x + this->half_size);
+    bool in_y = (this->center.y - this->half_size < boundary.center.y + boundary.half_size) and
+                (boundary.center.y - boundary.half_size < this->center.y + this->half_size);
+
+    return in_x and in_y;
+}
+
+
+bool BoundingBox::encloses(BoundingBox boundary){
+    bool in_x = (this->center.x - this->half_size <= boundary.center.x - boundary.half_size) and
+                (boundary.center.x + boundary.half_size <= this->center.x + this->half_size);
+    bool in_y = (this->center.y - this->half_size <= boundary.center.y - boundary.half_size) and
+                (boundary.center.y + boundary.half_size <= this->center.y + this->half_size);
+
+    return in_x and in_y;
+}
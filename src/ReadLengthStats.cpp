@@ -0,0 +1,317 @@
+#include "ReadLengthStats.hpp"
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include <fstream>
+#include <limits>
+#include <cmath>
+
+using std::numeric_limits;
+using std::runtime_error;
+using std::from_chars;
+using std::ifstream;
+using std::push_heap;
+using std::pop_heap;
+using std::to_string;
+using std::min;
+using std::max;
+
+
+ReadLengthReservoir::ReadLengthReservoir(uint64_t max_cumulative_length, uint64_t seed):
+    max_cumulative_length(max_cumulative_length),
+    cumulative_length(0),
+    generator(seed)
+{}
+
+
+void ReadLengthReservoir::add(uint32_t length){
+    this->insert(this->generator(), length);
+}
+
+
+void ReadLengthReservoir::insert(uint64_t key, uint32_t length){
+    // Once the sample is full, a key larger than every sampled key would be trimmed right away
+    if (this->cumulative_length >= this->max_cumulative_length and not this->sample.empty() and key > this->sample.front().first){
+        return;
+    }
+
+    this->sample.emplace_back(key, length);
+    push_heap(this->sample.begin(), this->sample.end());
+    this->cumulative_length += length;
+
+    this->trim();
+}
+
+
+void ReadLengthReservoir::trim(){
+    ///
+    /// Drop the largest key for as long as the rest of the sample still reaches the maximum cumulative length
+    ///
+    while (not this->sample.empty() and this->cumulative_length - this->sample.front().second >= this->max_cumulative_length){
+        this->cumulative_length -= this->sample.front().second;
+        pop_heap(this->sample.begin(), this->sample.end());
+        this->sample.pop_back();
+    }
+}
+
+
+void ReadLengthReservoir::get_lengths(vector<uint32_t>& lengths) const{
+    lengths.clear();
+    lengths.reserve(this->sample.size());
+
+    for (auto& [key, length]: this->sample){
+        lengths.emplace_back(length);
+    }
+
+    sort(lengths.begin(), lengths.end());
+}
+
+
+void operator+=(ReadLengthReservoir& a, ReadLengthReservoir& b){
+    ///
+    /// The keys of both reservoirs are independent and uniform, so the prefix of their union is a sample of the union
+    ///
+    if (a.max_cumulative_length != b.max_cumulative_length){
+        throw runtime_error("ERROR: reservoirs with unequal maximum cumulative lengths cannot be added: " +
+                            to_string(a.max_cumulative_length) + " " + to_string(b.max_cumulative_length));
+    }
+
+    for (auto& [key, length]: b.sample){
+        a.insert(key, length);
+    }
+}
+
+
+ReadLengthSketch::ReadLengthSketch(double relative_accuracy):
+    relative_accuracy(relative_accuracy),
+    gamma((1 + relative_accuracy)/(1 - relative_accuracy)),
+    log_gamma(log(gamma)),
+    n_reads(0),
+    total_length(0),
+    min_length(numeric_limits<uint32_t>::max()),
+    max_length(0)
+{
+    if (relative_accuracy <= 0 or relative_accuracy >= 1){
+        throw runtime_error("ERROR: relative accuracy of length sketch must be in (0,1): " + to_string(relative_accuracy));
+    }
+}
+
+
+size_t ReadLengthSketch::get_bucket_index(uint32_t length) const{
+    ///
+    /// Bucket 0 holds length 0, and bucket i>0 holds lengths in (gamma^(i-2), gamma^(i-1)]
+    ///
+    if (length == 0){
+        return 0;
+    }
+
+    return 1 + size_t(ceil(log(double(length))/this->log_gamma));
+}
+
+
+double ReadLengthSketch::get_bucket_value(size_t index) const{
+    ///
+    /// The point of the bucket whose relative distance to both of its bounds is 'relative_accuracy'
+    ///
+    if (index == 0){
+        return 0;
+    }
+
+    return 2*pow(this->gamma, double(index - 1))/(this->gamma + 1);
+}
+
+
+void ReadLengthSketch::add(uint32_t length){
+    size_t index = this->get_bucket_index(length);
+
+    if (index >= this->counts.size()){
+        this->counts.resize(index + 1, 0);
+        this->cumulative_lengths.resize(index + 1, 0);
+    }
+
+    this->counts[index]++;
+    this->cumulative_lengths[index] += length;
+    this->n_reads++;
+    this->total_length += length;
+    this->min_length = min(this->min_length, length);
+    this->max_length = max(this->max_length, length);
+}
+
+
+uint32_t ReadLengthSketch::get_quantile(double q) const{
+    if (this->n_reads == 0){
+        return 0;
+    }
+
+    uint64_t rank = uint64_t(q*double(this->n_reads - 1));
+    uint64_t n = 0;
+    size_t i = 0;
+
+    for (; i<this->counts.size(); i++){
+        n += this->counts[i];
+
+        if (n > rank){
+            break;
+        }
+    }
+
+    double value = round(this->get_bucket_value(i));
+
+    return uint32_t(min(max(value, double(this->min_length)), double(this->max_length)));
+}
+
+
+uint32_t ReadLengthSketch::get_nx(double x) const{
+    if (this->n_reads == 0){
+        return 0;
+    }
+
+    double target = x*double(this->total_length);
+    uint64_t cumulative_length = 0;
+    int64_t i = int64_t(this->cumulative_lengths.size()) - 1;
+
+    // Sum the bases of the longest reads first, until they reach the target fraction
+    for (; i>0; i--){
+        cumulative_length += this->cumulative_lengths[i];
+
+        if (double(cumulative_length) >= target){
+            break;
+        }
+    }
+
+    double value = round(this->get_bucket_value(size_t(i)));
+
+    return uint32_t(min(max(value, double(this->min_length)), double(this->max_length)));
+}
+
+
+double ReadLengthSketch::get_mean() const{
+    if (this->n_reads == 0){
+        return 0;
+    }
+
+    return double(this->total_length)/double(this->n_reads);
+}
+
+
+void operator+=(ReadLengthSketch& a, ReadLengthSketch& b){
+    if (a.relative_accuracy != b.relative_accuracy){
+        throw runtime_error("ERROR: length sketches with unequal accuracy cannot be added: " +
+                            to_string(a.relative_accuracy) + " " + to_string(b.relative_accuracy));
+    }
+
+    if (b.counts.size() > a.counts.size()){
+        a.counts.resize(b.counts.size(), 0);
+        a.cumulative_lengths.resize(b.counts.size(), 0);
+    }
+
+    for (size_t i=0; i<b.counts.size(); i++){
+        a.counts[i] += b.counts[i];
+        a.cumulative_lengths[i] += b.cumulative_lengths[i];
+    }
+
+    a.n_reads += b.n_reads;
+    a.total_length += b.total_length;
+    a.min_length = min(a.min_length, b.min_length);
+    a.max_length = max(a.max_length, b.max_length);
+}
+
+
+ReadLengthHistogram::ReadLengthHistogram(uint32_t bin_size):
+    bin_size(bin_size)
+{
+    if (bin_size == 0){
+        throw runtime_error("ERROR: histogram bin size must be greater than 0");
+    }
+}
+
+
+void ReadLengthHistogram::add(uint32_t length){
+    size_t index = length/this->bin_size;
+
+    if (index >= this->counts.size()){
+        this->counts.resize(index + 1, 0);
+    }
+
+    this->counts[index]++;
+}
+
+
+string ReadLengthHistogram::to_string() const{
+    ///
+    /// One "bin_start,count" line per bin
+    ///
+    string histogram_string;
+
+    for (size_t i=0; i<this->counts.size(); i++){
+        histogram_string += std::to_string(uint64_t(i)*this->bin_size) + "," + std::to_string(this->counts[i]) + "\n";
+    }
+
+    return histogram_string;
+}
+
+
+void operator+=(ReadLengthHistogram& a, ReadLengthHistogram& b){
+    if (a.bin_size != b.bin_size){
+        throw runtime_error("ERROR: histograms with unequal bin sizes cannot be added: " +
+                            to_string(a.bin_size) + " " + to_string(b.bin_size));
+    }
+
+    if (b.counts.size() > a.counts.size()){
+        a.counts.resize(b.counts.size(), 0);
+    }
+
+    for (size_t i=0; i<b.counts.size(); i++){
+        a.counts[i] += b.counts[i];
+    }
+}
+
+
+ReadLengthStats::ReadLengthStats(uint64_t max_cumulative_length, uint64_t seed, uint32_t bin_size, double relative_accuracy):
+    reservoir(max_cumulative_length, seed),
+    sketch(relative_accuracy),
+    histogram(bin_size)
+{}
+
+
+void ReadLengthStats::add(uint32_t length){
+    this->reservoir.add(length);
+    this->sketch.add(length);
+    this->histogram.add(length);
+}
+
+
+void operator+=(ReadLengthStats& a, ReadLengthStats& b){
+    a.reservoir += b.reservoir;
+    a.sketch += b.sketch;
+    a.histogram += b.histogram;
+}
+
+
+void update_read_length_stats_from_fasta_index(path index_path, ReadLengthStats& stats, uint32_t min_length){
+    ifstream index_file(index_path);
+    string line;
+
+    // Check if file is readable or exists
+    if (not index_file.good()){
+        throw runtime_error("ERROR: file read error: " + index_path.string());
+    }
+
+    // Each line of a .fai is: name, length, byte offset, bases per line, bytes per line (tab separated)
+    while (getline(index_file, line)){
+        if (line.empty()){
+            continue;
+        }
+
+        size_t tab = line.find('\t');
+        uint32_t length;
+
+        if (tab == string::npos or from_chars(line.data() + tab + 1, line.data() + line.size(), length).ec != std::errc()){
+            throw runtime_error("ERROR: could not parse length from FASTA index line: " + line);
+        }
+
+        if (length >= min_length){
+            stats.add(length);
+        }
+    }
+}
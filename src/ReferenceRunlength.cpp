@@ -1,29 +1,215 @@
-
 #include "ReferenceRunlength.hpp"
-#include "FastaReader.hpp"
-#include "Runlength.hpp"
-#include "Matrix.hpp"
+#include <algorithm>
 #include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <cmath>
+#include <utility>
+
+using std::cerr;
+using std::min;
+using std::pair;
+using std::ref;
+using std::atomic;
+using std::thread;
+using std::exception;
+using std::ofstream;
+using std::ostringstream;
+using std::fixed;
+using std::setprecision;
+using std::experimental::filesystem::create_directories;
+using std::experimental::filesystem::absolute;
+
+
+class ReferenceRunlengthJob {
+public:
+    /// Attributes ///
+    size_t sequence_index;
+    uint64_t start;
+    uint64_t stop;
+};
+
+
+void count_runlengths(reference_rle_length_histogram& runlength_frequencies, string_view sequence, uint64_t start, uint64_t stop){
+    if (runlength_frequencies.empty()){
+        throw runtime_error("ERROR: uninitialized histogram passed to 'count_runlengths', histogram must be initialized");
+    }
+
+    uint64_t max_length = runlength_frequencies.shape()[1] - 1;
+    stop = min(stop, uint64_t(sequence.size()));
+
+    uint64_t i = start;
+
+    // Skip the remainder of a run that began in the previous range
+    if (i > 0 and i < stop and is_valid_base(sequence[i])){
+        char previous_character = char(toupper(sequence[i-1]));
+
+        while (i < stop and toupper(sequence[i]) == previous_character){
+            i++;
+        }
+    }
+
+    while (i < stop){
+        char character = char(toupper(sequence[i]));
+
+        if (not is_valid_base(character)){
+            i++;
+            continue;
+        }
+
+        // Runs that start in this range are followed to their end, even if it lies beyond the range
+        uint64_t run_start = i;
+        while (i < sequence.size() and toupper(sequence[i]) == character){
+            i++;
+        }
+
+        runlength_frequencies[base_to_index(character)][min(i - run_start, max_length)]++;
+    }
+}
+
+
+void count_runlengths_thread_fn(vector<reference_rle_length_histogram>& histograms_per_thread,
+                                size_t thread_index,
+                                FastaTable& sequences,
+                                vector<ReferenceRunlengthJob>& jobs,
+                                atomic<uint64_t>& job_index){
+
+    while (job_index < jobs.size()) {
+        uint64_t thread_job_index = job_index.fetch_add(1);
+
+        if (thread_job_index >= jobs.size()){
+            break;
+        }
+
+        auto& job = jobs[thread_job_index];
+        count_runlengths(histograms_per_thread[thread_index], sequences.get_sequence(job.sequence_index), job.start, job.stop);
+    }
+}
+
+
+void count_runlengths(reference_rle_length_histogram& runlength_frequencies,
+                      FastaTable& sequences,
+                      uint16_t max_threads,
+                      uint64_t chunk_size){
+
+    if (chunk_size == 0){
+        throw runtime_error("ERROR: chunk size must be greater than 0");
+    }
 
-using std::cout;
+    // Small records are one job each, and large ones (chromosomes) are split into several
+    vector<ReferenceRunlengthJob> jobs;
 
-void measure_runlength_priors_from_reference(path fasta_path, uint16_t max_runlength){
-    FastaReader reader = FastaReader(fasta_path);
-    reader.index();
+    for (size_t i=0; i<sequences.size(); i++){
+        uint64_t length = sequences.get_length(i);
 
-    reference_rle_length_matrix runlength_frequencies(boost::extents[4][max_runlength + 1]);   // 0 length included
+        for (uint64_t start=0; start<length; start+=chunk_size){
+            jobs.push_back({i, start, min(start + chunk_size, length)});
+        }
+    }
+
+    // Each thread has its own histogram, which are summed at the end
+    auto shape = runlength_frequencies.shape();
+    vector<reference_rle_length_histogram> histograms_per_thread;
+
+    for (size_t i=0; i<max_threads; i++){
+        histograms_per_thread.emplace_back(boost::extents[shape[0]][shape[1]]);
+    }
 
-    SequenceElement sequence;
-    RunlengthSequenceElement runlength_sequence;
-    while (!reader.end_of_file) {
-        reader.next_element(sequence);
-        cout << sequence.name << '\n';
+    vector<thread> threads;
+    atomic<uint64_t> job_index = 0;
+
+    try {
+        for (uint64_t i=0; i<max_threads; i++){
+            threads.emplace_back(thread(count_runlengths_thread_fn,
+                                        ref(histograms_per_thread),
+                                        i,
+                                        ref(sequences),
+                                        ref(jobs),
+                                        ref(job_index)));
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        exit(1);
+    }
+
+    for (auto& t: threads){
+        t.join();
+    }
 
-        count_runlengths(runlength_frequencies, sequence);
+    for (auto& histogram: histograms_per_thread){
+        runlength_frequencies += histogram;
     }
+}
+
+
+string reference_histogram_to_prior_string(reference_rle_length_histogram& runlength_frequencies, double pseudocount){
+    ///
+    /// Reads are sequenced from both strands, so each prior pools a base with its complement. Every length (including
+    /// 0, which never occurs) gets a pseudocount, so that no length has probability 0.
+    ///
+    ostringstream prior_string;
+    prior_string << fixed << setprecision(9);
+
+    size_t n_lengths = runlength_frequencies.shape()[1];
+
+    vector <pair <string, vector<uint8_t> > > priors = {{"AT", {0, 3}}, {"GC", {1, 2}}};
+
+    for (auto& [name, base_indexes]: priors){
+        vector<double> counts(n_lengths, pseudocount);
+        double total = 0;
+
+        for (size_t i=0; i<n_lengths; i++){
+            for (auto& b: base_indexes){
+                counts[i] += double(runlength_frequencies[b][i]);
+            }
+            total += counts[i];
+        }
+
+        prior_string << ">" << name << " prior\n";
+
+        for (size_t i=0; i<n_lengths; i++){
+            prior_string << log10(counts[i]/total);
+
+            if (i < n_lengths - 1){
+                prior_string << ",";
+            }
+        }
+
+        prior_string << "\n\n";
+    }
+
+    return prior_string.str();
+}
+
+
+path measure_runlength_priors_from_reference(path fasta_path,
+                                             path output_directory,
+                                             uint16_t max_runlength,
+                                             uint16_t max_threads,
+                                             double pseudocount){
+
+    create_directories(output_directory);
+
+    path output_path = absolute(output_directory) / (fasta_path.stem().string() + "_runlength_priors.csv");
+    ofstream output_file(output_path);
+
+    if (not output_file.is_open()){
+        throw runtime_error("ERROR: file could not be written: " + output_path.string());
+    }
+
+    cerr << "Loading sequences...\n";
+    FastaTable sequences(fasta_path, max_threads);
 
+    cerr << "Counting runlengths in " << sequences.size() << " sequences...\n";
+    reference_rle_length_histogram runlength_frequencies(boost::extents[4][max_runlength + 1]);   // 0 length included
+    count_runlengths(runlength_frequencies, sequences, max_threads);
 
-    reference_matrix_to_string(runlength_frequencies);
+    cerr << "WRITING: prior file " + output_path.string() << '\n';
 
+    output_file << reference_histogram_to_prior_string(runlength_frequencies, pseudocount);
 
+    return output_path;
 }
@@ -1,14 +1,17 @@
 #include "MarginPolishReader.hpp"
 #include "AlignedSegment.hpp"
 #include "ShastaReader.hpp"
+#include "CoverageReader.hpp"
 #include "RunnieReader.hpp"
 #include "FastaReader.hpp"
 #include "FastaWriter.hpp"
-#include "BedReader.hpp"
 #include "BamReader.hpp"
 #include "Runlength.hpp"
 #include "Matrix.hpp"
 #include "Align.hpp"
+#include "SequenceCache.hpp"
+#include "LabeledCoverageWriter.hpp"
+#include "Checkpoint.hpp"
 #include <vector>
 #include <thread>
 #include <string>
@@ -16,6 +19,8 @@
 #include <mutex>
 #include <exception>
 #include <atomic>
+#include <algorithm>
+#include <fstream>
 #include <experimental/filesystem>
 
 using std::vector;
@@ -32,10 +37,13 @@ using std::move;
 using std::exception;
 using std::atomic;
 using std::atomic_fetch_add;
+using std::make_shared;
 using std::max;
 using std::min;
 using std::experimental::filesystem::path;
 using std::experimental::filesystem::absolute;
+using std::experimental::filesystem::exists;
+using std::experimental::filesystem::remove;
 
 
 void chunk_sequences_into_regions(vector<Region>& regions, unordered_map<string,RunlengthSequenceElement>& sequences, uint64_t chunk_size){
@@ -43,10 +51,82 @@ void chunk_sequences_into_regions(vector<Region>& regions, unordered_map<string,
     /// Take all the sequences in some iterable object and chunk their lengths
     ///
 
-    // For every sequence
+    // Sort the names, so that the regions are the same in every run (or shard) regardless of the order of the map
+    vector<string> names;
+
     for (auto& [name, item]: sequences){
-        chunk_sequence(regions, name, chunk_size, item.sequence.size());
+        names.emplace_back(name);
+    }
+
+    std::sort(names.begin(), names.end());
+
+    // For every sequence
+    for (auto& name: names){
+        chunk_sequence(regions, name, chunk_size, sequences.at(name).sequence.size());
+    }
+}
+
+
+void chunk_regions(path bed_path,
+                   IntervalIndex& bed_index,
+                   vector<Region>& regions,
+                   unordered_map<string,RunlengthSequenceElement>& sequences,
+                   uint64_t chunk_size){
+
+    chunk_sequences_into_regions(regions, sequences, chunk_size);
+
+    if (bed_path.empty()){
+        return;
+    }
+
+    // Keep only the chunks that contain BED intervals. Within each chunk, only the alignments that overlap those
+    // intervals are fetched (see initialize_chunk).
+    bed_index = IntervalIndex(bed_path);
+
+    vector<Region> bed_regions;
+    vector<Region> chunks;
+
+    for (auto& region: regions){
+        // Chunk stops are inclusive
+        bed_regions.clear();
+        bed_index.get_merged_regions(bed_regions, region.name, region.start, region.stop + 1);
+
+        if (not bed_regions.empty()){
+            chunks.emplace_back(region);
+        }
+    }
+
+    regions = move(chunks);
+}
+
+
+void initialize_chunk(BamReader& bam_reader, const Region& chunk){
+    ///
+    /// Chunks tile each contig, with inclusive stops, so an alignment belongs to the chunk containing its start
+    ///
+    string name = chunk.name;
+
+    bam_reader.initialize_region(name, chunk.start, chunk.stop + 1);
+    bam_reader.skip_alignments_before(chunk.start);
+}
+
+
+void initialize_chunk(BamReader& bam_reader, const IntervalIndex& bed_index, const Region& chunk, vector<Region>& bed_regions){
+    ///
+    /// With a BED, only alignments overlapping the BED intervals in the chunk are fetched, and an alignment that starts
+    /// before the chunk belongs to it unless it covers a BED position before the chunk, i.e. unless it starts before
+    /// the furthest stop of the earlier BED intervals.
+    ///
+    if (bed_index.empty()){
+        initialize_chunk(bam_reader, chunk);
+        return;
     }
+
+    bed_regions.clear();
+    bed_index.get_merged_regions(bed_regions, chunk.name, chunk.start, chunk.stop + 1);
+    bam_reader.initialize_regions(bed_regions);
+
+    bam_reader.skip_alignments_before(min(chunk.start, bed_index.get_max_stop(chunk.name, chunk.start)));
 }
 
 
@@ -72,6 +152,11 @@ void write_length_matrix_to_file(path output_directory, rle_length_matrix& matri
 
     directional_matrix_file << (matrix_to_string(matrix));
     nondirectional_matrix_file << (matrix_to_string(nondirectional_matrix));
+
+    path binary_matrix_path = absolute(output_directory) / "length_frequency_matrix_directional.bin";
+    cerr << "WRITING: matrix file " + binary_matrix_path.string() << '\n';
+
+    write_matrix_to_binary_file(binary_matrix_path, matrix);
 }
 
 
@@ -97,6 +182,11 @@ void write_base_matrix_to_file(path output_directory, rle_base_matrix& matrix){
 
     directional_matrix_file << (matrix_to_string(matrix));
     nondirectional_matrix_file << (matrix_to_string(nondirectional_matrix));
+
+    path binary_matrix_path = absolute(output_directory) / "base_frequency_matrix_directional.bin";
+    cerr << "WRITING: matrix file " + binary_matrix_path.string() << '\n';
+
+    write_matrix_to_binary_file(binary_matrix_path, matrix);
 }
 
 
@@ -200,13 +290,9 @@ path runlength_encode_fasta_file(path input_file_path,
     // This writer is mutexed across threads
     FastaWriter fasta_writer(output_file_path);
 
-    // Get index
-    unordered_map <string, FastaIndex> read_indexes;
-    fasta_reader.get_indexes_mapped_by_name(read_indexes);
-
-    // Convert the map object into an indexable object
+    // Get index, as an indexable object
     vector <pair <string, FastaIndex> > read_index_vector;
-    get_vector_from_index_map(read_index_vector, read_indexes);
+    fasta_reader.get_indexes(read_index_vector);
 
     mutex map_mutex;
     mutex file_write_mutex;
@@ -310,65 +396,13 @@ void update_runlength_matrix(AlignedSegment& aligned_segment,
 }
 
 
-ofstream& operator<<(ofstream& output_file, vector<CoverageElement>& coverage_data){
-    for (auto &coverage_element: coverage_data) {
-        output_file << coverage_element.base +
-        to_string(coverage_element.length) +
-        CoverageElement::reversal_string_plus_minus[coverage_element.reversal] + ' ' +
-        to_string(uint32_t(coverage_element.weight)) + ',';
-    }
-
-    return output_file;
-}
-
-
-char bool_to_vertex_label(bool is_vertex){
-    if (is_vertex){
-        return 'v';
-    }
-    else{
-        return 'e';
-    }
-}
-
-
-char bool_to_reversal_char(bool reversal){
-    if (reversal){
-        return '-';
-    }
-    else{
-        return '+';
-    }
-}
-
-
-void write_labeled_coverage_data(
-        ofstream& output_file,
-        string true_base,
-        uint16_t true_length,
-        char consensus_base,
-        uint16_t consensus_length,
-        vector<CoverageElement>& coverage_data,
-        bool is_vertex,
-        bool reversal){
-
-    if (reversal and consensus_base != '_'){
-        consensus_base = complement_base(consensus_base);
-    }
-
-    output_file << bool_to_reversal_char(reversal) << ',' << true_base << ',' << true_length << ',' << consensus_base << ',' << consensus_length << ',';
-    output_file << coverage_data << " ";
-    output_file << bool_to_vertex_label(is_vertex);
-    output_file << '\n';
-}
-
-
 template<typename T> void label_aligned_coverage(path bam_path,
                                                  path parent_directory,
                                                  unordered_map <string,path>& read_paths,
                                                  unordered_map <string,RunlengthSequenceElement>& ref_runlength_sequences,
                                                  vector <Region>& regions,
-                                                 path output_directory,
+                                                 IntervalIndex& bed_index,
+                                                 LabeledCoverageWriter& writer,
                                                  uint16_t insert_cutoff,
                                                  atomic <uint64_t>& job_index){
     ///
@@ -382,6 +416,9 @@ template<typename T> void label_aligned_coverage(path bam_path,
     CoverageSegment segment;
     reader.set_index(read_paths);
 
+    // Each thread formats its output into its own buffer, which is reused for every alignment
+    LabeledCoverageBuffer output_buffer(writer);
+
     // Initialize BAM reader and relevant containers
     BamReader bam_reader = BamReader(bam_path);
     AlignedSegment aligned_segment;
@@ -396,14 +433,14 @@ template<typename T> void label_aligned_coverage(path bam_path,
     uint16_t map_quality_cutoff = 5;
 
     // Volatiles
-    bool in_left_bound;
-    bool in_right_bound;
-    string true_base;
+    bool in_bed;
+    vector<Region> bed_regions;
+    char true_base = '_';
     char consensus_base = '_';
     uint16_t consensus_length = -1;
     uint16_t true_length = -1;
     bool is_vertex = false;
-    vector<CoverageElement> coverage_data;
+    CoveragePileup coverage_data;
 
     uint8_t match_code = Cigar::cigar_code_key.at("=");
     uint8_t mismatch_code = Cigar::cigar_code_key.at("X");
@@ -418,32 +455,44 @@ template<typename T> void label_aligned_coverage(path bam_path,
 
     while (job_index < regions.size()) {
         uint64_t thread_job_index = job_index.fetch_add(1);
+
+        if (thread_job_index >= regions.size()){
+            break;
+        }
+
         region = regions.at(thread_job_index);
 
-        // BAM coords are 1 based
-        bam_reader.initialize_region(region.name, region.start+1, region.stop+1);
+        // Fetch only the alignments that belong to this region, each of which is walked in full
+        initialize_chunk(bam_reader, bed_index, region, bed_regions);
 
         int i = 0;
 
         while (bam_reader.next_alignment(aligned_segment, map_quality_cutoff, filter_secondary)) {
             reader.fetch_read(segment, aligned_segment.read_name);
 
-            int64_t read_start = max(int64_t(aligned_segment.ref_start_index), int64_t(region.start));
-            int64_t read_stop = min(int64_t(aligned_segment.infer_reference_stop_position_from_alignment()), int64_t(region.stop));
+            // The BED intervals that the whole alignment overlaps (the fetch has already used the ones in this region)
+            if (not bed_index.empty()){
+                bed_regions.clear();
+                bed_index.get_merged_regions(bed_regions,
+                                             aligned_segment.ref_name,
+                                             aligned_segment.ref_start_index - 1,
+                                             aligned_segment.infer_reference_stop_position_from_alignment());
+            }
+
+            int64_t read_start = aligned_segment.ref_start_index;
+            int64_t read_stop = aligned_segment.infer_reference_stop_position_from_alignment();
             string read_region = region.name + "_" + to_string(read_start) + "-" + to_string(read_stop);
 
-            path output_path = output_directory / (aligned_segment.read_name + "_" + read_region + ".csv");
-            output_path = absolute(output_path);
-            ofstream output_file(output_path);
+            string record_name = aligned_segment.read_name + "_" + read_region;
+            output_buffer.start_record(record_name);
 
             // Iterate cigars that match the criteria
             while (aligned_segment.next_coordinate(coordinate, cigar, valid_cigar_codes)) {
-                in_left_bound = (int64_t(region.start) <= coordinate.ref_index - 1);
-                in_right_bound = (coordinate.ref_index - 1 < int64_t(region.stop));
+                in_bed = bed_index.empty() or contains_position(bed_regions, coordinate.ref_index);
 
-                // Subset alignment to portions of the read that are within the window/region
-                if (in_left_bound and in_right_bound) {
-                    coverage_data = segment.coverage_data[coordinate.read_true_index];
+                // With a BED, only count the positions in its intervals
+                if (in_bed) {
+                    coverage_data = segment.get_pileup(coordinate.read_true_index);
 
                     /// MATCH OR MISMATCH
                     if (cigar.code == match_code or cigar.code == mismatch_code) {
@@ -475,23 +524,25 @@ template<typename T> void label_aligned_coverage(path bam_path,
                         is_vertex = false;
                     }
 
-                    write_labeled_coverage_data(
-                            output_file,
+                    output_buffer.write_line(
+                            aligned_segment.reversal,
                             true_base,
                             true_length,
                             consensus_base,
                             consensus_length,
                             coverage_data,
-                            is_vertex,
-                            aligned_segment.reversal);
+                            is_vertex);
                 }
             }
 
-            cerr << "\33[2K\rParsed: " << output_path << flush;
+            output_buffer.end_record();
+            cerr << "\33[2K\rParsed: " << record_name << flush;
 
             i++;
         }
     }
+
+    output_buffer.close();
 }
 
 
@@ -502,6 +553,8 @@ void parse_aligned_runnie(path bam_path,
                           unordered_map <string,RunlengthSequenceElement>& ref_runlength_sequences,
                           vector <Region>& regions,
                           rle_length_matrix& runlength_matrix,
+                          Checkpoint& checkpoint,
+                          uint16_t thread_index,
                           atomic <uint64_t>& job_index){
     ///
     ///
@@ -528,8 +581,6 @@ void parse_aligned_runnie(path bam_path,
     uint16_t map_quality_cutoff = 5;
 
     // Volatiles
-    bool in_left_bound;
-    bool in_right_bound;
     string true_base;
     string observed_base;
     string consensus_base;
@@ -544,10 +595,20 @@ void parse_aligned_runnie(path bam_path,
 
     while (job_index < regions.size()) {
         uint64_t thread_job_index = job_index.fetch_add(1);
+
+        if (thread_job_index >= regions.size()){
+            break;
+        }
+
+        // Skip the regions that were completed before the run was resumed
+        if (checkpoint.is_completed(thread_job_index)){
+            continue;
+        }
+
         region = regions.at(thread_job_index);
 
-        // BAM coords are 1 based
-        bam_reader.initialize_region(region.name, region.start+1, region.stop+1);
+        // Fetch only the alignments that belong to this region, each of which is walked in full
+        initialize_chunk(bam_reader, region);
 
         int i = 0;
 
@@ -556,38 +617,36 @@ void parse_aligned_runnie(path bam_path,
 
             // Iterate cigars that match the criteria (must be '=')
             while (aligned_segment.next_coordinate(coordinate, cigar, valid_cigar_codes)) {
-                in_left_bound = (int64_t(region.start) <= coordinate.ref_index - 1);
-                in_right_bound = (coordinate.ref_index - 1 < int64_t(region.stop));
-
-                // Subset alignment to portions of the read that are within the window/region
-                if (in_left_bound and in_right_bound) {
-                    true_base = ref_runlength_sequences.at(aligned_segment.ref_name).sequence[coordinate.ref_index];
-
-                    // Skip anything other than ACTG
-                    if (not is_valid_base(true_base)){
-                        continue;
-                    }
+                true_base = ref_runlength_sequences.at(aligned_segment.ref_name).sequence[coordinate.ref_index];
 
-                    true_length = ref_runlength_sequences.at(aligned_segment.ref_name).lengths[coordinate.ref_index];
-                    observed_base = runnie_sequence.sequence[coordinate.read_true_index];
-                    observed_base_index = base_to_index(true_base);
-                    scale = runnie_sequence.scales[coordinate.read_true_index];
-                    shape = runnie_sequence.shapes[coordinate.read_true_index];
+                // Skip anything other than ACTG
+                if (not is_valid_base(true_base)){
+                    continue;
+                }
 
-                    if (true_length >= max_true_length){
-                        continue;
-                    }
+                true_length = ref_runlength_sequences.at(aligned_segment.ref_name).lengths[coordinate.ref_index];
+                observed_base = runnie_sequence.sequence[coordinate.read_true_index];
+                observed_base_index = base_to_index(true_base);
+                scale = runnie_sequence.scales[coordinate.read_true_index];
+                shape = runnie_sequence.shapes[coordinate.read_true_index];
 
-                    update_runlength_matrix_with_weibull_probabilities(runlength_matrix, aligned_segment.reversal, observed_base_index, true_length, scale, shape);
+                if (true_length >= max_true_length){
+                    continue;
                 }
+
+                update_runlength_matrix_with_weibull_probabilities(runlength_matrix, aligned_segment.reversal, observed_base_index, true_length, scale, shape);
             }
 
             i++;
         }
 
         cerr << "\33[2K\rParsed: " << region.to_string() << flush;
+
+        checkpoint.update(thread_index, thread_job_index, runlength_matrix);
     }
 
+    checkpoint.save(thread_index, runlength_matrix);
+
 }
 
 
@@ -596,7 +655,10 @@ template<typename T> void parse_aligned_coverage(path bam_path,
                                                  unordered_map <string,path>& read_paths,
                                                  unordered_map <string,RunlengthSequenceElement>& ref_runlength_sequences,
                                                  vector <Region>& regions,
+                                                 IntervalIndex& bed_index,
                                                  rle_length_matrix& runlength_matrix,
+                                                 Checkpoint& checkpoint,
+                                                 uint16_t thread_index,
                                                  atomic <uint64_t>& job_index){
     ///
     ///
@@ -625,46 +687,64 @@ template<typename T> void parse_aligned_coverage(path bam_path,
     uint16_t map_quality_cutoff = 5;
 
     // Volatiles
-    bool in_left_bound;
-    bool in_right_bound;
+    bool in_bed;
+    vector<Region> bed_regions;
     string true_base;
     char consensus_base;
     uint16_t true_length = -1;
     uint16_t observed_length = -1;
     uint8_t observed_base_index;
-    vector<CoverageElement> coverage_data;
+    CoveragePileup coverage_data;
 
     // Only allow matches
     unordered_set<uint8_t> valid_cigar_codes = {Cigar::cigar_code_key.at("=")};
 
     while (job_index < regions.size()) {
         uint64_t thread_job_index = job_index.fetch_add(1);
+
+        if (thread_job_index >= regions.size()){
+            break;
+        }
+
+        // Skip the regions that were completed before the run was resumed
+        if (checkpoint.is_completed(thread_job_index)){
+            continue;
+        }
+
         region = regions.at(thread_job_index);
 
-        // BAM coords are 1 based
-        bam_reader.initialize_region(region.name, region.start+1, region.stop+1);
+        // Fetch only the alignments that belong to this region, each of which is walked in full
+        initialize_chunk(bam_reader, bed_index, region, bed_regions);
 
         int i = 0;
 
         while (bam_reader.next_alignment(aligned_segment, map_quality_cutoff, filter_secondary)) {
             reader.fetch_read(segment, aligned_segment.read_name);
 
+            // The BED intervals that the whole alignment overlaps (the fetch has already used the ones in this region)
+            if (not bed_index.empty()){
+                bed_regions.clear();
+                bed_index.get_merged_regions(bed_regions,
+                                             aligned_segment.ref_name,
+                                             aligned_segment.ref_start_index - 1,
+                                             aligned_segment.infer_reference_stop_position_from_alignment());
+            }
+
             // Iterate cigars that match the criteria (must be '=')
             while (aligned_segment.next_coordinate(coordinate, cigar, valid_cigar_codes)) {
-                in_left_bound = (int64_t(region.start) <= coordinate.ref_index - 1);
-                in_right_bound = (coordinate.ref_index - 1 < int64_t(region.stop));
+                in_bed = bed_index.empty() or contains_position(bed_regions, coordinate.ref_index);
 
                 true_base = ref_runlength_sequences.at(aligned_segment.ref_name).sequence[coordinate.ref_index];
                 consensus_base = segment.sequence[coordinate.read_true_index];
 
-                // Subset alignment to portions of the read that are within the window/region
-                if (in_left_bound and in_right_bound) {
+                // With a BED, only count the positions in its intervals
+                if (in_bed) {
                     true_length = ref_runlength_sequences.at(aligned_segment.ref_name).lengths[coordinate.ref_index];
-                    coverage_data = segment.coverage_data[coordinate.read_true_index];
+                    coverage_data = segment.get_pileup(coordinate.read_true_index);
 
                     // Walk through all the coverage data for this position and update the matrix for each observation
                     // Only matches are allowed so checking the read base effectively checks the true base
-                    for (auto& coverage_element: coverage_data){
+                    for (auto coverage_element: coverage_data){
 
                         // Skip anything other than ACTG
                         if (not coverage_element.is_conventional_base()){
@@ -692,20 +772,30 @@ template<typename T> void parse_aligned_coverage(path bam_path,
         }
 
         cerr << "\33[2K\rParsed: " << region.to_string() << flush;
+
+        checkpoint.update(thread_index, thread_job_index, runlength_matrix);
     }
+
+    checkpoint.save(thread_index, runlength_matrix);
 }
 
 
 void parse_aligned_fasta(path bam_path,
         path reads_fasta_path,
         FastaReader& index_donor,
+        SequenceCache<RunlengthSequenceElement>& read_cache,
         unordered_map <string,RunlengthSequenceElement>& ref_runlength_sequences,
         vector <Region>& regions,
         RLEConfusion& runlength_matrix,
         size_t k,
+        Checkpoint& checkpoint,
+        uint16_t thread_index,
         atomic <uint64_t>& job_index){
     ///
-    ///
+    /// The alignments of each region are collected before any reads are fetched, so that the reads which aren't
+    /// already in the (shared) cache can be fetched in the order they appear in the FASTA. Reads with several
+    /// alignments in a region, or alignments in several regions, are only fetched and encoded once while they remain
+    /// in the cache.
     ///
 
     if (not k%2 == 1){
@@ -715,9 +805,14 @@ void parse_aligned_fasta(path bam_path,
     // Initialize FastaReader and relevant containers
     FastaReader fasta_reader = FastaReader(reads_fasta_path);
     SequenceElement sequence;
-    RunlengthSequenceElement runlength_sequence;
     fasta_reader.adopt_index(index_donor);
 
+    // Containers for the alignments in a region and the reads they need
+    vector<AlignedSegment> alignments;
+    unordered_map <string, shared_ptr<const RunlengthSequenceElement> > region_reads;
+    vector<string> uncached_read_names;
+    vector <pair <string, FastaIndex> > uncached_read_indexes;
+
     // Initialize BAM reader and relevant containers
     BamReader bam_reader = BamReader(bam_path);
     AlignedSegment aligned_segment;
@@ -734,9 +829,7 @@ void parse_aligned_fasta(path bam_path,
     bool filter_secondary = true;
     uint16_t map_quality_cutoff = 10;
 
-    bool in_left_bound;
-    bool in_right_bound;
-    char true_base;
+    char true_base = '_';
     char observed_base;
 
     size_t flank_size = k/2;
@@ -751,83 +844,118 @@ void parse_aligned_fasta(path bam_path,
 
     while (job_index < regions.size()) {
         uint64_t thread_job_index = job_index.fetch_add(1);
+
+        if (thread_job_index >= regions.size()){
+            break;
+        }
+
+        // Skip the regions that were completed before the run was resumed
+        if (checkpoint.is_completed(thread_job_index)){
+            continue;
+        }
+
         region = regions.at(thread_job_index);
 
         cerr << "\33[2K\rParsing: " << region.to_string() << flush;
 
-        // BAM coords are 1 based
-        bam_reader.initialize_region(region.name, region.start+1, region.stop+1);
+        // Fetch only the alignments that belong to this region, each of which is walked in full
+        initialize_chunk(bam_reader, region);
 
-        int i = 0;
+        alignments.clear();
+        region_reads.clear();
+        uncached_read_names.clear();
 
         while (bam_reader.next_alignment(aligned_segment, map_quality_cutoff, filter_secondary)) {
-            fasta_reader.get_sequence(sequence, aligned_segment.read_name);
-            runlength_encode(runlength_sequence, sequence);
+            alignments.emplace_back(aligned_segment);
+
+            // Hold a reference to every read in the region, so that they can't be evicted before they are used
+            if (region_reads.count(aligned_segment.read_name) == 0){
+                auto cached_sequence = read_cache.find(aligned_segment.read_name);
+
+                if (not cached_sequence){
+                    uncached_read_names.emplace_back(aligned_segment.read_name);
+                }
+
+                region_reads.emplace(aligned_segment.read_name, cached_sequence);
+            }
+        }
+
+        // Fetch the missing reads in the order they appear in the FASTA, so that the file is read sequentially
+        fasta_reader.get_indexes_in_file_order(uncached_read_names, uncached_read_indexes);
+
+        for (auto& [read_name, fasta_index]: uncached_read_indexes){
+            fasta_reader.get_sequence(sequence, read_name, fasta_index.byte_index);
+
+            auto runlength_sequence = make_shared<RunlengthSequenceElement>();
+            runlength_encode(*runlength_sequence, sequence);
+
+            read_cache.insert(read_name, runlength_sequence);
+            region_reads.at(read_name) = runlength_sequence;
+        }
+
+        for (auto& aligned_segment: alignments) {
+            const RunlengthSequenceElement& runlength_sequence = *region_reads.at(aligned_segment.read_name);
 
             // Iterate cigars that match the criteria (must be '=')
             while (aligned_segment.next_coordinate(coordinate, cigar, valid_cigar_codes)) {
-                in_left_bound = (int64_t(region.start) <= coordinate.ref_index - 1);
-                in_right_bound = (coordinate.ref_index - 1 < int64_t(region.stop));
-
                 string& ref_seq = ref_runlength_sequences.at(aligned_segment.ref_name).sequence;
 
-                // Subset alignment to portions of the read that are within the window/region
-                if (in_left_bound and in_right_bound) {
-                    true_length = ref_runlength_sequences.at(aligned_segment.ref_name).lengths[coordinate.ref_index];
+                true_length = ref_runlength_sequences.at(aligned_segment.ref_name).lengths[coordinate.ref_index];
 
-                    true_base = ref_seq[coordinate.ref_index];
-                    observed_base = runlength_sequence.sequence[coordinate.read_true_index];
+                true_base = ref_seq[coordinate.ref_index];
+                observed_base = runlength_sequence.sequence[coordinate.read_true_index];
 
-                    // At this stage the subcigar index is offset by +1
-                    size_t c_i = aligned_segment.subcigar_index;
+                // At this stage the subcigar index is offset by +1
+                size_t c_i = aligned_segment.subcigar_index;
 
-                    bool full_match = true;
+                bool full_match = true;
 
-                    // If it's not a '=' operation, it's not a match
-                    if (cigar.code != Cigar::cigar_code_key.at("=")){
+                // If it's not a '=' operation, it's not a match
+                if (cigar.code != Cigar::cigar_code_key.at("=")){
+                    full_match = false;
+                }
+                else {
+                    // Only count positions where a full k-mer matches
+                    // If the cigar operation is shorter than the k-mer, it can't be a full match
+                    if (cigar.length < k) {
                         full_match = false;
                     }
-                    else {
-                        // Only count positions where a full k-mer matches
-                        // If the cigar operation is shorter than the k-mer, it can't be a full match
-                        if (cigar.length < k) {
-                            full_match = false;
-                        }
-                        // If the kmer bounds aren't fully inside the '=' operation, it's not a full match.
-                        else if ((c_i - 1 < flank_size) or (cigar.length - c_i < flank_size)) {
-                            full_match = false;
-                        }
-                    }
-
-                    // Skip anything other than ACTG
-                    if (not is_valid_base(true_base)){
-                        continue;
+                    // If the kmer bounds aren't fully inside the '=' operation, it's not a full match.
+                    else if ((c_i - 1 < flank_size) or (cigar.length - c_i < flank_size)) {
+                        full_match = false;
                     }
+                }
 
-                    // Skip anything other than ACTG
-                    if (not is_valid_base(observed_base)){
-                        continue;
-                    }
+                // Skip anything other than ACTG
+                if (not is_valid_base(true_base)){
+                    continue;
+                }
 
-                    observed_length = runlength_sequence.lengths[coordinate.read_true_index];
-                    observed_base_index = base_to_index(observed_base);
-                    true_base_index = base_to_index(true_base);
+                // Skip anything other than ACTG
+                if (not is_valid_base(observed_base)){
+                    continue;
+                }
 
-                    if (observed_length >= max_observed_length or true_length >= max_true_length){
-                        continue;
-                    }
+                observed_length = runlength_sequence.lengths[coordinate.read_true_index];
+                observed_base_index = base_to_index(observed_base);
+                true_base_index = base_to_index(true_base);
 
-                    if (full_match) {
-                        runlength_matrix.length_matrix[aligned_segment.reversal][true_base_index][true_length][observed_length] += 1;
-                    }
+                if (observed_length >= max_observed_length or true_length >= max_true_length){
+                    continue;
+                }
 
-                    runlength_matrix.base_matrix[aligned_segment.reversal][true_base_index][observed_base_index] += 1;
+                if (full_match) {
+                    runlength_matrix.length_matrix[aligned_segment.reversal][true_base_index][true_length][observed_length] += 1;
                 }
-            }
 
-            i++;
+                runlength_matrix.base_matrix[aligned_segment.reversal][true_base_index][observed_base_index] += 1;
+            }
         }
+
+        checkpoint.update(thread_index, thread_job_index, runlength_matrix);
     }
+
+    checkpoint.save(thread_index, runlength_matrix);
 }
 
 
@@ -837,12 +965,16 @@ template <typename T> void get_coverage_labels(path bam_path,
                                        unordered_map <string,path>& read_paths,
                                        unordered_map <string,RunlengthSequenceElement>& ref_runlength_sequences,
                                        vector <Region>& regions,
+                                       IntervalIndex& bed_index,
                                        uint16_t insert_cutoff,
-                                       uint16_t max_threads){
+                                       uint16_t max_threads,
+                                       bool single_file){
     ///
     ///
     ///
 
+    LabeledCoverageWriter writer(output_directory, single_file);
+
     vector<thread> threads;
     atomic<uint64_t> job_index = 0;
 
@@ -856,7 +988,8 @@ template <typename T> void get_coverage_labels(path bam_path,
                                         ref(read_paths),
                                         ref(ref_runlength_sequences),
                                         ref(regions),
-                                        ref(output_directory),
+                                        ref(bed_index),
+                                        ref(writer),
                                         ref(insert_cutoff),
                                         ref(job_index)));
         } catch (const exception &e) {
@@ -880,6 +1013,7 @@ rle_length_matrix get_runnie_runlength_matrix(path bam_path,
                                               unordered_map <string,RunlengthSequenceElement>& ref_runlength_sequences,
                                               vector <Region>& regions,
                                               uint16_t max_runlength,
+                                              Checkpoint& checkpoint,
                                               uint16_t max_threads){
     ///
     ///
@@ -902,6 +1036,8 @@ rle_length_matrix get_runnie_runlength_matrix(path bam_path,
                                         ref(ref_runlength_sequences),
                                         ref(regions),
                                         ref(matrices_per_thread[i]),
+                                        ref(checkpoint),
+                                        i,
                                         ref(job_index)));
         } catch (const exception &e) {
             cerr << e.what() << "\n";
@@ -919,6 +1055,9 @@ rle_length_matrix get_runnie_runlength_matrix(path bam_path,
 
     rle_length_matrix matrix_sum = sum_matrices(matrices_per_thread);
 
+    // Add the results of the regions that were completed before the run was resumed
+    checkpoint.load(matrix_sum);
+
     return matrix_sum;
 }
 
@@ -929,7 +1068,9 @@ template <typename T> rle_length_matrix get_runlength_matrix(
         unordered_map <string,path>& read_paths,
         unordered_map <string,RunlengthSequenceElement>& ref_runlength_sequences,
         vector <Region>& regions,
+        IntervalIndex& bed_index,
         uint16_t max_runlength,
+        Checkpoint& checkpoint,
         uint16_t max_threads){
     ///
     ///
@@ -951,7 +1092,10 @@ template <typename T> rle_length_matrix get_runlength_matrix(
                                         ref(read_paths),
                                         ref(ref_runlength_sequences),
                                         ref(regions),
+                                        ref(bed_index),
                                         ref(matrices_per_thread[i]),
+                                        ref(checkpoint),
+                                        i,
                                         ref(job_index)));
         } catch (const exception &e) {
             cerr << e.what() << "\n";
@@ -969,6 +1113,9 @@ template <typename T> rle_length_matrix get_runlength_matrix(
 
     rle_length_matrix matrix_sum = sum_matrices(matrices_per_thread);
 
+    // Add the results of the regions that were completed before the run was resumed
+    checkpoint.load(matrix_sum);
+
     return matrix_sum;
 }
 
@@ -980,7 +1127,9 @@ RLEConfusion get_fasta_runlength_matrix(path bam_path,
                                        vector <Region>& regions,
                                        size_t k,
                                        uint16_t max_runlength,
-                                       uint16_t max_threads){
+                                       Checkpoint& checkpoint,
+                                       uint16_t max_threads,
+                                       uint64_t max_cached_bases=200*1000*1000){
     ///
     ///
     ///
@@ -988,6 +1137,9 @@ RLEConfusion get_fasta_runlength_matrix(path bam_path,
     RLEConfusion template_object(max_runlength);   // 0 length included
     vector<RLEConfusion> matrices_per_thread(max_threads, template_object);
 
+    // RLE reads shared by all threads, since neighboring regions (often parsed concurrently) share many reads
+    SequenceCache<RunlengthSequenceElement> read_cache(max_cached_bases);
+
     vector<thread> threads;
     atomic<uint64_t> job_index = 0;
 
@@ -999,10 +1151,13 @@ RLEConfusion get_fasta_runlength_matrix(path bam_path,
                                         ref(bam_path),
                                         ref(reads_fasta_path),
                                         ref(index_donor),
+                                        ref(read_cache),
                                         ref(ref_runlength_sequences),
                                         ref(regions),
                                         ref(matrices_per_thread[i]),
                                         k,
+                                        ref(checkpoint),
+                                        i,
                                         ref(job_index)));
         } catch (const exception &e) {
             cerr << e.what() << "\n";
@@ -1016,10 +1171,15 @@ RLEConfusion get_fasta_runlength_matrix(path bam_path,
     }
     cerr << "\n" << flush;
 
+    cerr << "Read cache hits: " << read_cache.n_hits << ", misses: " << read_cache.n_misses << '\n';
+
     cerr << "Summing matrices from " << max_threads << " threads...\n";
 
     RLEConfusion matrix_sum = sum_matrices(matrices_per_thread);
 
+    // Add the results of the regions that were completed before the run was resumed
+    checkpoint.load(matrix_sum);
+
     return matrix_sum;
 }
 
@@ -1029,14 +1189,16 @@ template <typename T> void measure_runlength_distribution_from_coverage_data(pat
                                                        path output_directory,
                                                        uint16_t max_runlength,
                                                        uint16_t max_threads,
-                                                       path bed_path){
+                                                       path bed_path,
+                                                       bool resume,
+                                                       double checkpoint_interval){
 
     cerr << "Using " + to_string(max_threads) + " threads\n";
 
-    // How big (bp) should the regions be for iterating the BAM? Regardless of size,
-    // only one alignment worth of RAM is consumed per chunk. This value should be chosen as an appropriate
-    // fraction of the genome size to prevent threads from being starved. Larger chunks also reduce overhead
-    // associated with iterating reads that extend beyond the region (at the edges)
+    // How big (bp) should the regions be for iterating the BAM? Each thread holds one alignment and the data of its
+    // read at a time, regardless of size. This value should be chosen as an appropriate fraction of the genome size to
+    // prevent threads from being starved. Larger chunks also reduce overhead associated with iterating reads that
+    // extend beyond the region (at the edges)
     uint64_t chunk_size = 1*1000*1000;
 
     T reader = T(input_directory);
@@ -1098,21 +1260,12 @@ template <typename T> void measure_runlength_distribution_from_coverage_data(pat
     // If a BED file was provided, only iterate the regions of the BAM that may be found in the reference provided.
     // Otherwise, iterate the entire BAM.
     vector<Region> regions;
-    if (bed_path.empty()){
-        // Chunk alignment regions
-        chunk_sequences_into_regions(regions, ref_runlength_sequences, chunk_size);
-    }
-    else{
-        // Load the BED regions, and then find the union of the regions in BED and reference FASTA
-        set<string> names;
-        for (auto& item: ref_runlength_sequences){
-            names.insert(item.first);
-        }
+    IntervalIndex bed_index;
+    chunk_regions(bed_path, bed_index, regions, ref_runlength_sequences, chunk_size);
 
-        BedReader bed_reader(bed_path);
-        bed_reader.read_regions(regions);
-        bed_reader.subset_by_regions_name(regions, names);
-    }
+    // Save partial results periodically, and skip the regions that were completed by a previous run if resuming
+    Checkpoint checkpoint(output_directory, regions, {input_directory, reference_fasta_path},
+                          max_threads, resume, checkpoint_interval);
 
     cerr << "Iterating alignments...\n" << std::flush;
 
@@ -1122,13 +1275,18 @@ template <typename T> void measure_runlength_distribution_from_coverage_data(pat
                                                        read_paths,
                                                        ref_runlength_sequences,
                                                        regions,
+                                                       bed_index,
                                                        max_runlength,
+                                                       checkpoint,
                                                        max_threads);
 
     cerr << '\n';
 
     // Write output
     write_length_matrix_to_file(output_directory, matrix);
+
+    // The output is complete, so the partial results are no longer needed
+    checkpoint.remove_files();
 }
 
 
@@ -1136,14 +1294,16 @@ void measure_runlength_distribution_from_runnie(path runnie_directory,
         path reference_fasta_path,
         path output_directory,
         uint16_t max_runlength,
-        uint16_t max_threads){
+        uint16_t max_threads,
+        bool resume,
+        double checkpoint_interval){
 
     cerr << "Using " + to_string(max_threads) + " threads\n";
 
-    // How big (bp) should the regions be for iterating the BAM? Regardless of size,
-    // only one alignment worth of RAM is consumed per chunk. This value should be chosen as an appropriate
-    // fraction of the genome size to prevent threads from being starved. Larger chunks also reduce overhead
-    // associated with iterating reads that extend beyond the region (at the edges)
+    // How big (bp) should the regions be for iterating the BAM? Each thread holds one alignment and the data of its
+    // read at a time, regardless of size. This value should be chosen as an appropriate fraction of the genome size to
+    // prevent threads from being starved. Larger chunks also reduce overhead associated with iterating reads that
+    // extend beyond the region (at the edges)
     uint64_t chunk_size = 1*1000*1000;
 
     RunnieReader runnie_reader = RunnieReader(runnie_directory);
@@ -1205,6 +1365,10 @@ void measure_runlength_distribution_from_runnie(path runnie_directory,
     vector<Region> regions;
     chunk_sequences_into_regions(regions, ref_runlength_sequences, chunk_size);
 
+    // Save partial results periodically, and skip the regions that were completed by a previous run if resuming
+    Checkpoint checkpoint(output_directory, regions, {runnie_directory, reference_fasta_path},
+                          max_threads, resume, checkpoint_interval);
+
     cerr << "Iterating alignments...\n" << std::flush;
 
     // Launch threads for parsing alignments and generating matrices
@@ -1214,12 +1378,16 @@ void measure_runlength_distribution_from_runnie(path runnie_directory,
                                                            ref_runlength_sequences,
                                                            regions,
                                                            max_runlength,
+                                                           checkpoint,
                                                            max_threads);
 
     cerr << '\n';
 
     // Write output
     write_length_matrix_to_file(output_directory, matrix);
+
+    // The output is complete, so the partial results are no longer needed
+    checkpoint.remove_files();
 }
 
 
@@ -1231,14 +1399,16 @@ void measure_runlength_distribution_from_fasta(
         uint16_t max_threads,
         size_t minimum_match_length,
         string minimap_preset,
-        uint16_t minimap_k){
+        uint16_t minimap_k,
+        bool resume,
+        double checkpoint_interval){
 
     cerr << "Using " + to_string(max_threads) + " threads\n";
 
-    // How big (bp) should the regions be for iterating the BAM? Regardless of size,
-    // only one alignment worth of RAM is consumed per chunk. This value should be chosen as an appropriate
-    // fraction of the genome size to prevent threads from being starved. Larger chunks also reduce overhead
-    // associated with iterating reads that extend beyond the region (at the edges)
+    // How big (bp) should the regions be for iterating the BAM? Each thread holds every alignment of its region, and
+    // every RLE read they need (even if evicted from the shared read cache), so memory grows with chunk size x depth.
+    // This value should be chosen as an appropriate fraction of the genome size to prevent threads from being starved.
+    // Larger chunks also reduce overhead associated with iterating reads that extend beyond the region (at the edges)
     uint64_t chunk_size = 1*1000*1000;
 //    uint64_t chunk_size = 1*1000;
 //    cerr << "WARNING USING 1000bp chunks!\n";
@@ -1294,9 +1464,13 @@ void measure_runlength_distribution_from_fasta(
     vector<Region> regions;
     chunk_sequences_into_regions(regions, ref_runlength_sequences, chunk_size);
 
+    // Save partial results periodically, and skip the regions that were completed by a previous run if resuming
+    Checkpoint checkpoint(output_directory, regions, {reads_fasta_path, reference_fasta_path},
+                          max_threads, resume, checkpoint_interval);
+
     cerr << "Iterating alignments...\n" << std::flush;
 
-    reads_fasta_reader.index();
+    reads_fasta_reader.index(max_threads);
 
     // Launch threads for parsing alignments and generating matrices
     RLEConfusion confusion = get_fasta_runlength_matrix(bam_path,
@@ -1306,6 +1480,7 @@ void measure_runlength_distribution_from_fasta(
             regions,
             minimum_match_length,
             max_runlength,
+            checkpoint,
             max_threads);
 
     cerr << '\n';
@@ -1313,6 +1488,210 @@ void measure_runlength_distribution_from_fasta(
     // Write output
     write_length_matrix_to_file(output_directory, confusion.length_matrix);
     write_base_matrix_to_file(output_directory, confusion.base_matrix);
+
+    // The output is complete, so the partial results are no longer needed
+    checkpoint.remove_files();
+}
+
+
+void load_alignment_manifest(path manifest_path, vector <pair <path,path> >& entries){
+    ///
+    /// Read a manifest of alignments: one BAM and the reads FASTA it was aligned from per line, separated by a tab.
+    /// Relative paths are relative to the manifest.
+    ///
+    ifstream file(manifest_path);
+
+    if (not file.is_open()){
+        throw runtime_error("ERROR: file could not be read: " + manifest_path.string());
+    }
+
+    path manifest_directory = absolute(manifest_path).parent_path();
+    string line;
+    uint64_t line_index = 0;
+
+    while (getline(file, line)){
+        line_index++;
+
+        if (line.empty()){
+            continue;
+        }
+
+        size_t separator = line.find('\t');
+
+        if (separator == string::npos or line.find('\t', separator + 1) != string::npos){
+            throw runtime_error("ERROR: manifest line " + to_string(line_index) + " does not contain 2 tab separated "
+                                "paths: " + manifest_path.string());
+        }
+
+        path bam_path = line.substr(0, separator);
+        path reads_fasta_path = line.substr(separator + 1);
+
+        entries.emplace_back(manifest_directory / bam_path, manifest_directory / reads_fasta_path);
+    }
+
+    if (entries.empty()){
+        throw runtime_error("ERROR: manifest is empty: " + manifest_path.string());
+    }
+}
+
+
+path get_shard_directory(path output_directory, uint64_t shard_index, uint64_t n_shards){
+    return output_directory / ("shard_" + to_string(shard_index) + "_of_" + to_string(n_shards));
+}
+
+
+void get_shard_regions(
+        const vector<Region>& regions,
+        size_t entry_index,
+        uint64_t shard_index,
+        uint64_t n_shards,
+        vector<Region>& shard_regions){
+    ///
+    /// Find the regions of one manifest entry that belong to a shard. The (entry, region) units are numbered entry by
+    /// entry and dealt to the shards in turn, so every unit belongs to exactly one shard.
+    ///
+    shard_regions.clear();
+
+    for (size_t r=0; r<regions.size(); r++){
+        if ((entry_index*regions.size() + r) % n_shards == shard_index){
+            shard_regions.emplace_back(regions[r]);
+        }
+    }
+}
+
+
+void measure_runlength_distribution_from_manifest(
+        path manifest_path,
+        path reference_fasta_path,
+        path output_directory,
+        uint16_t max_runlength,
+        uint16_t max_threads,
+        size_t minimum_match_length,
+        uint64_t shard_index,
+        uint64_t n_shards){
+    ///
+    /// The map step of a sharded measurement: every (alignment, region) pair of the manifest is a unit of work, and
+    /// the units are dealt to the shards in turn, so each shard gets a similar share of every BAM and every part of
+    /// the reference. The BAMs must contain RLE reads aligned (with --eqx) to the RLE reference, as made by
+    /// measure_runlength_distribution_from_fasta. The partial matrices of the shard are written as binary files in
+    /// '<output_directory>/shard_<index>_of_<n_shards>', to be summed by reduce_runlength_distribution_shards.
+    ///
+
+    if (n_shards == 0 or shard_index >= n_shards){
+        throw runtime_error("ERROR: shard index " + to_string(shard_index) + " is not less than the number of shards "
+                            + to_string(n_shards));
+    }
+
+    cerr << "Using " + to_string(max_threads) + " threads\n";
+    cerr << "Shard " << shard_index << " of " << n_shards << '\n';
+
+    // Same chunk size as the unsharded measurement, so that shards can be combined with it
+    uint64_t chunk_size = 1*1000*1000;
+
+    vector <pair <path,path> > entries;
+    load_alignment_manifest(manifest_path, entries);
+
+    path shard_directory = get_shard_directory(output_directory, shard_index, n_shards);
+
+    // Runlength encode the REFERENCE and store in memory. Each shard writes its own RLE FASTA, to avoid concurrent
+    // writes to the same file by the shards, and deletes it once the reference is loaded.
+    unordered_map<string,RunlengthSequenceElement> ref_runlength_sequences;
+    bool store_in_memory = true;
+    path reference_fasta_path_rle = runlength_encode_fasta_file(reference_fasta_path,
+            ref_runlength_sequences,
+            shard_directory,
+            store_in_memory,
+            max_threads);
+
+    remove(reference_fasta_path_rle);
+
+    // Chunk alignment regions, sorted so that every shard finds the same regions
+    vector<Region> regions;
+    chunk_sequences_into_regions(regions, ref_runlength_sequences, chunk_size);
+
+    // Checkpoints are per run, so a failed shard is simply rerun
+    Checkpoint checkpoint;
+
+    RLEConfusion confusion(max_runlength);
+
+    for (size_t e=0; e<entries.size(); e++){
+        auto& [bam_path, reads_fasta_path] = entries[e];
+
+        vector<Region> shard_regions;
+        get_shard_regions(regions, e, shard_index, n_shards, shard_regions);
+
+        if (shard_regions.empty()){
+            continue;
+        }
+
+        cerr << "Iterating " << shard_regions.size() << " of " << regions.size() << " regions in "
+             << bam_path.string() << "...\n" << std::flush;
+
+        FastaReader reads_fasta_reader = FastaReader(reads_fasta_path);
+        reads_fasta_reader.index(max_threads);
+
+        RLEConfusion entry_confusion = get_fasta_runlength_matrix(bam_path,
+                reads_fasta_path,
+                reads_fasta_reader,
+                ref_runlength_sequences,
+                shard_regions,
+                minimum_match_length,
+                max_runlength,
+                checkpoint,
+                max_threads);
+
+        confusion += entry_confusion;
+    }
+
+    cerr << '\n';
+
+    // Write output
+    path length_matrix_path = shard_directory / "length_frequency_matrix_directional.bin";
+    path base_matrix_path = shard_directory / "base_frequency_matrix_directional.bin";
+
+    cerr << "WRITING: matrix file " + length_matrix_path.string() << '\n';
+    cerr << "WRITING: matrix file " + base_matrix_path.string() << '\n';
+
+    write_matrix_to_binary_file(length_matrix_path, confusion.length_matrix);
+    write_matrix_to_binary_file(base_matrix_path, confusion.base_matrix);
+}
+
+
+void reduce_runlength_distribution_shards(path output_directory, uint64_t n_shards){
+    ///
+    /// The reduce step of a sharded measurement: sum the partial matrices of every shard, and write them as the
+    /// unsharded measurement would. Every shard must be present, so that a failed shard can't go unnoticed.
+    ///
+
+    if (n_shards == 0){
+        throw runtime_error("ERROR: number of shards must be greater than 0");
+    }
+
+    vector<path> length_matrix_paths;
+    vector<path> base_matrix_paths;
+
+    for (uint64_t i=0; i<n_shards; i++){
+        path shard_directory = get_shard_directory(output_directory, i, n_shards);
+
+        length_matrix_paths.emplace_back(shard_directory / "length_frequency_matrix_directional.bin");
+        base_matrix_paths.emplace_back(shard_directory / "base_frequency_matrix_directional.bin");
+
+        if (not exists(length_matrix_paths.back()) or not exists(base_matrix_paths.back())){
+            throw runtime_error("ERROR: shard " + to_string(i) + " is incomplete: " + shard_directory.string());
+        }
+    }
+
+    cerr << "Summing matrices from " << n_shards << " shards...\n";
+
+    rle_length_matrix length_matrix;
+    rle_base_matrix base_matrix;
+
+    sum_binary_matrix_files(length_matrix_paths, length_matrix);
+    sum_binary_matrix_files(base_matrix_paths, base_matrix);
+
+    // Write output
+    write_length_matrix_to_file(output_directory, length_matrix);
+    write_base_matrix_to_file(output_directory, base_matrix);
 }
 
 
@@ -1322,14 +1701,15 @@ template <typename T> void label_coverage_data(
         path output_directory,
         uint16_t max_threads,
         uint16_t insert_cutoff,
-        path bed_path){
+        path bed_path,
+        bool single_file){
 
     cerr << "Using " + to_string(max_threads) + " threads\n";
 
-    // How big (bp) should the regions be for iterating the BAM? Regardless of size,
-    // only one alignment worth of RAM is consumed per chunk. This value should be chosen as an appropriate
-    // fraction of the genome size to prevent threads from being starved. Larger chunks also reduce overhead
-    // associated with iterating reads that extend beyond the region (at the edges)
+    // How big (bp) should the regions be for iterating the BAM? Each thread holds one alignment and the data of its
+    // read at a time, regardless of size. This value should be chosen as an appropriate fraction of the genome size to
+    // prevent threads from being starved. Larger chunks also reduce overhead associated with iterating reads that
+    // extend beyond the region (at the edges)
     uint64_t chunk_size = 1*1000*1000;
 
     T reader = T(input_directory);
@@ -1391,21 +1771,8 @@ template <typename T> void label_coverage_data(
     // If a BED file was provided, only iterate the regions of the BAM that may be found in the reference provided.
     // Otherwise, iterate the entire BAM.
     vector<Region> regions;
-    if (bed_path.empty()){
-        // Chunk alignment regions
-        chunk_sequences_into_regions(regions, ref_runlength_sequences, chunk_size);
-    }
-    else{
-        // Load the BED regions, and then find the union of the regions in BED and reference FASTA
-        set<string> names;
-        for (auto& item: ref_runlength_sequences){
-            names.insert(item.first);
-        }
-
-        BedReader bed_reader(bed_path);
-        bed_reader.read_regions(regions);
-        bed_reader.subset_by_regions_name(regions, names);
-    }
+    IntervalIndex bed_index;
+    chunk_regions(bed_path, bed_index, regions, ref_runlength_sequences, chunk_size);
 
     cerr << "Iterating alignments...\n" << std::flush;
 
@@ -1416,8 +1783,10 @@ template <typename T> void label_coverage_data(
             read_paths,
             ref_runlength_sequences,
             regions,
+            bed_index,
             insert_cutoff,
-            max_threads);
+            max_threads,
+            single_file);
 
     cerr << '\n';
 }
@@ -1428,15 +1797,33 @@ void measure_runlength_distribution_from_marginpolish(path input_directory,
                                                        path output_directory,
                                                        uint16_t max_runlength,
                                                        uint16_t max_threads,
-                                                       path bed_path) {
-
-    measure_runlength_distribution_from_coverage_data<MarginPolishReader>(
-            input_directory,
-            reference_fasta_path,
-            output_directory,
-            max_runlength,
-            max_threads,
-            bed_path);
+                                                       path bed_path,
+                                                       bool resume,
+                                                       double checkpoint_interval) {
+
+    // A single file is a directory that was packed by convert_coverage_directory
+    if (is_regular_file(input_directory)){
+        measure_runlength_distribution_from_coverage_data<CoverageReader>(
+                input_directory,
+                reference_fasta_path,
+                output_directory,
+                max_runlength,
+                max_threads,
+                bed_path,
+                resume,
+                checkpoint_interval);
+    }
+    else{
+        measure_runlength_distribution_from_coverage_data<MarginPolishReader>(
+                input_directory,
+                reference_fasta_path,
+                output_directory,
+                max_runlength,
+                max_threads,
+                bed_path,
+                resume,
+                checkpoint_interval);
+    }
 }
 
 
@@ -1446,15 +1833,33 @@ void measure_runlength_distribution_from_shasta(
         path output_directory,
         uint16_t max_runlength,
         uint16_t max_threads,
-        path bed_path) {
-
-    measure_runlength_distribution_from_coverage_data<ShastaReader>(
-            input_directory,
-            reference_fasta_path,
-            output_directory,
-            max_runlength,
-            max_threads,
-            bed_path);
+        path bed_path,
+        bool resume,
+        double checkpoint_interval) {
+
+    // A single file is a directory that was packed by convert_coverage_directory
+    if (is_regular_file(input_directory)){
+        measure_runlength_distribution_from_coverage_data<CoverageReader>(
+                input_directory,
+                reference_fasta_path,
+                output_directory,
+                max_runlength,
+                max_threads,
+                bed_path,
+                resume,
+                checkpoint_interval);
+    }
+    else{
+        measure_runlength_distribution_from_coverage_data<ShastaReader>(
+                input_directory,
+                reference_fasta_path,
+                output_directory,
+                max_runlength,
+                max_threads,
+                bed_path,
+                resume,
+                checkpoint_interval);
+    }
 }
 
 
@@ -1464,13 +1869,28 @@ void label_coverage_data_from_shasta(
         path output_directory,
         uint16_t max_threads,
         path bed_path,
-        uint16_t insert_cutoff) {
-
-    label_coverage_data<ShastaReader>(
-            input_directory,
-            reference_fasta_path,
-            output_directory,
-            max_threads,
-            insert_cutoff,
-            bed_path);
+        uint16_t insert_cutoff,
+        bool single_file) {
+
+    // A single file is a directory that was packed by convert_coverage_directory
+    if (is_regular_file(input_directory)){
+        label_coverage_data<CoverageReader>(
+                input_directory,
+                reference_fasta_path,
+                output_directory,
+                max_threads,
+                insert_cutoff,
+                bed_path,
+                single_file);
+    }
+    else{
+        label_coverage_data<ShastaReader>(
+                input_directory,
+                reference_fasta_path,
+                output_directory,
+                max_threads,
+                insert_cutoff,
+                bed_path,
+                single_file);
+    }
 }
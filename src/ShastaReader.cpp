@@ -1,11 +1,16 @@
 #include <cmath>
+#include <cstring>
 #include "ShastaReader.hpp"
+#include "Miscellaneous.hpp"
+
+using std::memchr;
 
 
 ShastaReader::ShastaReader(path directory_path, bool store_length_consensus, bool store_coverage_data){
     this->directory_path = directory_path;
     this->store_length_consensus = store_length_consensus;
     this->store_coverage_data = store_coverage_data;
+    this->store_vertex_labels = false;
 }
 
 
@@ -43,23 +48,25 @@ void ShastaReader::read_file(CoverageSegment& segment, path& file_path) {
     ///
     /// Iterate all the lines in a shasta coverageData output file (CSV)
     ///
-    // Clear the container
-    segment = {};
+    // Clear the containers (without releasing their memory)
+    segment.clear();
 
-    // Open file
-    ifstream file = ifstream(file_path);
-    if (not file.good()){
-        throw runtime_error("ERROR: could not open file " + file_path.string());
-    }
+    read_file_to_string(file_path, this->file_buffer);
+
+    const char* start = this->file_buffer.data();
+    const char* end = start + this->file_buffer.size();
 
-    // File iteration variables
-    string line;
-    uint64_t l = 0;
+    while (start < end){
+        auto stop = static_cast<const char*>(memchr(start, '\n', end - start));
+        if (stop == nullptr){
+            stop = end;
+        }
+
+        if (stop > start) {
+            this->parse_coverage_string(segment, start, stop);
+        }
 
-    // TODO: stop using getline()
-    while (getline(file, line)){
-        this->parse_coverage_string(segment, line);
-        l++;
+        start = stop + 1;
     }
 }
 
@@ -78,44 +85,44 @@ void ShastaReader::fetch_read(CoverageSegment& segment, string& read_name) {
 }
 
 
-size_t ShastaReader::parse_consensus(CoverageSegment& shasta_segment, string& line){
-    size_t n_commas = 0;
-    size_t i = 0;
-    string length_string;
+const char* ShastaReader::parse_consensus(CoverageSegment& shasta_segment, const char* start, const char* stop){
+    ///
+    /// Parse the first 3 columns (index, consensus base, consensus length) and return a pointer to the comma that
+    /// follows them
+    ///
+    auto comma_0 = static_cast<const char*>(memchr(start, ',', stop - start));
+    auto comma_1 = (comma_0 == nullptr) ? nullptr : static_cast<const char*>(memchr(comma_0 + 1, ',', stop - comma_0 - 1));
+    auto comma_2 = (comma_1 == nullptr) ? nullptr : static_cast<const char*>(memchr(comma_1 + 1, ',', stop - comma_1 - 1));
 
-    while (n_commas < 3) {
-        if (line[i] == ','){
-            n_commas++;
-        }
-        else if (n_commas == 1){
-                shasta_segment.sequence += line[i];
-        }
-        else if (this->store_length_consensus and n_commas == 2){
-                length_string += line[i];
-        }
-        i++;
+    if (comma_2 == nullptr){
+        throw runtime_error("ERROR: incomplete line in Shasta coverage data: " + string(start, stop));
     }
 
+    shasta_segment.sequence.append(comma_0 + 1, comma_1);
+
     // Only keep the consensus length data if specified by class attribute
     if (this->store_length_consensus) {
-        uint16_t consensus_length = stoi(length_string);
+        uint16_t consensus_length;
+        parse_uint16(comma_1 + 1, comma_2, consensus_length);
         shasta_segment.lengths.emplace_back(consensus_length);
-//        cout << line << '\n' << consensus_length << '\n';
     }
 
-
-    return i-1;
+    return comma_2;
 }
 
 
 void ShastaReader::parse_coverage_string(CoverageSegment& segment, string& line) {
+    this->parse_coverage_string(segment, line.data(), line.data() + line.size());
+}
+
+
+void ShastaReader::parse_coverage_string(CoverageSegment& segment, const char* start, const char* stop) {
     ///
-    /// Reads a line of the Shasta runlength CSV and converts it to a vector of CoverageElements
+    /// Reads a line of the Shasta runlength CSV and appends its observations to the segment, without
+    /// allocating. Each observation looks like "A2+ 15," i.e. base, length, strand, space, weight, comma.
     ///
 
-    // For iterating elements within the tab separated string
-    uint64_t start_index = parse_consensus(segment, line);
-    uint64_t c = 0;
+    const char* p = this->parse_consensus(segment, start, stop);
 
     // Placeholders for Coverage element
     char base;
@@ -123,60 +130,44 @@ void ShastaReader::parse_coverage_string(CoverageSegment& segment, string& line)
     bool reversal;
     float weight;
 
-    // Buffers for elements with indeterminate number of chars
-    string reversal_string;
-    string weight_string;
-    string length_string;
-    bool space_found = false;
     float n_coverage = 0;
 
-    vector<CoverageElement> pileup;
-
-    // Iterate observations
-    for (uint64_t i=start_index; i<=line.size()-1; i++){
-        // Perform element level operations at start of next element and end of line
-        if (line[i] == ',' or i == line.size()){
-            if (i > start_index){
-                reversal = this->parse_reversal_string(reversal_string);
-                length = uint16_t(stoi(length_string));
-                weight = stof(weight_string);
-                pileup.emplace_back(base, length, reversal, weight);
-                n_coverage += weight;
-            }
-            c = 0;
-            length_string = "";
-            weight_string = "";
-            reversal_string = "";
-            space_found = false;
-
-            if (i < line.size() - 1 and isspace(line[i+1])){
-                break;
-            }
+    // Iterate observations, p always points at the comma that precedes the next observation
+    while (p + 1 < stop and not isspace(p[1])){
+        const char* element_start = p + 1;
+        auto element_stop = static_cast<const char*>(memchr(element_start, ',', stop - element_start));
+
+        // Unterminated trailing elements are ignored
+        if (element_stop == nullptr){
+            break;
+        }
+
+        base = element_start[0];
+        const char* q = parse_uint16(element_start + 1, element_stop, length);
+
+        if (*q == '+'){
+            reversal = false;
+        }
+        else if (*q == '-'){
+            reversal = true;
         }
-        // Parse element members
-        else {
-            if (c == 1) {
-                base = line[i];
-            }
-            else if (not space_found and c > 1 and line[i] != ' ' and line[i] != '+' and line[i] != '-') {
-                length_string += line[i];
-            }
-            else if (not space_found and c > 2 and line[i] != ' ') {
-                reversal_string = line[i];
-            }
-            else if (line[i] == ' '){
-                space_found = true;
-            }
-            else if (space_found){
-                weight_string += line[i];
-            }
+        else{
+            throw runtime_error("ERROR: Invalid reversal string " + string(1, *q));
         }
-        c++;
+
+        parse_float(q + 2, element_stop, weight);
+
+        if (this->store_coverage_data) {
+            segment.add_observation(base, length, reversal, weight);
+        }
+        n_coverage += weight;
+
+        p = element_stop;
     }
 
     // Either store all the specific coverage data, or just count the n-fold coverage at this position
     if (this->store_coverage_data) {
-        segment.coverage_data.push_back(move(pileup));
+        segment.end_position();
     }
     else{
         segment.n_coverage.emplace_back(uint16_t(round(n_coverage)));
@@ -184,7 +175,7 @@ void ShastaReader::parse_coverage_string(CoverageSegment& segment, string& line)
 
     // Store whether the coverage data came from a vertex or not (edge)
     if (this->store_vertex_labels){
-        bool is_vertex = (line[line.size()-1] == 'v');
+        bool is_vertex = (stop[-1] == 'v');
         segment.is_vertex.emplace_back(is_vertex);
     }
 }
@@ -209,21 +200,23 @@ bool ShastaReader::parse_reversal_string(string reversal_string) {
 
 
 void ShastaReader::read_consensus_sequence_from_file(CoverageSegment& segment, path& file_path) {
-    // Open file
-    ifstream file = ifstream(file_path);
-    if (not file.good()){
-        throw runtime_error("ERROR: could not open file " + file_path.string());
-    }
+    read_file_to_string(file_path, this->file_buffer);
+
+    const char* start = this->file_buffer.data();
+    const char* end = start + this->file_buffer.size();
 
-    // File iteration variables
-    string line;
-    uint64_t l = 0;
+    while (start < end){
+        auto stop = static_cast<const char*>(memchr(start, '\n', end - start));
+        if (stop == nullptr){
+            stop = end;
+        }
+
+        auto comma = static_cast<const char*>(memchr(start, ',', stop - start));
+        if (comma != nullptr and comma + 1 < stop) {
+            segment.sequence += comma[1];
+        }
 
-    // TODO: stop using getline()
-    while (getline(file, line)){
-        size_t base_index = line.find_first_of(',') + 1;
-        segment.sequence += line[base_index];
-        l++;
+        start = stop + 1;
     }
 }
 
@@ -234,7 +227,7 @@ void ShastaReader::fetch_consensus_sequence(CoverageSegment& segment, string& re
     ///
 
     // Clear the container
-    segment = {};
+    segment.clear();
 
     if (this->file_paths.empty()){
         cerr << "Index not loaded for directory, generating now...\n";
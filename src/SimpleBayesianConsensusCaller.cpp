@@ -8,6 +8,7 @@
 #include <string>
 #include <cstdio>
 #include <array>
+#include <algorithm>
 #include <cmath>
 #include <map>
 #include "SimpleBayesianConsensusCaller.hpp"
@@ -18,6 +19,7 @@ using std::to_string;
 using std::cout;
 using std::endl;
 using std::max;
+using std::min;
 using Separator = boost::char_separator<char>;
 using Tokenizer = boost::tokenizer<Separator>;
 
@@ -158,6 +160,11 @@ void SimpleBayesianConsensusCaller::printPriors(char separator) const{
 }
 
 
+const vector<double>& SimpleBayesianConsensusCaller::getPrior(size_t atOrGc) const{
+    return priors.at(atOrGc);
+}
+
+
 void SimpleBayesianConsensusCaller::parseName(ifstream& matrixFile, string& line){
     // Expect only one line to follow
     getline(matrixFile, line);
@@ -266,13 +273,21 @@ void SimpleBayesianConsensusCaller::factorRepeats(
 
     // Store counts for each unique observation
     for (auto& observation: pileup_column ){
-        // If NOT a gap, always increment
-        if (not is_gap(observation[BASE])) {
-            factoredRepeats[uint16_t(observation[REVERSAL])][uint16_t(observation[LENGTH])]++;
-        // If IS a gap only increment if "countGapsAsZeros" is true
-        }else if (countGapsAsZeros){
-            factoredRepeats[uint16_t(observation[REVERSAL])][0]++;
-        }
+        factorRepeat(factoredRepeats, observation);
+    }
+}
+
+
+void SimpleBayesianConsensusCaller::factorRepeat(
+    array<std::map<uint16_t,uint16_t>,2>& factoredRepeats,
+    const vector <float>& observation) const{
+
+    // If NOT a gap, always increment
+    if (not is_gap(observation[BASE])) {
+        factoredRepeats[uint16_t(observation[REVERSAL])][uint16_t(observation[LENGTH])]++;
+    // If IS a gap only increment if "countGapsAsZeros" is true
+    }else if (countGapsAsZeros){
+        factoredRepeats[uint16_t(observation[REVERSAL])][0]++;
     }
 }
 
@@ -286,13 +301,7 @@ void SimpleBayesianConsensusCaller::factorRepeats(
     for (auto& observation: pileup_column){
         // Ignore non consensus repeat values
         if (observation[BASE] == consensus_base_index){
-            // If NOT a gap, always increment
-            if (not is_gap(observation[BASE])) {
-                factoredRepeats[uint16_t(observation[REVERSAL])][uint16_t(observation[LENGTH])]++;
-            // If IS a gap only increment if "countGapsAsZeros" is true
-            }else if (countGapsAsZeros){
-                factoredRepeats[uint16_t(observation[REVERSAL])][0]++;
-            }
+            factorRepeat(factoredRepeats, observation);
         }
     }
 }
@@ -304,6 +313,24 @@ uint16_t SimpleBayesianConsensusCaller::predictRunlength(
         vector<double>& logLikelihoodY) const{
     array <std::map <uint16_t,uint16_t>, 2> factoredRepeats;    // Repeats grouped by strand and length
 
+    // Count the number of times each unique repeat was observed, to reduce redundancy in calculating log likelihoods/
+    // Depending on class boolean "ignoreNonConsensusBaseRepeats" filter out observations
+    if (ignoreNonConsensusBaseRepeats) {
+        factorRepeats(factoredRepeats, pileup_column, consensus_base_index);
+    }
+    else {
+        factorRepeats(factoredRepeats, pileup_column);
+    }
+
+    return predictRunlength(factoredRepeats, consensus_base_index, logLikelihoodY);
+}
+
+
+uint16_t SimpleBayesianConsensusCaller::predictRunlength(
+        const array<std::map<uint16_t,uint16_t>, 2>& factoredRepeats,
+        uint8_t consensus_base_index,
+        vector<double>& logLikelihoodY) const{
+
     size_t priorIndex = -1;   // Used to determine which prior probability vector to access (AT=0 or GC=1)
     uint16_t x;               // Element of X = {x_0, x_1, ..., x_i} observed repeats
     uint16_t c;               // Number of times x_i was observed
@@ -321,15 +348,6 @@ uint16_t SimpleBayesianConsensusCaller::predictRunlength(
         priorIndex = 1;
     }
 
-    // Count the number of times each unique repeat was observed, to reduce redundancy in calculating log likelihoods/
-    // Depending on class boolean "ignoreNonConsensusBaseRepeats" filter out observations
-    if (ignoreNonConsensusBaseRepeats) {
-        factorRepeats(factoredRepeats, pileup_column, consensus_base_index);
-    }
-    else {
-        factorRepeats(factoredRepeats, pileup_column);
-    }
-
     // Iterate all possible Y from 0 to j to calculate p(Y_j|X) where X is all observations 0 to i,
     // assuming i and j are less than maxRunlength
     for (y = 0; y <= maxOutputRunlength; y++){
@@ -373,9 +391,7 @@ uint16_t SimpleBayesianConsensusCaller::predictRunlength(
 
 
 uint8_t SimpleBayesianConsensusCaller::predictConsensusBase(const vector <vector <float> >& pileup_column) const{
-    vector<uint32_t> baseCounts(5,0);
-    uint32_t maxBaseCount = 0;
-    uint8_t maxBase = 4;   // Default to gap in case coverage is empty (is this possible?)
+    array<uint32_t, 5> baseCounts = {0,0,0,0,0};
     size_t base_index;
 
     // Count bases. If it's a gap increment placeholder 4 in baseCount vector
@@ -394,6 +410,14 @@ uint8_t SimpleBayesianConsensusCaller::predictConsensusBase(const vector <vector
         }
     }
 
+    return predictConsensusBase(baseCounts);
+}
+
+
+uint8_t SimpleBayesianConsensusCaller::predictConsensusBase(const array<uint32_t, 5>& baseCounts) const{
+    uint32_t maxBaseCount = 0;
+    uint8_t maxBase = 4;   // Default to gap in case coverage is empty (is this possible?)
+
     // Determine most represented base (consensus)
     for (uint32_t i=0; i<5; i++){
         if (baseCounts[i] > maxBaseCount){
@@ -433,3 +457,68 @@ void SimpleBayesianConsensusCaller::operator()(const vector <vector <float> >& c
     consensus.emplace_back(float(consensusBase));
     consensus.emplace_back(float(consensusRepeat));
 }
+
+
+void SimpleBayesianConsensusCaller::predictConsensusByCoverage(
+        const vector <vector <float> >& coverage,
+        size_t step,
+        size_t n_checkpoints,
+        vector <vector <float> >& consensus) const{
+    ///
+    /// Every checkpoint sees a prefix of the column, so the base counts and factored repeats of checkpoint i are those
+    /// of checkpoint i-1 plus the next `step` observations. The counts are the same integers that operator() would
+    /// build from the shrunken column, and predictRunlength sums them in the same (map) order, so the calls are
+    /// identical to operator()'s and not just approximately equal.
+    ///
+    array<uint32_t, 5> baseCounts = {0,0,0,0,0};
+
+    // When non consensus repeats are ignored, the counts are kept separately for each possible consensus base
+    array <array <std::map <uint16_t,uint16_t>, 2>, 5> factoredRepeatsByBase;
+    array <std::map <uint16_t,uint16_t>, 2> factoredRepeats;
+
+    vector<double> logLikelihoods(u_long(maxOutputRunlength+1), -INF);
+
+    consensus.resize(n_checkpoints);
+
+    size_t n = 0;
+    for (size_t i=0; i<n_checkpoints; i++){
+        size_t stop = min(coverage.size(), (i+1)*step);
+
+        // Beyond the end of the column, every checkpoint sees the whole column
+        if (i > 0 and stop == n and n == coverage.size()){
+            consensus[i] = consensus[i-1];
+            continue;
+        }
+
+        for (; n<stop; n++){
+            auto& observation = coverage[n];
+
+            if (not is_empty(observation[BASE])){
+                baseCounts[is_gap(observation[BASE]) ? 4 : size_t(observation[BASE])]++;
+            }
+
+            if (ignoreNonConsensusBaseRepeats){
+                // Only observations of A, C, G, T or gap can ever match a consensus base
+                for (uint8_t b=0; b<5; b++){
+                    if (observation[BASE] == b){
+                        factorRepeat(factoredRepeatsByBase[b], observation);
+                        break;
+                    }
+                }
+            }
+            else{
+                factorRepeat(factoredRepeats, observation);
+            }
+        }
+
+        uint8_t consensusBase = predictConsensusBase(baseCounts);
+        uint16_t consensusRepeat = 0;
+
+        if (predictGapRunlengths or not is_gap(consensusBase)) {
+            auto& repeats = (ignoreNonConsensusBaseRepeats) ? factoredRepeatsByBase[consensusBase] : factoredRepeats;
+            consensusRepeat = predictRunlength(repeats, consensusBase, logLikelihoods);
+        }
+
+        consensus[i] = {float(consensusBase), float(consensusRepeat)};
+    }
+}
@@ -0,0 +1,212 @@
+#include "WindowedConsensus.hpp"
+#include <stdexcept>
+#include <algorithm>
+
+using std::runtime_error;
+using std::lock_guard;
+using std::unique_lock;
+using std::min;
+using std::to_string;
+using std::move;
+
+
+void chunk_sequence_into_windows(vector<Region>& windows,
+        string name,
+        uint64_t window_size,
+        uint64_t overlap,
+        uint64_t length){
+
+    if (window_size == 0){
+        throw runtime_error("ERROR: window size must be greater than 0");
+    }
+
+    // Beyond this, the overlaps of consecutive pairs of windows could cross, and the stitching would not be monotonic
+    if (overlap > window_size){
+        throw runtime_error("ERROR: window overlap (" + to_string(overlap) + ") cannot exceed window size (" +
+                            to_string(window_size) + ")");
+    }
+
+    for (uint64_t core_start=0; core_start<length; core_start+=window_size){
+        uint64_t core_stop = min(core_start + window_size, length) - 1;
+
+        uint64_t start = (core_start > overlap) ? core_start - overlap : 0;
+        uint64_t stop = min(core_stop + overlap, length - 1);
+
+        windows.emplace_back(name, start, stop);
+    }
+}
+
+
+WindowConsensus::WindowConsensus() = default;
+
+
+WindowConsensus::WindowConsensus(Region& region){
+    this->region = region;
+    this->column_stops.reserve(region.stop - region.start + 1);
+}
+
+
+void WindowConsensus::end_column(){
+    this->column_stops.emplace_back(this->sequence.size());
+}
+
+
+uint64_t WindowConsensus::get_column_start(uint64_t ref_index){
+    if (ref_index == this->region.start){
+        return 0;
+    }
+
+    return this->column_stops.at(ref_index - this->region.start - 1);
+}
+
+
+uint64_t WindowConsensus::get_column_stop(uint64_t ref_index){
+    return this->column_stops.at(ref_index - this->region.start);
+}
+
+
+bool WindowConsensus::column_equals(WindowConsensus& other, uint64_t ref_index){
+    uint64_t a = this->get_column_start(ref_index);
+    uint64_t a_length = this->get_column_stop(ref_index) - a;
+    uint64_t b = other.get_column_start(ref_index);
+    uint64_t b_length = other.get_column_stop(ref_index) - b;
+
+    return this->sequence.compare(a, a_length, other.sequence, b, b_length) == 0;
+}
+
+
+uint64_t find_stitch_position(WindowConsensus& left, WindowConsensus& right){
+    ///
+    /// Any position within the overlap gives a valid (gapless, non-redundant) join. Preferring one where both windows
+    /// made the same call keeps the seam away from positions where the two pileups disagreed, e.g. because reads were
+    /// dropped at maximum depth in one of them but not the other.
+    ///
+    uint64_t overlap_start = right.region.start;
+    uint64_t overlap_stop = left.region.stop;
+
+    if (overlap_start > overlap_stop + 1 or overlap_start < left.region.start){
+        throw runtime_error("ERROR: windows cannot be stitched, they are not adjacent: " + left.region.to_string() +
+                            " " + right.region.to_string());
+    }
+
+    uint64_t middle = (overlap_start + overlap_stop + 1)/2;
+
+    for (uint64_t ref_index=middle; ref_index<=overlap_stop; ref_index++){
+        if (left.column_equals(right, ref_index)){
+            return ref_index;
+        }
+    }
+
+    return middle;
+}
+
+
+ConsensusStitcher::ConsensusStitcher(vector<Region>& windows, ofstream& file, string name_suffix, size_t max_pending):
+    windows(windows),
+    file(file)
+{
+    if (max_pending < 2){
+        throw runtime_error("ERROR: ConsensusStitcher needs room for at least 2 pending windows, to stitch a pair");
+    }
+
+    this->name_suffix = name_suffix;
+    this->max_pending = max_pending;
+    this->next_window_index = 0;
+    this->next_ref_index = 0;
+    this->record_started = false;
+}
+
+
+bool ConsensusStitcher::is_last_in_contig(size_t window_index){
+    return (window_index + 1 == this->windows.size()) or (this->windows[window_index + 1].name != this->windows[window_index].name);
+}
+
+
+void ConsensusStitcher::write(WindowConsensus& consensus, uint64_t start, uint64_t stop){
+    ///
+    /// Write the consensus of reference positions [start, stop), starting a new FASTA record first if needed. Records
+    /// are only started once there is sequence to put in them, so contigs with no consensus at all are omitted, as
+    /// before.
+    ///
+    if (stop <= start){
+        return;
+    }
+
+    uint64_t a = consensus.get_column_start(start);
+    uint64_t b = consensus.get_column_stop(stop - 1);
+
+    if (b > a and not this->record_started){
+        this->file << '>' << consensus.region.name << this->name_suffix << '\n';
+        this->record_started = true;
+    }
+
+    this->file.write(consensus.sequence.data() + a, b - a);
+}
+
+
+void ConsensusStitcher::add(size_t window_index, WindowConsensus& consensus){
+    ///
+    /// Take ownership of a window's consensus (the argument is moved from)
+    ///
+    unique_lock<mutex> lock(this->stitch_mutex);
+
+    this->pending[window_index] = move(consensus);
+    size_t prev_window_index = this->next_window_index;
+
+    // Write every window that is ready, in order
+    while (this->pending.count(this->next_window_index) > 0){
+        size_t i = this->next_window_index;
+        WindowConsensus& left = this->pending.at(i);
+
+        if (this->is_last_in_contig(i)){
+            this->write(left, this->next_ref_index, left.region.stop + 1);
+
+            if (this->record_started){
+                this->file << '\n';
+            }
+
+            this->next_ref_index = 0;
+            this->record_started = false;
+        }
+        else{
+            if (this->pending.count(i + 1) == 0){
+                break;
+            }
+
+            WindowConsensus& right = this->pending.at(i + 1);
+            uint64_t stitch_position = find_stitch_position(left, right);
+
+            this->write(left, this->next_ref_index, stitch_position);
+            this->next_ref_index = stitch_position;
+        }
+
+        this->pending.erase(i);
+        this->next_window_index++;
+    }
+
+    bool advanced = this->next_window_index != prev_window_index;
+    lock.unlock();
+
+    if (advanced){
+        this->window_written.notify_all();
+    }
+}
+
+
+void ConsensusStitcher::wait_for_capacity(size_t window_index){
+    ///
+    /// The windows between next_window_index and window_index never wait here (they are closer), so the pair that
+    /// unblocks next_window_index can always be added, and this can't deadlock as long as max_pending >= 2
+    ///
+    unique_lock<mutex> lock(this->stitch_mutex);
+
+    this->window_written.wait(lock, [&]{
+        return window_index < this->next_window_index or window_index - this->next_window_index < this->max_pending;
+    });
+}
+
+
+size_t ConsensusStitcher::get_n_pending(){
+    lock_guard<mutex> lock(this->stitch_mutex);
+    return this->pending.size();
+}
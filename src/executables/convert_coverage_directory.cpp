@@ -0,0 +1,209 @@
+#include "MarginPolishReader.hpp"
+#include "ShastaReader.hpp"
+#include "CoverageWriter.hpp"
+#include "CoverageReader.hpp"
+#include "boost/program_options.hpp"
+#include <experimental/filesystem>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <map>
+
+using std::cerr;
+using std::cout;
+using std::flush;
+using std::string;
+using std::sort;
+using std::mutex;
+using std::unique_lock;
+using std::condition_variable;
+using std::map;
+using std::move;
+using std::thread;
+using std::ref;
+using std::atomic;
+using std::exception;
+
+using std::experimental::filesystem::path;
+using std::experimental::filesystem::absolute;
+using boost::program_options::value;
+using boost::program_options::variables_map;
+using boost::program_options::options_description;
+
+
+template <typename T> void convert_coverage_segments(path& input_directory,
+                                                     unordered_map<string,path>& read_paths,
+                                                     vector<string>& read_names,
+                                                     mutex& file_write_mutex,
+                                                     condition_variable& segment_written,
+                                                     map<uint64_t,CoverageSegment>& pending_segments,
+                                                     uint64_t& next_write_index,
+                                                     uint64_t max_pending,
+                                                     CoverageWriter& writer,
+                                                     atomic<uint64_t>& job_index){
+
+    // One reader per thread, so that its parsing buffers are reused for every file
+    T reader = T(input_directory);
+    configure_reader(reader);
+    reader.set_index(read_paths);
+
+    while (job_index < read_names.size()) {
+        uint64_t thread_job_index = job_index.fetch_add(1);
+
+        if (thread_job_index >= read_names.size()){
+            break;
+        }
+
+        // Don't parse too far ahead of the next segment to be written, so that the reorder buffer stays bounded. The
+        // thread that holds next_write_index never waits here.
+        {
+            unique_lock<mutex> lock(file_write_mutex);
+            segment_written.wait(lock, [&]{return thread_job_index < next_write_index + max_pending;});
+        }
+
+        CoverageSegment segment;
+        reader.fetch_read(segment, read_names[thread_job_index]);
+        segment.name = read_names[thread_job_index];
+
+        cerr << "\33[2K\rParsed: " << segment.name << flush;
+
+        // Segments are written in the order of read_names, so any segment that finishes early is held until all of the
+        // segments before it have been written
+        unique_lock<mutex> lock(file_write_mutex);
+        pending_segments.emplace(thread_job_index, move(segment));
+
+        bool wrote = false;
+        auto next = pending_segments.find(next_write_index);
+
+        while (next != pending_segments.end()){
+            writer.write_segment(next->second);
+            pending_segments.erase(next);
+            next_write_index++;
+            wrote = true;
+
+            next = pending_segments.find(next_write_index);
+        }
+
+        lock.unlock();
+
+        if (wrote){
+            segment_written.notify_all();
+        }
+    }
+}
+
+
+template <typename T> void convert_coverage_directory(path input_directory,
+                                                      path output_path,
+                                                      bool store_length_consensus,
+                                                      bool store_vertex_labels,
+                                                      uint16_t max_threads){
+
+    T reader = T(input_directory);
+    reader.index();
+    unordered_map<string,path> read_paths = reader.get_index();
+
+    // Blocks are written in the order of the sorted names, so the output doesn't depend on the number of threads
+    vector<string> read_names;
+    for (auto& element: read_paths){
+        read_names.push_back(element.first);
+    }
+    sort(read_names.begin(), read_names.end());
+
+    CoverageWriter writer(output_path, store_length_consensus, store_vertex_labels);
+
+    vector<thread> threads;
+    mutex file_write_mutex;
+    condition_variable segment_written;
+    map<uint64_t,CoverageSegment> pending_segments;
+    uint64_t next_write_index = 0;
+    uint64_t max_pending = 2*uint64_t(max_threads);
+    atomic<uint64_t> job_index = 0;
+
+    // Launch threads
+    for (uint64_t i=0; i<max_threads; i++){
+        try {
+            threads.emplace_back(thread(convert_coverage_segments<T>,
+                                        ref(input_directory),
+                                        ref(read_paths),
+                                        ref(read_names),
+                                        ref(file_write_mutex),
+                                        ref(segment_written),
+                                        ref(pending_segments),
+                                        ref(next_write_index),
+                                        max_pending,
+                                        ref(writer),
+                                        ref(job_index)));
+        } catch (const exception &e) {
+            cerr << e.what() << "\n";
+            exit(1);
+        }
+    }
+
+    // Wait for threads to finish
+    for (auto& t: threads){
+        t.join();
+    }
+    cerr << "\n" << flush;
+
+    writer.write_indexes();
+
+    cerr << "Wrote " << writer.indexes.size() << " segments to " << absolute(output_path) << '\n';
+}
+
+
+int main(int argc, char* argv[]){
+    path input_dir;
+    path output_path;
+    string format;
+    uint16_t max_threads;
+
+    options_description options("Arguments");
+
+    options.add_options()
+        ("input_dir",
+        value<path>(&input_dir),
+        "Path to directory containing Shasta CSVs or MarginPolish TSVs")
+
+        ("format",
+        value<string>(&format)->
+        default_value("shasta"),
+        "Format of the files in the input directory: 'shasta' or 'marginpolish'")
+
+        ("output",
+        value<path>(&output_path)->
+        default_value("output/coverage.bin"),
+        "Destination file, which can be provided as the input_dir of the shasta/marginpolish analysis executables")
+
+        ("max_threads",
+        value<uint16_t>(&max_threads)->
+        default_value(1),
+        "Maximum number of threads to launch");
+
+    // Store options in a map and apply values to each corresponding variable
+    variables_map vm;
+    store(parse_command_line(argc, argv, options), vm);
+    notify(vm);
+
+    // If help was specified, or no arguments given, provide help
+    if (vm.count("help") || argc == 1) {
+        cout << options << "\n";
+        return 0;
+    }
+
+    if (format == "shasta"){
+        convert_coverage_directory<ShastaReader>(input_dir, output_path, true, true, max_threads);
+    }
+    else if (format == "marginpolish"){
+        convert_coverage_directory<MarginPolishReader>(input_dir, output_path, false, false, max_threads);
+    }
+    else{
+        throw runtime_error("ERROR: unrecognized format: " + format);
+    }
+
+    return 0;
+}
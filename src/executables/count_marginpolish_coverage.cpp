@@ -21,10 +21,8 @@ void count_marginpolish_coverage(path input_directory){
     for (pair<string,path> element: marginpolish_reader.file_paths){
         marginpolish_reader.fetch_read(segment, element.first);
 
-        for (auto& pileup: segment.coverage_data){
-            for (auto& element: pileup){
-                total_coverage += element.weight;
-            }
+        for (auto& weight: segment.coverage_weights){
+            total_coverage += weight;
         }
     }
 
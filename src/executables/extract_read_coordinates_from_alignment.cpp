@@ -1,9 +1,7 @@
 #include "Identity.hpp"
-#include "BedReader.hpp"
+#include "IntervalIndex.hpp"
 
 #include "boost/program_options.hpp"
-#include "boost/icl/interval_map.hpp"
-#include "boost/icl/interval.hpp"
 #include <iostream>
 #include <experimental/filesystem>
 #include <utility>
@@ -23,10 +21,6 @@ using boost::program_options::variables_map;
 using boost::program_options::value;
 using boost::program_options::bool_switch;
 using std::experimental::filesystem::path;
-using boost::icl::interval_map;
-using boost::icl::interval;
-using boost::icl::partial_enricher;
-using boost::icl::total_enricher;
 using std::make_pair;
 using std::vector;
 using std::atomic;
@@ -37,15 +31,12 @@ using std::move;
 using std::ref;
 using std::exception;
 using std::to_string;
+using std::max;
+using std::set;
 
 
 
-void parse_cigars(path bam_path,
-                  unordered_map<string,FastaIndex>& ref_index,
-                  regional_interval_map& bed_regions){
-
-    // Initialize FastaReader and relevant containers
-    SequenceElement sequence;
+void parse_cigars(path bam_path, vector<Region>& regions){
 
     // Initialize BAM reader and relevant containers
     BamReader bam_reader = BamReader(bam_path);
@@ -53,16 +44,10 @@ void parse_cigars(path bam_path,
     Coordinate coordinate;
     Cigar cigar;
 
-    string ref_name;
-
     bool filter_secondary = true;
     bool filter_supplementary = false;
     uint16_t map_quality_cutoff = 5;
 
-    // Temporaries
-    string true_base;
-    string observed_base;
-
     uint8_t ambiguous_match_code = Cigar::cigar_code_key.at("M");
     uint8_t match_code = Cigar::cigar_code_key.at("=");
     uint8_t mismatch_code = Cigar::cigar_code_key.at("X");
@@ -75,45 +60,28 @@ void parse_cigars(path bam_path,
                                                 mismatch_code,
                                                 insert_code,
                                                 delete_code};
-    string region_name;
-    FastaIndex ref_fasta_index;
-
-    for (auto& item: ref_index) {
-        region_name = item.first;
 
-        ref_fasta_index = item.second;
+    // Only fetch the alignments that overlap each BED region, instead of iterating every contig and filtering. Regions
+    // are disjoint, so restricting coordinates to the region reports each of them once.
+    for (auto& region: regions) {
+        // Coordinates are 1-based and compared directly to the BED, so the 0-based fetch starts 1 earlier
+        bam_reader.initialize_region(region.name, max(region.start, uint64_t(1)) - 1, region.stop);
 
-        // BAM coords are 1 based
-        bam_reader.initialize_region(region_name, 1, ref_fasta_index.length);
-
-        int i = 0;
+        string interval_string = "[" + to_string(region.start) + "," + to_string(region.stop) + ")";
 
         while (bam_reader.next_alignment(aligned_segment, map_quality_cutoff, filter_secondary, filter_supplementary)) {
             // Iterate cigars that match the criteria (must be '=')
             while (aligned_segment.next_coordinate(coordinate, cigar, valid_cigar_codes)) {
-
-                if (bed_regions.count(region_name) == 0) {
-                    continue;
-                }
-
-                auto result = bed_regions.at(region_name).find(coordinate.ref_index);
-
-                if (coordinate.ref_index > 19000 and coordinate.ref_index < 19010){
-                    cout << aligned_segment.read_name << '\t' << coordinate.read_true_index << '\n';
-                }
-
-                if (result != bed_regions.at(region_name).end()) {
-                    cout << region_name << '\t' << result->first << '\t' << aligned_segment.read_name << '\t' << coordinate.read_true_index << '\n';
+                if (uint64_t(coordinate.ref_index) >= region.start and uint64_t(coordinate.ref_index) < region.stop) {
+                    cout << region.name << '\t' << interval_string << '\t' << aligned_segment.read_name << '\t' << coordinate.read_true_index << '\n';
                 }
 
                 coordinate = {};
                 cigar = {};
             }
-
-            i++;
         }
 
-        cerr << "\33[2K\rParsed: " << region_name << " " << to_string(ref_fasta_index.length) << flush;
+        cerr << "\33[2K\rParsed: " << region.name << " " << interval_string << flush;
     }
     cerr << '\n';
 }
@@ -124,24 +92,26 @@ void extract_coordinates_from_alignment(path reference_fasta_path, path bam_path
     FastaReader ref_fasta_reader = FastaReader(reference_fasta_path);
     ref_fasta_reader.index();
 
-    // Get reference contig lengths
-    unordered_map<string,FastaIndex> ref_index;
-    ref_index = ref_fasta_reader.get_index();
+    // Get reference contig names
+    vector <pair <string, FastaIndex> > ref_indexes;
+    ref_fasta_reader.get_indexes(ref_indexes);
 
-    // Parse the BED file as a map of interval maps (one interval map for each chromosome/contig/region)
-    BedReader bed_reader(bed_path);
-    regional_interval_map regions;
-    bed_reader.read_regions(regions);
+    set<string> names;
+    for (auto& [name, item]: ref_indexes){
+        names.insert(name);
+    }
 
+    // Index the BED file, and take the union of its intervals on contigs that exist in the reference
+    IntervalIndex bed_index(bed_path);
+    vector<Region> regions;
+    bed_index.get_merged_regions(regions, names);
 
-    for(auto [name, imap]: regions){
-        for(auto interval: imap){
-            cout << name << '\t' << interval.first << '\t' << interval.second << '\n';
-        }
+    for (auto& region: regions){
+        cout << region.name << '\t' << "[" << region.start << "," << region.stop << ")" << '\n';
     }
 
     // Iterate all the alignments and locate read coordinates
-    parse_cigars(bam_path, ref_index, regions);
+    parse_cigars(bam_path, regions);
 }
 
 
@@ -11,15 +11,23 @@ using boost::program_options::variables_map;
 using boost::program_options::value;
 
 
-void filter_fastq_by_quality(path fastq_path, uint64_t minimum_average_quality){
+void filter_fastq_by_quality(path fastq_path, path output_path, uint64_t minimum_average_quality, uint16_t max_threads){
     FastqReader reader(fastq_path);
-    reader.filter_by_quality(minimum_average_quality);
+
+    if (output_path.empty()){
+        output_path = reader.get_filtered_path(minimum_average_quality);
+    }
+
+    cout << "WRITING FILE: " << output_path.string() << "\n";
+
+    reader.filter_by_quality(minimum_average_quality, output_path, max_threads);
 }
 
 
 int main(int argc, char* argv[]){
     path input_file_path;
-    path output_dir;
+    path output_path;
+    uint16_t minimum_quality;
     uint16_t max_threads;
 
     options_description options("Required options");
@@ -27,11 +35,21 @@ int main(int argc, char* argv[]){
     options.add_options()
         ("fastq",
         value<path>(&input_file_path),
-        "File path of FASTA file containing sequences to be Run-length encoded")
+        "File path of FASTQ file (plain, gzip or BGZF) containing reads to be filtered")
 
         ("q",
-        value<uint16_t>(&max_threads)->
+        value<uint16_t>(&minimum_quality)->
         default_value(0),
+        "Minimum mean phred quality of reads to keep")
+
+        ("output",
+        value<path>(&output_path)->
+        default_value(path()),
+        "Destination file, which is BGZF compressed if it ends in .gz. Defaults to <input>_filtered_<q>.fastq(.gz)")
+
+        ("max_threads",
+        value<uint16_t>(&max_threads)->
+        default_value(1),
         "Maximum number of threads to launch");
 
     // Store options in a map and apply values to each corresponding variable
@@ -47,7 +65,7 @@ int main(int argc, char* argv[]){
 
     cout << "READING FILE: " << string(input_file_path) << "\n";
 
-    filter_fastq_by_quality(input_file_path, max_threads);
+    filter_fastq_by_quality(input_file_path, output_path, minimum_quality, max_threads);
 
     return 0;
 }
@@ -6,6 +6,7 @@ using std::cout;
 using boost::program_options::options_description;
 using boost::program_options::variables_map;
 using boost::program_options::value;
+using boost::program_options::bool_switch;
 
 
 int main(int argc, char* argv[]){
@@ -15,6 +16,7 @@ int main(int argc, char* argv[]){
     path output_dir;
     uint16_t max_threads;
     uint32_t insert_cutoff;
+    bool single_file;
 
     options_description options("Arguments");
 
@@ -25,7 +27,7 @@ int main(int argc, char* argv[]){
 
         ("input_dir",
         value<path>(&input_dir),
-        "Path to directory containing Shasta CSVs")
+        "Path to directory containing Shasta CSVs, or a single file packed by convert_coverage_directory")
 
         ("output_dir",
         value<path>(&output_dir)->
@@ -45,7 +47,13 @@ int main(int argc, char* argv[]){
         ("insert_cutoff",
         value<uint32_t>(&insert_cutoff)->
         default_value(1000000),
-        "Maximum size of insert. Any insert cigar block larger than this will be excluded entirely from output");
+        "Maximum size of insert. Any insert cigar block larger than this will be excluded entirely from output")
+
+        ("single_file",
+        bool_switch(&single_file)->
+        default_value(false),
+        "Write all labeled alignments to one file (labeled_coverage.csv) with an index of the byte range of each, "
+        "instead of one CSV per alignment");
 
     // Store options in a map and apply values to each corresponding variable
     variables_map vm;
@@ -63,7 +71,8 @@ int main(int argc, char* argv[]){
             output_dir,
             max_threads,
             bed_path,
-            insert_cutoff);
+            insert_cutoff,
+            single_file);
 
     return 0;
 }
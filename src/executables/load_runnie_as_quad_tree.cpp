@@ -1,7 +1,7 @@
 #include <iostream>
 #include <experimental/filesystem>
 #include "RunnieReader.hpp"
-#include "QuadTree.hpp"
+#include "FlatQuadTree.hpp"
 #include "Quadrant.hpp"
 #include "boost/program_options.hpp"
 
@@ -31,7 +31,7 @@ void compress_runnie(path input_dir, path output_dir){
 
     QuadCoordinate center = QuadCoordinate(x, y);
     BoundingBox bounds = BoundingBox(center, size/2);
-    QuadTree tree = QuadTree(bounds);
+    FlatQuadTree tree = FlatQuadTree(bounds);
 
     RunnieSequenceElement sequence;
     string read_name;
@@ -20,6 +20,8 @@ int main(int argc, char* argv[]){
     string minimap_preset;
     uint16_t max_threads;
     bool per_alignment;
+    bool resume;
+    double checkpoint_interval;
 
     options_description options("Arguments");
 
@@ -49,7 +51,17 @@ int main(int argc, char* argv[]){
         ("per_alignment,a",
         bool_switch(&per_alignment)->
         default_value(false),
-        "This flag will indicate to dump all cigar stats to a file where each row pertains to 1 alignment");;
+        "This flag will indicate to dump all cigar stats to a file where each row pertains to 1 alignment")
+
+        ("resume",
+        bool_switch(&resume)->
+        default_value(false),
+        "Continue a preempted run from the checkpoints in the output directory")
+
+        ("checkpoint_interval",
+        value<double>(&checkpoint_interval)->
+        default_value(600),
+        "Seconds between saves of each thread's partial results (0 disables checkpoints)");
 
     // Store options in a map and apply values to each corresponding variable
     variables_map vm;
@@ -67,7 +79,11 @@ int main(int argc, char* argv[]){
                                 output_dir,
                                 minimap_preset,
                                 max_threads,
-                                per_alignment);
+                                per_alignment,
+                                1*1000*1000,
+                                {},
+                                resume,
+                                checkpoint_interval);
 
     return 0;
 }
@@ -176,8 +176,8 @@ void measure_kmer_stats_from_fasta(path reference_fasta_path,
     // Ensure that the FASTAs are indexed before starting threading
     FastaReader ref_reader = FastaReader(reference_fasta_path);
     FastaReader sequence_reader = FastaReader(reads_fasta_path);
-    ref_reader.index();
-    sequence_reader.index();
+    ref_reader.index(max_threads);
+    sequence_reader.index(max_threads);
 
     // Setup Alignment parameters
     bool sort = true;
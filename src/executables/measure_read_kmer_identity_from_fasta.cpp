@@ -30,14 +30,14 @@ using boost::program_options::variables_map;
 using boost::program_options::options_description;
 
 
-void chunk_sequences_into_regions(vector<Region>& regions, unordered_map<string,SequenceElement>& sequences, uint64_t chunk_size){
+void chunk_sequences_into_regions(vector<Region>& regions, CompactFastaIndex& index, uint64_t chunk_size){
     ///
-    /// Take all the sequences in some iterable object and chunk their lengths
+    /// Take the lengths of all the sequences in a FASTA's index and chunk them, without loading any sequence
     ///
 
     // For every sequence
-    for (auto& [name, item]: sequences){
-        chunk_sequence(regions, name, chunk_size, item.sequence.size());
+    for (size_t i=0; i<index.size(); i++){
+        chunk_sequence(regions, index.get_name(i), chunk_size, index.get_index(i).size());
     }
 }
 
@@ -190,86 +190,6 @@ void get_kmer_identity(path bam_path,
 }
 
 
-void load_fasta_sequences_from_file(path& fasta_path,
-        vector <pair <string, FastaIndex> >& read_index_vector,
-        unordered_map<string, SequenceElement>& sequences,
-        mutex& map_mutex,
-        atomic<uint64_t>& job_index){
-
-    while (job_index < read_index_vector.size()) {
-        // Fetch add
-        uint64_t thread_job_index = job_index.fetch_add(1);
-
-        // Initialize containers
-        SequenceElement sequence;
-
-        // Fetch Fasta sequence
-        FastaReader fasta_reader = FastaReader(fasta_path);
-
-        // Get read name and index
-        string read_name = read_index_vector[thread_job_index].first;
-        uint64_t read_index = read_index_vector[thread_job_index].second.byte_index;
-
-        // First of each element is read_name, second is its index
-        fasta_reader.get_sequence(sequence, read_name, read_index);
-
-        // Append the sequence to a map of names:sequence
-        map_mutex.lock();
-        sequences[sequence.name] = move(sequence);
-        map_mutex.unlock();
-
-        // Print status update to stdout
-        cerr << "\33[2K\rParsed: " << read_name << flush;
-    }
-}
-
-
-void load_fasta_file(path input_file_path,
-        unordered_map <string, SequenceElement>& sequences,
-        uint16_t max_threads) {
-
-    // This reader is used to fetch an index
-    FastaReader fasta_reader(input_file_path);
-
-    // Get index
-    unordered_map <string, FastaIndex> read_indexes;
-    fasta_reader.get_indexes_mapped_by_name(read_indexes);
-
-    // Convert the map object into an indexable object
-    vector <pair <string, FastaIndex> > read_index_vector;
-    get_vector_from_index_map(read_index_vector, read_indexes);
-
-    mutex map_mutex;
-
-    atomic<uint64_t> job_index = 0;
-    vector<thread> threads;
-
-    // Launch threads
-    for (uint64_t i=0; i<max_threads; i++){
-        // Get data to send to threads (must not be sent by reference, or will lead to concurrency issues)
-        try {
-            // Call thread safe function to RL encode and write to file
-            threads.emplace_back(thread(load_fasta_sequences_from_file,
-                                        ref(input_file_path),
-                                        ref(read_index_vector),
-                                        ref(sequences),
-                                        ref(map_mutex),
-                                        ref(job_index)));
-        } catch (const exception &e) {
-            cerr << e.what() << "\n";
-            exit(1);
-        }
-    }
-
-    // Wait for threads to finish
-    for (auto& t: threads){
-        t.join();
-    }
-
-    cerr << "\n" << flush;
-}
-
-
 void measure_kmer_accuracy_from_fasta(
         path reference_fasta_path,
         path reads_fasta_path,
@@ -288,8 +208,8 @@ void measure_kmer_accuracy_from_fasta(
     // Index any input files before threading
     FastaReader reads_fasta_reader = FastaReader(reads_fasta_path);
     FastaReader ref_fasta_reader = FastaReader(reference_fasta_path);
-    reads_fasta_reader.index();
-    ref_fasta_reader.index();
+    reads_fasta_reader.index(max_threads);
+    ref_fasta_reader.index(max_threads);
 
     // Setup Alignment parameters
     bool sort = true;
@@ -311,13 +231,9 @@ void measure_kmer_accuracy_from_fasta(
             explicit_mismatch,
             max_threads);
 
-    // Store ref sequences in memory
-    unordered_map<string,SequenceElement> ref_sequences;
-    load_fasta_file(reference_fasta_path, ref_sequences, max_threads);
-
-    // Chunk alignment regions
+    // Chunk alignment regions using the lengths in the reference index (the sequences are fetched by each thread)
     vector<Region> regions;
-    chunk_sequences_into_regions(regions, ref_sequences, chunk_size);
+    chunk_sequences_into_regions(regions, *ref_fasta_reader.compact_index, chunk_size);
 
     cerr << "Iterating alignments...\n";
 
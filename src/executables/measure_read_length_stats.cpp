@@ -1,8 +1,12 @@
 
 #include "FastaReader.hpp"
 #include "Miscellaneous.hpp"
+#include "ReadLengthStats.hpp"
 #include <algorithm>
 #include <random>
+#include <thread>
+#include <atomic>
+#include <set>
 #include <experimental/filesystem>
 #include <boost/program_options.hpp>
 #include "boost/algorithm/string.hpp"
@@ -15,11 +19,18 @@ using std::sort_heap;
 using std::random_device;
 using std::mt19937;
 using std::shuffle;
+using std::thread;
+using std::atomic;
+using std::exception;
+using std::ref;
+using std::set;
+using std::min;
 using std::experimental::filesystem::path;
 using std::experimental::filesystem::create_directories;
 using boost::program_options::options_description;
 using boost::program_options::variables_map;
 using boost::program_options::value;
+using boost::program_options::bool_switch;
 using boost::trim_left_if;
 using boost::trim_right;
 using boost::split;
@@ -78,7 +89,7 @@ void measure_read_length_stats_from_fasta(string comma_separated_paths, path out
         out_file << '>' << path << '\n';
 
         FastaReader reader(path);
-        reader.build_fasta_index();
+        reader.build_fasta_index(max_threads);
 
         read_lengths_from_fasta_index(reader.index_path, lengths);
 
@@ -109,12 +120,146 @@ void measure_read_length_stats_from_fasta(string comma_separated_paths, path out
 }
 
 
+void update_read_length_stats_thread_fn(vector<string>& paths,
+                                        vector<ReadLengthStats>& stats_per_path,
+                                        uint32_t min_length,
+                                        atomic<uint64_t>& job_index){
+
+    while (job_index < paths.size()) {
+        uint64_t thread_job_index = job_index.fetch_add(1);
+
+        if (thread_job_index >= paths.size()){
+            break;
+        }
+
+        // The index was built before the threads were launched
+        FastaReader reader(paths[thread_job_index]);
+
+        update_read_length_stats_from_fasta_index(reader.index_path, stats_per_path[thread_job_index], min_length);
+    }
+}
+
+
+void write_read_length_stats_line(ofstream& file, const string& name, ReadLengthSketch& sketch){
+    file << name << ','
+         << sketch.n_reads << ','
+         << sketch.total_length << ','
+         << (sketch.n_reads > 0 ? sketch.min_length : 0) << ','
+         << sketch.get_quantile(0.5) << ','
+         << sketch.get_mean() << ','
+         << sketch.max_length << ','
+         << sketch.get_nx(0.5) << ','
+         << sketch.get_nx(0.9) << '\n';
+}
+
+
+void measure_read_length_stats_from_fasta_streaming(string comma_separated_paths,
+        path output_dir,
+        uint32_t min_length,
+        uint64_t sample_length,
+        uint32_t histogram_bin_size,
+        uint16_t max_threads) {
+    ///
+    /// Stream the lengths of each FASTA's index into a reservoir sample, a length sketch and a histogram, one file per
+    /// thread, so that no file's lengths are ever held in memory at once. The reservoir only keeps enough lengths to
+    /// reach sample_length, so it must be bounded for memory to be too.
+    ///
+    vector<string> paths;
+    string separators = ",";
+    split_as_string(paths, comma_separated_paths, separators);
+
+    // Build any missing indexes first, one file at a time with every thread. Building them in the workers would build
+    // the index of a path that is given more than once twice, concurrently.
+    set<string> unique_paths(paths.begin(), paths.end());
+
+    for (auto& p: unique_paths){
+        FastaReader reader(p);
+        reader.build_fasta_index(max_threads);
+    }
+
+    create_directories(output_dir);
+    path lengths_path = absolute(output_dir / "read_lengths.txt");
+    path stats_path = absolute(output_dir / "read_length_stats.csv");
+    path histogram_path = absolute(output_dir / "read_length_histograms.txt");
+
+    ofstream lengths_file(lengths_path);
+    ofstream stats_file(stats_path);
+    ofstream histogram_file(histogram_path);
+
+    for (auto& p: {lengths_path, stats_path, histogram_path}){
+        cerr << "WRITING: " << p << '\n';
+    }
+
+    random_device device;
+    vector<ReadLengthStats> stats_per_path;
+
+    for (size_t i=0; i<paths.size(); i++){
+        stats_per_path.emplace_back(sample_length, (uint64_t(device()) << 32) | device(), histogram_bin_size);
+    }
+
+    uint16_t n_threads = uint16_t(min(size_t(max_threads), paths.size()));
+
+    vector<thread> threads;
+    atomic<uint64_t> job_index = 0;
+
+    try {
+        for (uint64_t i=0; i<n_threads; i++){
+            threads.emplace_back(thread(update_read_length_stats_thread_fn,
+                                        ref(paths),
+                                        ref(stats_per_path),
+                                        min_length,
+                                        ref(job_index)));
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        exit(1);
+    }
+
+    for (auto& t: threads){
+        t.join();
+    }
+
+    stats_file << "name,n_reads,total_length,min,median,mean,max,N50,N90\n";
+
+    ReadLengthSketch total_sketch;
+    vector<uint32_t> lengths;
+
+    for (size_t i=0; i<paths.size(); i++){
+        auto& stats = stats_per_path[i];
+
+        stats.reservoir.get_lengths(lengths);
+
+        lengths_file << '>' << paths[i] << '\n';
+        for (size_t j=0; j<lengths.size(); j++) {
+            lengths_file << lengths[j];
+            if (j < lengths.size() - 1) {
+                lengths_file << ',';
+            }
+        }
+        lengths_file << '\n';
+
+        histogram_file << '>' << paths[i] << '\n' << stats.histogram.to_string();
+
+        write_read_length_stats_line(stats_file, paths[i], stats.sketch);
+
+        total_sketch += stats.sketch;
+    }
+
+    if (paths.size() > 1){
+        write_read_length_stats_line(stats_file, "all", total_sketch);
+    }
+}
+
+
 int main(int argc, char* argv[]){
     string fasta_paths;
     path output_dir;
     uint16_t max_threads;
     uint32_t min_length;
     uint64_t max_cumulative_length;
+    uint64_t sample_length;
+    uint32_t histogram_bin_size;
+    bool streaming;
 
     options_description options("Arguments");
 
@@ -141,7 +286,24 @@ int main(int argc, char* argv[]){
              ("max_cumulative_length",
              value<uint64_t>(&max_cumulative_length)->
                      default_value(std::numeric_limits<uint64_t>::max()),
-             "Minimum length of read to record");
+             "Minimum length of read to record")
+
+            ("streaming",
+             bool_switch(&streaming)->
+                     default_value(false),
+             "Stream lengths from the index instead of loading them, reading multiple files concurrently, and also write "
+             "summary stats (including N50/N90) and length histograms")
+
+            ("sample_length",
+             value<uint64_t>(&sample_length)->
+                     default_value(100*1000*1000),
+             "In streaming mode, the cumulative length of the random sample of lengths written to read_lengths.txt (at "
+             "most max_cumulative_length). The sample is held in memory, so it has a finite default")
+
+            ("histogram_bin_size",
+             value<uint32_t>(&histogram_bin_size)->
+                     default_value(1000),
+             "Width of the length histogram bins in streaming mode");
 
     // Store options in a map and apply values to each corresponding variable
     variables_map vm;
@@ -154,11 +316,21 @@ int main(int argc, char* argv[]){
         return 0;
     }
 
-    measure_read_length_stats_from_fasta(fasta_paths,
-            output_dir,
-            min_length,
-            max_cumulative_length,
-            max_threads);
+    if (streaming){
+        measure_read_length_stats_from_fasta_streaming(fasta_paths,
+                output_dir,
+                min_length,
+                min(max_cumulative_length, sample_length),
+                histogram_bin_size,
+                max_threads);
+    }
+    else {
+        measure_read_length_stats_from_fasta(fasta_paths,
+                output_dir,
+                min_length,
+                max_cumulative_length,
+                max_threads);
+    }
 
     return 0;
 }
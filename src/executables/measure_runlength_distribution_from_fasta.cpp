@@ -6,6 +6,7 @@ using std::cout;
 using boost::program_options::options_description;
 using boost::program_options::variables_map;
 using boost::program_options::value;
+using boost::program_options::bool_switch;
 
 
 int main(int argc, char* argv[]){
@@ -17,6 +18,12 @@ int main(int argc, char* argv[]){
     size_t minimum_match_length;
     string minimap_preset;
     uint16_t minimap_k;
+    path manifest_path;
+    uint64_t shard_index;
+    uint64_t n_shards;
+    bool reduce;
+    bool resume;
+    double checkpoint_interval;
 
     options_description options("Arguments");
 
@@ -57,7 +64,37 @@ int main(int argc, char* argv[]){
             ("minimap_k",
              value<uint16_t>(&minimap_k)->
              default_value(19),
-             "Maximum length of a run to use in the model");
+             "Maximum length of a run to use in the model")
+
+            ("resume",
+            bool_switch(&resume)->
+            default_value(false),
+            "Continue a preempted run from the checkpoints in the output directory")
+
+            ("checkpoint_interval",
+            value<double>(&checkpoint_interval)->
+            default_value(600),
+            "Seconds between saves of each thread's partial results (0 disables checkpoints)")
+
+            ("manifest",
+             value<path>(&manifest_path),
+             "Sharded mode: file path of a manifest with one BAM (RLE reads aligned to the RLE reference) and its reads "
+             "FASTA per line, separated by a tab. Replaces --sequences, and writes the partial matrices of one shard.")
+
+            ("shard_index",
+             value<uint64_t>(&shard_index)->
+             default_value(0),
+             "Sharded mode: index of the shard to process, from 0 to n_shards-1")
+
+            ("n_shards",
+             value<uint64_t>(&n_shards)->
+             default_value(1),
+             "Sharded mode: number of shards that the manifest is split into")
+
+            ("reduce",
+             bool_switch(&reduce)->
+             default_value(false),
+             "Sum the partial matrices of all n_shards shards in the output directory, and write the final matrices");
 
     // Store options in a map and apply values to each corresponding variable
     variables_map vm;
@@ -70,6 +107,23 @@ int main(int argc, char* argv[]){
         return 0;
     }
 
+    if (reduce){
+        reduce_runlength_distribution_shards(output_dir, n_shards);
+        return 0;
+    }
+
+    if (not manifest_path.empty()){
+        measure_runlength_distribution_from_manifest(manifest_path,
+                                                     ref_fasta_path,
+                                                     output_dir,
+                                                     max_runlength,
+                                                     max_threads,
+                                                     minimum_match_length,
+                                                     shard_index,
+                                                     n_shards);
+        return 0;
+    }
+
     measure_runlength_distribution_from_fasta(reads_fasta_path,
                                               ref_fasta_path,
                                               output_dir,
@@ -77,7 +131,9 @@ int main(int argc, char* argv[]){
                                               max_threads,
                                               minimum_match_length,
                                               minimap_preset,
-                                              minimap_k);
+                                              minimap_k,
+                                              resume,
+                                              checkpoint_interval);
 
     return 0;
 }
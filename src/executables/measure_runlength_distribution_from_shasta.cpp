@@ -6,6 +6,7 @@ using std::cout;
 using boost::program_options::options_description;
 using boost::program_options::variables_map;
 using boost::program_options::value;
+using boost::program_options::bool_switch;
 
 
 int main(int argc, char* argv[]){
@@ -15,6 +16,8 @@ int main(int argc, char* argv[]){
     path output_dir;
     uint16_t max_threads;
     uint16_t max_runlength;
+    bool resume;
+    double checkpoint_interval;
 
     options_description options("Arguments");
 
@@ -25,7 +28,7 @@ int main(int argc, char* argv[]){
 
         ("input_dir",
         value<path>(&input_dir),
-        "Path to directory containing Shasta CSVs")
+        "Path to directory containing Shasta CSVs, or a single file packed by convert_coverage_directory")
 
         ("output_dir",
         value<path>(&output_dir)->
@@ -45,7 +48,17 @@ int main(int argc, char* argv[]){
         ("max_runlength",
         value<uint16_t>(&max_runlength)->
         default_value(50),
-        "Maximum length of a run to use in the model");
+        "Maximum length of a run to use in the model")
+
+        ("resume",
+        bool_switch(&resume)->
+        default_value(false),
+        "Continue a preempted run from the checkpoints in the output directory")
+
+        ("checkpoint_interval",
+        value<double>(&checkpoint_interval)->
+        default_value(600),
+        "Seconds between saves of each thread's partial results (0 disables checkpoints)");
 
     // Store options in a map and apply values to each corresponding variable
     variables_map vm;
@@ -63,7 +76,9 @@ int main(int argc, char* argv[]){
             output_dir,
             max_runlength,
             max_threads,
-            bed_path);
+            bed_path,
+            resume,
+            checkpoint_interval);
 
     return 0;
 }
@@ -200,8 +200,8 @@ void measure_kmer_stats_from_fasta(path reference_fasta_path,
     // Ensure that the FASTAs are indexed before starting threading
     FastaReader ref_reader = FastaReader(reference_fasta_path_rle);
     FastaReader sequence_reader = FastaReader(reads_fasta_path_rle);
-    ref_reader.index();
-    sequence_reader.index();
+    ref_reader.index(max_threads);
+    sequence_reader.index(max_threads);
 
     // Setup Alignment parameters
     bool sort = true;
@@ -59,19 +59,15 @@ void iterate_pileup_kmers(path bam_path,
     Pileup pileup;
     Region region;
 
+    PileupGenerator pileup_generator = PileupGenerator(absolute_bam_path, 80);
+    FastaReader sequence_reader = FastaReader(absolute_fasta_reads_path);
+
     while (job_index < regions.size()) {
         uint64_t thread_job_index = job_index.fetch_add(1);
         region = regions.at(thread_job_index);
 
-        PileupGenerator pileup_generator = PileupGenerator(absolute_bam_path, 80);
-
-        FastaReader ref_reader = FastaReader(absolute_fasta_ref_path);
-        FastaReader sequence_reader = FastaReader(absolute_fasta_reads_path);
-
         pileup_generator.fetch_region(region, sequence_reader, pileup);
 
-        PileupGenerator::print(pileup);
-
         cerr << "\33[2K\rParsed: " << region.to_string() << flush;
 
         PileupKmerIterator pileup_iterator(pileup, window_size, k);
@@ -200,8 +196,8 @@ void measure_kmer_stats_from_fasta(path reference_fasta_path,
     // Ensure that the FASTAs are indexed before starting threading
     FastaReader ref_reader = FastaReader(reference_fasta_path_rle);
     FastaReader sequence_reader = FastaReader(reads_fasta_path_rle);
-    ref_reader.index();
-    sequence_reader.index();
+    ref_reader.index(max_threads);
+    sequence_reader.index(max_threads);
 
     // Setup Alignment parameters
     bool sort = true;
@@ -0,0 +1,103 @@
+#include "Runlength.hpp"
+#include "Matrix.hpp"
+#include "boost/program_options.hpp"
+#include <experimental/filesystem>
+#include <iostream>
+#include <fstream>
+
+using std::cout;
+using std::cerr;
+using std::ifstream;
+using std::experimental::filesystem::path;
+using std::experimental::filesystem::create_directories;
+using boost::program_options::options_description;
+using boost::program_options::variables_map;
+using boost::program_options::value;
+
+
+void read_input_list(path input_list_path, vector<path>& input_paths){
+    ifstream file(input_list_path);
+
+    if (not file.is_open()){
+        throw runtime_error("ERROR: file could not be read: " + input_list_path.string());
+    }
+
+    string line;
+
+    while (getline(file, line)){
+        if (not line.empty()){
+            input_paths.emplace_back(line);
+        }
+    }
+}
+
+
+void merge_matrices(vector<path>& input_paths, path output_directory){
+    if (input_paths.empty()){
+        throw runtime_error("ERROR: no input matrices provided");
+    }
+
+    create_directories(output_directory);
+
+    // The kind of matrix is given by its number of dimensions, and all the inputs must match the first one
+    vector<uint64_t> shape = read_binary_matrix_shape(input_paths[0]);
+
+    cerr << "Summing " << input_paths.size() << " matrices...\n";
+
+    if (shape.size() == 4){
+        rle_length_matrix matrix;
+        sum_binary_matrix_files(input_paths, matrix);
+        write_length_matrix_to_file(output_directory, matrix);
+    }
+    else if (shape.size() == 3){
+        rle_base_matrix matrix;
+        sum_binary_matrix_files(input_paths, matrix);
+        write_base_matrix_to_file(output_directory, matrix);
+    }
+    else{
+        throw runtime_error("ERROR: not a length or base matrix (" + to_string(shape.size()) + " dimensions): " +
+                            input_paths[0].string());
+    }
+}
+
+
+int main(int argc, char* argv[]){
+    vector<path> input_paths;
+    path input_list_path;
+    path output_dir;
+
+    options_description options("Arguments");
+
+    options.add_options()
+        ("input",
+        value<vector<path> >(&input_paths)->multitoken(),
+        "File paths of one or more binary matrices (e.g. length_frequency_matrix_directional.bin) to be summed")
+
+        ("input_list",
+        value<path>(&input_list_path),
+        "File path of a text file containing one binary matrix path per line, in addition to any --input")
+
+        ("output_dir",
+        value<path>(&output_dir)->
+        default_value("output/"),
+        "Destination directory. The sum is written as binary and CSV, with the same names as the measurement outputs");
+
+    // Store options in a map and apply values to each corresponding variable
+    variables_map vm;
+    store(parse_command_line(argc, argv, options), vm);
+    notify(vm);
+
+    // If help was specified, or no arguments given, provide help
+    if (vm.count("help") || argc == 1) {
+        cout << options << "\n";
+        return 0;
+    }
+
+    if (not input_list_path.empty()){
+        read_input_list(input_list_path, input_paths);
+    }
+
+    merge_matrices(input_paths, output_dir);
+
+    return 0;
+}
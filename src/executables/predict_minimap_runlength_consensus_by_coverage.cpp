@@ -3,6 +3,7 @@
 #include "PileupGenerator.hpp"
 #include "RunlengthReader.hpp"
 #include "RunlengthWriter.hpp"
+#include "WindowedConsensus.hpp"
 #include "SequenceElement.hpp"
 #include "FastaReader.hpp"
 #include "FastaWriter.hpp"
@@ -15,6 +16,7 @@
 #include <mutex>
 #include <atomic>
 #include <exception>
+#include <deque>
 
 using std::exception;
 using std::thread;
@@ -30,20 +32,21 @@ using std::ofstream;
 using std::cout;
 using std::min;
 using std::max;
+using std::deque;
 using boost::program_options::options_description;
 using boost::program_options::variables_map;
 using boost::program_options::value;
 using std::experimental::filesystem::create_directories;
 
 
-void chunk_sequences_into_regions(vector<Region>& regions, vector<RunlengthIndex> indexes, uint64_t chunk_size){
+void chunk_sequences_into_windows(vector<Region>& windows, vector<RunlengthIndex>& indexes, uint64_t window_size, uint64_t overlap){
     ///
-    /// Take all the sequences in some iterable object and chunk their lengths
+    /// Take all the sequences in some iterable object and chunk their lengths into overlapping windows
     ///
 
     // For every sequence
     for (auto& item: indexes){
-        chunk_sequence(regions, item.name, chunk_size, item.sequence_length);
+        chunk_sequence_into_windows(windows, item.name, window_size, overlap, item.sequence_length);
     }
 }
 
@@ -61,10 +64,10 @@ path align_as_runlength(path fasta_ref_path,
     RunlengthSequenceElement runlength_sequence;
 
     FastaReader ref_fasta_reader(fasta_ref_path);
-    ref_fasta_reader.index();
+    ref_fasta_reader.index(max_threads);
 
     FastaReader reads_fasta_reader(fasta_reads_path);
-    reads_fasta_reader.index();
+    reads_fasta_reader.index(max_threads);
 
     FastaWriter ref_fasta_writer(runlength_fasta_ref_path);
     FastaWriter reads_fasta_writer(runlength_fasta_reads_path);
@@ -152,66 +155,52 @@ void append_consensus_sequence(string& consensus_sequence, vector<float>& consen
 }
 
 
-void predict_consensus(PileupGenerator& pileup_generator,
-        RunlengthReader& ref_runlength_reader,
-        RunlengthReader& reads_runlength_reader,
-        Pileup& pileup,
-        Pileup& ref_pileup,
+void predict_consensus(Pileup& pileup,
         SimpleBayesianConsensusCaller& consensus_caller,
-        Region& region,
-        vector<ofstream>& output_files,
-        vector<mutex>& file_write_mutexes,
+        Region& window,
+        size_t window_index,
+        deque<ConsensusStitcher>& stitchers,
         uint32_t max_coverage){
 
-    vector<float> consensus = {4,0};
-    vector<string> consensus_sequences((max_coverage/5));
+    size_t n_checkpoints = max_coverage/5;
+    vector <vector <float> > consensus;
+    vector<WindowConsensus> window_consensus(n_checkpoints, WindowConsensus(window));
 
     for (size_t width_index = 0; width_index<pileup.pileup.size(); width_index++) {
-        vector <vector <float> > column = pileup.pileup[width_index];
-
-        for (int64_t i=(max_coverage/5)-1; i>=0; i--) {
-            // Subset the coverage (iteratively shrinking the vector) IFF the column is bigger than the current value
-            column.resize(min(int64_t(column.size()), (i+1) * 5));
+        // Call consensus on ref columns, at every coverage from 5 to max_coverage in one pass
+        consensus_caller.predictConsensusByCoverage(pileup.pileup[width_index], 5, n_checkpoints, consensus);
 
-            // Call consensus on ref columns
-            consensus_caller(column, consensus);
-            append_consensus_sequence(consensus_sequences[i], consensus);
+        for (size_t i=0; i<n_checkpoints; i++) {
+            append_consensus_sequence(window_consensus[i].sequence, consensus[i]);
         }
 
         // Call consensus on insert columns
         if (pileup.inserts.count(width_index) > 0) {
             for (auto &insert_column: pileup.inserts.at(width_index)) {
-                column = insert_column;
+                consensus_caller.predictConsensusByCoverage(insert_column, 5, n_checkpoints, consensus);
 
-                for (int64_t i = (max_coverage/5)-1; i >= 0; i--) {
-                    column.resize(min(int64_t(column.size()), (i+1) * 5));
-
-                    consensus_caller(column, consensus);
-                    append_consensus_sequence(consensus_sequences[i], consensus);
+                for (size_t i=0; i<n_checkpoints; i++) {
+                    append_consensus_sequence(window_consensus[i].sequence, consensus[i]);
                 }
             }
         }
-    }
 
-    for (size_t i=0; i < (max_coverage/5); i++) {
-        // Add fasta formatting to sequence string
-        if (not consensus_sequences[i].empty()) {
-            consensus_sequences[i] = ">" + region.to_string() + "_coverage-" + to_string((i+1)*5) + "\n" + consensus_sequences[i] + "\n";
+        // The column and its inserts are complete
+        for (auto& item: window_consensus){
+            item.end_column();
         }
+    }
 
-        file_write_mutexes[i].lock();
-        output_files[i] << consensus_sequences[i];
-        file_write_mutexes[i].unlock();
+    for (size_t i=0; i < n_checkpoints; i++) {
+        stitchers[i].add(window_index, window_consensus[i]);
     }
 }
 
 
-void predict_chunk_consensus(path& bam_path,
-        RunlengthReader& ref_runlength_reader,
+void predict_window_consensus(path& bam_path,
         RunlengthReader& reads_runlength_reader,
-        vector<Region>& regions,
-        vector<ofstream>& output_files,
-        vector<mutex>& file_write_mutex,
+        vector<Region>& windows,
+        deque<ConsensusStitcher>& stitchers,
         uint16_t& max_coverage,
         atomic<size_t>& job_index){
 
@@ -223,14 +212,23 @@ void predict_chunk_consensus(path& bam_path,
     SimpleBayesianConsensusCaller consensus_caller(config_path);
 
     Pileup pileup;
-    Pileup ref_pileup;
 
-    while (job_index < regions.size()) {
+    while (job_index < windows.size()) {
         uint64_t thread_job_index = job_index.fetch_add(1);
 
-        pileup_generator.fetch_region(regions[thread_job_index], reads_runlength_reader, pileup);
-        pileup_generator.generate_reference_pileup(pileup, ref_pileup, regions[thread_job_index], ref_runlength_reader);
-        predict_consensus(pileup_generator, ref_runlength_reader, reads_runlength_reader, pileup, ref_pileup, consensus_caller, regions[thread_job_index], output_files, file_write_mutex, max_coverage);
+        if (thread_job_index >= windows.size()){
+            break;
+        }
+
+        // Don't get too far ahead of a slow window, which would leave every window after it pending in the stitchers
+        for (auto& stitcher: stitchers){
+            stitcher.wait_for_capacity(thread_job_index);
+        }
+
+        pileup_generator.fetch_region(windows[thread_job_index], reads_runlength_reader, pileup);
+        predict_consensus(pileup, consensus_caller, windows[thread_job_index], thread_job_index, stitchers, max_coverage);
+
+        cerr << "\33[2K\rParsed: " << windows[thread_job_index].to_string() << flush;
     }
 }
 
@@ -240,33 +238,38 @@ void get_consensus(path bam_path,
         path runlength_reads_path,
         vector <ofstream>& output_files,
         uint16_t max_coverage,
-        uint16_t max_threads){
+        uint16_t max_threads,
+        uint64_t window_size,
+        uint64_t overlap){
+    ///
+    /// Polish each contig as a series of overlapping windows in parallel. The windows' consensus sequences are
+    /// stitched within their overlaps, so that each output file contains one contiguous sequence per contig.
+    ///
 
     RunlengthReader ref_runlength_reader(runlength_ref_path);
     RunlengthReader reads_runlength_reader(runlength_reads_path);
 
-    vector<Region> regions;
-    uint64_t chunk_size = 100*1000;
-    chunk_sequences_into_regions(regions, ref_runlength_reader.indexes, chunk_size);
+    vector<Region> windows;
+    chunk_sequences_into_windows(windows, ref_runlength_reader.indexes, window_size, overlap);
 
-//    vector<Region> regions = {Region("hg38_dna", 2*1000*1000, 2*1000*1000+400*1000)}; //TODO: UNDO THIS TEST
-//    vector<Region> regions = {Region("CM010818.1", 74000000, 74000000+400*1000)}; //TODO: UNDO THIS TEST
+    // One stitcher per coverage level, each of which serializes the writing of its own file
+    deque<ConsensusStitcher> stitchers;
+    for (size_t i=0; i<output_files.size(); i++){
+        stitchers.emplace_back(windows, output_files[i], "_coverage-" + to_string((i+1)*5), 2*size_t(max_threads) + 2);
+    }
 
     vector<thread> threads;
     atomic<size_t> job_index = 0;
-    vector<mutex> file_write_mutexes(output_files.size());
 
     // Launch threads
     for (uint64_t i=0; i<max_threads; i++){
         try {
             // Call thread safe function to read and write to file
-            threads.emplace_back(thread(predict_chunk_consensus,
+            threads.emplace_back(thread(predict_window_consensus,
                     ref(bam_path),
-                    ref(ref_runlength_reader),
                     ref(reads_runlength_reader),
-                    ref(regions),
-                    ref(output_files),
-                    ref(file_write_mutexes),
+                    ref(windows),
+                    ref(stitchers),
                     ref(max_coverage),
                     ref(job_index)));
 
@@ -280,10 +283,23 @@ void get_consensus(path bam_path,
     for (auto& t: threads){
         t.join();
     }
+    cerr << '\n';
+
+    for (auto& stitcher: stitchers){
+        if (stitcher.get_n_pending() > 0){
+            throw runtime_error("ERROR: " + to_string(stitcher.get_n_pending()) + " consensus windows were not stitched");
+        }
+    }
 }
 
 
-void test(path fasta_ref_path, path fasta_reads_path, path output_directory, uint16_t max_threads, uint16_t max_coverage) {
+void test(path fasta_ref_path,
+        path fasta_reads_path,
+        path output_directory,
+        uint16_t max_threads,
+        uint16_t max_coverage,
+        uint64_t window_size,
+        uint64_t overlap) {
     create_directories(output_directory);
 
     // Create filenames for runlength files
@@ -329,7 +345,13 @@ void test(path fasta_ref_path, path fasta_reads_path, path output_directory, uin
             runlength_reads_path,
             output_files,
             max_coverage,
-            max_threads);
+            max_threads,
+            window_size,
+            overlap);
+
+    for (auto& file: output_files){
+        file.close();
+    }
 
     path results_path = output_directory / "results.txt";
     ofstream results_file(results_path);
@@ -365,6 +387,8 @@ int main(int argc, char* argv[]){
     path output_dir;
     uint16_t max_threads;
     uint16_t max_coverage;
+    uint64_t window_size;
+    uint64_t overlap;
 
     options_description options("Arguments");
 
@@ -390,7 +414,18 @@ int main(int argc, char* argv[]){
         ("max_coverage",
         value<uint16_t>(&max_coverage)->
         default_value(120),
-        "Maximum coverage to test at. IF coverage is lower than this, it will still be used as is.");
+        "Maximum coverage to test at. IF coverage is lower than this, it will still be used as is.")
+
+        ("window_size",
+        value<uint64_t>(&window_size)->
+        default_value(100*1000),
+        "Size (in runlength encoded bp) of the windows that are polished in parallel")
+
+        ("overlap",
+        value<uint64_t>(&overlap)->
+        default_value(5*1000),
+        "How far (in runlength encoded bp) each window extends into its neighbors. The consensus of neighboring "
+        "windows is stitched within this overlap.");
 
     // Store options in a map and apply values to each corresponding variable
     variables_map vm;
@@ -408,7 +443,9 @@ int main(int argc, char* argv[]){
             reads_fasta_path,
             output_dir,
             max_threads,
-            max_coverage);
+            max_coverage,
+            window_size,
+            overlap);
 
     return 0;
 }
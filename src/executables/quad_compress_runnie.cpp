@@ -3,6 +3,7 @@
 #include "RunnieReader.hpp"
 #include "QuadLoss.hpp"
 #include "QuadCompressor.hpp"
+#include "CompressionParameterTrainer.hpp"
 #include "boost/program_options.hpp"
 
 using std::cout;
@@ -13,22 +14,46 @@ using std::experimental::filesystem::absolute;
 using boost::program_options::options_description;
 using boost::program_options::variables_map;
 using boost::program_options::value;
+using boost::program_options::bool_switch;
 
 
-void compress_runnie(path input_dir, path output_dir){
-    path script_path = __FILE__;
-    path project_directory = script_path.parent_path().parent_path().parent_path();
-    path output_filename;
-    input_dir = absolute(input_dir);
+void train_compression_parameters(vector<path> input_dirs,
+        path output_dir,
+        uint64_t sample_size,
+        uint64_t n_scale_intervals,
+        uint64_t n_encodings,
+        uint16_t max_threads){
 
-    RunnieReader reader = RunnieReader(input_dir);
-    reader.index();
+    for (auto& input_dir: input_dirs){
+        input_dir = absolute(input_dir);
+    }
 
     float x = 25;
     float y = 25;
 
     float size = 50;
 
+    QuadCoordinate center = QuadCoordinate(x, y);
+    BoundingBox bounds = BoundingBox(center, size/2);
+
+    CompressionParameterTrainer trainer = CompressionParameterTrainer(bounds, 50, max_threads);
+
+    trainer.sample_points(input_dirs, sample_size);
+    trainer.train(n_scale_intervals, n_encodings);
+
+    path output_path = output_dir / "compression_parameters.tsv";
+    trainer.write_parameters(output_path);
+
+    cerr << "WRITING FILE: " << output_path.string() << "\n";
+}
+
+
+void compress_runnie(vector<path> input_dirs, path output_dir){
+    float x = 25;
+    float y = 25;
+
+    float size = 50;
+
     QuadCoordinate center = QuadCoordinate(x, y);
     BoundingBox bounds = BoundingBox(center, size/2);
     QuadCompressor tree = QuadCompressor(bounds);
@@ -40,20 +65,30 @@ void compress_runnie(path input_dir, path output_dir){
 
     size_t cutoff = 10*1000*1000;
     size_t n_bases = 0;
-    for (auto& index: reader.read_indexes){
-        read_name = index.first;
-        reader.fetch_sequence(sequence, read_name);
 
-        for (size_t i=0; i<sequence.scales.size(); i++){
-            scale = sequence.scales[i];
-            shape = sequence.shapes[i];
+    for (auto& input_dir: input_dirs) {
+        RunnieReader reader = RunnieReader(absolute(input_dir));
+        reader.index();
+
+        for (auto& index: reader.read_indexes) {
+            read_name = index.first;
+            reader.fetch_sequence(sequence, read_name);
 
-            tree.insert(QuadCoordinate(scale, shape));
+            for (size_t i = 0; i < sequence.scales.size(); i++) {
+                scale = sequence.scales[i];
+                shape = sequence.shapes[i];
 
-            n_bases++;
+                tree.insert(QuadCoordinate(scale, shape));
+
+                n_bases++;
+            }
+
+            if (n_bases > cutoff) {
+                break;
+            }
         }
 
-        if (n_bases > cutoff){
+        if (n_bases > cutoff) {
             break;
         }
     }
@@ -68,20 +103,51 @@ void compress_runnie(path input_dir, path output_dir){
 
 
 int main(int argc, char* argv[]){
-    path input_dir;
+    vector<path> input_dirs;
     path output_dir;
+    bool train_params;
+    uint64_t sample_size;
+    uint64_t n_scale_intervals;
+    uint64_t n_encodings;
+    uint16_t max_threads;
 
     options_description options("Required options");
 
     options.add_options()
         ("input_dir",
-        value<path>(&input_dir)->required(),
-        "File path of directory containing Runnie .out file containing sequences to be compressed")
+        value<vector<path> >(&input_dirs)->required()->multitoken(),
+        "File path of one or more directories containing Runnie .out files containing sequences to be compressed")
 
         ("output_dir",
         value<path>(&output_dir)->
         default_value("output/"),
-        "Destination directory. File will be named based on input file name");
+        "Destination directory. File will be named based on input file name")
+
+        ("train_params",
+        bool_switch(&train_params)->
+        default_value(false),
+        "Instead of writing quadtree bounds, sample all input directories in parallel and write a compression "
+        "parameters file that can be used directly by CompressedRunnieWriter")
+
+        ("sample_size",
+        value<uint64_t>(&sample_size)->
+        default_value(10*1000*1000),
+        "Approximate number of (scale, shape) points to sample from all input directories combined")
+
+        ("n_scale_intervals",
+        value<uint64_t>(&n_scale_intervals)->
+        default_value(16),
+        "Number of scale intervals (strips) to split the parameter space into")
+
+        ("n_encodings",
+        value<uint64_t>(&n_encodings)->
+        default_value(256),
+        "Total number of (scale, shape) intervals, which must fit in one byte")
+
+        ("max_threads",
+        value<uint16_t>(&max_threads)->
+        default_value(1),
+        "Maximum number of threads to launch");
 
     // Store options in a map and apply values to each corresponding variable
     variables_map vm;
@@ -94,9 +160,16 @@ int main(int argc, char* argv[]){
         return 0;
     }
 
-    cout << "READING DIR: " << string(input_dir) << "\n";
+    for (auto& input_dir: input_dirs) {
+        cout << "READING DIR: " << string(input_dir) << "\n";
+    }
 
-    compress_runnie(input_dir, output_dir);
+    if (train_params){
+        train_compression_parameters(input_dirs, output_dir, sample_size, n_scale_intervals, n_encodings, max_threads);
+    }
+    else {
+        compress_runnie(input_dirs, output_dir);
+    }
 
     return 0;
 }
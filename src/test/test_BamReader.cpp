@@ -323,5 +323,103 @@ int main() {
         cout << aligned_segment.to_string() << "\n";
     }
 
+    cout << "\nTESTING MULTI-REGION ITERATION: ";
+
+    // Every alignment overlaps the whole region, so each one should be yielded exactly once by overlapping regions
+    bam_reader.initialize_region(ref_name, 0, 1337);
+
+    vector<string> expected_names;
+    while (bam_reader.next_alignment(aligned_segment)) {
+        expected_names.emplace_back(aligned_segment.read_name);
+    }
+
+    vector<Region> regions = {Region(ref_name, 900, 1000),
+                              Region(ref_name, 0, 300),
+                              Region(ref_name, 200, 500),
+                              Region("not_a_contig", 0, 1000)};
+
+    bam_reader.initialize_regions(regions);
+
+    vector<string> names;
+    while (bam_reader.next_alignment(aligned_segment)) {
+        names.emplace_back(aligned_segment.read_name);
+    }
+
+    assert(not expected_names.empty());
+    assert(names == expected_names);
+
+    // Regions on unknown contigs, or past the end of the reference, yield nothing
+    regions = {Region("not_a_contig", 0, 1000), Region(ref_name, 5000, 6000)};
+    bam_reader.initialize_regions(regions);
+    assert(not bam_reader.next_alignment(aligned_segment));
+
+    regions = {};
+    bam_reader.initialize_regions(regions);
+    assert(not bam_reader.next_alignment(aligned_segment));
+
+    cout << "PASS\n";
+
+    cout << "TESTING CHUNK OWNERSHIP: ";
+
+    // Every alignment belongs to exactly one chunk, however many chunks it spans
+    vector <pair <string, int64_t> > expected_alignments;
+    vector <pair <string, int64_t> > alignments;
+
+    bam_reader.initialize_region(ref_name, 0, ref_sequence.sequence.size());
+    while (bam_reader.next_alignment(aligned_segment)) {
+        expected_alignments.emplace_back(aligned_segment.read_name, aligned_segment.ref_start_index);
+    }
+
+    vector<Region> chunks;
+    chunk_sequence(chunks, ref_name, 100, ref_sequence.sequence.size());
+
+    for (auto& chunk: chunks){
+        initialize_chunk(bam_reader, chunk);
+
+        while (bam_reader.next_alignment(aligned_segment)) {
+            alignments.emplace_back(aligned_segment.read_name, aligned_segment.ref_start_index);
+        }
+    }
+
+    sort(expected_alignments.begin(), expected_alignments.end());
+    sort(alignments.begin(), alignments.end());
+    assert(alignments == expected_alignments);
+
+    // With a BED, only the alignments that overlap its intervals are fetched, each by exactly one chunk
+    vector<Region> bed_intervals = {Region(ref_name, 50, 60), Region(ref_name, 150, 420), Region(ref_name, 850, 870)};
+    IntervalIndex bed_index(bed_intervals);
+    vector<Region> bed_regions;
+
+    expected_alignments.clear();
+    alignments.clear();
+
+    bam_reader.initialize_region(ref_name, 0, ref_sequence.sequence.size());
+    while (bam_reader.next_alignment(aligned_segment)) {
+        vector<size_t> overlaps;
+        bed_index.find_overlaps(ref_name,
+                                aligned_segment.ref_start_index - 1,
+                                aligned_segment.infer_reference_stop_position_from_alignment(),
+                                overlaps);
+
+        if (not overlaps.empty()){
+            expected_alignments.emplace_back(aligned_segment.read_name, aligned_segment.ref_start_index);
+        }
+    }
+
+    for (auto& chunk: chunks){
+        initialize_chunk(bam_reader, bed_index, chunk, bed_regions);
+
+        while (bam_reader.next_alignment(aligned_segment)) {
+            alignments.emplace_back(aligned_segment.read_name, aligned_segment.ref_start_index);
+        }
+    }
+
+    sort(expected_alignments.begin(), expected_alignments.end());
+    sort(alignments.begin(), alignments.end());
+    assert(not expected_alignments.empty());
+    assert(alignments == expected_alignments);
+
+    cout << "PASS\n";
+
     return 0;
 }
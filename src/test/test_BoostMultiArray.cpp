@@ -1,9 +1,112 @@
 #include "Matrix.hpp"
+#include <experimental/filesystem>
+#include <assert.h>
+
+using std::experimental::filesystem::temp_directory_path;
+using std::experimental::filesystem::create_directories;
+using std::experimental::filesystem::remove_all;
+using std::experimental::filesystem::resize_file;
+using std::experimental::filesystem::file_size;
 
 
 int main(){
+    path directory = temp_directory_path() / "test_BoostMultiArray";
+    remove_all(directory);
+    create_directories(directory);
+
+    cout << "TESTING BINARY MATRIX ROUND TRIP\n";
+
+    RLEConfusion a(50);
+    a.length_matrix[0][1][2][3] = 7;
+    a.length_matrix[1][3][50][0] = 1.5;
+    a.base_matrix[1][2][3] = 4;
+
+    path a_path = directory / "a.bin";
+    write_matrix_to_binary_file(a_path, a.length_matrix);
+
+    vector<uint64_t> shape = read_binary_matrix_shape(a_path);
+    assert((shape == vector<uint64_t>{2, 4, 51, 51}));
+
+    rle_length_matrix a_read;
+    read_matrix_from_binary_file(a_path, a_read);
+    assert(a_read == a.length_matrix);
+
+    cout << "TESTING BINARY MATRIX SUM\n";
+
+    RLEConfusion b(50);
+    b.length_matrix[0][1][2][3] = 1;
+    b.length_matrix[0][0][0][0] = 2;
+
+    path b_path = directory / "b.bin";
+    write_matrix_to_binary_file(b_path, b.length_matrix);
+
+    rle_length_matrix sum;
+    sum_binary_matrix_files({a_path, b_path, b_path}, sum);
+
+    assert(sum[0][1][2][3] == 9);
+    assert(sum[1][3][50][0] == 1.5);
+    assert(sum[0][0][0][0] == 4);
+    assert(sum[1][1][1][1] == 0);
+
+    cout << "TESTING BINARY MATRIX SHAPE MISMATCH\n";
+
+    RLEConfusion c(10);
+    path c_path = directory / "c.bin";
+    write_matrix_to_binary_file(c_path, c.length_matrix);
+
+    bool threw = false;
+    try {
+        sum_binary_matrix_files({a_path, c_path}, sum);
+    }
+    catch (const runtime_error& e){
+        cout << e.what() << '\n';
+        threw = true;
+    }
+    assert(threw);
+
+    // A base matrix has a different number of dimensions than a length matrix
+    path base_path = directory / "base.bin";
+    write_matrix_to_binary_file(base_path, a.base_matrix);
+
+    threw = false;
+    try {
+        read_matrix_from_binary_file(base_path, a_read);
+    }
+    catch (const runtime_error& e){
+        cout << e.what() << '\n';
+        threw = true;
+    }
+    assert(threw);
+
+    cout << "TESTING TRUNCATED BINARY MATRIX\n";
+
+    resize_file(b_path, file_size(b_path) - 8);
+
+    threw = false;
+    try {
+        read_matrix_from_binary_file(b_path, a_read);
+    }
+    catch (const runtime_error& e){
+        cout << e.what() << '\n';
+        threw = true;
+    }
+    assert(threw);
+
+    // Cut inside the header, after the magic
+    resize_file(b_path, 12);
 
+    threw = false;
+    try {
+        read_binary_matrix_shape(b_path);
+    }
+    catch (const runtime_error& e){
+        cout << e.what() << '\n';
+        threw = string(e.what()).find("truncated") != string::npos;
+    }
+    assert(threw);
 
+    remove_all(directory);
+    cout << "PASS\n";
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,234 @@
+#include "Checkpoint.hpp"
+#include "BamReader.hpp"
+#include "Matrix.hpp"
+#include <experimental/filesystem>
+#include <iostream>
+#include <fstream>
+#include <assert.h>
+
+using std::experimental::filesystem::temp_directory_path;
+using std::experimental::filesystem::remove_all;
+using std::experimental::filesystem::exists;
+using std::experimental::filesystem::remove;
+using std::experimental::filesystem::create_directories;
+using std::cout;
+using std::ofstream;
+
+
+void write_text_file(path file_path, const string& text){
+    ofstream file(file_path);
+    file << text;
+}
+
+
+void test_cigar_stats(path output_directory){
+    vector<Region> regions = {Region("a", 0, 99), Region("a", 100, 199), Region("b", 0, 99), Region("b", 100, 199)};
+
+    // Stand-ins for the reads and reference, and a directory of coverage files
+    path input_directory = output_directory / "input";
+    create_directories(input_directory);
+    write_text_file(output_directory / "reads.fasta", ">a\nACGT\n");
+    write_text_file(input_directory / "a.tsv", "0\n");
+    vector<path> input_paths = {output_directory / "reads.fasta", input_directory};
+
+    cout << "TESTING PREEMPTED RUN\n";
+
+    // Two threads complete one region each (saving every time), then the run stops
+    {
+        Checkpoint checkpoint(output_directory, regions, input_paths, 2, false, 1e-9);
+
+        CigarStats stats_0;
+        stats_0.n_matches = 10;
+        stats_0.cigar_lengths[7][10] = 1;
+        checkpoint.update(0, 0, stats_0);
+
+        CigarStats stats_1;
+        stats_1.n_mismatches = 3;
+        stats_1.cigar_lengths[8][3] = 1;
+        checkpoint.update(1, 2, stats_1);
+    }
+
+    cout << "TESTING CHECKPOINTS WITHOUT RESUME\n";
+
+    bool threw = false;
+    try {
+        Checkpoint checkpoint(output_directory, regions, input_paths, 2, false, 1e-9);
+    }
+    catch (const runtime_error& e){
+        threw = true;
+    }
+    assert(threw);
+
+    cout << "TESTING CHECKPOINTS WITH DIFFERENT REGIONS\n";
+
+    threw = false;
+    try {
+        vector<Region> other_regions = {Region("a", 0, 199), Region("b", 0, 199)};
+        Checkpoint checkpoint(output_directory, other_regions, input_paths, 2, true, 1e-9);
+    }
+    catch (const runtime_error& e){
+        threw = true;
+    }
+    assert(threw);
+
+    cout << "TESTING CHECKPOINTS WITH DIFFERENT INPUTS\n";
+
+    threw = false;
+    try {
+        vector<path> other_input_paths = {input_directory, output_directory / "reads.fasta"};
+        Checkpoint checkpoint(output_directory, regions, other_input_paths, 2, true, 1e-9);
+    }
+    catch (const runtime_error& e){
+        threw = true;
+    }
+    assert(threw);
+
+    // A file of the same name with different contents
+    write_text_file(output_directory / "reads.fasta", ">a\nACGTACGT\n");
+
+    threw = false;
+    try {
+        Checkpoint checkpoint(output_directory, regions, input_paths, 2, true, 1e-9);
+    }
+    catch (const runtime_error& e){
+        threw = true;
+    }
+    assert(threw);
+
+    write_text_file(output_directory / "reads.fasta", ">a\nACGT\n");
+
+    // A file added to the input directory
+    write_text_file(input_directory / "b.tsv", "0\n");
+
+    threw = false;
+    try {
+        Checkpoint checkpoint(output_directory, regions, input_paths, 2, true, 1e-9);
+    }
+    catch (const runtime_error& e){
+        threw = true;
+    }
+    assert(threw);
+
+    remove(input_directory / "b.tsv");
+
+    cout << "TESTING UNRELATED FILES IN CHECKPOINT DIRECTORY\n";
+
+    // Files that look like checkpoints but aren't named like one must be skipped, and left in place
+    vector<path> stray_paths = {
+            output_directory / "checkpoint" / "checkpoint_foo.bin",
+            output_directory / "checkpoint" / "checkpoint_1.bin",
+            output_directory / "checkpoint" / "checkpoint_1_x.bin",
+            output_directory / "checkpoint" / "checkpoint_99999999999999999999999_0.bin"};
+
+    for (auto& stray_path: stray_paths){
+        write_text_file(stray_path, "not a checkpoint");
+    }
+
+    cout << "TESTING RESUMED RUN\n";
+
+    // The resumed run skips the completed regions, completes the rest with one thread, and is preempted again
+    {
+        Checkpoint checkpoint(output_directory, regions, input_paths, 1, true, 1e-9);
+        assert(checkpoint.get_n_completed() == 2);
+        assert(checkpoint.is_completed(0) and checkpoint.is_completed(2));
+        assert(not checkpoint.is_completed(1) and not checkpoint.is_completed(3));
+
+        CigarStats stats;
+        stats.n_matches = 5;
+        stats.cigar_lengths[7][5] = 1;
+        checkpoint.update(0, 1, stats);
+
+        stats.n_inserts = 1;
+        stats.cigar_lengths[1][1] = 1;
+        checkpoint.update(0, 3, stats);
+    }
+
+    cout << "TESTING LOADING ALL RUNS\n";
+
+    Checkpoint checkpoint(output_directory, regions, input_paths, 1, true, 1e-9);
+    assert(checkpoint.get_n_completed() == 4);
+
+    CigarStats total;
+    checkpoint.load(total);
+
+    cout << total.to_string(true) << '\n';
+
+    assert(total.n_matches == 15);
+    assert(total.n_mismatches == 3);
+    assert(total.n_inserts == 1);
+    assert(total.n_deletes == 0);
+    assert(total.cigar_lengths[7][10] == 1);
+    assert(total.cigar_lengths[7][5] == 1);
+    assert(total.cigar_lengths[8][3] == 1);
+    assert(total.cigar_lengths[1][1] == 1);
+
+    cout << "TESTING REMOVING CHECKPOINTS\n";
+
+    checkpoint.remove_files();
+
+    for (auto& stray_path: stray_paths){
+        assert(exists(stray_path));
+        remove(stray_path);
+    }
+
+    checkpoint.remove_files();
+    assert(not exists(checkpoint.directory));
+
+    Checkpoint new_checkpoint(output_directory, regions, input_paths, 1, false, 1e-9);
+    assert(new_checkpoint.get_n_completed() == 0);
+}
+
+
+void test_length_matrix(path output_directory){
+    vector<Region> regions = {Region("a", 0, 99), Region("a", 100, 199)};
+    vector<path> input_paths;
+
+    cout << "TESTING LENGTH MATRIX CHECKPOINT\n";
+
+    {
+        Checkpoint checkpoint(output_directory, regions, input_paths, 1, false, 1e-9);
+
+        rle_length_matrix matrix(boost::extents[2][4][11][11]);
+        matrix[0][1][2][3] = 4;
+        matrix[1][3][10][0] = 0.5;
+        checkpoint.update(0, 1, matrix);
+    }
+
+    Checkpoint checkpoint(output_directory, regions, input_paths, 1, true, 1e-9);
+    assert(checkpoint.is_completed(1) and not checkpoint.is_completed(0));
+
+    rle_length_matrix matrix(boost::extents[2][4][11][11]);
+    matrix[0][1][2][3] = 1;
+    checkpoint.load(matrix);
+
+    assert(matrix[0][1][2][3] == 5);
+    assert(matrix[1][3][10][0] == 0.5);
+    assert(matrix[0][0][0][0] == 0);
+
+    cout << "TESTING LENGTH MATRIX WITH DIFFERENT SHAPE\n";
+
+    bool threw = false;
+    try {
+        rle_length_matrix other_matrix(boost::extents[2][4][51][51]);
+        checkpoint.load(other_matrix);
+    }
+    catch (const runtime_error& e){
+        threw = true;
+    }
+    assert(threw);
+}
+
+
+int main(){
+    path output_directory = temp_directory_path() / "test_Checkpoint";
+    remove_all(output_directory);
+    test_cigar_stats(output_directory);
+
+    remove_all(output_directory);
+    test_length_matrix(output_directory);
+
+    remove_all(output_directory);
+    cout << "PASS\n";
+
+    return 0;
+}
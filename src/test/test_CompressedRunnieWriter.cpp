@@ -2,6 +2,7 @@
 #include "CompressedRunnieWriter.hpp"
 #include "CompressedRunnieReader.hpp"
 #include "DiscreteWeibull.hpp"
+#include <assert.h>
 
 
 void write_file(path absolute_output_path, path absolute_config_path, vector <pair <double,double> >& centroids){
@@ -35,6 +36,27 @@ void write_file(path absolute_output_path, path absolute_config_path, vector <pa
 
    writer.write_indexes();
 
+   cout << "TESTING BATCHED ENCODING\n";
+
+   // Include values outside of the bounds and a length that isn't a multiple of the block size
+   vector<float> scales = {-1, 0, 1000};
+   vector<float> shapes = {-1, 1000, 0};
+
+   for (auto& centroid: centroids){
+       for (double offset: {-0.05, 0.0, 0.05}){
+           scales.push_back(centroid.first + offset);
+           shapes.push_back(centroid.second + offset);
+       }
+   }
+
+   vector<uint8_t> encodings;
+   writer.fetch_encodings(encodings, scales, shapes);
+
+   assert(encodings.size() == scales.size());
+   for (size_t i=0; i<scales.size(); i++){
+       assert(encodings[i] == writer.fetch_encoding(scales[i], shapes[i]));
+   }
+
    //    i = 0;
 //    for (auto& params: centroids){
 //        cout << params.first << " " << params.second << " " << int(writer.fetch_encoding(params.first, params.second)) << '\n' << std::flush;
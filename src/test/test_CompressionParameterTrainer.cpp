@@ -0,0 +1,84 @@
+#include "CompressionParameterTrainer.hpp"
+#include <iostream>
+#include <random>
+#include <algorithm>
+#include <assert.h>
+
+using std::cout;
+using std::mt19937;
+using std::uniform_real_distribution;
+using std::shuffle;
+
+
+void sample_test_points(vector<QuadCoordinate>& points){
+    mt19937 generator(0);
+
+    // Scales and shapes from a few clusters, to give the loss something to split
+    uniform_real_distribution<float> x_distribution(0.5, 10);
+    uniform_real_distribution<float> y_distribution(0.5, 4);
+    uniform_real_distribution<float> noise(-0.5, 0.5);
+
+    for (size_t i=0; i<40000; i++){
+        float x = x_distribution(generator);
+        float y = y_distribution(generator);
+
+        if (i % 3 == 0){
+            x = 2 + noise(generator);
+            y = 1.5 + noise(generator);
+        }
+
+        points.emplace_back(x, y);
+    }
+}
+
+
+void assert_equal_parameters(CompressionParameterTrainer& a, CompressionParameterTrainer& b){
+    assert(a.scale_intervals == b.scale_intervals);
+    assert(a.shape_bounds == b.shape_bounds);
+}
+
+
+int main(){
+    BoundingBox bounds = BoundingBox(QuadCoordinate(25, 25), 25);
+
+    vector<QuadCoordinate> points;
+    sample_test_points(points);
+
+    uint64_t n_scale_intervals = 8;
+    uint64_t n_encodings = 64;
+
+    cout << "TESTING SINGLE THREADED TRAINING\n";
+
+    CompressionParameterTrainer single_trainer(bounds, 50, 1);
+    single_trainer.points = points;
+    single_trainer.train(n_scale_intervals, n_encodings);
+
+    assert(single_trainer.scale_intervals.size() == n_scale_intervals);
+    assert(single_trainer.shape_bounds.size() == n_scale_intervals);
+
+    cout << "TESTING MULTITHREADED TRAINING\n";
+
+    CompressionParameterTrainer trainer(bounds, 50, 4);
+    trainer.points = points;
+    trainer.train(n_scale_intervals, n_encodings);
+    assert_equal_parameters(trainer, single_trainer);
+
+    cout << "TESTING REPEATED MULTITHREADED TRAINING\n";
+
+    // The worker pool is restarted, and the points are left in a different order by the previous call
+    for (size_t i=0; i<3; i++){
+        trainer.train(n_scale_intervals, n_encodings);
+        assert_equal_parameters(trainer, single_trainer);
+    }
+
+    cout << "TESTING UNSORTED POINTS\n";
+
+    mt19937 generator(1);
+    shuffle(trainer.points.begin(), trainer.points.end(), generator);
+    trainer.train(n_scale_intervals, n_encodings);
+    assert_equal_parameters(trainer, single_trainer);
+
+    cout << "PASS\n";
+
+    return 0;
+}
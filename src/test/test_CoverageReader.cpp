@@ -0,0 +1,92 @@
+#include "CoverageWriter.hpp"
+#include "CoverageReader.hpp"
+#include "ShastaReader.hpp"
+#include "MarginPolishReader.hpp"
+#include <iostream>
+#include <assert.h>
+
+using std::cout;
+
+
+bool is_equal(CoverageSegment& a, CoverageSegment& b){
+    if (a.sequence != b.sequence or a.lengths != b.lengths or a.is_vertex != b.is_vertex or a.n_coverage != b.n_coverage){
+        return false;
+    }
+    if (a.coverage_offsets != b.coverage_offsets or a.coverage_bases != b.coverage_bases or
+        a.coverage_lengths != b.coverage_lengths or a.coverage_weights != b.coverage_weights){
+        return false;
+    }
+    return true;
+}
+
+
+template <typename T> void test_conversion(path input_directory, path output_path, bool store_length_consensus, bool store_vertex_labels){
+    cout << "TESTING " << input_directory << "\n";
+
+    T directory_reader = T(input_directory);
+    configure_reader(directory_reader);
+    directory_reader.index();
+    unordered_map<string,path> read_paths = directory_reader.get_index();
+
+    // Pack the directory
+    CoverageWriter writer(output_path, store_length_consensus, store_vertex_labels);
+    CoverageSegment segment;
+
+    for (auto& element: read_paths){
+        string name = element.first;
+        directory_reader.fetch_read(segment, name);
+        segment.name = name;
+        writer.write_segment(segment);
+    }
+    writer.write_indexes();
+
+    // Read it back, and compare to the original directory
+    CoverageReader reader(output_path);
+    reader.store_length_consensus = store_length_consensus;
+    reader.store_vertex_labels = store_vertex_labels;
+    reader.index();
+
+    CoverageSegment expected_segment;
+
+    for (auto& element: reader.get_index()){
+        string name = element.first;
+        directory_reader.fetch_read(expected_segment, name);
+        reader.fetch_read(segment, name);
+
+        cout << name << " n_positions: " << segment.sequence.size() << '\n';
+        assert(is_equal(segment, expected_segment));
+
+        directory_reader.fetch_consensus_sequence(expected_segment, name);
+        reader.fetch_consensus_sequence(segment, name);
+
+        assert(segment.sequence == expected_segment.sequence);
+    }
+
+    // Iterate by position in file
+    for (size_t i=0; i<reader.get_read_count(); i++){
+        reader.fetch_read(segment, i);
+        cout << i << " " << reader.get_read_name(i) << '\n';
+        segment.print();
+    }
+}
+
+
+int main(){
+    path script_path = __FILE__;
+    path project_directory = script_path.parent_path().parent_path().parent_path();
+
+    path shasta_path = project_directory / "/data/test/shasta/";
+    path marginpolish_path = project_directory / "/data/test/marginpolish/";
+
+    path output_directory = project_directory / "/output/";
+
+    cout << "SHASTA:\n";
+    test_conversion<ShastaReader>(shasta_path, output_directory / "test_CoverageReader_shasta.bin", true, true);
+
+    cout << "\nMARGINPOLISH:\n";
+    test_conversion<MarginPolishReader>(marginpolish_path, output_directory / "test_CoverageReader_marginpolish.bin", false, false);
+
+    cout << "PASS\n";
+
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include "CoverageSegment.hpp"
+#include <iostream>
+#include <limits>
+#include <assert.h>
+
+using std::cout;
+using std::numeric_limits;
+
+
+int main(){
+    cout << "TESTING BASE PACKING\n";
+
+    string bases = "ACGTN_-acgtn";
+
+    for (char base: bases){
+        for (bool reversal: {false, true}){
+            uint8_t packed_base = CoverageSegment::pack_base(base, reversal);
+
+            assert(CoverageSegment::unpack_base(packed_base) == base);
+            assert(CoverageSegment::unpack_reversal(packed_base) == reversal);
+        }
+    }
+
+    // Any 7 bit character fits alongside the reversal flag
+    for (int c=0; c<128; c++){
+        for (bool reversal: {false, true}){
+            uint8_t packed_base = CoverageSegment::pack_base(char(c), reversal);
+
+            assert(CoverageSegment::unpack_base(packed_base) == char(c));
+            assert(CoverageSegment::unpack_reversal(packed_base) == reversal);
+        }
+    }
+
+    cout << "TESTING OBSERVATION ROUND TRIP\n";
+
+    uint16_t max_length = numeric_limits<uint16_t>::max();
+    vector<uint16_t> lengths = {0, 1, 2, 255, 256, uint16_t(max_length - 1), max_length};
+
+    CoverageSegment segment;
+
+    // One position per base, with every length and both reversal flags at each
+    for (char base: bases){
+        for (auto length: lengths){
+            for (bool reversal: {false, true}){
+                segment.add_observation(base, length, reversal, float(length)/2);
+            }
+        }
+        segment.end_position();
+    }
+
+    assert(segment.n_positions() == bases.size());
+    assert(segment.n_observations() == bases.size()*lengths.size()*2);
+
+    for (size_t i=0; i<bases.size(); i++){
+        CoveragePileup pileup = segment.get_pileup(i);
+        assert(pileup.size() == lengths.size()*2);
+
+        size_t j = 0;
+        for (auto length: lengths){
+            for (bool reversal: {false, true}){
+                CoverageElement element = pileup[j];
+
+                assert(element.base == bases[i]);
+                assert(element.length == length);
+                assert(element.reversal == reversal);
+                assert(element.weight == float(length)/2);
+                j++;
+            }
+        }
+    }
+
+    cout << "TESTING CLEAR\n";
+
+    segment.clear();
+    assert(segment.n_positions() == 0);
+    assert(segment.n_observations() == 0);
+
+    segment.add_observation('_', max_length, true, 1);
+    segment.end_position();
+
+    CoverageElement element = segment.get_observation(0);
+    assert(element.base == '_' and element.length == max_length and element.reversal);
+
+    cout << "PASS\n";
+
+    return 0;
+}
@@ -1,10 +1,154 @@
 #include "FastaReader.hpp"
+#include "FastaTable.hpp"
 #include <iostream>
 #include <experimental/filesystem>
+#include <fstream>
+#include <thread>
+#include <chrono>
 #include <assert.h>
 
 using std::cout;
 using std::experimental::filesystem::path;
+using std::experimental::filesystem::create_directories;
+using std::experimental::filesystem::remove_all;
+using std::experimental::filesystem::remove;
+using std::experimental::filesystem::temp_directory_path;
+using std::experimental::filesystem::file_size;
+using std::experimental::filesystem::last_write_time;
+using std::ofstream;
+using std::chrono::milliseconds;
+using std::this_thread::sleep_for;
+using std::ifstream;
+using std::thread;
+using std::ref;
+using std::to_string;
+
+
+string read_text_file(path file_path){
+    ifstream file(file_path);
+    return string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+
+string to_fai_string(vector <vector <FastaIndexRecord> >& chunk_records){
+    string fai;
+
+    for (auto& records: chunk_records){
+        for (auto& record: records){
+            fai += record.name + '\t' + to_string(record.length) + '\t' + to_string(record.byte_index) + '\t' +
+                   to_string(record.line_bases) + '\t' + to_string(record.line_width) + '\n';
+        }
+    }
+
+    return fai;
+}
+
+
+string index_in_chunks(const string& fasta, uint64_t chunk_size, uint16_t max_threads){
+    ///
+    /// Index a FASTA held in memory the way build_fasta_index does, with chunks of any size
+    ///
+    vector <pair <uint64_t, uint64_t> > chunk_bounds;
+    for (uint64_t start=0; start<fasta.size(); start+=chunk_size){
+        chunk_bounds.emplace_back(start, std::min(start + chunk_size, uint64_t(fasta.size())));
+    }
+
+    vector <vector <FastaIndexRecord> > chunk_records(chunk_bounds.size());
+    atomic<uint64_t> job_index = 0;
+    vector<thread> threads;
+
+    for (uint16_t i=0; i<max_threads; i++){
+        threads.emplace_back(index_fasta_chunks,
+                             fasta.data(),
+                             fasta.size(),
+                             ref(chunk_bounds),
+                             ref(chunk_records),
+                             ref(job_index));
+    }
+
+    for (auto& t: threads){
+        t.join();
+    }
+
+    return to_fai_string(chunk_records);
+}
+
+
+void test_chunked_index(){
+    cout << "\nCHUNKED INDEX TEST: \n";
+
+    path directory = temp_directory_path() / "test_FastaReader";
+    remove_all(directory);
+    create_directories(directory);
+    path fasta_path = directory / "chunked.fasta";
+
+    // Headers with descriptions, sequences wrapped at different widths, CRLF line endings, an empty sequence, and no
+    // newline at the end of the file
+    string fasta;
+    string bases = "ACGT";
+    uint64_t n = 0;
+
+    for (size_t i=0; i<12; i++){
+        size_t length = 13*i + (i % 3)*50;
+        size_t width = (i % 2 == 0) ? 60 : 7;
+        string newline = (i == 5) ? "\r\n" : "\n";
+
+        fasta += ">sequence_" + to_string(i) + ((i % 4 == 0) ? " some description" : "") + newline;
+
+        for (size_t j=0; j<length; j++){
+            fasta += bases[(n++*7) % 4];
+            if ((j + 1) % width == 0 or j + 1 == length){
+                fasta += newline;
+            }
+        }
+    }
+    fasta += ">last\nACGTACGT";
+
+    {
+        ofstream file(fasta_path);
+        file << fasta;
+    }
+
+    FastaReader reader(fasta_path);
+    reader.build_fasta_index(1);
+    string expected = read_text_file(reader.index_path);
+
+    cout << "Testing single chunk: ";
+    assert(index_in_chunks(fasta, fasta.size(), 1) == expected);
+    cout << "PASS\n";
+
+    // With a chunk size of 1, every byte is a chunk start: inside headers, inside sequence lines, and on each '>'
+    cout << "Testing every chunk size: ";
+    for (uint64_t chunk_size=1; chunk_size<=fasta.size(); chunk_size++){
+        assert(index_in_chunks(fasta, chunk_size, 3) == expected);
+    }
+    cout << "PASS\n";
+
+    cout << "Testing multithreaded build_fasta_index: ";
+    for (uint64_t minimum_chunk_size: {1, 7, 61, 200}){
+        remove(reader.index_path);
+        reader.build_fasta_index(4, minimum_chunk_size);
+        assert(read_text_file(reader.index_path) == expected);
+    }
+    cout << "PASS\n";
+
+    cout << "Testing fetch from multithreaded index: ";
+    remove(reader.index_path);
+    reader.build_fasta_index(4, 1);
+    reader.index(4);
+
+    SequenceElement element;
+    string name = "sequence_5";
+    reader.get_sequence(element, name);
+    assert(element.sequence.size() == 13*5 + 2*50);
+
+    name = "last";
+    reader.get_sequence(element, name);
+    assert(element.sequence == "ACGTACGT");
+    cout << "PASS\n";
+
+    remove_all(directory);
+}
 
 
 int main(){
@@ -97,6 +241,155 @@ int main(){
     assert(element.sequence == "GGGGTTTGGT");
     cout << "PASS\n";
 
+
+    cout << "\nCOMPACT INDEX TEST: \n";
+
+    cout << "Testing lookup of every sequence: ";
+    CompactFastaIndex compact_index(fasta_reader.compact_index_path);
+    assert(compact_index.size() == 4);
+
+    for (size_t i=0; i<compact_index.size(); i++){
+        assert(compact_index.find(compact_index.get_name(i)) == int64_t(i));
+    }
+    assert(compact_index.get_name(2) == "test3");
+    assert(compact_index.get_index(2).size() == 30);
+    cout << "PASS\n";
+
+    cout << "Testing missing sequence: ";
+    assert(compact_index.find("test5") == -1);
+    assert(compact_index.find("test") == -1);
+    cout << "PASS\n";
+
+    cout << "Testing adopted index: ";
+    FastaReader adopting_reader(absolute_data_path);
+    adopting_reader.adopt_index(fasta_reader);
+    assert(adopting_reader.compact_index == fasta_reader.compact_index);
+
+    sequence_name = "test3";
+    adopting_reader.get_sequence(element, sequence_name);
+    assert(element.sequence == "GGGGTTTGGTGGGGTTTGGTGGGGTTTGGT");
+    cout << "PASS\n";
+
+    cout << "Testing index of a FASTA edited in place: ";
+    {
+        path edited_directory = temp_directory_path() / "test_FastaReader_edited";
+        remove_all(edited_directory);
+        create_directories(edited_directory);
+        path edited_path = edited_directory / "edited.fasta";
+
+        ofstream edited_file(edited_path);
+        edited_file << ">a\nACGT\n";
+        edited_file.close();
+
+        {
+            FastaReader edited_reader(edited_path);
+            edited_reader.index();
+            assert(CompactFastaIndex::is_up_to_date(edited_reader.compact_index_path, edited_reader.index_path, edited_path));
+        }
+
+        // Same size, different name. Modification times can be as coarse as the kernel tick, so don't rewrite too soon.
+        sleep_for(milliseconds(50));
+        edited_file.open(edited_path);
+        edited_file << ">b\nTTTT\n";
+        edited_file.close();
+
+        {
+            FastaReader edited_reader(edited_path);
+            assert(not CompactFastaIndex::is_up_to_date(edited_reader.compact_index_path, edited_reader.index_path, edited_path));
+            assert(not CompactFastaIndex::is_fai_up_to_date(edited_reader.compact_index_path, edited_reader.index_path, edited_path));
+
+            // The .fai and the compact index are both rebuilt from the edited FASTA
+            edited_reader.index();
+            assert(edited_reader.compact_index->size() == 1);
+            assert(edited_reader.compact_index->find("a") == -1);
+
+            string edited_name = "b";
+            edited_reader.get_sequence(element, edited_name);
+            assert(element.sequence == "TTTT");
+        }
+
+        // Different names, sizes and offsets
+        sleep_for(milliseconds(50));
+        edited_file.open(edited_path);
+        edited_file << ">first sequence\nAAAAAAAA\nCC\n>second\nGGG\n";
+        edited_file.close();
+
+        {
+            FastaReader edited_reader(edited_path);
+            edited_reader.index();
+            assert(edited_reader.compact_index->size() == 2);
+            assert(edited_reader.compact_index->find("b") == -1);
+
+            FastaIndex second_index;
+            assert(edited_reader.compact_index->find("second", second_index));
+            assert(second_index.byte_index == string(">first sequence\nAAAAAAAA\nCC\n>second\n").size());
+            assert(second_index.length == 3);
+
+            string edited_name = "second";
+            edited_reader.get_sequence(element, edited_name);
+            assert(element.sequence == "GGG");
+
+            edited_name = "first";
+            edited_reader.get_sequence(element, edited_name);
+            assert(element.sequence == "AAAAAAAACC");
+        }
+
+        // An edit that leaves the FASTA no newer than the .fai (e.g. within one tick of the clock) is found from the
+        // compact index's record of the FASTA
+        edited_file.open(edited_path);
+        edited_file << ">c\nA\n";
+        edited_file.close();
+        last_write_time(edited_path, last_write_time(edited_path.string() + ".fai"));
+
+        {
+            FastaReader edited_reader(edited_path);
+            edited_reader.index();
+            assert(edited_reader.compact_index->size() == 1);
+
+            string edited_name = "c";
+            edited_reader.get_sequence(element, edited_name);
+            assert(element.sequence == "A");
+        }
+
+        remove_all(edited_directory);
+    }
+    cout << "PASS\n";
+
+    cout << "\nFASTA TABLE TEST: \n";
+
+    cout << "Testing bulk loaded sequences: ";
+    FastaTable table(absolute_data_path, 2);
+    assert(table.size() == 4);
+
+    for (size_t i=0; i<table.size(); i++){
+        sequence_name = table.get_name(i);
+        fasta_reader.get_sequence(element, sequence_name);
+        assert(table.get_sequence(i) == element.sequence);
+        assert(table.get_sequence(sequence_name) == element.sequence);
+    }
+    cout << "PASS\n";
+
+    cout << "Testing multi-line, CRLF and empty sequences: ";
+    path output_directory = "output/";
+    create_directories(output_directory);
+    path table_fasta_path = output_directory / "test_FastaTable.fasta";
+
+    {
+        ofstream file(table_fasta_path);
+        file << ">a\r\nACGT\r\nAC\r\n>b description\nGG\n\nT\n>c\n>d\nTTTT";
+    }
+
+    FastaTable multiline_table(table_fasta_path);
+    assert(multiline_table.size() == 4);
+    assert(multiline_table.get_sequence("a") == "ACGTAC");
+    assert(multiline_table.get_sequence("b") == "GGT");
+    assert(multiline_table.get_sequence("c").empty());
+    assert(multiline_table.get_sequence("d") == "TTTT");
+    assert(multiline_table.find("e") == -1);
+    cout << "PASS\n";
+
+    test_chunked_index();
+
     return 0;
 }
 
@@ -1,8 +1,249 @@
-
 #include "FastqReader.hpp"
+#include "htslib/bgzf.h"
+#include <experimental/filesystem>
 #include <iostream>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <zlib.h>
+#include <assert.h>
 
 using std::cout;
+using std::to_string;
+using std::runtime_error;
+using std::ofstream;
+using std::mt19937;
+using std::uniform_int_distribution;
+using std::experimental::filesystem::temp_directory_path;
+using std::experimental::filesystem::create_directories;
+using std::experimental::filesystem::remove_all;
+using std::experimental::filesystem::file_size;
+
+
+void test_quality_sums(){
+    cout << "TESTING QUALITY SUMS\n";
+
+    mt19937 generator(0);
+    uniform_int_distribution<int> distribution(33, 126);
+
+    // Extra bytes on either side, so that the sums start at unaligned offsets and end mid block
+    string qualities(300, ' ');
+    for (auto& c: qualities){
+        c = char(distribution(generator));
+    }
+
+    for (size_t offset=0; offset<17; offset++){
+        for (size_t length=0; length + offset <= 260; length++){
+            uint64_t expected = 0;
+            for (size_t i=offset; i<offset+length; i++){
+                expected += uint8_t(qualities[i]);
+            }
+
+            assert(sum_quality_chars(qualities.data() + offset, length) == expected);
+        }
+    }
+
+    // Every byte 255, to check that no lane overflows
+    string high_qualities(1001, char(255));
+    assert(sum_quality_chars(high_qualities.data(), high_qualities.size()) == 255*1001);
+}
+
+
+string make_fastq(size_t n_bytes, uint64_t seed){
+    ///
+    /// Random records with a variety of sequence lengths and qualities, some with a name on the separator line
+    ///
+    mt19937 generator(seed);
+    uniform_int_distribution<size_t> length_distribution(1, 500);
+    uniform_int_distribution<int> base_distribution(0, 3);
+    uniform_int_distribution<int> quality_distribution(33 + 2, 33 + 14);
+    string bases = "ACGT";
+
+    string fastq;
+    size_t i = 0;
+
+    while (fastq.size() < n_bytes){
+        size_t length = length_distribution(generator);
+        string name = "read_" + to_string(i);
+
+        fastq += "@" + name + " extra description\n";
+
+        for (size_t j=0; j<length; j++){
+            fastq += bases[base_distribution(generator)];
+        }
+
+        fastq += (i % 5 == 0) ? "\n+" + name + "\n" : "\n+\n";
+
+        for (size_t j=0; j<length; j++){
+            fastq += char(quality_distribution(generator));
+        }
+
+        fastq += '\n';
+        i++;
+    }
+
+    return fastq;
+}
+
+
+string filter_fastq(const string& fastq, uint64_t minimum_average_quality){
+    ///
+    /// A simple version of the filter, to compare against
+    ///
+    string output;
+    vector<string> lines;
+    size_t start = 0;
+
+    while (start < fastq.size()){
+        size_t stop = fastq.find('\n', start);
+        if (stop == string::npos){
+            stop = fastq.size();
+        }
+
+        lines.emplace_back(fastq.substr(start, stop - start));
+        start = stop + 1;
+    }
+
+    while (lines.size() % 4 != 0){
+        lines.emplace_back();
+    }
+
+    for (size_t i=0; i<lines.size(); i+=4){
+        const string& sequence = lines[i+1];
+        const string& qualities = lines[i+3];
+
+        if (sequence.empty() or qualities.empty()){
+            continue;
+        }
+
+        double sum = 0;
+        for (auto c: qualities){
+            sum += uint8_t(c) - 33;
+        }
+
+        if (sum/qualities.size() >= minimum_average_quality){
+            output += "@" + lines[i].substr(1) + "\n" + sequence + "\n+\n" + qualities + "\n";
+        }
+    }
+
+    return output;
+}
+
+
+void write_plain_file(path file_path, const string& data){
+    ofstream file(file_path, std::ios::binary);
+    file << data;
+}
+
+
+void write_gzip_file(path file_path, const string& data){
+    gzFile file = gzopen(file_path.string().c_str(), "wb");
+    assert(file != nullptr);
+    assert(gzwrite(file, data.data(), data.size()) == int(data.size()));
+    gzclose(file);
+}
+
+
+void write_bgzf_file(path file_path, const string& data){
+    BGZF* file = bgzf_open(file_path.string().c_str(), "w");
+    assert(file != nullptr);
+    assert(bgzf_write(file, data.data(), data.size()) == ssize_t(data.size()));
+    assert(bgzf_close(file) == 0);
+}
+
+
+string read_file(path file_path){
+    ///
+    /// Read a plain or compressed file
+    ///
+    BGZF* file = bgzf_open(file_path.string().c_str(), "r");
+    assert(file != nullptr);
+
+    string data;
+    char buffer[65536];
+    ssize_t n_bytes;
+
+    while ((n_bytes = bgzf_read(file, buffer, sizeof(buffer))) > 0){
+        data.append(buffer, n_bytes);
+    }
+
+    assert(n_bytes == 0);
+    bgzf_close(file);
+
+    return data;
+}
+
+
+void test_filter(path directory){
+    // Longer than several chunks, so that chunks end inside of records
+    string fastq = make_fastq(3*FastqReader::chunk_size + 12345, 1);
+    uint64_t minimum_average_quality = 8;
+    string expected = filter_fastq(fastq, minimum_average_quality);
+
+    assert(not expected.empty() and expected.size() < fastq.size());
+
+    path plain_path = directory / "reads.fastq";
+    path gzip_path = directory / "reads_gzip.fastq.gz";
+    path bgzf_path = directory / "reads_bgzf.fastq.gz";
+
+    write_plain_file(plain_path, fastq);
+    write_gzip_file(gzip_path, fastq);
+    write_bgzf_file(bgzf_path, fastq);
+
+    for (auto& input_path: {plain_path, gzip_path, bgzf_path}){
+        for (uint16_t max_threads: {1, 3}){
+            for (string extension: {".fastq", ".fastq.gz"}){
+                cout << "TESTING FILTER " << input_path.filename() << " to " << extension << " with " << max_threads
+                     << " threads\n";
+
+                path output_path = directory / ("filtered" + extension);
+
+                FastqReader reader(input_path);
+                reader.filter_by_quality(minimum_average_quality, output_path, max_threads);
+
+                // Records are in the input order, including those cut by chunk boundaries
+                assert(read_file(output_path) == expected);
+
+                if (extension == ".fastq.gz"){
+                    BGZF* file = bgzf_open(output_path.string().c_str(), "r");
+                    assert(bgzf_compression(file) == 2);
+                    bgzf_close(file);
+                }
+            }
+        }
+    }
+
+    cout << "TESTING FINAL RECORD WITHOUT NEWLINE\n";
+
+    string short_fastq = "@a\nACGT\n+\nIIII\n@b\nAC\n+\n!!\n@c\nA\n+\nI";
+    write_plain_file(plain_path, short_fastq);
+
+    FastqReader short_reader(plain_path);
+    short_reader.filter_by_quality(20, directory / "filtered.fastq", 2);
+    assert(read_file(directory / "filtered.fastq") == "@a\nACGT\n+\nIIII\n@c\nA\n+\nI\n");
+
+    cout << "TESTING CORRUPT INPUT\n";
+
+    // Corrupt a block near the end, so that the error occurs while a batch is being filtered on other threads
+    uint64_t size = file_size(bgzf_path);
+    {
+        std::fstream file(bgzf_path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(size*9/10);
+        string garbage(4096, 'x');
+        file.write(garbage.data(), garbage.size());
+    }
+
+    bool threw = false;
+    try {
+        FastqReader reader(bgzf_path);
+        reader.filter_by_quality(minimum_average_quality, directory / "filtered.fastq", 2);
+    }
+    catch (const runtime_error& e){
+        cout << e.what() << '\n';
+        threw = true;
+    }
+    assert(threw);
+}
 
 
 int main(){
@@ -11,9 +252,19 @@ int main(){
     path relative_data_path = "/data/test/test_sequences.fastq";
     path absolute_data_path = project_directory / relative_data_path;
 
+    path directory = temp_directory_path() / "test_FastqReader";
+    remove_all(directory);
+    create_directories(directory);
+
     cout << "Reading file: " << absolute_data_path << '\n';
     FastqReader reader(absolute_data_path);
-    reader.filter_by_quality(7);
+    reader.filter_by_quality(7, directory / "test_sequences_filtered_7.fastq");
+
+    test_quality_sums();
+    test_filter(directory);
+
+    remove_all(directory);
+    cout << "PASS\n";
 
     return 0;
 }
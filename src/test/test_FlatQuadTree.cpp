@@ -0,0 +1,180 @@
+
+#include "FlatQuadTree.hpp"
+#include "QuadTree.hpp"
+#include <vector>
+#include <utility>
+#include <iostream>
+#include <stdexcept>
+#include <random>
+
+using std::vector;
+using std::pair;
+using std::cout;
+using std::cerr;
+using std::runtime_error;
+using std::to_string;
+using std::mt19937;
+using std::uniform_real_distribution;
+
+
+class CountingLoss: public QuadLoss{
+public:
+    uint64_t n = 0;
+
+    void reset() override{
+        this->n = 0;
+    }
+
+    void update(QuadCoordinate point) override{
+        this->n++;
+    }
+
+    double calculate_loss() override{
+        return this->n;
+    }
+};
+
+
+int main(){
+    vector <pair <float,float> > test_points = {
+            {0.05,0.05}, {0.05,0.14}, {0.14,0.14},
+            {0.11,0.02}, {0.11,0.08}, {0.17,0.08},
+            {0.14,0.01}, {0.14,0.03}, {0.17,0.03},{0.17,0.01},
+            {-0.5,-0.5}, {1.5,1.5},
+            {0.0,-0.5}, {1.0,1.5},
+            {0.0,0.0}, {1.0,1.0},
+            };
+
+    vector<bool> truth_set = {true, true, true,
+                              true, true, true,
+                              true, true, true, true,
+                              false, false,
+                              false, false,
+                              true, false,
+    };
+
+    float x = 0.09;
+    float y = 0.09;
+
+    float size = 0.18;
+
+    QuadCoordinate center = QuadCoordinate(x, y);
+    BoundingBox bounds = BoundingBox(center, size/2);
+    FlatQuadTree tree = FlatQuadTree(bounds);
+
+    cerr << "TESTING ADDITION OF POINTS IN/OUT BOUNDS\n";
+
+    bool success;
+    size_t i = 0;
+    for (auto& [x_i, y_i]: test_points){
+        center = QuadCoordinate(x_i, y_i);
+        success = tree.insert(center);
+
+        if (not success == truth_set[i]){
+            throw runtime_error("FAIL: " + to_string(x_i) + " " + to_string(y_i));
+        }
+        i++;
+    }
+    cerr << "PASS\n";
+
+    cerr << "\nTESTING FETCHING INDIVIDUAL POINTS IN/OUT BOUNDS\n";
+    i = 0;
+    size_t n_true = 0;
+    for (auto& [x_i, y_i]: test_points) {
+        vector<QuadCoordinate> results;
+        center = QuadCoordinate(x_i, y_i);
+        BoundingBox test_bounds = BoundingBox(center, 0.0001);
+
+        tree.query_range(results, test_bounds);
+
+        if (not (results.size() == truth_set[i])){
+            cerr << "FOUND INCORRECT NUMBER OF POINTS\n";
+            for (auto& point: results){
+                cerr << point.x << " " << point.y << '\n';
+            }
+            throw runtime_error("FAIL: " + to_string(x_i) + " " + to_string(y_i));
+        }
+
+        n_true += truth_set[i];
+        i++;
+    }
+    cerr << "PASS\n";
+    cerr << "\nTESTING FETCHING ALL POINTS IN BOUNDS\n";
+
+    vector<QuadCoordinate> results;
+    tree.query_range(results, bounds);
+
+    if (not (results.size() == n_true)){
+        throw runtime_error("FAIL: Not all points found");
+    }
+
+    cerr << "PASS\n";
+
+    cerr << "\nTESTING LEAF CAPACITY AND CONTIGUOUS RANGES\n";
+
+    for (auto& node: tree.nodes){
+        if (node.is_leaf() and node.n_points > tree.capacity){
+            throw runtime_error("FAIL: leaf exceeds capacity: " + to_string(node.n_points));
+        }
+        if (not node.is_leaf()){
+            uint32_t start = node.point_start;
+            for (uint32_t q=0; q<4; q++){
+                QuadNode& child = tree.nodes[node.first_child + q];
+
+                // Children may be visited in any order, but must exactly tile the parent's range
+                if (child.point_start < node.point_start or child.point_start + child.n_points > node.point_start + node.n_points){
+                    throw runtime_error("FAIL: child range outside of parent range");
+                }
+                start += child.n_points;
+            }
+            if (start != node.point_start + node.n_points){
+                throw runtime_error("FAIL: child ranges do not sum to parent range");
+            }
+        }
+        for (uint32_t p=node.point_start; p<node.point_start + node.n_points; p++){
+            if (not node.boundary.contains(tree.points[p])){
+                throw runtime_error("FAIL: point outside of node boundary");
+            }
+        }
+    }
+
+    cerr << "PASS\n";
+
+    cerr << "\nTESTING RANDOM RANGE QUERIES AGAINST QuadTree\n";
+
+    mt19937 generator(42);
+    uniform_real_distribution<float> distribution(0, 50);
+
+    BoundingBox random_bounds = BoundingBox(QuadCoordinate(25,25), 25);
+    QuadTree reference_tree = QuadTree(random_bounds);
+    FlatQuadTree flat_tree = FlatQuadTree(random_bounds);
+
+    for (size_t p=0; p<20000; p++){
+        QuadCoordinate c = QuadCoordinate(distribution(generator), distribution(generator));
+        reference_tree.insert(c);
+        flat_tree.insert(c);
+    }
+
+    for (size_t q=0; q<200; q++){
+        BoundingBox query = BoundingBox(QuadCoordinate(distribution(generator), distribution(generator)), distribution(generator)/4);
+
+        vector<QuadCoordinate> expected;
+        vector<QuadCoordinate> observed;
+        reference_tree.query_range(expected, query);
+        flat_tree.query_range(observed, query);
+
+        CountingLoss loss;
+        flat_tree.update_loss_from_range(query, loss);
+
+        if (expected.size() != observed.size() or loss.n != observed.size()){
+            throw runtime_error("FAIL: query " + to_string(q) + " found " + to_string(observed.size()) + " expected " + to_string(expected.size()));
+        }
+    }
+
+    cerr << "PASS\n";
+
+    tree.write_as_dot("output/");
+    tree.write_bounds("output/");
+
+    return 0;
+}
@@ -0,0 +1,203 @@
+#include "IntervalIndex.hpp"
+#include "BedReader.hpp"
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <tuple>
+#include <assert.h>
+
+using std::cout;
+using std::sort;
+using std::max;
+using std::tie;
+using std::make_pair;
+using std::count_if;
+using std::mt19937;
+using std::uniform_int_distribution;
+using std::chrono::steady_clock;
+using std::chrono::duration;
+
+
+void simulate_intervals(vector<Region>& intervals, size_t n, uint64_t contig_length, uint64_t max_length, mt19937& generator){
+    uniform_int_distribution<size_t> contig_distribution(0, 2);
+    uniform_int_distribution<uint64_t> start_distribution(0, contig_length);
+    uniform_int_distribution<uint64_t> length_distribution(0, max_length);
+
+    for (size_t i=0; i<n; i++){
+        uint64_t start = start_distribution(generator);
+        intervals.emplace_back("chr" + std::to_string(contig_distribution(generator) + 1), start, start + length_distribution(generator));
+    }
+}
+
+
+void find_overlaps_naively(const vector<Region>& intervals, const string& name, uint64_t start, uint64_t stop, vector<Region>& overlaps){
+    for (auto& interval: intervals){
+        if (interval.name == name and interval.start < interval.stop and interval.start < stop and start < interval.stop){
+            overlaps.emplace_back(interval);
+        }
+    }
+}
+
+
+bool operator<(const Region& a, const Region& b){
+    return tie(a.name, a.start, a.stop) < tie(b.name, b.start, b.stop);
+}
+
+
+bool operator==(const Region& a, const Region& b){
+    return a.name == b.name and a.start == b.start and a.stop == b.stop;
+}
+
+
+int main(){
+    path script_path = __FILE__;
+    path project_directory = script_path.parent_path().parent_path().parent_path();
+    path bed_path = project_directory / "data/test/bed/test.bed";
+
+    cout << "Testing BED index: ";
+    IntervalIndex bed_index(bed_path);
+
+    assert(bed_index.size() == 4);
+    assert(bed_index.contains("chr1", 109740));
+    assert(not bed_index.contains("chr1", 109773));
+    assert(bed_index.contains("chr2", 12654));
+    assert(not bed_index.contains("chr2", 12600));
+    assert(not bed_index.contains("chr3", 12342));
+
+    vector<Region> regions;
+    bed_index.get_merged_regions(regions, {"chr2", "chr3"});
+    assert(regions.size() == 2);
+    assert(regions[0] == Region("chr2", 12342, 12526));
+    assert(regions[1] == Region("chr2", 12629, 12655));
+    cout << "PASS\n";
+
+    cout << "Testing overlaps against brute force: ";
+    mt19937 generator(11);
+
+    for (uint64_t max_length: {uint64_t(1), uint64_t(50), uint64_t(5000)}){
+        for (size_t n: {size_t(0), size_t(1), size_t(7), size_t(100), size_t(3000)}){
+            vector<Region> intervals;
+            simulate_intervals(intervals, n, 100000, max_length, generator);
+
+            IntervalIndex index(intervals);
+
+            // Empty intervals are dropped
+            size_t n_nonempty = count_if(intervals.begin(), intervals.end(), [](auto& r){return r.start < r.stop;});
+            assert(index.size() == n_nonempty);
+
+            vector<Region> queries;
+            simulate_intervals(queries, 200, 100000, 2000, generator);
+            queries.emplace_back("chr4", 0, 100000);
+
+            vector <pair <size_t, size_t> > batch_overlaps;
+            index.find_overlaps(queries, batch_overlaps);
+            size_t b = 0;
+
+            for (size_t q=0; q<queries.size(); q++){
+                auto& query = queries[q];
+
+                vector<Region> expected;
+                find_overlaps_naively(intervals, query.name, query.start, query.stop, expected);
+
+                vector<size_t> overlap_indexes;
+                index.find_overlaps(query.name, query.start, query.stop, overlap_indexes);
+
+                vector<Region> result;
+                for (auto& i: overlap_indexes){
+                    result.emplace_back(index.get_interval(i));
+                }
+
+                vector<Region> batch_result;
+                for (; b < batch_overlaps.size() and batch_overlaps[b].first == q; b++){
+                    batch_result.emplace_back(index.get_interval(batch_overlaps[b].second));
+                }
+
+                sort(expected.begin(), expected.end());
+                sort(result.begin(), result.end());
+                sort(batch_result.begin(), batch_result.end());
+
+                assert(result == expected);
+                assert(batch_result == expected);
+
+                expected.clear();
+                find_overlaps_naively(intervals, query.name, query.start, query.start + 1, expected);
+                assert(index.contains(query.name, query.start) == not expected.empty());
+
+                uint64_t expected_max_stop = 0;
+                for (auto& interval: intervals){
+                    if (interval.name == query.name and interval.start < query.start and interval.start < interval.stop){
+                        expected_max_stop = max(expected_max_stop, interval.stop);
+                    }
+                }
+                assert(index.get_max_stop(query.name, query.start) == expected_max_stop);
+            }
+            assert(b == batch_overlaps.size());
+
+            // Every position of the merged regions is in an interval, and merged regions neither overlap nor abut
+            regions.clear();
+            index.get_merged_regions(regions);
+
+            uint64_t merged_length = 0;
+            for (size_t i=0; i<regions.size(); i++){
+                assert(index.contains(regions[i].name, regions[i].start));
+                assert(index.contains(regions[i].name, regions[i].stop - 1));
+                assert(not index.contains(regions[i].name, regions[i].stop));
+
+                if (i > 0 and regions[i].name == regions[i-1].name){
+                    assert(regions[i-1].stop < regions[i].start);
+                }
+                merged_length += regions[i].stop - regions[i].start;
+            }
+
+            uint64_t n_covered = 0;
+            for (auto& name: {"chr1", "chr2", "chr3"}){
+                for (uint64_t p=0; p<100000 + max_length; p++){
+                    n_covered += index.contains(name, p);
+                }
+            }
+            assert(n_covered == merged_length);
+        }
+    }
+    cout << "PASS\n";
+
+    cout << "Benchmarking 300k intervals, 1M point queries:\n";
+    vector<Region> intervals;
+    simulate_intervals(intervals, 300000, 100000000, 300, generator);
+
+    vector<Region> queries;
+    simulate_intervals(queries, 1000000, 100000000, 0, generator);
+
+    auto t = steady_clock::now();
+    regional_interval_map interval_maps;
+    for (auto& region: intervals){
+        interval_maps[region.name].insert(make_pair(interval<uint64_t>::right_open(region.start, region.stop), true));
+    }
+    double map_build_time = duration<double>(steady_clock::now() - t).count();
+
+    t = steady_clock::now();
+    size_t n_map_hits = 0;
+    for (auto& query: queries){
+        auto& interval_map = interval_maps.at(query.name);
+        n_map_hits += (interval_map.find(query.start) != interval_map.end());
+    }
+    double map_query_time = duration<double>(steady_clock::now() - t).count();
+
+    t = steady_clock::now();
+    IntervalIndex index(intervals);
+    double index_build_time = duration<double>(steady_clock::now() - t).count();
+
+    t = steady_clock::now();
+    size_t n_index_hits = 0;
+    for (auto& query: queries){
+        n_index_hits += index.contains(query.name, query.start);
+    }
+    double index_query_time = duration<double>(steady_clock::now() - t).count();
+
+    assert(n_map_hits == n_index_hits);
+
+    cout << "interval_map:\tbuild " << map_build_time << " s\tquery " << map_query_time << " s\n";
+    cout << "IntervalIndex:\tbuild " << index_build_time << " s\tquery " << index_query_time << " s\n";
+
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include "LabeledCoverageWriter.hpp"
+#include "Miscellaneous.hpp"
+#include <experimental/filesystem>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <map>
+#include <assert.h>
+
+using std::cout;
+using std::map;
+using std::thread;
+using std::ref;
+using std::to_string;
+using std::istringstream;
+using std::experimental::filesystem::remove_all;
+using std::experimental::filesystem::create_symlink;
+
+
+void write_records(LabeledCoverageWriter& writer, CoverageSegment& segment, size_t thread_index){
+    LabeledCoverageBuffer buffer(writer);
+
+    for (size_t r=0; r<20; r++){
+        buffer.start_record("read" + to_string(thread_index) + "_" + to_string(r));
+
+        // Records of every size, from empty to many times the buffer size
+        for (size_t i=0; i<r*r; i++){
+            size_t position = i % segment.n_positions();
+            buffer.write_line(i%2, 'A', i%7, segment.sequence[position], 3, segment.get_pileup(position), i%3 == 0);
+        }
+
+        buffer.end_record();
+    }
+
+    buffer.close();
+}
+
+
+void write_all(LabeledCoverageWriter& writer, CoverageSegment& segment){
+    vector<thread> threads;
+
+    for (size_t t=0; t<4; t++){
+        threads.emplace_back(thread(write_records, ref(writer), ref(segment), t));
+    }
+
+    for (auto& t: threads){
+        t.join();
+    }
+}
+
+
+int main(){
+    CoverageSegment segment;
+    segment.sequence = "AC_G";
+
+    segment.add_observation('A', 2, false, 1);
+    segment.add_observation('a', 3, true, 255);
+    segment.end_position();
+    segment.add_observation('C', 12, false, 7);
+    segment.end_position();
+    segment.end_position();
+    segment.add_observation('G', 1, true, 1.9);
+    segment.end_position();
+
+    path output_directory = "output/test_LabeledCoverageWriter/";
+    remove_all(output_directory);
+
+    cout << "Testing line format: ";
+    {
+        LabeledCoverageWriter writer(output_directory / "single_line", false);
+        LabeledCoverageBuffer buffer(writer);
+        buffer.start_record("line");
+        buffer.write_line(true, 'T', 2, 'A', 3, segment.get_pileup(0), true);
+        buffer.write_line(false, 'C', 1, '_', 0, segment.get_pileup(2), false);
+        buffer.close();
+    }
+
+    string result;
+    read_file_to_string(output_directory / "single_line" / "line.csv", result);
+    assert(result == "-,T,2,T,3,A2+ 1,a3- 255, v\n+,C,1,_,0, e\n");
+    cout << "PASS\n";
+
+    // Write the same records as individual files, and as one file with a tiny buffer so most records are split
+    {
+        LabeledCoverageWriter writer(output_directory / "per_record", false, 64);
+        write_all(writer, segment);
+    }
+    {
+        LabeledCoverageWriter writer(output_directory / "single_file", true, 64);
+        write_all(writer, segment);
+    }
+
+    cout << "Testing single file index: ";
+    string single_file;
+    string index;
+    read_file_to_string(output_directory / "single_file" / LabeledCoverageWriter::file_name, single_file);
+    read_file_to_string(output_directory / "single_file" / (LabeledCoverageWriter::file_name + ".idx"), index);
+
+    map<string,string> records;
+    istringstream index_stream(index);
+    string name;
+    uint64_t offset;
+    uint64_t length;
+    uint64_t n_bytes = 0;
+
+    while (index_stream >> name >> offset >> length){
+        records[name] += single_file.substr(offset, length);
+        n_bytes += length;
+    }
+
+    // Every byte belongs to exactly one piece
+    assert(n_bytes == single_file.size());
+    assert(records.size() == 80);
+
+    for (auto& item: records){
+        string expected;
+        read_file_to_string(output_directory / "per_record" / (item.first + ".csv"), expected);
+        assert(item.second == expected);
+    }
+    cout << "PASS\n";
+
+    cout << "Testing write error in a record file: ";
+    {
+        // Every write to /dev/full fails with ENOSPC
+        LabeledCoverageWriter writer(output_directory / "full", false, 64);
+        create_symlink("/dev/full", output_directory / "full" / "full.csv");
+
+        LabeledCoverageBuffer buffer(writer);
+        buffer.start_record("full");
+
+        bool threw = false;
+        try {
+            for (size_t i=0; i<100; i++){
+                buffer.write_line(false, 'A', 1, 'A', 1, segment.get_pileup(0), false);
+            }
+            buffer.end_record();
+        }
+        catch (const runtime_error& e){
+            threw = true;
+        }
+        assert(threw);
+    }
+    cout << "PASS\n";
+
+    return 0;
+}
@@ -46,6 +46,33 @@ void test_distribution_set(vector <vector<double> > distribution_set){
 }
 
 
+void test_distribution_set_merge(vector <vector<double> > distribution_set){
+    MultiDistributionStats stats_a(distribution_set.size());
+    MultiDistributionStats stats_b(distribution_set.size());
+    MultiDistributionStats stats_all(distribution_set.size());
+
+    // Accumulate each half separately, as if on two threads
+    for (size_t i=0; i<distribution_set.size(); i++){
+        if (i < distribution_set.size()/2){
+            stats_a.update(distribution_set[i]);
+        }
+        else{
+            stats_b.update(distribution_set[i]);
+        }
+        stats_all.update(distribution_set[i]);
+    }
+
+    stats_a += stats_b;
+
+    cout << "Merged weighted variance:\t" << stats_a.get_weighted_variance() << '\n';
+    cout << "Serial weighted variance:\t" << stats_all.get_weighted_variance() << '\n';
+
+    if (std::abs(stats_a.get_weighted_variance() - stats_all.get_weighted_variance()) > 1e-9 or stats_a.size != stats_all.size){
+        throw runtime_error("FAIL: merged MultiDistributionStats does not match serial");
+    }
+}
+
+
 int main(){
     vector <vector <double> > distributions_a = {
             {1,0,0,0,0,0},
@@ -95,5 +122,10 @@ int main(){
     cerr << "\n\nTESTING: distributions_d\n";
     test_distribution_set(distributions_d);
 
+    cerr << "\n\nTESTING: merge of partial stats\n";
+    test_distribution_set_merge(distributions_a);
+    test_distribution_set_merge(distributions_b);
+    test_distribution_set_merge(distributions_c);
+
     return 0;
 }
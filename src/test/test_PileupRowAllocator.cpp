@@ -0,0 +1,144 @@
+#include "PileupRowAllocator.hpp"
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <deque>
+#include <utility>
+#include <assert.h>
+
+using std::cout;
+using std::deque;
+using std::pair;
+using std::mt19937;
+using std::uniform_int_distribution;
+using std::chrono::steady_clock;
+using std::chrono::duration;
+
+
+///
+/// The allocation that PileupGenerator used before, which sorted every row on every alignment. With a stable sort it
+/// defines the expected assignment. With std::sort it is only guaranteed to agree for small depths, where libstdc++
+/// falls back to insertion sort, which is stable.
+///
+template <bool stable> class SortingRowAllocator{
+public:
+    deque <pair <int64_t, int64_t> > lowest_free_index_per_depth = {{0,0}};
+
+    int64_t allocate(int64_t start_index, int64_t stop_index){
+        auto compare = [](auto &left, auto &right) {
+            return left.second < right.second;
+        };
+
+        if (stable){
+            stable_sort(this->lowest_free_index_per_depth.begin(), this->lowest_free_index_per_depth.end(), compare);
+        }
+        else{
+            sort(this->lowest_free_index_per_depth.begin(), this->lowest_free_index_per_depth.end(), compare);
+        }
+
+        int64_t depth_index;
+        int64_t lowest_width_index = this->lowest_free_index_per_depth[0].second;
+
+        if (lowest_width_index == 0 or start_index > lowest_width_index + 1){
+            depth_index = this->lowest_free_index_per_depth[0].first;
+        }
+        else{
+            depth_index = this->lowest_free_index_per_depth.size();
+            this->lowest_free_index_per_depth.emplace_front(this->lowest_free_index_per_depth.size(), start_index);
+        }
+
+        this->lowest_free_index_per_depth[0].second = stop_index;
+
+        return depth_index;
+    }
+};
+
+
+// Simulate reads sorted by start position, with coordinates rounded so that many of them end at the same position
+void simulate_alignments(vector <pair <int64_t, int64_t> >& alignments, size_t depth, int64_t region_size, int64_t read_length){
+    mt19937 generator(depth);
+    uniform_int_distribution<int64_t> start_distribution(-read_length, region_size);
+    uniform_int_distribution<int64_t> length_distribution(read_length/2, read_length*3/2);
+
+    alignments.clear();
+    size_t n = depth*(region_size + read_length)/read_length;
+
+    for (size_t i=0; i<n; i++){
+        int64_t start = (start_distribution(generator)/50)*50;
+        int64_t stop = start + (length_distribution(generator)/10)*10;
+        alignments.emplace_back(start, stop);
+    }
+
+    sort(alignments.begin(), alignments.end());
+
+    // Reads are only fetched if they overlap the region
+    alignments.erase(remove_if(alignments.begin(), alignments.end(), [&](auto& a){
+        return a.second < 1 or a.first >= region_size;
+    }), alignments.end());
+}
+
+
+template <class T> double allocate_all(T& allocator, vector <pair <int64_t, int64_t> >& alignments, vector<int64_t>& rows){
+    auto t = steady_clock::now();
+
+    rows.clear();
+    for (auto& [start, stop]: alignments){
+        rows.emplace_back(allocator.allocate(start, stop));
+    }
+
+    return duration<double>(steady_clock::now() - t).count();
+}
+
+
+int main(){
+    vector <pair <int64_t, int64_t> > alignments;
+    vector<int64_t> expected_rows;
+    vector<int64_t> rows;
+
+    cout << "Testing row assignment at low depth: ";
+    for (size_t depth: {1, 2, 5, 8}){
+        simulate_alignments(alignments, depth, 20000, 1000);
+
+        SortingRowAllocator<false> sorting_allocator;
+        PileupRowAllocator allocator;
+
+        allocate_all(sorting_allocator, alignments, expected_rows);
+        allocate_all(allocator, alignments, rows);
+
+        assert(sorting_allocator.lowest_free_index_per_depth.size() <= 16);
+        assert(rows == expected_rows);
+        assert(allocator.get_n_rows() == sorting_allocator.lowest_free_index_per_depth.size());
+    }
+    cout << "PASS\n";
+
+    cout << "Testing row assignment at high depth: ";
+    for (size_t depth: {30, 200}){
+        simulate_alignments(alignments, depth, 20000, 1000);
+
+        SortingRowAllocator<true> sorting_allocator;
+        PileupRowAllocator allocator;
+
+        allocate_all(sorting_allocator, alignments, expected_rows);
+        allocate_all(allocator, alignments, rows);
+
+        assert(rows == expected_rows);
+    }
+    cout << "PASS\n";
+
+    cout << "Benchmarking 100kbp region with 10kbp reads:\n";
+    for (size_t depth: {200, 1000}){
+        simulate_alignments(alignments, depth, 100000, 10000);
+
+        SortingRowAllocator<false> sorting_allocator;
+        PileupRowAllocator allocator;
+
+        double sort_time = allocate_all(sorting_allocator, alignments, expected_rows);
+        double heap_time = allocate_all(allocator, alignments, rows);
+
+        cout << depth << "x\t" << alignments.size() << " alignments\t" << allocator.get_n_rows() << " rows\t"
+             << "sort: " << sort_time << " s\t" << "heap: " << heap_time << " s\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include "ReadLengthStats.hpp"
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <numeric>
+#include <cmath>
+#include <assert.h>
+
+using std::cout;
+using std::sort;
+using std::mt19937_64;
+using std::lognormal_distribution;
+using std::greater;
+
+
+uint32_t exact_quantile(vector<uint32_t> lengths, double q){
+    sort(lengths.begin(), lengths.end());
+    return lengths[uint64_t(q*double(lengths.size() - 1))];
+}
+
+
+uint32_t exact_nx(vector<uint32_t> lengths, double x){
+    sort(lengths.begin(), lengths.end(), greater<uint32_t>());
+    double total = accumulate(lengths.begin(), lengths.end(), 0.0);
+    double cumulative = 0;
+
+    for (auto& length: lengths){
+        cumulative += length;
+        if (cumulative >= x*total){
+            return length;
+        }
+    }
+
+    return 0;
+}
+
+
+bool is_within(uint32_t value, uint32_t expected, double relative_accuracy){
+    return fabs(double(value) - double(expected)) <= relative_accuracy*double(expected) + 1;
+}
+
+
+int main(){
+    mt19937_64 generator(7);
+    lognormal_distribution<double> length_distribution(9, 1);
+
+    vector <pair <uint64_t, uint32_t> > items;
+    vector<uint32_t> lengths;
+
+    for (size_t i=0; i<200000; i++){
+        uint32_t length = uint32_t(length_distribution(generator)) + 1;
+        items.emplace_back(generator(), length);
+        lengths.emplace_back(length);
+    }
+
+    cout << "Testing reservoir against a shuffled prefix: ";
+    for (uint64_t max_cumulative_length: {uint64_t(0), uint64_t(1), uint64_t(50000000), uint64_t(1) << 60}){
+        // The expected sample is the prefix of the items sorted by key, up to the maximum cumulative length
+        auto sorted_items = items;
+        sort(sorted_items.begin(), sorted_items.end());
+
+        vector<uint32_t> expected_lengths;
+        uint64_t cumulative_length = 0;
+
+        for (auto& [key, length]: sorted_items){
+            if (cumulative_length >= max_cumulative_length){
+                break;
+            }
+            expected_lengths.emplace_back(length);
+            cumulative_length += length;
+        }
+        sort(expected_lengths.begin(), expected_lengths.end());
+
+        ReadLengthReservoir reservoir(max_cumulative_length, 0);
+        ReadLengthReservoir reservoir_a(max_cumulative_length, 0);
+        ReadLengthReservoir reservoir_b(max_cumulative_length, 0);
+
+        for (size_t i=0; i<items.size(); i++){
+            reservoir.insert(items[i].first, items[i].second);
+
+            if (i % 3 == 0){
+                reservoir_a.insert(items[i].first, items[i].second);
+            }
+            else{
+                reservoir_b.insert(items[i].first, items[i].second);
+            }
+        }
+
+        reservoir_a += reservoir_b;
+
+        vector<uint32_t> sampled_lengths;
+        reservoir.get_lengths(sampled_lengths);
+        assert(sampled_lengths == expected_lengths);
+        assert(reservoir.cumulative_length == cumulative_length);
+
+        reservoir_a.get_lengths(sampled_lengths);
+        assert(sampled_lengths == expected_lengths);
+    }
+    cout << "PASS\n";
+
+    cout << "Testing sketch quantiles and N-statistics: ";
+    ReadLengthSketch sketch;
+    ReadLengthSketch sketch_a;
+    ReadLengthSketch sketch_b;
+
+    for (size_t i=0; i<lengths.size(); i++){
+        sketch.add(lengths[i]);
+
+        if (i < lengths.size()/2){
+            sketch_a.add(lengths[i]);
+        }
+        else{
+            sketch_b.add(lengths[i]);
+        }
+    }
+
+    for (double q: {0.0, 0.1, 0.5, 0.9, 0.99, 1.0}){
+        assert(is_within(sketch.get_quantile(q), exact_quantile(lengths, q), sketch.relative_accuracy));
+    }
+
+    for (double x: {0.1, 0.5, 0.9}){
+        assert(is_within(sketch.get_nx(x), exact_nx(lengths, x), sketch.relative_accuracy));
+    }
+
+    assert(sketch.min_length == *min_element(lengths.begin(), lengths.end()));
+    assert(sketch.max_length == *max_element(lengths.begin(), lengths.end()));
+    assert(sketch.counts.size() < 5000);
+
+    sketch_a += sketch_b;
+    assert(sketch_a.counts == sketch.counts);
+    assert(sketch_a.cumulative_lengths == sketch.cumulative_lengths);
+    assert(sketch_a.get_nx(0.5) == sketch.get_nx(0.5));
+    cout << "PASS\n";
+
+    cout << "Testing histogram: ";
+    ReadLengthHistogram histogram(1000);
+    ReadLengthHistogram histogram_a(1000);
+    ReadLengthHistogram histogram_b(1000);
+
+    for (size_t i=0; i<lengths.size(); i++){
+        histogram.add(lengths[i]);
+        (i % 2 == 0 ? histogram_a : histogram_b).add(lengths[i]);
+    }
+
+    histogram_a += histogram_b;
+    assert(histogram_a.counts == histogram.counts);
+    assert(accumulate(histogram.counts.begin(), histogram.counts.end(), uint64_t(0)) == lengths.size());
+    assert(histogram.counts[lengths[0]/1000] > 0);
+    cout << "PASS\n";
+
+    ReadLengthHistogram small_histogram(10);
+    for (uint32_t length: {3, 15, 17, 41}){
+        small_histogram.add(length);
+    }
+    cout << small_histogram.to_string();
+
+    return 0;
+}
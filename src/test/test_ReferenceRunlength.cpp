@@ -1,45 +1,233 @@
-
 #include "ReferenceRunlength.hpp"
+#include "SimpleBayesianConsensusCaller.hpp"
+#include "Miscellaneous.hpp"
 #include "boost/program_options.hpp"
 #include <iostream>
+#include <fstream>
+#include <random>
+#include <cmath>
+#include <algorithm>
 #include <experimental/filesystem>
+#include <assert.h>
 
 using std::cout;
 using std::pair;
+using std::ofstream;
+using std::mt19937;
+using std::uniform_int_distribution;
+using std::abs;
+using std::min;
+using std::pow;
+using std::log10;
 using std::experimental::filesystem::path;
+using std::experimental::filesystem::create_directories;
+using std::experimental::filesystem::remove_all;
 using boost::program_options::options_description;
 using boost::program_options::variables_map;
 using boost::program_options::value;
 
 
+void count_runlengths_naively(reference_rle_length_histogram& histogram, const string& sequence){
+    ///
+    /// The simplest possible count of the whole sequence at once, for comparison
+    ///
+    uint64_t max_length = histogram.shape()[1] - 1;
+
+    size_t i = 0;
+    while (i < sequence.size()){
+        char base = char(toupper(sequence[i]));
+        size_t run_start = i;
+
+        while (i < sequence.size() and toupper(sequence[i]) == base){
+            i++;
+        }
+
+        if (is_valid_base(base)){
+            histogram[base_to_index(base)][min(uint64_t(i - run_start), max_length)]++;
+        }
+    }
+}
+
+
+void test_count_runlengths(path directory){
+    uint16_t max_length = 50;
+
+    // Runs of every length up to past the maximum, in mixed case, separated by Ns and other bases
+    mt19937 generator(7);
+    uniform_int_distribution<int> base_distribution(0, 5);
+    uniform_int_distribution<int> length_distribution(1, 60);
+
+    vector<string> sequences = {"AAAACCCGTTTTTTNNAAaaAC", "A", "", "NNNN", string(120, 'g')};
+
+    for (size_t s=0; s<3; s++){
+        string sequence;
+        for (size_t r=0; r<300; r++){
+            sequence += string(length_distribution(generator), "ACGTNa"[base_distribution(generator)]);
+        }
+        sequences.push_back(sequence);
+    }
+
+    path fasta_path = directory / "runs.fasta";
+    ofstream fasta_file(fasta_path);
+    for (size_t s=0; s<sequences.size(); s++){
+        fasta_file << ">" << s << '\n';
+
+        // Wrapped, so that runs also cross line breaks
+        for (size_t i=0; i<sequences[s].size(); i+=13){
+            fasta_file << sequences[s].substr(i, 13) << '\n';
+        }
+    }
+    fasta_file.close();
+
+    reference_rle_length_histogram expected(boost::extents[4][max_length + 1]);
+    for (auto& sequence: sequences){
+        count_runlengths_naively(expected, sequence);
+    }
+
+    cout << "Testing every split point of a sequence: ";
+    for (auto& sequence: sequences){
+        reference_rle_length_histogram whole(boost::extents[4][max_length + 1]);
+        count_runlengths_naively(whole, sequence);
+
+        for (uint64_t split=0; split<=sequence.size(); split++){
+            reference_rle_length_histogram halves(boost::extents[4][max_length + 1]);
+            count_runlengths(halves, sequence, 0, split);
+            count_runlengths(halves, sequence, split, sequence.size());
+
+            assert(halves == whole);
+        }
+    }
+    cout << "PASS\n";
+
+    cout << "Testing chunked, multithreaded counts against a single threaded count: ";
+    FastaTable table(fasta_path, 2);
+
+    for (uint64_t chunk_size: {1, 2, 3, 7, 64, 100000}){
+        for (uint16_t max_threads: {1, 3}){
+            reference_rle_length_histogram result(boost::extents[4][max_length + 1]);
+            count_runlengths(result, table, max_threads, chunk_size);
+
+            assert(result == expected);
+        }
+    }
+    cout << "PASS\n";
+}
+
+
+void test_prior_round_trip(path directory, path project_directory){
+    cout << "Testing that the prior is parsed back by SimpleBayesianConsensusCaller: ";
+
+    // The caller's likelihoods have 51 true lengths, so the prior must too
+    uint16_t max_length = 50;
+    double pseudocount = 1;
+
+    reference_rle_length_histogram histogram(boost::extents[4][max_length + 1]);
+    histogram[0][1] = 100;      // A
+    histogram[3][1] = 50;       // T
+    histogram[3][7] = 3;
+    histogram[1][2] = 20;       // C
+    histogram[2][50] = 9;       // G
+
+    // Replace the priors of an existing config with the new ones
+    string config;
+    read_file_to_string(project_directory / "config" / "SimpleBayesianConsensusCaller-5.csv", config);
+
+    path config_path = directory / "config_with_prior.csv";
+    ofstream config_file(config_path);
+    config_file << ">Name\ntest_ReferenceRunlength\n\n";
+    config_file << reference_histogram_to_prior_string(histogram, pseudocount);
+    config_file << config.substr(config.find(">A likelihood"));
+    config_file.close();
+
+    SimpleBayesianConsensusCaller caller(config_path);
+
+    vector <vector <uint8_t> > base_pairs = {{0, 3}, {1, 2}};
+
+    for (size_t p=0; p<2; p++){
+        const vector<double>& prior = caller.getPrior(p);
+        assert(prior.size() == size_t(max_length + 1));
+
+        double total = 0;
+        for (size_t i=0; i<prior.size(); i++){
+            total += pseudocount + histogram[base_pairs[p][0]][i] + histogram[base_pairs[p][1]][i];
+        }
+
+        double probability_sum = 0;
+        for (size_t i=0; i<prior.size(); i++){
+            double count = pseudocount + histogram[base_pairs[p][0]][i] + histogram[base_pairs[p][1]][i];
+
+            // Written with 9 decimals
+            assert(abs(prior[i] - log10(count/total)) < 1e-8);
+            probability_sum += pow(10, prior[i]);
+        }
+
+        assert(abs(probability_sum - 1) < 1e-6);
+    }
+
+    cout << "PASS\n";
+}
+
+
 int main(int argc, char* argv[]){
     path input_path;
+    path output_dir;
     uint16_t max_length;
+    uint16_t max_threads;
+    double pseudocount;
 
     options_description options("Arguments");
 
     options.add_options()
         ("fasta",
         value<path>(&input_path),
-        "Path to FASTA file containing (reference) sequences")
+        "Path to FASTA file containing (reference) sequences. Without any arguments, only the self checks are run")
+
+        ("output_dir",
+        value<path>(&output_dir)->
+        default_value("output/"),
+        "Path of directory to save prior file")
 
         ("max_length",
         value<uint16_t>(&max_length)->
         default_value(50),
-        "Maximum runlength to count when collecting length observations");
+        "Maximum runlength to count when collecting length observations")
+
+        ("pseudocount",
+        value<double>(&pseudocount)->
+        default_value(1),
+        "Count to add to every length before normalizing")
+
+        ("max_threads",
+        value<uint16_t>(&max_threads)->
+        default_value(1),
+        "Maximum number of threads to launch");
 
     // Store options in a map and apply values to each corresponding variable
     variables_map vm;
     store(parse_command_line(argc, argv, options), vm);
     notify(vm);
 
-    // If help was specified, or no arguments given, provide help
-    if (vm.count("help") || argc == 1) {
+    if (vm.count("help")) {
         cout << options << "\n";
         return 0;
     }
 
-    measure_runlength_priors_from_reference(input_path, max_length);
+    if (argc == 1) {
+        path script_path = __FILE__;
+        path project_directory = script_path.parent_path().parent_path().parent_path();
+
+        path directory = "output/test_ReferenceRunlength/";
+        remove_all(directory);
+        create_directories(directory);
+
+        test_count_runlengths(directory);
+        test_prior_round_trip(directory, project_directory);
+
+        remove_all(directory);
+        return 0;
+    }
+
+    measure_runlength_priors_from_reference(input_path, output_dir, max_length, max_threads, pseudocount);
 
     return 0;
 }
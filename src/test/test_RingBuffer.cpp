@@ -0,0 +1,140 @@
+#include "RingBuffer.hpp"
+#include <iostream>
+#include <deque>
+#include <assert.h>
+
+using std::cout;
+using std::deque;
+
+
+void assert_equal(RingBuffer<uint64_t>& buffer, deque<uint64_t>& expected){
+    assert(buffer.size() == expected.size());
+    assert(buffer.empty() == expected.empty());
+
+    for (size_t i=0; i<expected.size(); i++){
+        assert(buffer[i] == expected[i]);
+    }
+
+    if (not expected.empty()){
+        assert(buffer.front() == expected.front());
+        assert(buffer.back() == expected.back());
+    }
+}
+
+
+int main(){
+    cout << "TESTING CAPACITY ROUNDING\n";
+
+    RingBuffer<uint64_t> buffer(5);
+    assert(buffer.capacity() == 8);
+    assert(buffer.empty());
+
+    cout << "TESTING GROWING WHILE WRAPPED\n";
+
+    deque<uint64_t> expected;
+    uint64_t x = 0;
+
+    // Cycle items through the buffer so that it starts near the end of its storage and wraps around
+    for (size_t i=0; i<6; i++){
+        buffer.push_back(x);
+        expected.push_back(x);
+        x++;
+    }
+
+    for (size_t i=0; i<5; i++){
+        buffer.pop_front();
+        expected.pop_front();
+        assert_equal(buffer, expected);
+    }
+
+    for (size_t i=0; i<7; i++){
+        buffer.push_back(x);
+        expected.push_back(x);
+        x++;
+        assert_equal(buffer, expected);
+    }
+
+    // Full and wrapped, so the next push grows the buffer and must unwrap the items in order
+    assert(buffer.size() == buffer.capacity());
+    assert(buffer.start + buffer.size() > buffer.capacity());
+
+    buffer.push_back(x);
+    expected.push_back(x);
+    x++;
+
+    assert(buffer.capacity() == 16);
+    assert_equal(buffer, expected);
+
+    cout << "TESTING POPPING AFTER GROWING\n";
+
+    while (not expected.empty()){
+        buffer.pop_front();
+        expected.pop_front();
+        assert_equal(buffer, expected);
+    }
+
+    cout << "TESTING MANY CYCLES\n";
+
+    // Push 3 and pop 2 at a time, growing repeatedly while wrapped, and popping several items at once
+    for (size_t i=0; i<1000; i++){
+        for (size_t j=0; j<3; j++){
+            buffer.push_back(x);
+            expected.push_back(x);
+            x++;
+        }
+
+        if (i % 2 == 0){
+            buffer.pop_front();
+            buffer.pop_front();
+        }
+        else{
+            buffer.pop_front(2);
+        }
+
+        expected.pop_front();
+        expected.pop_front();
+        assert_equal(buffer, expected);
+    }
+
+    assert(buffer.capacity() == 1024);
+
+    cout << "TESTING POPPING FROM EMPTY\n";
+
+    buffer.clear();
+    expected.clear();
+    assert_equal(buffer, expected);
+
+    bool threw = false;
+    try {
+        buffer.pop_front();
+    }
+    catch (const runtime_error& e){
+        threw = true;
+    }
+    assert(threw);
+
+    threw = false;
+    try {
+        buffer.push_back(1);
+        buffer.pop_front(2);
+    }
+    catch (const runtime_error& e){
+        threw = true;
+    }
+    assert(threw);
+
+    cout << "TESTING DEFAULT CONSTRUCTOR\n";
+
+    RingBuffer<uint64_t> small_buffer;
+    expected.clear();
+
+    for (uint64_t i=0; i<10; i++){
+        small_buffer.push_back(i);
+        expected.push_back(i);
+        assert_equal(small_buffer, expected);
+    }
+
+    cout << "PASS\n";
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include "Runlength.hpp"
+#include "Matrix.hpp"
+#include <experimental/filesystem>
+#include <iostream>
+#include <random>
+#include <assert.h>
+
+using std::experimental::filesystem::temp_directory_path;
+using std::experimental::filesystem::create_directories;
+using std::experimental::filesystem::remove_all;
+using std::cout;
+using std::mt19937;
+using std::uniform_int_distribution;
+
+
+void test_shard_regions(){
+    cout << "TESTING SHARD ASSIGNMENT\n";
+
+    for (size_t n_entries: {1, 2, 5}){
+        for (size_t n_regions: {1, 3, 4, 10}){
+            for (uint64_t n_shards: {1, 2, 3, 7, 50}){
+                vector<Region> regions;
+
+                for (size_t r=0; r<n_regions; r++){
+                    regions.emplace_back("chr" + to_string(r), 0, 100);
+                }
+
+                // How many shards each (entry, region) unit was assigned to
+                vector <vector <size_t> > n_assigned(n_entries, vector<size_t>(n_regions, 0));
+                vector<size_t> n_units_per_shard(n_shards, 0);
+
+                for (uint64_t s=0; s<n_shards; s++){
+                    for (size_t e=0; e<n_entries; e++){
+                        vector<Region> shard_regions;
+                        get_shard_regions(regions, e, s, n_shards, shard_regions);
+
+                        for (auto& region: shard_regions){
+                            size_t r = std::stoul(region.name.substr(3));
+                            n_assigned[e][r]++;
+                        }
+
+                        n_units_per_shard[s] += shard_regions.size();
+                    }
+                }
+
+                for (size_t e=0; e<n_entries; e++){
+                    for (size_t r=0; r<n_regions; r++){
+                        assert(n_assigned[e][r] == 1);
+                    }
+                }
+
+                // Dealt in turn, so no shard gets more than one unit more than another
+                size_t n_units = n_entries*n_regions;
+
+                for (uint64_t s=0; s<n_shards; s++){
+                    assert(n_units_per_shard[s] == n_units/n_shards or n_units_per_shard[s] == n_units/n_shards + 1);
+                }
+            }
+        }
+    }
+}
+
+
+void test_reduce(path output_directory){
+    cout << "TESTING SHARD REDUCE\n";
+
+    uint64_t n_shards = 3;
+    uint16_t max_runlength = 10;
+
+    mt19937 generator(0);
+    uniform_int_distribution<uint32_t> distribution(0, 5);
+
+    RLEConfusion total(max_runlength);
+
+    for (uint64_t s=0; s<n_shards; s++){
+        RLEConfusion confusion(max_runlength);
+
+        for (size_t i=0; i<confusion.length_matrix.num_elements(); i++){
+            confusion.length_matrix.data()[i] = distribution(generator);
+        }
+
+        for (size_t i=0; i<confusion.base_matrix.num_elements(); i++){
+            confusion.base_matrix.data()[i] = distribution(generator);
+        }
+
+        path shard_directory = get_shard_directory(output_directory, s, n_shards);
+        create_directories(shard_directory);
+
+        write_matrix_to_binary_file(shard_directory / "length_frequency_matrix_directional.bin", confusion.length_matrix);
+        write_matrix_to_binary_file(shard_directory / "base_frequency_matrix_directional.bin", confusion.base_matrix);
+
+        total += confusion;
+    }
+
+    reduce_runlength_distribution_shards(output_directory, n_shards);
+
+    rle_length_matrix length_matrix;
+    read_matrix_from_binary_file(output_directory / "length_frequency_matrix_directional.bin", length_matrix);
+    assert(length_matrix == total.length_matrix);
+
+    rle_base_matrix base_matrix;
+    read_matrix_from_binary_file(output_directory / "base_frequency_matrix_directional.bin", base_matrix);
+    assert(base_matrix == total.base_matrix);
+
+    cout << "TESTING SHARD REDUCE WITH MISSING SHARD\n";
+
+    remove_all(get_shard_directory(output_directory, 1, n_shards));
+
+    bool threw = false;
+    try {
+        reduce_runlength_distribution_shards(output_directory, n_shards);
+    }
+    catch (const runtime_error& e){
+        cout << e.what() << '\n';
+        threw = true;
+    }
+    assert(threw);
+}
+
+
+int main(){
+    test_shard_regions();
+
+    path output_directory = temp_directory_path() / "test_ShardedRunlength";
+    remove_all(output_directory);
+    create_directories(output_directory);
+    test_reduce(output_directory);
+
+    remove_all(output_directory);
+    cout << "PASS\n";
+
+    return 0;
+}
@@ -2,9 +2,14 @@
 #include "SimpleBayesianConsensusCaller.hpp"
 #include <iostream>
 #include <vector>
+#include <random>
+#include <assert.h>
 
 using std::cout;
+using std::min;
 using std::vector;
+using std::mt19937;
+using std::uniform_int_distribution;
 
 
 int main(){
@@ -100,6 +105,36 @@ int main(){
 
     cout << "CONSENSUS: " << consensus[0] << " " << consensus[1] << '\n';
 
+    cout << "Testing incremental coverage consensus: ";
+    mt19937 generator(0);
+    uniform_int_distribution<int> base_distribution(0, 6);
+    uniform_int_distribution<int> length_distribution(1, 60);
+    uniform_int_distribution<int> reversal_distribution(0, 1);
+    uniform_int_distribution<int> size_distribution(0, 130);
+
+    for (size_t t=0; t<200; t++){
+        coverage = {};
+        size_t size = size_distribution(generator);
+
+        // Mostly one base, with gaps, empties and other bases mixed in, so the consensus changes with coverage
+        for (size_t i=0; i<size; i++){
+            int base = base_distribution(generator);
+            base = (base > 3) ? base : ((base < 2) ? int(t%4) : base);
+            float length = (base == 4 or base == 6) ? 0 : float(length_distribution(generator) % (t%2 ? 7 : 60));
+            coverage.push_back({float(base), float(reversal_distribution(generator)), length});
+        }
+
+        vector <vector <float> > consensus_by_coverage;
+        consensus_caller.predictConsensusByCoverage(coverage, 5, 24, consensus_by_coverage);
+        assert(consensus_by_coverage.size() == 24);
+
+        for (size_t i=0; i<24; i++){
+            vector <vector <float> > subset(coverage.begin(), coverage.begin() + min(coverage.size(), (i+1)*5));
+            consensus_caller(subset, consensus);
+            assert(consensus == consensus_by_coverage[i]);
+        }
+    }
+    cout << "PASS\n";
+
     return 0;
 }
-
@@ -0,0 +1,126 @@
+#include "WindowedConsensus.hpp"
+#include "Miscellaneous.hpp"
+#include <experimental/filesystem>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <assert.h>
+
+using std::cout;
+using std::experimental::filesystem::create_directories;
+using std::experimental::filesystem::path;
+using std::thread;
+using std::atomic;
+using std::chrono::milliseconds;
+using std::this_thread::sleep_for;
+
+
+void fill_window_consensus(WindowConsensus& consensus, string& sequence){
+    // Every reference position contributes one base, except position 4 which is followed by an insert
+    for (uint64_t ref_index=consensus.region.start; ref_index<=consensus.region.stop; ref_index++){
+        consensus.sequence += sequence[ref_index];
+
+        if (ref_index == 4){
+            consensus.sequence += 'T';
+        }
+
+        consensus.end_column();
+    }
+}
+
+
+int main(){
+    string contig_a = "ACGTACGTACGGGTTTACAACCAGTC";
+    string contig_b = "TTTGACCA";
+
+    vector<Region> windows;
+    chunk_sequence_into_windows(windows, "a", 10, 3, contig_a.size());
+    chunk_sequence_into_windows(windows, "b", 10, 3, contig_b.size());
+
+    cout << "Testing window boundaries: ";
+    assert(windows.size() == 4);
+    assert(windows[0].start == 0 and windows[0].stop == 12);
+    assert(windows[1].start == 7 and windows[1].stop == 22);
+    assert(windows[2].start == 17 and windows[2].stop == 25);
+    assert(windows[3].start == 0 and windows[3].stop == 7);
+    cout << "PASS\n";
+
+    path output_directory = "output/";
+    create_directories(output_directory);
+    path output_path = output_directory / "test_WindowedConsensus.fasta";
+
+    {
+        ofstream file(output_path);
+        ConsensusStitcher stitcher(windows, file, "_test");
+
+        vector<WindowConsensus> window_consensus;
+        for (size_t i=0; i<windows.size(); i++){
+            window_consensus.emplace_back(windows[i]);
+            fill_window_consensus(window_consensus.back(), (windows[i].name == "a") ? contig_a : contig_b);
+        }
+
+        // The second window disagrees at the middle of its overlap with the first, so the seam moves one base right
+        window_consensus[1].sequence[10 - windows[1].start] = 'N';
+
+        cout << "Testing stitch position: ";
+        assert(find_stitch_position(window_consensus[0], window_consensus[1]) == 11);
+        assert(find_stitch_position(window_consensus[1], window_consensus[2]) == 20);
+        cout << "PASS\n";
+
+        // Add out of order, as threads would
+        for (size_t i: {2, 3, 0, 1}){
+            stitcher.add(i, window_consensus[i]);
+        }
+
+        assert(stitcher.get_n_pending() == 0);
+    }
+
+    cout << "Testing stitched output: ";
+    string result;
+    read_file_to_string(output_path, result);
+
+    string expected = ">a_test\n" + contig_a.substr(0,5) + "T" + contig_a.substr(5) + "\n>b_test\n" + contig_b.substr(0,5) + "T" + contig_b.substr(5) + "\n";
+    assert(result == expected);
+    cout << "PASS\n";
+
+    cout << "Testing bounded pending windows: ";
+    {
+        ofstream file(output_path);
+        ConsensusStitcher stitcher(windows, file, "_test", 2);
+
+        vector<WindowConsensus> window_consensus;
+        for (size_t i=0; i<windows.size(); i++){
+            window_consensus.emplace_back(windows[i]);
+            fill_window_consensus(window_consensus.back(), (windows[i].name == "a") ? contig_a : contig_b);
+        }
+
+        // Windows 0 and 1 are within the limit, and window 2 has to wait until window 0 is written
+        stitcher.wait_for_capacity(0);
+        stitcher.wait_for_capacity(1);
+
+        atomic<bool> released(false);
+        thread producer([&]{
+            stitcher.wait_for_capacity(2);
+            released = true;
+            stitcher.add(2, window_consensus[2]);
+        });
+
+        stitcher.add(0, window_consensus[0]);
+        sleep_for(milliseconds(50));
+        assert(not released);
+
+        stitcher.add(1, window_consensus[1]);
+        producer.join();
+        assert(released);
+
+        stitcher.add(3, window_consensus[3]);
+        assert(stitcher.get_n_pending() == 0);
+    }
+
+    read_file_to_string(output_path, result);
+    assert(result == expected);
+    cout << "PASS\n";
+
+    return 0;
+}
@@ -75,25 +75,24 @@ int main(){
     PileupReadKmerIterator iterator(window_size, depth_index, k);
 
     deque<uint8_t> kmer;
+    KmerReadTable middle_kmers(read_pileup.max_observed_depth);
 
     // Test a single read iterator in the pileup
     for (size_t i=0; i<40 - 1; i++) {
-        unordered_map <uint64_t, unordered_set <uint64_t> > middle_kmers;
+        middle_kmers.clear();
 
         // Walk along the pileup in a windowed manner
         iterator.step(read_pileup, middle_kmers);
 
-        for (const auto& item: iterator.current_kmer) {
-            cout << index_to_base(item);
-        }
+        cout << kmer_index_to_string(iterator.current_kmer_index, iterator.current_kmer_length);
         cout << '\n';
 
-        for (const auto& [middle_kmer_index, coverage_set]: middle_kmers) {
-            index_to_kmer(kmer, middle_kmer_index, k);
+        for (size_t j=0; j<middle_kmers.size(); j++) {
+            index_to_kmer(kmer, middle_kmers.kmers[j], k);
             for (auto& b: kmer) {
                 cout << index_to_base(b);
             }
-            cout << ':' << coverage_set.size() << ',';
+            cout << ':' << middle_kmers.get_coverage(j) << ',';
         }
         cout << '\n' << '\n';
     }
@@ -124,14 +123,14 @@ int main(){
     for (size_t i = 0; i < read_pileup.pileup.size() - 1; i++) {
         ref_pileup_iterator.step(ref_pileup);
 
-        for (auto& [kmer_index, _]: ref_pileup_iterator.middle_kmers){
-            cout << kmer_index_to_string(kmer_index, k);
+        for (size_t j=0; j<ref_pileup_iterator.middle_kmers.size(); j++){
+            cout << kmer_index_to_string(ref_pileup_iterator.middle_kmers.kmers[j], k);
         }
 
         cout << '\n';
 
-        for (auto& [kmer_index, _]: read_pileup_iterator.middle_kmers){
-            cout << kmer_index_to_string(kmer_index, k) << ' ';
+        for (size_t j=0; j<read_pileup_iterator.middle_kmers.size(); j++){
+            cout << kmer_index_to_string(read_pileup_iterator.middle_kmers.kmers[j], k) << ' ';
         }
 
         cout << '\n';